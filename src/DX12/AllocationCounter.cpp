@@ -0,0 +1,105 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+#include "AllocationCounter.h"
+
+#include <atomic>
+
+static std::atomic<uint64_t> s_failedScopeCount(0);
+
+#ifdef HYBRID_SHADOWS_COUNT_ALLOCATIONS
+
+// Per thread so the loader, the async shader compiles and the driver threads don't show up
+// in the render thread's scopes
+static thread_local uint64_t s_allocationCount = 0;
+static thread_local uint32_t s_pauseDepth = 0;
+
+static void* CountedAlloc(size_t size)
+{
+    if (s_pauseDepth == 0)
+        ++s_allocationCount;
+
+    void* p = malloc(size != 0 ? size : 1);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(size_t size) { return CountedAlloc(size); }
+void* operator new[](size_t size) { return CountedAlloc(size); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+uint64_t AllocationCounter::GetCount()
+{
+    return s_allocationCount;
+}
+
+AllocationCounter::Pause::Pause()
+{
+    ++s_pauseDepth;
+}
+
+AllocationCounter::Pause::~Pause()
+{
+    --s_pauseDepth;
+}
+
+#else
+
+uint64_t AllocationCounter::GetCount()
+{
+    return 0;
+}
+
+AllocationCounter::Pause::Pause()
+{
+}
+
+AllocationCounter::Pause::~Pause()
+{
+}
+
+#endif
+
+uint64_t AllocationCounter::GetFailedScopeCount()
+{
+    return s_failedScopeCount.load();
+}
+
+AllocationCounter::Scope::Scope(const char* name, bool bCheck)
+    : m_name(name)
+    , m_start(AllocationCounter::GetCount())
+    , m_bCheck(bCheck)
+{
+}
+
+AllocationCounter::Scope::~Scope()
+{
+    uint64_t const count = AllocationCounter::GetCount() - m_start;
+    if (m_bCheck && count != 0)
+    {
+        ++s_failedScopeCount;
+        Trace(format("%s: %llu heap allocations in the steady state frame\n", m_name, count));
+        assert(!"heap allocation in the steady state frame");
+    }
+}
@@ -0,0 +1,58 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#pragma once
+
+//--------------------------------------------------------------------------------------
+// Counts the heap allocations made through the global operator new, used to check that
+// the steady state frame doesn't allocate. The count is per thread, a scope only sees the
+// allocations of the thread it lives on. The counting operator new is only compiled in
+// when building with HYBRID_SHADOWS_COUNT_ALLOCATIONS, otherwise the count stays at zero.
+// A checked scope that saw an allocation asserts, and is counted so release builds (the
+// benchmark, the tests) can still tell.
+//--------------------------------------------------------------------------------------
+class AllocationCounter
+{
+public:
+    // Allocations made by the calling thread so far, except for the paused ones
+    static uint64_t GetCount();
+    // Checked scopes that saw an allocation so far, on any thread
+    static uint64_t GetFailedScopeCount();
+
+    // Leaves the thread's allocations out of the count while it's alive, for the calls into
+    // Cauldron and ImGui the steady state frame can't avoid
+    class Pause
+    {
+    public:
+        Pause();
+        ~Pause();
+    };
+
+    // Asserts that the thread didn't allocate while the scope was alive
+    class Scope
+    {
+    public:
+        Scope(const char* name, bool bCheck);
+        ~Scope();
+
+    private:
+        const char* m_name;
+        uint64_t m_start;
+        bool m_bCheck;
+    };
+};
@@ -0,0 +1,308 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include "stdafx.h"
+
+#include "AlphaMaskPacker.h"
+
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <emmintrin.h>
+
+namespace
+{
+    float Coverage(AlphaMaskPacker::AlphaMask const& mask, float alphaCutoff, float scale)
+    {
+        float const threshold = alphaCutoff * 255.0f;
+        size_t covered = 0;
+        for (uint8_t alpha : mask.alpha)
+        {
+            covered += min(alpha * scale, 255.0f) > threshold ? 1 : 0;
+        }
+        return (float)covered / (float)mask.alpha.size();
+    }
+
+    // One axis of Resample, over lineCount lines whose texels are sourceStep and destinationStep apart.
+    // The values are fixed point with the given number of fractional bits, so that the pass between
+    // the axes doesn't round.
+    template <uint32_t SourceShift, uint32_t DestinationShift, typename Source, typename Destination>
+    void Resample1D(Source const* pSource, uint32_t sourceSize, uint32_t sourceStep, Destination* pDestination, uint32_t destinationSize, uint32_t destinationStep,
+        uint32_t lineCount, uint32_t sourceLineStep, uint32_t destinationLineStep)
+    {
+        for (uint32_t line = 0; line < lineCount; ++line)
+        {
+            Source const* pSourceLine = pSource + (size_t)line * sourceLineStep;
+            Destination* pDestinationLine = pDestination + (size_t)line * destinationLineStep;
+            for (uint32_t i = 0; i < destinationSize; ++i)
+            {
+                uint64_t value;
+                if (destinationSize <= sourceSize)
+                {
+                    uint32_t const first = (uint32_t)((uint64_t)i * sourceSize / destinationSize);
+                    uint32_t const last = max(first + 1, (uint32_t)((uint64_t)(i + 1) * sourceSize / destinationSize));
+                    uint64_t sum = 0;
+                    for (uint32_t s = first; s < last; ++s)
+                    {
+                        sum += pSourceLine[(size_t)s * sourceStep];
+                    }
+                    uint64_t const count = (uint64_t)(last - first) << SourceShift;
+                    value = ((sum << DestinationShift) + count / 2) / count;
+                }
+                else
+                {
+                    float const position = (i + 0.5f) * sourceSize / destinationSize - 0.5f;
+                    float const base = floorf(position);
+                    float const weight = position - base;
+                    uint32_t const s0 = ((int32_t)base + sourceSize) % sourceSize;
+                    uint32_t const s1 = (s0 + 1) % sourceSize;
+                    float const blend = pSourceLine[(size_t)s0 * sourceStep] * (1.0f - weight) + pSourceLine[(size_t)s1 * sourceStep] * weight;
+                    value = (uint64_t)(ldexpf(blend, (int)DestinationShift - (int)SourceShift) + 0.5f);
+                }
+                pDestinationLine[(size_t)i * destinationStep] = (Destination)value;
+            }
+        }
+    }
+
+    // Smallest and largest byte of a block in every lane
+    __m128i HorizontalMin(__m128i v)
+    {
+        v = _mm_min_epu8(v, _mm_srli_si128(v, 8));
+        v = _mm_min_epu8(v, _mm_srli_si128(v, 4));
+        v = _mm_min_epu8(v, _mm_srli_si128(v, 2));
+        return _mm_min_epu8(v, _mm_srli_si128(v, 1));
+    }
+
+    __m128i HorizontalMax(__m128i v)
+    {
+        v = _mm_max_epu8(v, _mm_srli_si128(v, 8));
+        v = _mm_max_epu8(v, _mm_srli_si128(v, 4));
+        v = _mm_max_epu8(v, _mm_srli_si128(v, 2));
+        return _mm_max_epu8(v, _mm_srli_si128(v, 1));
+    }
+
+    // BC4 with the endpoints at the extremes of the block in the 8 value mode, a texel takes the
+    // interpolated value nearest to it, step 0 being the smallest and 7 the largest
+    void EncodeBlock(__m128i texels, uint8_t* pBlock)
+    {
+        uint8_t const lo = (uint8_t)_mm_cvtsi128_si32(HorizontalMin(texels));
+        uint8_t const hi = (uint8_t)_mm_cvtsi128_si32(HorizontalMax(texels));
+
+        pBlock[0] = hi;
+        pBlock[1] = lo;
+        memset(pBlock + 2, 0, 6);
+        if (hi == lo)
+            return;
+
+        // the step is the number of midpoints between the steps that (texel - lo) * 14 reaches,
+        // the midpoint k sits at (2k - 1) * range
+        uint32_t const range = hi - lo;
+        __m128i const zero = _mm_setzero_si128();
+        __m128i const vLo = _mm_set1_epi16(lo);
+        __m128i const vFourteen = _mm_set1_epi16(14);
+
+        __m128i steps[2];
+        for (uint32_t half = 0; half < 2; ++half)
+        {
+            __m128i const v = half == 0 ? _mm_unpacklo_epi8(texels, zero) : _mm_unpackhi_epi8(texels, zero);
+            __m128i const scaled = _mm_mullo_epi16(_mm_sub_epi16(v, vLo), vFourteen);
+
+            steps[half] = zero;
+            for (uint32_t k = 1; k < 8; ++k)
+            {
+                __m128i const midpoint = _mm_set1_epi16((short)((2 * k - 1) * range - 1));
+                steps[half] = _mm_sub_epi16(steps[half], _mm_cmpgt_epi16(scaled, midpoint));
+            }
+        }
+
+        uint8_t step[16];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(step), _mm_packus_epi16(steps[0], steps[1]));
+
+        // palette order, hi then lo then the values from hi down to lo
+        static uint8_t const k_stepToIndex[8] = { 1, 7, 6, 5, 4, 3, 2, 0 };
+        uint64_t bits = 0;
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            bits |= (uint64_t)k_stepToIndex[step[i]] << (3 * i);
+        }
+        for (uint32_t i = 0; i < 6; ++i)
+        {
+            pBlock[2 + i] = (uint8_t)(bits >> (8 * i));
+        }
+    }
+}
+
+void AlphaMaskPacker::ExtractAlpha(uint32_t const* pPixels, size_t pixelCount, uint8_t* pAlpha)
+{
+    size_t i = 0;
+    for (; i + 16 <= pixelCount; i += 16)
+    {
+        __m128i const p0 = _mm_srli_epi32(_mm_loadu_si128(reinterpret_cast<__m128i const*>(pPixels + i + 0)), 24);
+        __m128i const p1 = _mm_srli_epi32(_mm_loadu_si128(reinterpret_cast<__m128i const*>(pPixels + i + 4)), 24);
+        __m128i const p2 = _mm_srli_epi32(_mm_loadu_si128(reinterpret_cast<__m128i const*>(pPixels + i + 8)), 24);
+        __m128i const p3 = _mm_srli_epi32(_mm_loadu_si128(reinterpret_cast<__m128i const*>(pPixels + i + 12)), 24);
+        __m128i const alpha = _mm_packus_epi16(_mm_packs_epi32(p0, p1), _mm_packs_epi32(p2, p3));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pAlpha + i), alpha);
+    }
+    for (; i < pixelCount; ++i)
+    {
+        pAlpha[i] = (uint8_t)(pPixels[i] >> 24);
+    }
+}
+
+void AlphaMaskPacker::Resample(AlphaMask const& source, uint32_t width, uint32_t height, AlphaMask& destination)
+{
+    std::vector<uint16_t> rows((size_t)width * source.height);
+    Resample1D<0, 8>(source.alpha.data(), source.width, 1, rows.data(), width, 1, source.height, source.width, width);
+
+    destination.width = width;
+    destination.height = height;
+    destination.alpha.resize((size_t)width * height);
+    Resample1D<8, 0>(rows.data(), source.height, width, destination.alpha.data(), height, width, width, 1, 1);
+}
+
+void AlphaMaskPacker::BuildMipChain(AlphaMask const& top, uint32_t mipCount, float alphaCutoff, std::vector<AlphaMask>& mips)
+{
+    mips.resize(mipCount);
+    if (mipCount == 0)
+        return;
+
+    mips[0] = top;
+    float const coverage = Coverage(top, alphaCutoff, 1.0f);
+
+    // each mip is filtered from the unscaled one above it, so the scales don't add up
+    AlphaMask filtered = top;
+    for (uint32_t mip = 1; mip < mipCount; ++mip)
+    {
+        AlphaMask next;
+        Resample(filtered, max(filtered.width / 2, 1u), max(filtered.height / 2, 1u), next);
+        filtered = next;
+
+        float lowScale = 0.0f;
+        float highScale = 4.0f;
+        for (uint32_t iteration = 0; iteration < 12; ++iteration)
+        {
+            float const scale = 0.5f * (lowScale + highScale);
+            if (Coverage(filtered, alphaCutoff, scale) < coverage)
+            {
+                lowScale = scale;
+            }
+            else
+            {
+                highScale = scale;
+            }
+        }
+
+        // the coverage goes up in steps, take the side of the last one that is closer
+        float const lowError = fabsf(Coverage(filtered, alphaCutoff, lowScale) - coverage);
+        float const highError = fabsf(Coverage(filtered, alphaCutoff, highScale) - coverage);
+        float const scale = lowError < highError ? lowScale : highScale;
+        for (uint8_t& alpha : next.alpha)
+        {
+            alpha = (uint8_t)min(alpha * scale + 0.5f, 255.0f);
+        }
+        mips[mip] = std::move(next);
+    }
+}
+
+size_t AlphaMaskPacker::GetBC4Size(uint32_t width, uint32_t height)
+{
+    return (size_t)(width / 4) * (height / 4) * 8;
+}
+
+void AlphaMaskPacker::EncodeBC4(AlphaMask const& mask, uint8_t* pBlocks)
+{
+    for (uint32_t y = 0; y < mask.height; y += 4)
+    {
+        for (uint32_t x = 0; x < mask.width; x += 4)
+        {
+            int32_t rows[4];
+            for (uint32_t row = 0; row < 4; ++row)
+            {
+                memcpy(&rows[row], mask.alpha.data() + (size_t)(y + row) * mask.width + x, 4);
+            }
+
+            EncodeBlock(_mm_setr_epi32(rows[0], rows[1], rows[2], rows[3]), pBlocks);
+            pBlocks += 8;
+        }
+    }
+}
+
+void AlphaMaskPacker::DecodeBC4(uint8_t const* pBlocks, uint32_t width, uint32_t height, AlphaMask& mask)
+{
+    mask.width = width;
+    mask.height = height;
+    mask.alpha.resize((size_t)width * height);
+    for (uint32_t y = 0; y < height; y += 4)
+    {
+        for (uint32_t x = 0; x < width; x += 4)
+        {
+            uint32_t const a0 = pBlocks[0];
+            uint32_t const a1 = pBlocks[1];
+            uint8_t palette[8] = { (uint8_t)a0, (uint8_t)a1 };
+            if (a0 > a1)
+            {
+                for (uint32_t i = 1; i < 7; ++i)
+                {
+                    palette[i + 1] = (uint8_t)(((7 - i) * a0 + i * a1 + 3) / 7);
+                }
+            }
+            else
+            {
+                for (uint32_t i = 1; i < 5; ++i)
+                {
+                    palette[i + 1] = (uint8_t)(((5 - i) * a0 + i * a1 + 2) / 5);
+                }
+                palette[6] = 0;
+                palette[7] = 255;
+            }
+
+            uint64_t bits = 0;
+            for (uint32_t i = 0; i < 6; ++i)
+            {
+                bits |= (uint64_t)pBlocks[2 + i] << (8 * i);
+            }
+            for (uint32_t i = 0; i < 16; ++i)
+            {
+                mask.alpha[(size_t)(y + i / 4) * width + x + i % 4] = palette[(bits >> (3 * i)) & 0x7];
+            }
+            pBlocks += 8;
+        }
+    }
+}
+
+float AlphaMaskPacker::GetUVDensity(float const edge1[3], float const edge2[3], float const uv01[2], float const uv02[2])
+{
+    float const normal[3] =
+    {
+        edge1[1] * edge2[2] - edge1[2] * edge2[1],
+        edge1[2] * edge2[0] - edge1[0] * edge2[2],
+        edge1[0] * edge2[1] - edge1[1] * edge2[0],
+    };
+    float const area = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+    float const uvArea = std::fabs(uv01[0] * uv02[1] - uv01[1] * uv02[0]);
+
+    // degenerate triangles in either space stay finite, they're never hit or sample a single texel
+    return 0.5f * std::log2(max(uvArea, FLT_MIN) / max(area, FLT_MIN));
+}
+
+float AlphaMaskPacker::GetConeMipLevel(float uvDensity, float coneWidth, uint32_t width, uint32_t height)
+{
+    // the width of the cone in texels is coneWidth * sqrt(texels per unit area)
+    return std::log2(max(coneWidth, FLT_MIN)) + uvDensity + 0.5f * std::log2((float)width * (float)height);
+}
@@ -0,0 +1,53 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#pragma once
+
+#include "OpacityMicromap.h"
+
+//--------------------------------------------------------------------------------------
+// Builds the single channel alpha masks the shadow rays test against. The alpha of the
+// base color textures is extracted, resampled to the size of the mask array and
+// compressed to BC4 with a short mip chain. The mips are rescaled so that they keep the
+// alpha tested coverage of the top mip. Only depends on the standard library and SSE2.
+//--------------------------------------------------------------------------------------
+class AlphaMaskPacker
+{
+public:
+    typedef OpacityMicromap::AlphaMask AlphaMask;
+
+    // Top byte of each 32 bit RGBA or BGRA pixel
+    static void ExtractAlpha(uint32_t const* pPixels, size_t pixelCount, uint8_t* pAlpha);
+
+    // Box filtered when shrinking and linearly interpolated when growing, with wrap addressing
+    static void Resample(AlphaMask const& source, uint32_t width, uint32_t height, AlphaMask& destination);
+
+    // mips[0] is top, each mip halves the previous one, the sizes have to be powers of two
+    static void BuildMipChain(AlphaMask const& top, uint32_t mipCount, float alphaCutoff, std::vector<AlphaMask>& mips);
+
+    // 8 bytes per 4x4 block, the blocks row by row, the size has to be a multiple of 4
+    static size_t GetBC4Size(uint32_t width, uint32_t height);
+    static void EncodeBC4(AlphaMask const& mask, uint8_t* pBlocks);
+    static void DecodeBC4(uint8_t const* pBlocks, uint32_t width, uint32_t height, AlphaMask& mask);
+
+    // Ray cone mip selection, CheckAlphaMask in ShadowRaytrace.hlsl does the same math. The density
+    // is stored per triangle, half the log2 of its UV area over its area in the space of the edges.
+    // The cone width is the footprint of the cone at the hit in that same space.
+    static float GetUVDensity(float const edge1[3], float const edge2[3], float const uv01[2], float const uv02[2]);
+    static float GetConeMipLevel(float uvDensity, float coneWidth, uint32_t width, uint32_t height);
+};
@@ -0,0 +1,117 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+
+#include "BLASSkinning.h"
+
+namespace
+{
+	uint32_t const k_threadGroupSize = 64;
+}
+
+namespace Raytracing
+{
+	BLASSkinning::BLASSkinning(void)
+		: m_pRootSignature(nullptr)
+		, m_pPipelineState(nullptr)
+	{
+	}
+
+	BLASSkinning::~BLASSkinning(void)
+	{
+	}
+
+	void BLASSkinning::OnCreate(Device* pDevice)
+	{
+		// Create root signature
+		//
+		{
+			CD3DX12_ROOT_PARAMETER rootParameters[6] = {};
+			rootParameters[0].InitAsConstants(3, 0);
+			rootParameters[1].InitAsConstantBufferView(1);
+			rootParameters[2].InitAsShaderResourceView(0);
+			rootParameters[3].InitAsShaderResourceView(1);
+			rootParameters[4].InitAsShaderResourceView(2);
+			rootParameters[5].InitAsUnorderedAccessView(0);
+
+			CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc;
+			rootSignatureDesc.Init(_countof(rootParameters), rootParameters, 0, nullptr);
+
+			ID3DBlob* pOutBlob, * pErrorBlob = NULL;
+			ThrowIfFailed(D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &pOutBlob, &pErrorBlob));
+			ThrowIfFailed(
+				pDevice->GetDevice()->CreateRootSignature(0, pOutBlob->GetBufferPointer(), pOutBlob->GetBufferSize(), IID_PPV_ARGS(&m_pRootSignature))
+			);
+			SetName(m_pRootSignature, "m_pSkinningRootSig");
+
+			pOutBlob->Release();
+			if (pErrorBlob)
+				pErrorBlob->Release();
+		}
+
+		// Create pipeline
+		//
+		{
+			D3D12_SHADER_BYTECODE shaderByteCode = {};
+			CompileShaderFromFile("BLASSkinning.hlsl", NULL, "main", "-T cs_6_0", &shaderByteCode);
+
+			D3D12_COMPUTE_PIPELINE_STATE_DESC pipelineStateDesc = {};
+			pipelineStateDesc.pRootSignature = m_pRootSignature;
+			pipelineStateDesc.CS = shaderByteCode;
+
+			ThrowIfFailed(pDevice->GetDevice()->CreateComputePipelineState(&pipelineStateDesc, IID_PPV_ARGS(&m_pPipelineState)));
+			SetName(m_pPipelineState, "m_pSkinningPso");
+		}
+	}
+
+	void BLASSkinning::OnDestroy()
+	{
+		if (m_pPipelineState)
+		{
+			m_pPipelineState->Release();
+			m_pPipelineState = nullptr;
+		}
+
+		if (m_pRootSignature)
+		{
+			m_pRootSignature->Release();
+			m_pRootSignature = nullptr;
+		}
+	}
+
+	void BLASSkinning::Dispatch(ID3D12GraphicsCommandList* pCommandList, SkinnedGeometry const& geometry, D3D12_GPU_VIRTUAL_ADDRESS skinningMatrices, D3D12_GPU_VIRTUAL_ADDRESS output)
+	{
+		assert(skinningMatrices != 0);
+
+		uint32_t const constants[3] = { geometry.vertexCount, geometry.jointStride, geometry.outputOffset };
+
+		pCommandList->SetComputeRootSignature(m_pRootSignature);
+		pCommandList->SetPipelineState(m_pPipelineState);
+
+		pCommandList->SetComputeRoot32BitConstants(0, _countof(constants), constants, 0);
+		pCommandList->SetComputeRootConstantBufferView(1, skinningMatrices);
+		pCommandList->SetComputeRootShaderResourceView(2, geometry.positions);
+		pCommandList->SetComputeRootShaderResourceView(3, geometry.joints);
+		pCommandList->SetComputeRootShaderResourceView(4, geometry.weights);
+		pCommandList->SetComputeRootUnorderedAccessView(5, output);
+
+		pCommandList->Dispatch((geometry.vertexCount + k_threadGroupSize - 1) / k_threadGroupSize, 1, 1);
+	}
+}
@@ -0,0 +1,53 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#pragma once
+
+namespace Raytracing
+{
+	// Where a skinned primitive's vertex streams are and where its skinned positions go
+	struct SkinnedGeometry
+	{
+		D3D12_GPU_VIRTUAL_ADDRESS positions;
+		D3D12_GPU_VIRTUAL_ADDRESS joints;
+		D3D12_GPU_VIRTUAL_ADDRESS weights;
+		uint32_t vertexCount;
+		uint32_t jointStride;
+		uint32_t outputOffset;
+		int skinIndex;
+		size_t structureIndex;
+	};
+
+	// Skins the positions of the BLAS geometry in a compute pass, one thread per skinned vertex
+	class BLASSkinning
+	{
+	public:
+		BLASSkinning(void);
+		~BLASSkinning(void);
+
+		void OnCreate(Device* pDevice);
+		void OnDestroy();
+
+		// The output is the base address of the skinned positions buffer, the geometry has its offset in it
+		void Dispatch(ID3D12GraphicsCommandList* pCommandList, SkinnedGeometry const& geometry, D3D12_GPU_VIRTUAL_ADDRESS skinningMatrices, D3D12_GPU_VIRTUAL_ADDRESS output);
+
+	private:
+		ID3D12RootSignature* m_pRootSignature;
+		ID3D12PipelineState* m_pPipelineState;
+	};
+}
@@ -29,6 +29,9 @@ void CSMManager::OnCreate(int numCascades)
     m_fCascadePartitionsFrustum.clear();
     m_fCascadePartitionsFrustum.resize(numCascades);
 
+    m_casterCullVolumes.clear();
+    m_casterCullVolumes.resize(2 * numCascades);
+
     m_vSceneAABBPointsLightSpaceCenter.clear();
     m_vSceneAABBPointsLightSpaceCenter.resize(numCascades);
 
@@ -93,17 +96,416 @@ void CSMManager::CreateFrustumPointsFromCascadeInterval(float camNear, float fCa
     pvCornerPointsWorld[7].setW(1.0f);
 }
 
-void CSMManager::SetupCascades(math::Matrix4 matCameraProjection, math::Matrix4 matViewCameraView,
+//--------------------------------------------------------------------------------------
+// Batched version of CreateFrustumPointsFromCascadeInterval followed by the min/max of the
+// corners in view and light space. The data is laid out as structure of arrays with one
+// cascade per SSE lane, so the 8 corners of all the cascades are processed together and
+// the inverse projection is only computed once.
+//--------------------------------------------------------------------------------------
+void CSMManager::ComputeCascadeFrustumBounds(math::Matrix4 const& matCameraProjection,
+    math::Matrix4 const& matInverseViewCamera, math::Matrix4 const& matLightCameraView, float camNear,
+    int numCascades, float const* pIntervalBegin, float const* pIntervalEnd, CascadeFrustumBounds* pBounds)
+{
+    assert(numCascades <= MaxCascades);
+
+    // Corners of the near plane in view space, the cascade corners are these scaled by interval / camNear.
+    math::Matrix4 inverseProjection = math::inverse(matCameraProjection);
+    math::Vector4 vNearCorners[4] = {
+        inverseProjection * math::Vector4(-1.0f, 1.0f, 0.0f, 1.0f),
+        inverseProjection * math::Vector4(1.0f, 1.0f, 0.0f, 1.0f),
+        inverseProjection * math::Vector4(-1.0f, -1.0f, 0.0f, 1.0f),
+        inverseProjection * math::Vector4(1.0f, -1.0f, 0.0f, 1.0f),
+    };
+    for (int i = 0; i < 4; ++i)
+    {
+        vNearCorners[i] /= vNearCorners[i].getW();
+    }
+
+    // View space straight to light space.
+    math::Matrix4 matViewToLight = matLightCameraView * matInverseViewCamera;
+
+    float beginScale[MaxCascades] = {};
+    float endScale[MaxCascades] = {};
+    for (int i = 0; i < numCascades; ++i)
+    {
+        beginScale[i] = pIntervalBegin[i] / camNear;
+        endScale[i] = pIntervalEnd[i] / camNear;
+    }
+    __m128 const scales[2] = { _mm_loadu_ps(beginScale), _mm_loadu_ps(endScale) };
+
+    __m128 frustumMin[3], frustumMax[3], lightMin[3], lightMax[3];
+    for (int c = 0; c < 3; ++c)
+    {
+        frustumMin[c] = lightMin[c] = _mm_set1_ps(FLT_MAX);
+        frustumMax[c] = lightMax[c] = _mm_set1_ps(-FLT_MAX);
+    }
+    __m128 radiusSq = _mm_setzero_ps();
+    __m128 corner[8][3];
+
+    for (int plane = 0; plane < 2; ++plane)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            __m128* p = corner[plane * 4 + i];
+            p[0] = _mm_mul_ps(_mm_set1_ps(vNearCorners[i].getX()), scales[plane]);
+            p[1] = _mm_mul_ps(_mm_set1_ps(vNearCorners[i].getY()), scales[plane]);
+            p[2] = _mm_mul_ps(_mm_set1_ps(vNearCorners[i].getZ()), scales[plane]);
+
+            radiusSq = _mm_max_ps(radiusSq, _mm_add_ps(_mm_add_ps(_mm_mul_ps(p[0], p[0]), _mm_mul_ps(p[1], p[1])), _mm_mul_ps(p[2], p[2])));
+
+            for (int c = 0; c < 3; ++c)
+            {
+                frustumMin[c] = _mm_min_ps(frustumMin[c], p[c]);
+                frustumMax[c] = _mm_max_ps(frustumMax[c], p[c]);
+
+                // Row c of the view to light transform, the corners have w = 1.
+                __m128 l = _mm_set1_ps(matViewToLight.getElem(3, c));
+                l = _mm_add_ps(l, _mm_mul_ps(_mm_set1_ps(matViewToLight.getElem(0, c)), p[0]));
+                l = _mm_add_ps(l, _mm_mul_ps(_mm_set1_ps(matViewToLight.getElem(1, c)), p[1]));
+                l = _mm_add_ps(l, _mm_mul_ps(_mm_set1_ps(matViewToLight.getElem(2, c)), p[2]));
+
+                lightMin[c] = _mm_min_ps(lightMin[c], l);
+                lightMax[c] = _mm_max_ps(lightMax[c], l);
+            }
+        }
+    }
+
+    // Corners 0 and 6 span the diagonal of the interval, its length is the same in view and world space.
+    __m128 diagonalSq = _mm_setzero_ps();
+    for (int c = 0; c < 3; ++c)
+    {
+        __m128 d = _mm_sub_ps(corner[0][c], corner[6][c]);
+        diagonalSq = _mm_add_ps(diagonalSq, _mm_mul_ps(d, d));
+    }
+
+    // Back to one vector per cascade, w is 1 like the points the bounds were computed from.
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 frustumMinW = one, frustumMaxW = one, lightMinW = one, lightMaxW = one;
+    _MM_TRANSPOSE4_PS(frustumMin[0], frustumMin[1], frustumMin[2], frustumMinW);
+    _MM_TRANSPOSE4_PS(frustumMax[0], frustumMax[1], frustumMax[2], frustumMaxW);
+    _MM_TRANSPOSE4_PS(lightMin[0], lightMin[1], lightMin[2], lightMinW);
+    _MM_TRANSPOSE4_PS(lightMax[0], lightMax[1], lightMax[2], lightMaxW);
+
+    __m128 const frustumMinOut[4] = { frustumMin[0], frustumMin[1], frustumMin[2], frustumMinW };
+    __m128 const frustumMaxOut[4] = { frustumMax[0], frustumMax[1], frustumMax[2], frustumMaxW };
+    __m128 const lightMinOut[4] = { lightMin[0], lightMin[1], lightMin[2], lightMinW };
+    __m128 const lightMaxOut[4] = { lightMax[0], lightMax[1], lightMax[2], lightMaxW };
+
+    float radius[MaxCascades], diagonal[MaxCascades];
+    _mm_storeu_ps(radius, _mm_sqrt_ps(radiusSq));
+    _mm_storeu_ps(diagonal, _mm_sqrt_ps(diagonalSq));
+
+    for (int i = 0; i < numCascades; ++i)
+    {
+        pBounds[i].vFrustumMin = math::Vector4(frustumMinOut[i]);
+        pBounds[i].vFrustumMax = math::Vector4(frustumMaxOut[i]);
+        pBounds[i].vLightMin = math::Vector4(lightMinOut[i]);
+        pBounds[i].vLightMax = math::Vector4(lightMaxOut[i]);
+        pBounds[i].fSphereRadius = radius[i];
+        pBounds[i].fDiagonal = diagonal[i];
+    }
+}
+
+//--------------------------------------------------------------------------------------
+// Computes the near and far plane of a cascade by clipping the triangles of the scene AABB
+// (in light space) against the 4 sides of the orthographic projection. The min and max Z
+// of the surviving vertices bound everything that can cast into or receive from the cascade.
+//--------------------------------------------------------------------------------------
+void CSMManager::ComputeNearAndFar(FLOAT& fNearPlane, FLOAT& fFarPlane,
+    math::Vector4 vLightCameraOrthographicMin,
+    math::Vector4 vLightCameraOrthographicMax,
+    math::Vector4* pvPointsInCameraView)
+{
+    // Initialize the near and far planes
+    fNearPlane = FLT_MAX;
+    fFarPlane = -FLT_MAX;
+
+    // Every triangle can be clipped at most once per plane, 16 is enough for the 4 planes.
+    Triangle triangleList[16];
+    INT iTriangleCnt = 1;
+
+    // These are the indices used to tesselate an AABB into a list of triangles.
+    static const INT iAABBTriIndexes[] =
+    {
+        0,1,2,  1,2,3,
+        4,5,6,  5,6,7,
+        0,2,4,  2,4,6,
+        1,3,5,  3,5,7,
+        0,1,4,  1,4,5,
+        2,3,6,  3,6,7
+    };
+
+    INT iPointPassesCollision[3];
+
+    // At a high level:
+    // 1. Iterate over all 12 triangles of the AABB.
+    // 2. Clip the triangles against each plane. Create new triangles as needed.
+    // 3. Find the min and max z values as the near and far plane.
+    for (INT AABBTriIter = 0; AABBTriIter < 12; ++AABBTriIter)
+    {
+        triangleList[0].pt[0] = pvPointsInCameraView[iAABBTriIndexes[AABBTriIter * 3 + 0]];
+        triangleList[0].pt[1] = pvPointsInCameraView[iAABBTriIndexes[AABBTriIter * 3 + 1]];
+        triangleList[0].pt[2] = pvPointsInCameraView[iAABBTriIndexes[AABBTriIter * 3 + 2]];
+        iTriangleCnt = 1;
+        triangleList[0].culled = false;
+
+        // Clip each individual triangle against the 4 frustum planes. Whenever a triangle is clipped into new triangles,
+        // add them to the list.
+        for (INT frustumPlaneIter = 0; frustumPlaneIter < 4; ++frustumPlaneIter)
+        {
+            FLOAT fEdge;
+            INT iComponent;
+            FLOAT fSign;
+
+            if (frustumPlaneIter == 0)
+            {
+                fEdge = vLightCameraOrthographicMin.getX();
+                iComponent = 0;
+                fSign = 1.0f;
+            }
+            else if (frustumPlaneIter == 1)
+            {
+                fEdge = vLightCameraOrthographicMax.getX();
+                iComponent = 0;
+                fSign = -1.0f;
+            }
+            else if (frustumPlaneIter == 2)
+            {
+                fEdge = vLightCameraOrthographicMin.getY();
+                iComponent = 1;
+                fSign = 1.0f;
+            }
+            else
+            {
+                fEdge = vLightCameraOrthographicMax.getY();
+                iComponent = 1;
+                fSign = -1.0f;
+            }
+
+            for (INT triIter = 0; triIter < iTriangleCnt; ++triIter)
+            {
+                // We don't delete triangles, so we skip those that have been culled.
+                if (triangleList[triIter].culled)
+                    continue;
+
+                INT iInsideVertCount = 0;
+                math::Vector4 tempOrder;
+
+                // Test against the current frustum plane.
+                for (INT triPtIter = 0; triPtIter < 3; ++triPtIter)
+                {
+                    iPointPassesCollision[triPtIter] = (triangleList[triIter].pt[triPtIter].getElem(iComponent) - fEdge) * fSign > 0.0f ? 1 : 0;
+                    iInsideVertCount += iPointPassesCollision[triPtIter];
+                }
+
+                // Move the points that pass the frustum test to the beginning of the array.
+                if (iPointPassesCollision[1] && !iPointPassesCollision[0])
+                {
+                    tempOrder = triangleList[triIter].pt[0];
+                    triangleList[triIter].pt[0] = triangleList[triIter].pt[1];
+                    triangleList[triIter].pt[1] = tempOrder;
+                    iPointPassesCollision[0] = TRUE;
+                    iPointPassesCollision[1] = FALSE;
+                }
+                if (iPointPassesCollision[2] && !iPointPassesCollision[1])
+                {
+                    tempOrder = triangleList[triIter].pt[1];
+                    triangleList[triIter].pt[1] = triangleList[triIter].pt[2];
+                    triangleList[triIter].pt[2] = tempOrder;
+                    iPointPassesCollision[1] = TRUE;
+                    iPointPassesCollision[2] = FALSE;
+                }
+                if (iPointPassesCollision[1] && !iPointPassesCollision[0])
+                {
+                    tempOrder = triangleList[triIter].pt[0];
+                    triangleList[triIter].pt[0] = triangleList[triIter].pt[1];
+                    triangleList[triIter].pt[1] = tempOrder;
+                    iPointPassesCollision[0] = TRUE;
+                    iPointPassesCollision[1] = FALSE;
+                }
+
+                if (iInsideVertCount == 0)
+                {
+                    // All points failed. We're done.
+                    triangleList[triIter].culled = true;
+                }
+                else if (iInsideVertCount == 1)
+                {
+                    // One point passed. Clip the triangle against the frustum plane.
+                    triangleList[triIter].culled = false;
+
+                    math::Vector4 vVert0ToVert1 = triangleList[triIter].pt[1] - triangleList[triIter].pt[0];
+                    math::Vector4 vVert0ToVert2 = triangleList[triIter].pt[2] - triangleList[triIter].pt[0];
+
+                    // Find the collision ratio.
+                    FLOAT fHitPointTimeRatio = fEdge - triangleList[triIter].pt[0].getElem(iComponent);
+                    // Calculate the distance along the vector as ratio of the hit ratio to the component.
+                    FLOAT fDistanceAlongVector01 = fHitPointTimeRatio / vVert0ToVert1.getElem(iComponent);
+                    FLOAT fDistanceAlongVector02 = fHitPointTimeRatio / vVert0ToVert2.getElem(iComponent);
+                    // Add the point plus a percentage of the vector.
+                    vVert0ToVert1 = triangleList[triIter].pt[0] + vVert0ToVert1 * fDistanceAlongVector01;
+                    vVert0ToVert2 = triangleList[triIter].pt[0] + vVert0ToVert2 * fDistanceAlongVector02;
+
+                    triangleList[triIter].pt[1] = vVert0ToVert2;
+                    triangleList[triIter].pt[2] = vVert0ToVert1;
+                }
+                else if (iInsideVertCount == 2)
+                {
+                    // 2 in, tesselate into 2 triangles.
+                    // Copy the triangle (if it exists) after the current triangle out of
+                    // the way so we can override it with the new triangle we're inserting.
+                    triangleList[iTriangleCnt] = triangleList[triIter + 1];
+
+                    triangleList[triIter].culled = false;
+                    triangleList[triIter + 1].culled = false;
+
+                    // Get the vector from the outside point into the 2 inside points.
+                    math::Vector4 vVert2ToVert0 = triangleList[triIter].pt[0] - triangleList[triIter].pt[2];
+                    math::Vector4 vVert2ToVert1 = triangleList[triIter].pt[1] - triangleList[triIter].pt[2];
+
+                    // Get the hit point ratio.
+                    FLOAT fHitPointTime_2_0 = fEdge - triangleList[triIter].pt[2].getElem(iComponent);
+                    FLOAT fDistanceAlongVector_2_0 = fHitPointTime_2_0 / vVert2ToVert0.getElem(iComponent);
+                    // Calculate the new vert by adding the percentage of the vector plus point 2.
+                    vVert2ToVert0 = triangleList[triIter].pt[2] + vVert2ToVert0 * fDistanceAlongVector_2_0;
+
+                    FLOAT fHitPointTime_2_1 = fEdge - triangleList[triIter].pt[2].getElem(iComponent);
+                    FLOAT fDistanceAlongVector_2_1 = fHitPointTime_2_1 / vVert2ToVert1.getElem(iComponent);
+                    vVert2ToVert1 = triangleList[triIter].pt[2] + vVert2ToVert1 * fDistanceAlongVector_2_1;
+
+                    // Add a new triangle.
+                    triangleList[triIter + 1].pt[0] = triangleList[triIter].pt[0];
+                    triangleList[triIter + 1].pt[1] = triangleList[triIter].pt[1];
+                    triangleList[triIter + 1].pt[2] = vVert2ToVert0;
+
+                    triangleList[triIter].pt[0] = triangleList[triIter + 1].pt[1];
+                    triangleList[triIter].pt[1] = triangleList[triIter + 1].pt[2];
+                    triangleList[triIter].pt[2] = vVert2ToVert1;
+
+                    // Increment triangle count and skip the triangle we just inserted.
+                    ++iTriangleCnt;
+                    ++triIter;
+                }
+                else
+                {
+                    // All in
+                    triangleList[triIter].culled = false;
+                }
+            }
+        }
+
+        for (INT index = 0; index < iTriangleCnt; ++index)
+        {
+            if (triangleList[index].culled)
+                continue;
+
+            // Set the near and far plane to the min and max z values respectively.
+            for (INT vertind = 0; vertind < 3; ++vertind)
+            {
+                FLOAT fTriangleCoordZ = triangleList[index].pt[vertind].getZ();
+                fNearPlane = min(fNearPlane, fTriangleCoordZ);
+                fFarPlane = max(fFarPlane, fTriangleCoordZ);
+            }
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------
+// Splits the visible depth range in numCascades partitions. The split is blended between
+// a logarithmic distribution, which keeps the texel density constant, and a uniform one.
+// pCascadePartitions receives numCascades + 1 view distances.
+//--------------------------------------------------------------------------------------
+void CSMManager::ComputeDepthPartitions(float fMinDistance, float fMaxDistance, int numCascades, float fLogWeight, float* pCascadePartitions)
+{
+    fMaxDistance = max(fMaxDistance, fMinDistance * 1.001f);
+
+    pCascadePartitions[0] = fMinDistance;
+    for (int i = 1; i < numCascades; ++i)
+    {
+        float fRatio = static_cast<float>(i) / numCascades;
+        float fLog = fMinDistance * powf(fMaxDistance / fMinDistance, fRatio);
+        float fUniform = fMinDistance + (fMaxDistance - fMinDistance) * fRatio;
+        pCascadePartitions[i] = fLogWeight * fLog + (1.0f - fLogWeight) * fUniform;
+    }
+    pCascadePartitions[numCascades] = fMaxDistance;
+}
+
+//--------------------------------------------------------------------------------------
+// Light space volume of everything that can receive a shadow on screen: the whole view
+// frustum clipped to the scene bounds. Like the cascade volumes it is meant to be extruded
+// towards the light, so its max Z is the top of the scene. fSunSize is the tangent of the
+// half angle of the sun, the shadow rays spread by that much per unit of light space Z.
+//--------------------------------------------------------------------------------------
+void CSMManager::ComputeReceiverVolume(math::Matrix4 const& matCameraProjection, math::Matrix4 const& matViewCameraView,
+    math::Matrix4 const& matLightCameraView, float camNear, float fSunSize, GLTFCommon* pC, CasterCullVolume* pVolume)
+{
+    m_sceneBounds.Update(pC);
+
+    math::Vector4 vSceneMin = m_sceneBounds.GetMin();
+    math::Vector4 vSceneMax = m_sceneBounds.GetMax();
+
+    // The frustum only has to reach as deep as the farthest corner of the scene.
+    math::Vector4 vSceneLightMin = { FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX };
+    math::Vector4 vSceneLightMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    FLOAT fFarDistance = camNear;
+    for (int i = 0; i < 8; ++i)
+    {
+        math::Point3 vCorner((i & 1) ? vSceneMax.getX() : vSceneMin.getX(),
+            (i & 2) ? vSceneMax.getY() : vSceneMin.getY(),
+            (i & 4) ? vSceneMax.getZ() : vSceneMin.getZ());
+
+        fFarDistance = max(fFarDistance, -(matViewCameraView * vCorner).getZ());
+
+        math::Vector4 vLightCorner = matLightCameraView * vCorner;
+        vSceneLightMin = math::SSE::minPerElem(vLightCorner, vSceneLightMin);
+        vSceneLightMax = math::SSE::maxPerElem(vLightCorner, vSceneLightMax);
+    }
+
+    FLOAT fNearDistance = 0.0f;
+    CascadeFrustumBounds bounds;
+    ComputeCascadeFrustumBounds(matCameraProjection, math::affineInverse(matViewCameraView), matLightCameraView, camNear, 1,
+        &fNearDistance, &fFarDistance, &bounds);
+
+    math::Vector4 vMin = math::SSE::maxPerElem(bounds.vLightMin, vSceneLightMin);
+    math::Vector4 vMax = math::SSE::minPerElem(bounds.vLightMax, vSceneLightMax);
+
+    // A caster outside of the frustum can still throw its penumbra into it, the rays towards the edge
+    // of the sun drift sideways by up to the cone spread over the height between receiver and caster.
+    FLOAT fSpread = fSunSize * max(vSceneLightMax.getZ() - vMin.getZ(), 0.0f);
+
+    pVolume->vMin = math::Vector4(vMin.getX() - fSpread, vMin.getY() - fSpread, vMin.getZ(), 1.0f);
+    pVolume->vMax = math::Vector4(vMax.getX() + fSpread, vMax.getY() + fSpread, vSceneLightMax.getZ(), 1.0f);
+}
+
+//--------------------------------------------------------------------------------------
+// Returns the mask of cascades to update this frame. Cascade i is updated every
+// pUpdateIntervals[i] frames, offset by its index so the updates of the distant cascades
+// are spread over different frames.
+//--------------------------------------------------------------------------------------
+uint32_t CSMManager::ScheduleCascadeUpdates(uint32_t frame, int numCascades, int const* pUpdateIntervals, bool bForceUpdate)
+{
+    uint32_t mask = 0;
+    for (int i = 0; i < numCascades; ++i)
+    {
+        uint32_t interval = static_cast<uint32_t>(max(pUpdateIntervals[i], 1));
+        if (bForceUpdate || ((frame + i) % interval) == 0)
+            mask |= 1u << i;
+    }
+    return mask;
+}
+
+void CSMManager::SetupCascades(math::Matrix4 matCameraProjection, math::Matrix4 matViewCameraView, math::Point3 const& cameraPosition,
     math::Matrix4 matLightCameraView, float camNear, GLTFCommon* pC, int numCascades, const float* pCascadeSplitPoints,
-    int cascadeType, float width, bool bMoveLightTexelSize)
+    int cascadeType, int nearFarFitType, float width, bool bMoveLightTexelSize, float const* pCascadePartitions,
+    uint32_t cascadeUpdateMask)
 {
     math::Matrix4 matInverseViewCamera = math::affineInverse(matViewCameraView);
 
-    // Find scene min/max
-    math::Vector4 m_vSceneAABBMin = { FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX };
-    math::Vector4 m_vSceneAABBMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    // Find scene min/max, only nodes that moved since the last frame are re-transformed
+    m_sceneBounds.Update(pC);
 
-    math::Vector4 vMeshCorner;
+    math::Vector4 m_vSceneAABBMin = m_sceneBounds.GetMin();
+    math::Vector4 m_vSceneAABBMax = m_sceneBounds.GetMax();
 
     math::Vector4 boxbounds[8];
     boxbounds[0] = math::Vector4(-1, -1, 1, 0);
@@ -115,25 +517,6 @@ void CSMManager::SetupCascades(math::Matrix4 matCameraProjection, math::Matrix4
     boxbounds[6] = math::Vector4(1, 1, -1, 0);
     boxbounds[7] = math::Vector4(-1, 1, -1, 0);
 
-    for (uint32_t i = 0; i < pC->m_nodes.size(); i++)
-    {
-        tfNode* pNode = &pC->m_nodes[i];
-        if (pNode->meshIndex < 0)
-            continue;
-
-        math::Matrix4 mWorldTransformMatrix = pC->m_worldSpaceMats[i].GetCurrent();
-        tfMesh* pMesh = &pC->m_meshes[pNode->meshIndex];
-        for (uint32_t p = 0; p < pMesh->m_pPrimitives.size(); p++)
-        {
-            for (int j = 0; j < 8; ++j)
-            {
-                vMeshCorner = mWorldTransformMatrix * (pMesh->m_pPrimitives[p].m_center + math::mulPerElem(boxbounds[j], pMesh->m_pPrimitives[p].m_radius));
-                m_vSceneAABBMin = math::SSE::minPerElem(vMeshCorner, m_vSceneAABBMin);
-                m_vSceneAABBMax = math::SSE::maxPerElem(vMeshCorner, m_vSceneAABBMax);
-            }
-        }
-    }
-
     math::Vector4 m_vSceneAABBCenter = (m_vSceneAABBMin + m_vSceneAABBMax) * 0.5f;
     math::Vector4 m_vSceneAABBRadius = (m_vSceneAABBMax - m_vSceneAABBMin) * 0.5f;
 
@@ -165,7 +548,6 @@ void CSMManager::SetupCascades(math::Matrix4 matCameraProjection, math::Matrix4
     fNearPlane = vLightSpaceSceneAABBminValue.getZ();
     fFarPlane = vLightSpaceSceneAABBmaxValue.getZ();
 
-    FLOAT fFrustumIntervalBegin, fFrustumIntervalEnd;
     math::Vector4 vLightCameraOrthographicMin;  // light space frustrum aabb 
     math::Vector4 vLightCameraOrthographicMax;
 
@@ -175,9 +557,15 @@ void CSMManager::SetupCascades(math::Matrix4 matCameraProjection, math::Matrix4
 
     math::Vector4 vWorldUnitsPerTexel = { 0.0f, 0.0f, 0.0f, 0.0f };
 
-    // We loop over the cascades to calculate the orthographic projection for each cascade.
+    // Calculate the interval of the View Frustum each cascade covers first, so the frustum bounds of all
+    // the cascades can be computed in one batch.
+    FLOAT fIntervalBegin[MaxCascades];
+    FLOAT fIntervalEnd[MaxCascades];
     for (INT iCascadeIndex = 0; iCascadeIndex < numCascades; ++iCascadeIndex)
     {
+        FLOAT& fFrustumIntervalBegin = fIntervalBegin[iCascadeIndex];
+        FLOAT& fFrustumIntervalEnd = fIntervalEnd[iCascadeIndex];
+
         // Calculate the interval of the View Frustum that this cascade covers. We measure the interval 
         // the cascade covers as a Min and Max distance along the Z Axis.
         if (cascadeType == FIT_TO_CASCADES)
@@ -208,45 +596,47 @@ void CSMManager::SetupCascades(math::Matrix4 matCameraProjection, math::Matrix4
         fFrustumIntervalBegin = fFrustumIntervalBegin * fSceneNearFarRange;
         fFrustumIntervalEnd = fFrustumIntervalEnd * fSceneNearFarRange;
 
-        // Lets get bounding box of current frustum
-        math::Vector4 vFrustumPoints[8];
-        CreateFrustumPointsFromCascadeInterval(camNear, fFrustumIntervalBegin, fFrustumIntervalEnd,
-            matCameraProjection, vFrustumPoints);
-
-        // center + radius
-        math::Vector4 vFrustumPointsMin = { FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX };
-        math::Vector4 vFrustumPointsMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX };
-
-        for (int i = 0; i < 8; ++i)
+        if (pCascadePartitions != nullptr)
         {
-            // Find the closest point.
-            vFrustumPointsMin = math::SSE::minPerElem(vFrustumPoints[i], vFrustumPointsMin);
-            vFrustumPointsMax = math::SSE::maxPerElem(vFrustumPoints[i], vFrustumPointsMax);
+            // The partitions are view distances fitted to the visible depth range, there is nothing to see
+            // before the first one so the FIT_TO_SCENE cascades start there.
+            if (cascadeType == FIT_TO_CASCADES) fFrustumIntervalBegin = pCascadePartitions[iCascadeIndex];
+            else fFrustumIntervalBegin = pCascadePartitions[0];
+
+            fFrustumIntervalEnd = pCascadePartitions[iCascadeIndex + 1];
         }
+    }
 
-        m_vFrustumPointsAABBCenter = (vFrustumPointsMin + vFrustumPointsMax) * 0.5f;
-        m_vFrustumPointsAABBRadius = (vFrustumPointsMax - vFrustumPointsMin) * 0.5f;
+    CascadeFrustumBounds frustumBounds[MaxCascades];
+    ComputeCascadeFrustumBounds(matCameraProjection, matInverseViewCamera, matLightCameraView, camNear, numCascades,
+        fIntervalBegin, fIntervalEnd, frustumBounds);
 
-        vLightCameraOrthographicMin = { FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX };
-        vLightCameraOrthographicMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    // We loop over the cascades to calculate the orthographic projection for each cascade.
+    for (INT iCascadeIndex = 0; iCascadeIndex < numCascades; ++iCascadeIndex)
+    {
+        // Cascades that are not updated this frame keep the projection their shadow map was rendered with.
+        if ((cascadeUpdateMask & (1u << iCascadeIndex)) == 0)
+            continue;
 
-        // Lets get bounding box of frustum after translating it into light view space
-        math::Vector4 vTempTranslatedCornerPoint;
-        for (int icpIndex = 0; icpIndex < 8; ++icpIndex)
-        {
-            // Transform the frustum from camera view space to world space.
-            vFrustumPoints[icpIndex] = matInverseViewCamera * vFrustumPoints[icpIndex];
-            // Transform the point from world space to Light Camera Space.
-            vTempTranslatedCornerPoint = matLightCameraView * vFrustumPoints[icpIndex];
-
-            // Find the closest point.
-            vLightCameraOrthographicMin = math::SSE::minPerElem(vTempTranslatedCornerPoint, vLightCameraOrthographicMin);
-            vLightCameraOrthographicMax = math::SSE::maxPerElem(vTempTranslatedCornerPoint, vLightCameraOrthographicMax);
-        }
+        FLOAT fFrustumIntervalEnd = fIntervalEnd[iCascadeIndex];
+
+        CascadeFrustumBounds const& bounds = frustumBounds[iCascadeIndex];
+        FLOAT fFrustumSphereRadius = bounds.fSphereRadius;
+
+        m_vFrustumPointsAABBCenter = (bounds.vFrustumMin + bounds.vFrustumMax) * 0.5f;
+        m_vFrustumPointsAABBRadius = (bounds.vFrustumMax - bounds.vFrustumMin) * 0.5f;
+
+        vLightCameraOrthographicMin = bounds.vLightMin;
+        vLightCameraOrthographicMax = bounds.vLightMax;
 
         m_vLightCameraAABBCenter = (vLightCameraOrthographicMin + vLightCameraOrthographicMax) * 0.5f;
         m_vLightCameraAABBRadius = (vLightCameraOrthographicMax - vLightCameraOrthographicMin) * 0.5f;
 
+        // Light space Z range of the cascade frustum, kept before the texel snapping below touches Z.
+        // The light looks down -Z, so the max is the side closest to the light.
+        FLOAT fCascadeFarZ = vLightCameraOrthographicMin.getZ();
+        FLOAT fCascadeNearZ = vLightCameraOrthographicMax.getZ();
+
         const math::Vector4 g_vHalfVector = { 0.5f, 0.5f, 0.5f, 0.5f };
         const math::Vector4 g_vMultiplySetzwToZero = { 1.0f, 1.0f, 0.0f, 0.0f };
 
@@ -259,11 +649,9 @@ void CSMManager::SetupCascades(math::Matrix4 matCameraProjection, math::Matrix4
             // 
             // To do this, we pad the ortho transform so that it is always big enough to cover 
             // the entire camera view frustum.
-            math::Vector4 vDiagonal = vFrustumPoints[0] - vFrustumPoints[6];
-
             // The bound is the length of the diagonal of the frustum interval.
-            FLOAT fCascadeBound = math::SSE::length(vDiagonal);
-            vDiagonal = { fCascadeBound, fCascadeBound, fCascadeBound, fCascadeBound };
+            FLOAT fCascadeBound = bounds.fDiagonal;
+            math::Vector4 vDiagonal = { fCascadeBound, fCascadeBound, fCascadeBound, fCascadeBound };
 
             // The offset calculated will pad the ortho projection so that it is always the same size 
             // and big enough to cover the entire cascade interval.
@@ -284,6 +672,29 @@ void CSMManager::SetupCascades(math::Matrix4 matCameraProjection, math::Matrix4
             vWorldUnitsPerTexel = math::Vector4(fWorldUnitsPerTexel, fWorldUnitsPerTexel, 0.0f, 0.0f);
 
 
+        }
+        else if (cascadeType == FIT_TO_BOUNDING_SPHERE)
+        {
+            // Fit the ortho projection to the sphere around the camera. Rotating the camera changes neither
+            // the radius nor the center, so the projection stays the same and the cascade contents with it.
+            // The radius is quantized so float noise in the projection doesn't change the cascade size. The
+            // center is the camera position as given, the translation of the inverse view isn't bit exact
+            // under rotation and the unsnapped Z would move the near and far planes.
+            FLOAT fRadius = ceilf(fFrustumSphereRadius * 16.0f) / 16.0f;
+            math::Vector4 vSphereCenter = matLightCameraView * cameraPosition;
+
+            // Snap the center to texel sized increments so moving the camera doesn't make the shadows shimmer.
+            FLOAT fWorldUnitsPerTexel = 2.0f * fRadius / width;
+            FLOAT fCenterX = floorf(vSphereCenter.getX() / fWorldUnitsPerTexel) * fWorldUnitsPerTexel;
+            FLOAT fCenterY = floorf(vSphereCenter.getY() / fWorldUnitsPerTexel) * fWorldUnitsPerTexel;
+
+            vLightCameraOrthographicMin = math::Vector4(fCenterX - fRadius, fCenterY - fRadius, vSphereCenter.getZ() - fRadius, 1.0f);
+            vLightCameraOrthographicMax = math::Vector4(fCenterX + fRadius, fCenterY + fRadius, vSphereCenter.getZ() + fRadius, 1.0f);
+
+            fCascadeFarZ = vLightCameraOrthographicMin.getZ();
+            fCascadeNearZ = vLightCameraOrthographicMax.getZ();
+
+            vWorldUnitsPerTexel = math::Vector4(fWorldUnitsPerTexel, fWorldUnitsPerTexel, 0.0f, 0.0f);
         }
         else if (cascadeType == FIT_TO_CASCADES)
         {
@@ -305,7 +716,8 @@ void CSMManager::SetupCascades(math::Matrix4 matCameraProjection, math::Matrix4
 
         }
 
-        if (bMoveLightTexelSize)
+        // The bounding sphere is always snapped through its center, snapping min and max again could change its size.
+        if (bMoveLightTexelSize && cascadeType != FIT_TO_BOUNDING_SPHERE)
         {
             // We snape the camera to 1 pixel increments so that moving the camera does not cause the shadows to jitter.
             // This is a matter of integer dividing by the world space size of a texel
@@ -321,17 +733,59 @@ void CSMManager::SetupCascades(math::Matrix4 matCameraProjection, math::Matrix4
         m_vSceneAABBPointsLightSpaceCenter[iCascadeIndex] = (vLightSpaceSceneAABBminValue + vLightSpaceSceneAABBmaxValue) * 0.5f;
         m_vSceneAABBPointsLightSpaceRadius[iCascadeIndex] = (vLightSpaceSceneAABBmaxValue - vLightSpaceSceneAABBminValue) * 0.5f;
 
+        // As above, fNearPlane and fFarPlane are the min and max light space Z the cascade covers,
+        // depth 0 is at fFarPlane (closest to the light) and depth 1 at fNearPlane.
+        FLOAT fCascadeNearPlane = fNearPlane;
+        FLOAT fCascadeFarPlane = fFarPlane;
+
+        if (nearFarFitType == FIT_NEARFAR_ZERO_ONE)
+        {
+            // Fixed range in front of the light, purposely awful to show how much precision a fitted range buys.
+            fCascadeNearPlane = -10000.0f;
+            fCascadeFarPlane = 0.0f;
+        }
+        else if (nearFarFitType == FIT_NEARFAR_AABB)
+        {
+            // Use the light space AABB of the cascade frustum, casters outside of it are clipped.
+            fCascadeNearPlane = fCascadeFarZ;
+            fCascadeFarPlane = fCascadeNearZ;
+        }
+        else if (nearFarFitType == FIT_NEARFAR_SCENE_AABB)
+        {
+            // Intersect the scene AABB with the sides of the orthographic projection.
+            FLOAT fClippedNearPlane, fClippedFarPlane;
+            ComputeNearAndFar(fClippedNearPlane, fClippedFarPlane, vLightCameraOrthographicMin, vLightCameraOrthographicMax,
+                vSceneAABBPointsLightSpace);
+
+            // Nothing of the scene falls in the cascade, keep the scene range.
+            if (fClippedNearPlane <= fClippedFarPlane)
+            {
+                fCascadeNearPlane = fClippedNearPlane;
+                fCascadeFarPlane = fClippedFarPlane;
+            }
+
+        }
+
         // Create the orthographic projection for this cascade.
         m_matShadowProj[iCascadeIndex] = math::Matrix4::orthographic(vLightCameraOrthographicMin.getX(), vLightCameraOrthographicMax.getX(),
             vLightCameraOrthographicMin.getY(), vLightCameraOrthographicMax.getY(),
-            fNearPlane, fFarPlane);
+            fCascadeNearPlane, fCascadeFarPlane);
 
         m_matShadowProj[iCascadeIndex].setCol2(m_matShadowProj[iCascadeIndex].getCol2() / 2.0f);
 
         math::Vector4 vec = m_matShadowProj[iCascadeIndex].getCol3();
-        vec.setZ(-(fFarPlane / (fNearPlane - fFarPlane)));
+        vec.setZ(-(fCascadeFarPlane / (fCascadeNearPlane - fCascadeFarPlane)));
         m_matShadowProj[iCascadeIndex].setCol3(vec);
 
         m_fCascadePartitionsFrustum[iCascadeIndex] = fFrustumIntervalEnd;
+
+        // Receiver volume of the cascade, extruded towards the light when culling casters.
+        m_casterCullVolumes[iCascadeIndex].vMin = math::Vector4(vLightCameraOrthographicMin.getX(), vLightCameraOrthographicMin.getY(), fCascadeFarZ, 1.0f);
+        m_casterCullVolumes[iCascadeIndex].vMax = math::Vector4(vLightCameraOrthographicMax.getX(), vLightCameraOrthographicMax.getY(), fCascadeFarPlane, 1.0f);
+
+        // Whole depth range of the projection. Unlike the receiver volume it only depends on the projection,
+        // so the casters culled against it don't change as long as the projection doesn't.
+        m_casterCullVolumes[numCascades + iCascadeIndex].vMin = math::Vector4(vLightCameraOrthographicMin.getX(), vLightCameraOrthographicMin.getY(), fCascadeNearPlane, 1.0f);
+        m_casterCullVolumes[numCascades + iCascadeIndex].vMax = math::Vector4(vLightCameraOrthographicMax.getX(), vLightCameraOrthographicMax.getY(), fCascadeFarPlane, 1.0f);
     }
 }
\ No newline at end of file
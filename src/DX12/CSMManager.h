@@ -46,17 +46,46 @@
 class CSMManager
 {
 public:
+    static const int MaxCascades = 4;
+
 
     void OnCreate(int numCascades);
+    void InvalidateSceneBounds() { m_sceneBounds.Invalidate(); }
     void CreateFrustumPointsFromCascadeInterval(float camNear, float fCascadeIntervalBegin,
         FLOAT fCascadeIntervalEnd,
         math::Matrix4 projection,
         math::Vector4* pvCornerPointsWorld);
-    void SetupCascades(math::Matrix4 matCameraProjection, math::Matrix4 matViewCameraView,
+    // Frustum bounds of a cascade interval, as found by ComputeCascadeFrustumBounds
+    struct CascadeFrustumBounds
+    {
+        math::Vector4 vFrustumMin;  // camera view space
+        math::Vector4 vFrustumMax;
+        math::Vector4 vLightMin;    // light space
+        math::Vector4 vLightMax;
+        float fSphereRadius;        // distance from the camera to the farthest corner
+        float fDiagonal;            // length of the interval diagonal
+    };
+    void ComputeCascadeFrustumBounds(math::Matrix4 const& matCameraProjection,
+        math::Matrix4 const& matInverseViewCamera, math::Matrix4 const& matLightCameraView, float camNear,
+        int numCascades, float const* pIntervalBegin, float const* pIntervalEnd, CascadeFrustumBounds* pBounds);
+    void ComputeNearAndFar(FLOAT& fNearPlane, FLOAT& fFarPlane,
+        math::Vector4 vLightCameraOrthographicMin,
+        math::Vector4 vLightCameraOrthographicMax,
+        math::Vector4* pvPointsInCameraView);
+    // cameraPosition has to be the eye matViewCameraView was built from, the bounding sphere cascades are
+    // centered on it rather than on the inverse view, which changes with the rotation in the last bits
+    void SetupCascades(math::Matrix4 matCameraProjection, math::Matrix4 matViewCameraView, math::Point3 const& cameraPosition,
         math::Matrix4 matLightCameraView, float camNear, GLTFCommon* pC, int numCascades, float const* pCascadeSplitPoints,
-        int cascadeType, float width, bool bMoveLightTexelSize);
-    const std::vector<math::Matrix4> GetShadowProj() { return m_matShadowProj; }
-    const std::vector<float> GetCascadePartitionsFrustum() { return m_fCascadePartitionsFrustum; }
+        int cascadeType, int nearFarFitType, float width, bool bMoveLightTexelSize, float const* pCascadePartitions = nullptr,
+        uint32_t cascadeUpdateMask = 0xffffffff);
+    void ComputeReceiverVolume(math::Matrix4 const& matCameraProjection, math::Matrix4 const& matViewCameraView,
+        math::Matrix4 const& matLightCameraView, float camNear, float fSunSize, GLTFCommon* pC, CasterCullVolume* pVolume);
+    uint32_t ScheduleCascadeUpdates(uint32_t frame, int numCascades, int const* pUpdateIntervals, bool bForceUpdate);
+    static void ComputeDepthPartitions(float fMinDistance, float fMaxDistance, int numCascades, float fLogWeight, float* pCascadePartitions);
+    const std::vector<math::Matrix4>& GetShadowProj() const { return m_matShadowProj; }
+    const std::vector<float>& GetCascadePartitionsFrustum() const { return m_fCascadePartitionsFrustum; }
+    // numCascades receiver volumes followed by numCascades volumes covering the whole cascade projections
+    const std::vector<CasterCullVolume>& GetCasterCullVolumes() const { return m_casterCullVolumes; }
 
     const math::Vector4 GetLightCameraAABBCenter() { return m_vLightCameraAABBCenter; }
     const math::Vector4 GetLightCameraAABBRadius() { return m_vLightCameraAABBRadius; }
@@ -71,9 +100,11 @@ private:
 
     math::Vector4 m_vSceneAABBMin;
     math::Vector4 m_vSceneAABBMax;
+    SceneBounds m_sceneBounds;
 
     std::vector<math::Matrix4> m_matShadowProj;
     std::vector<float> m_fCascadePartitionsFrustum;
+    std::vector<CasterCullVolume> m_casterCullVolumes;
 
     math::Vector4 m_vLightCameraAABBCenter;
     math::Vector4 m_vLightCameraAABBRadius;
@@ -96,6 +127,16 @@ private:
     enum FIT_PROJECTION_TO_CASCADES
     {
         FIT_TO_CASCADES,
-        FIT_TO_SCENE
+        FIT_TO_SCENE,
+        FIT_TO_BOUNDING_SPHERE
+    };
+
+    // There is no pancaking mode: it needs depth clamping, and Cauldron's depth pass PSO keeps depth clip
+    // enabled, so the casters in front of the cascade would be clipped instead of flattened onto it.
+    enum FIT_TO_NEAR_FAR
+    {
+        FIT_NEARFAR_ZERO_ONE,
+        FIT_NEARFAR_AABB,
+        FIT_NEARFAR_SCENE_AABB
     };
 };
@@ -45,7 +45,7 @@ public:
         UINT         m_nCascadeLevels; // Number of Cascades
         UINT         m_nTextureSizeX; // 1 is to visualize the cascades in different colors. 0 is to just draw the scene.
         UINT         m_nTextureSizeY; // 1 is to visualize the cascades in different colors. 0 is to just draw the scene.
-        UINT         _pad;
+        UINT         m_nCascadeSliceOffset; // first slice of this light's cascades in the shadow map array
 
         // For Map based selection scheme, this keeps the pixels inside of the the valid range.
         // When there is no boarder, these values are 0 and 1 respectivley.
@@ -57,6 +57,9 @@ public:
         
         FLOAT       m_fLightDir[3];
         FLOAT       m_fSunSize;
+
+        UINT        m_nOutputSlice; // slice of the shadow masks this light is written to
+        UINT        _pad[3];
     };
 
     void OnCreate(
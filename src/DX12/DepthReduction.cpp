@@ -0,0 +1,210 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+#include "DepthReduction.h"
+
+namespace
+{
+    const uint32_t s_TileSize = 8;
+    const uint32_t s_ResultSize = 2 * sizeof(uint32_t);
+}
+
+//--------------------------------------------------------------------------------------
+//
+// OnCreate
+//
+//--------------------------------------------------------------------------------------
+void DepthReduction::OnCreate(Device* pDevice, ResourceViewHeaps* pResourceViewHeaps, uint32_t numFramesInFlight)
+{
+    m_numFramesInFlight = numFramesInFlight;
+    m_slotFrames.assign(m_numFramesInFlight, 0);
+
+    pResourceViewHeaps->AllocCBV_SRV_UAVDescriptor(2, &m_table);
+
+    // Create root signature
+    //
+    {
+        CD3DX12_DESCRIPTOR_RANGE descriptorRanges[2] = {};
+        descriptorRanges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1u, 0u);
+        descriptorRanges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1u, 0u);
+
+        CD3DX12_ROOT_PARAMETER rootParameters[2] = {};
+        rootParameters[0].InitAsConstants(2, 0);
+        rootParameters[1].InitAsDescriptorTable(2, descriptorRanges);
+
+        CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc;
+        rootSignatureDesc.Init(2, rootParameters, 0, nullptr);
+
+        ID3DBlob* pOutBlob, * pErrorBlob = NULL;
+        ThrowIfFailed(D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &pOutBlob, &pErrorBlob));
+        ThrowIfFailed(
+            pDevice->GetDevice()->CreateRootSignature(0, pOutBlob->GetBufferPointer(), pOutBlob->GetBufferSize(), IID_PPV_ARGS(&m_pRootSignature))
+        );
+        SetName(m_pRootSignature, "DepthReduction");
+
+        pOutBlob->Release();
+        if (pErrorBlob)
+            pErrorBlob->Release();
+    }
+
+    // Create pipeline
+    //
+    {
+        D3D12_SHADER_BYTECODE shaderByteCode = {};
+        CompileShaderFromFile("DepthReduction.hlsl", NULL, "main", "-T cs_6_0", &shaderByteCode);
+
+        D3D12_COMPUTE_PIPELINE_STATE_DESC pipelineStateDesc = {};
+        pipelineStateDesc.pRootSignature = m_pRootSignature;
+        pipelineStateDesc.CS = shaderByteCode;
+
+        ThrowIfFailed(pDevice->GetDevice()->CreateComputePipelineState(&pipelineStateDesc, IID_PPV_ARGS(&m_pPipelineState)));
+        SetName(m_pPipelineState, "DepthReduction");
+    }
+
+    m_minMaxBuffer.InitBuffer(pDevice, "Depth min max", &CD3DX12_RESOURCE_DESC::Buffer(s_ResultSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS), sizeof(uint32_t), D3D12_RESOURCE_STATE_COPY_DEST);
+    m_minMaxBuffer.CreateBufferUAV(1, nullptr, &m_table);
+
+    ThrowIfFailed(pDevice->GetDevice()->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer(s_ResultSize * m_numFramesInFlight),
+        D3D12_RESOURCE_STATE_COPY_DEST,
+        nullptr,
+        IID_PPV_ARGS(&m_pReadbackBuffer)));
+    SetName(m_pReadbackBuffer, "Depth min max readback");
+
+    // readback heaps can stay mapped, every slot is only read once the GPU is done writing it
+    ThrowIfFailed(m_pReadbackBuffer->Map(0, nullptr, reinterpret_cast<void**>(&m_pReadbackData)));
+}
+
+//--------------------------------------------------------------------------------------
+//
+// OnDestroy
+//
+//--------------------------------------------------------------------------------------
+void DepthReduction::OnDestroy()
+{
+    if (m_pReadbackBuffer)
+    {
+        m_pReadbackBuffer->Unmap(0, nullptr);
+        m_pReadbackBuffer->Release();
+        m_pReadbackBuffer = nullptr;
+        m_pReadbackData = nullptr;
+    }
+
+    m_minMaxBuffer.OnDestroy();
+
+    if (m_pPipelineState)
+    {
+        m_pPipelineState->Release();
+        m_pPipelineState = nullptr;
+    }
+
+    if (m_pRootSignature)
+    {
+        m_pRootSignature->Release();
+        m_pRootSignature = nullptr;
+    }
+}
+
+//--------------------------------------------------------------------------------------
+//
+// BindDepthTexture
+//
+//--------------------------------------------------------------------------------------
+void DepthReduction::BindDepthTexture(Texture& depth, uint32_t width, uint32_t height)
+{
+    depth.CreateSRV(0, &m_table);
+
+    m_width = width;
+    m_height = height;
+
+    // results of the old size are still valid, but don't mix them with a new depth buffer
+    Invalidate();
+}
+
+//--------------------------------------------------------------------------------------
+//
+// Invalidate
+//
+//--------------------------------------------------------------------------------------
+void DepthReduction::Invalidate()
+{
+    // the copies already recorded still land in their slots, they just aren't read anymore
+    std::fill(m_slotFrames.begin(), m_slotFrames.end(), 0);
+}
+
+//--------------------------------------------------------------------------------------
+//
+// Reduce
+//
+//--------------------------------------------------------------------------------------
+bool DepthReduction::Reduce(ID3D12GraphicsCommandList* pCommandList, uint32_t frame, float* pMinDepth, float* pMaxDepth)
+{
+    uint32_t const slot = frame % m_numFramesInFlight;
+
+    // Read the result before the slot gets overwritten by this frame's copy, a slot written
+    // before a skipped frame or an invalidation is older than it looks
+    bool bIsValid = false;
+    if (m_slotFrames[slot] != 0 && m_slotFrames[slot] + m_numFramesInFlight == frame + 1)
+    {
+        uint32_t const minDepth = m_pReadbackData[2 * slot + 0];
+        uint32_t const maxDepth = m_pReadbackData[2 * slot + 1];
+
+        // the max stays 0 when no pixel covered geometry
+        bIsValid = maxDepth != 0;
+        memcpy(pMinDepth, &minDepth, sizeof(float));
+        memcpy(pMaxDepth, &maxDepth, sizeof(float));
+    }
+
+    UserMarker marker(pCommandList, "Depth reduction");
+
+    // clear min max by using WriteBufferImmediate
+    ID3D12GraphicsCommandList4* pCmdList4 = nullptr;
+    pCommandList->QueryInterface(&pCmdList4);
+
+    D3D12_GPU_VIRTUAL_ADDRESS address = m_minMaxBuffer.GetResource()->GetGPUVirtualAddress();
+    D3D12_WRITEBUFFERIMMEDIATE_PARAMETER const params[2] =
+    {
+        {address + sizeof(uint32_t) * 0, 0xffffffff},
+        {address + sizeof(uint32_t) * 1, 0},
+    };
+    pCmdList4->WriteBufferImmediate(2, params, nullptr);
+    pCmdList4->Release();
+
+    pCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_minMaxBuffer.GetResource(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
+
+    pCommandList->SetComputeRootSignature(m_pRootSignature);
+    pCommandList->SetPipelineState(m_pPipelineState);
+
+    uint32_t const textureSize[2] = { m_width, m_height };
+    pCommandList->SetComputeRoot32BitConstants(0, 2, textureSize, 0);
+    pCommandList->SetComputeRootDescriptorTable(1, m_table.GetGPU());
+
+    pCommandList->Dispatch((m_width + s_TileSize - 1) / s_TileSize, (m_height + s_TileSize - 1) / s_TileSize, 1);
+
+    pCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_minMaxBuffer.GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE));
+    pCommandList->CopyBufferRegion(m_pReadbackBuffer, s_ResultSize * slot, m_minMaxBuffer.GetResource(), 0, s_ResultSize);
+    pCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_minMaxBuffer.GetResource(), D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_COPY_DEST));
+
+    m_slotFrames[slot] = frame + 1;
+
+    return bIsValid;
+}
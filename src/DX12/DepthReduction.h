@@ -0,0 +1,58 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+using namespace CAULDRON_DX12;
+
+//--------------------------------------------------------------------------------------
+// Reduces the depth buffer to the min and max depth of the visible geometry and reads it
+// back without stalling: every frame reads the slot it is about to overwrite, which was
+// written numFramesInFlight frames ago and is guaranteed to be done on the GPU. A slot is
+// only used if it was written exactly that many frames ago and not invalidated since.
+//--------------------------------------------------------------------------------------
+class DepthReduction
+{
+public:
+    void OnCreate(Device* pDevice, ResourceViewHeaps* pResourceViewHeaps, uint32_t numFramesInFlight);
+    void OnDestroy();
+
+    void BindDepthTexture(Texture& depth, uint32_t width, uint32_t height);
+
+    // Drops the results in flight, used when they don't match what the depth buffer shows anymore.
+    void Invalidate();
+
+    // Returns false until a result is available or if no geometry was visible.
+    bool Reduce(ID3D12GraphicsCommandList* pCommandList, uint32_t frame, float* pMinDepth, float* pMaxDepth);
+
+private:
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+
+    uint32_t m_numFramesInFlight = 0;
+    std::vector<uint32_t> m_slotFrames; // frame + 1 each slot was written in, 0 when it holds no valid result
+
+    Texture m_minMaxBuffer;
+    ID3D12Resource* m_pReadbackBuffer = nullptr;
+    uint32_t* m_pReadbackData = nullptr;
+
+    ID3D12RootSignature* m_pRootSignature = nullptr;
+    ID3D12PipelineState* m_pPipelineState = nullptr;
+    CBV_SRV_UAV m_table;
+};
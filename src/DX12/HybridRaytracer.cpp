@@ -21,6 +21,7 @@
 #include <intrin.h>
 
 #include "HybridRaytracer.h"
+#include "SceneCache.h"
 
 
 HybridRaytracer::HybridRaytracer(LPCSTR name) : FrameworkWindows(name)
@@ -44,6 +45,7 @@ void HybridRaytracer::OnParseCommandLine(LPSTR lpCmdLine, uint32_t* pWidth, uint
 	m_activeScene = 0; //load the first one by default
 	m_VsyncEnabled = false;
 	m_bIsBenchmarking = false;
+	m_bUseSceneCache = false;
 	m_fontSize = 13.f; // default value overridden by a json file if available
 	m_isCpuValidationLayerEnabled = false;
 	m_isGpuValidationLayerEnabled = false;
@@ -63,6 +65,7 @@ void HybridRaytracer::OnParseCommandLine(LPSTR lpCmdLine, uint32_t* pWidth, uint
 		m_isGpuValidationLayerEnabled = jData.value("GpuValidationLayerEnabled", m_isGpuValidationLayerEnabled);
 		m_VsyncEnabled = jData.value("vsync", m_VsyncEnabled);
 		m_bIsBenchmarking = jData.value("benchmark", m_bIsBenchmarking);
+		m_bUseSceneCache = jData.value("sceneCache", m_bUseSceneCache);
 		m_stablePowerState = jData.value("stablePowerState", m_stablePowerState);
 		m_fontSize = jData.value("fontsize", m_fontSize);
 	};
@@ -282,6 +285,18 @@ void HybridRaytracer::LoadScene(int sceneIndex)
 		LOAD(scene, "hybirdMode", m_UIState.hMode);
 		LOAD(scene, "alphaMaskMode", m_UIState.amMode);
 		LOAD(scene, "shadowMapSize", m_UIState.shadowMapWidth);
+		LOAD(scene, "compactBLAS", m_UIState.bCompactBLAS);
+		LOAD(scene, "shadowProxyRatio", m_UIState.shadowProxyRatio);
+		LOAD(scene, "shadowProxyMaxError", m_UIState.shadowProxyMaxError);
+		LOAD(scene, "shadowQuantizationMaxError", m_UIState.shadowQuantizationMaxError);
+		LOAD(scene, "staticMergeMaxSize", m_UIState.staticMergeMaxSize);
+		LOAD(scene, "staticMergeClusterSize", m_UIState.staticMergeClusterSize);
+		LOAD(scene, "opacityMicromapMaxLevel", m_UIState.opacityMicromapMaxLevel);
+		LOAD(scene, "alphaMaskSize", m_UIState.alphaMaskSize);
+
+		// only with "sceneCache": true in the globals, a scene can still opt out with "sceneCache": false
+		bool const bUseSceneCache = m_bUseSceneCache && scene.value("sceneCache", true);
+		m_UIState.sceneCachePath = bUseSceneCache ? Raytracing::SceneCache::GetUserCachePath((scene["directory"].get<std::string>() + scene["filename"].get<std::string>()).c_str()) : std::string();
 
 		for (uint32_t i = 0; i < _countof(k_shadowMapWidthNames); ++i)
 		{
@@ -311,6 +326,15 @@ void HybridRaytracer::LoadScene(int sceneIndex)
 			m_pGltfLoader->AddLight(n, l);
 		}
 		
+		// Every directional light gets its own cascades, as many as the shadow mask has channels for
+		m_UIState.numShadowedLights = 0;
+		for (tfLight const& light : m_pGltfLoader->m_lights)
+		{
+			if (light.m_type == tfLight::LIGHT_DIRECTIONAL)
+				++m_UIState.numShadowedLights;
+		}
+		m_UIState.numShadowedLights = min(m_UIState.numShadowedLights, Renderer::MaxShadowedLights);
+
 		// Allocate shadow information (if any)
 		m_pRenderer->OnResizeShadowMapWidth(&m_UIState);
 
@@ -447,7 +471,7 @@ void HybridRaytracer::OnRender()
 	{
 		// the scene loads in chunks, that way we can show a progress bar
 		static int loadingStage = 0;
-		loadingStage = m_pRenderer->LoadScene(m_pGltfLoader, loadingStage);
+		loadingStage = m_pRenderer->LoadScene(m_pGltfLoader, &m_UIState, loadingStage);
 		if (loadingStage == 0)
 		{
 			m_time = 0;
@@ -459,6 +483,15 @@ void HybridRaytracer::OnRender()
 		// Benchmarking takes control of the time, and exits the app when the animation is done
 		std::vector<TimeStamp> timeStamps = m_pRenderer->GetTimingValues();
 		m_time = BenchmarkLoop(timeStamps, &m_camera, m_pRenderer->GetScreenshotFileName());
+
+		// A steady state frame that allocated fails the run, the count only moves when the counting
+		// is built in with HYBRID_SHADOWS_COUNT_ALLOCATIONS
+		uint64_t const allocatingFrames = AllocationCounter::GetFailedScopeCount();
+		if (allocatingFrames != 0)
+		{
+			Trace(format("Benchmark failed: %llu steady state frames allocated from the heap\n", allocatingFrames));
+			exit(1);
+		}
 	}
 	else
 	{
@@ -48,6 +48,7 @@ public:
 private:
     
     bool                        m_bIsBenchmarking;
+    bool                        m_bUseSceneCache; // opt-in, the caches go to the user's local app data
 
     GLTFCommon                 *m_pGltfLoader = NULL;
     bool                        m_loadingScene = false;
@@ -0,0 +1,441 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <array>
+#include <queue>
+#include <unordered_map>
+
+namespace
+{
+    struct Vec3
+    {
+        double x, y, z;
+    };
+
+    Vec3 Sub(Vec3 const& a, Vec3 const& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+    Vec3 Cross(Vec3 const& a, Vec3 const& b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+    double Dot(Vec3 const& a, Vec3 const& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+    // Sum of squared distances to a set of planes, stored as the symmetric 4x4 matrix of the planes
+    struct Quadric
+    {
+        double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+
+        void AddPlane(Vec3 const& n, double d, double weight)
+        {
+            a2 += weight * n.x * n.x; ab += weight * n.x * n.y; ac += weight * n.x * n.z; ad += weight * n.x * d;
+            b2 += weight * n.y * n.y; bc += weight * n.y * n.z; bd += weight * n.y * d;
+            c2 += weight * n.z * n.z; cd += weight * n.z * d;
+            d2 += weight * d * d;
+        }
+
+        void Add(Quadric const& q)
+        {
+            a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+            b2 += q.b2; bc += q.bc; bd += q.bd;
+            c2 += q.c2; cd += q.cd;
+            d2 += q.d2;
+        }
+
+        double Evaluate(Vec3 const& p) const
+        {
+            return a2 * p.x * p.x + 2 * ab * p.x * p.y + 2 * ac * p.x * p.z + 2 * ad * p.x
+                + b2 * p.y * p.y + 2 * bc * p.y * p.z + 2 * bd * p.y
+                + c2 * p.z * p.z + 2 * cd * p.z
+                + d2;
+        }
+    };
+
+    struct Collapse
+    {
+        double cost;
+        uint32_t from;
+        uint32_t to;
+        uint32_t fromVersion;
+        uint32_t toVersion;
+
+        bool operator>(Collapse const& other) const { return cost > other.cost; }
+    };
+
+    struct PositionKey
+    {
+        uint32_t x, y, z;
+
+        bool operator==(PositionKey const& other) const { return x == other.x && y == other.y && z == other.z; }
+    };
+
+    struct PositionKeyHash
+    {
+        size_t operator()(PositionKey const& key) const { return (key.x * 73856093u) ^ (key.y * 19349663u) ^ (key.z * 83492791u); }
+    };
+
+    uint64_t EdgeKey(uint32_t a, uint32_t b)
+    {
+        return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+    }
+
+    // borders are kept in place by planes through them, perpendicular to their triangle
+    double const s_BorderWeight = 10.0;
+
+    // a collapse may not turn a triangle further than this
+    double const s_MinNormalCos = 0.2;
+
+    class Simplifier
+    {
+    public:
+        void Weld(float const* pPositions, uint32_t positionStride, uint32_t vertexCount);
+        void AddTriangles(uint32_t const* pIndices, uint32_t indexCount);
+        void ComputeQuadrics();
+        void Run(uint32_t targetIndexCount, float maxError);
+        void Write(std::vector<uint32_t>& outIndices) const;
+
+    private:
+        void GatherNeighbours(uint32_t v, std::vector<uint32_t>& neighbours) const;
+        void PushCollapse(uint32_t a, uint32_t b);
+        bool IsValid(uint32_t from, uint32_t to);
+        void DoCollapse(uint32_t from, uint32_t to);
+
+        std::vector<Vec3> m_positions;             // welded
+        std::vector<uint32_t> m_representative;    // welded vertex to one of its original vertices
+        std::vector<uint32_t> m_remap;             // original vertex to welded vertex
+
+        std::vector<std::array<uint32_t, 3>> m_triangles;
+        std::vector<bool> m_triangleAlive;
+        uint32_t m_liveTriangles = 0;
+
+        std::vector<std::vector<uint32_t>> m_vertexTriangles;
+        std::vector<Quadric> m_quadrics;
+        std::vector<uint32_t> m_versions;
+        std::vector<bool> m_removed;
+
+        std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> m_queue;
+
+        std::vector<uint32_t> m_scratchA;
+        std::vector<uint32_t> m_scratchB;
+    };
+
+    void Simplifier::Weld(float const* pPositions, uint32_t positionStride, uint32_t vertexCount)
+    {
+        std::unordered_map<PositionKey, uint32_t, PositionKeyHash> welded;
+        welded.reserve(vertexCount);
+
+        m_remap.resize(vertexCount);
+        for (uint32_t i = 0; i < vertexCount; ++i)
+        {
+            float const* p = reinterpret_cast<float const*>(reinterpret_cast<uint8_t const*>(pPositions) + size_t(i) * positionStride);
+
+            // -0 and 0 are the same position but not the same bits
+            float const position[3] = { p[0] == 0.0f ? 0.0f : p[0], p[1] == 0.0f ? 0.0f : p[1], p[2] == 0.0f ? 0.0f : p[2] };
+
+            PositionKey key;
+            memcpy(&key, position, sizeof(key));
+
+            auto it = welded.find(key);
+            if (it == welded.end())
+            {
+                it = welded.emplace(key, static_cast<uint32_t>(m_positions.size())).first;
+                m_positions.push_back({ p[0], p[1], p[2] });
+                m_representative.push_back(i);
+            }
+            m_remap[i] = it->second;
+        }
+
+        m_vertexTriangles.resize(m_positions.size());
+        m_quadrics.resize(m_positions.size(), Quadric{});
+        m_versions.resize(m_positions.size(), 0);
+        m_removed.resize(m_positions.size(), false);
+    }
+
+    void Simplifier::AddTriangles(uint32_t const* pIndices, uint32_t indexCount)
+    {
+        m_triangles.reserve(indexCount / 3);
+        for (uint32_t i = 0; i + 2 < indexCount; i += 3)
+        {
+            std::array<uint32_t, 3> const t = { m_remap[pIndices[i + 0]], m_remap[pIndices[i + 1]], m_remap[pIndices[i + 2]] };
+
+            // degenerate after welding, these don't cast shadows anyway
+            if (t[0] == t[1] || t[1] == t[2] || t[2] == t[0])
+                continue;
+
+            uint32_t const triangle = static_cast<uint32_t>(m_triangles.size());
+            m_triangles.push_back(t);
+            for (uint32_t v : t)
+            {
+                m_vertexTriangles[v].push_back(triangle);
+            }
+        }
+
+        m_triangleAlive.resize(m_triangles.size(), true);
+        m_liveTriangles = static_cast<uint32_t>(m_triangles.size());
+    }
+
+    void Simplifier::ComputeQuadrics()
+    {
+        std::unordered_map<uint64_t, uint32_t> edgeUse;
+        edgeUse.reserve(m_triangles.size() * 3);
+        for (auto const& t : m_triangles)
+        {
+            for (int e = 0; e < 3; ++e)
+            {
+                edgeUse[EdgeKey(t[e], t[(e + 1) % 3])]++;
+            }
+        }
+
+        for (auto const& t : m_triangles)
+        {
+            Vec3 const& p0 = m_positions[t[0]];
+            Vec3 n = Cross(Sub(m_positions[t[1]], p0), Sub(m_positions[t[2]], p0));
+            double const length = sqrt(Dot(n, n));
+            if (length == 0.0)
+                continue;
+            n = { n.x / length, n.y / length, n.z / length };
+
+            double const d = -Dot(n, p0);
+            for (uint32_t v : t)
+            {
+                m_quadrics[v].AddPlane(n, d, 1.0);
+            }
+
+            for (int e = 0; e < 3; ++e)
+            {
+                uint32_t const a = t[e];
+                uint32_t const b = t[(e + 1) % 3];
+                if (edgeUse[EdgeKey(a, b)] != 1)
+                    continue;
+
+                Vec3 const edge = Sub(m_positions[b], m_positions[a]);
+                Vec3 borderNormal = Cross(edge, n);
+                double const borderLength = sqrt(Dot(borderNormal, borderNormal));
+                if (borderLength == 0.0)
+                    continue;
+                borderNormal = { borderNormal.x / borderLength, borderNormal.y / borderLength, borderNormal.z / borderLength };
+
+                double const borderD = -Dot(borderNormal, m_positions[a]);
+                m_quadrics[a].AddPlane(borderNormal, borderD, s_BorderWeight);
+                m_quadrics[b].AddPlane(borderNormal, borderD, s_BorderWeight);
+            }
+        }
+    }
+
+    void Simplifier::GatherNeighbours(uint32_t v, std::vector<uint32_t>& neighbours) const
+    {
+        neighbours.clear();
+        for (uint32_t triangle : m_vertexTriangles[v])
+        {
+            if (!m_triangleAlive[triangle])
+                continue;
+            for (uint32_t other : m_triangles[triangle])
+            {
+                if (other != v)
+                {
+                    neighbours.push_back(other);
+                }
+            }
+        }
+        std::sort(neighbours.begin(), neighbours.end());
+        neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+    }
+
+    void Simplifier::PushCollapse(uint32_t a, uint32_t b)
+    {
+        Quadric q = m_quadrics[a];
+        q.Add(m_quadrics[b]);
+
+        double const costAB = q.Evaluate(m_positions[b]);
+        double const costBA = q.Evaluate(m_positions[a]);
+
+        if (costAB <= costBA)
+        {
+            m_queue.push({ costAB, a, b, m_versions[a], m_versions[b] });
+        }
+        else
+        {
+            m_queue.push({ costBA, b, a, m_versions[b], m_versions[a] });
+        }
+    }
+
+    bool Simplifier::IsValid(uint32_t from, uint32_t to)
+    {
+        // link condition, the edge may only share the vertices of the triangles on it, otherwise
+        // the collapse pinches the surface
+        uint32_t sharedTriangles = 0;
+        for (uint32_t triangle : m_vertexTriangles[from])
+        {
+            if (!m_triangleAlive[triangle])
+                continue;
+
+            auto const& t = m_triangles[triangle];
+            if (t[0] == to || t[1] == to || t[2] == to)
+            {
+                ++sharedTriangles;
+                continue;
+            }
+
+            // the triangles that stay must not flip
+            Vec3 p[3];
+            Vec3 q[3];
+            for (int i = 0; i < 3; ++i)
+            {
+                p[i] = m_positions[t[i]];
+                q[i] = t[i] == from ? m_positions[to] : p[i];
+            }
+            Vec3 const before = Cross(Sub(p[1], p[0]), Sub(p[2], p[0]));
+            Vec3 const after = Cross(Sub(q[1], q[0]), Sub(q[2], q[0]));
+
+            double const lengths = sqrt(Dot(before, before) * Dot(after, after));
+            if (lengths == 0.0 || Dot(before, after) < s_MinNormalCos * lengths)
+                return false;
+        }
+
+        GatherNeighbours(from, m_scratchA);
+        GatherNeighbours(to, m_scratchB);
+
+        uint32_t commonNeighbours = 0;
+        for (size_t i = 0, j = 0; i < m_scratchA.size() && j < m_scratchB.size();)
+        {
+            if (m_scratchA[i] < m_scratchB[j])
+                ++i;
+            else if (m_scratchB[j] < m_scratchA[i])
+                ++j;
+            else
+            {
+                ++commonNeighbours;
+                ++i;
+                ++j;
+            }
+        }
+
+        return commonNeighbours <= sharedTriangles;
+    }
+
+    void Simplifier::DoCollapse(uint32_t from, uint32_t to)
+    {
+        for (uint32_t triangle : m_vertexTriangles[from])
+        {
+            if (!m_triangleAlive[triangle])
+                continue;
+
+            auto& t = m_triangles[triangle];
+            if (t[0] == to || t[1] == to || t[2] == to)
+            {
+                m_triangleAlive[triangle] = false;
+                --m_liveTriangles;
+                continue;
+            }
+
+            for (uint32_t& v : t)
+            {
+                if (v == from)
+                {
+                    v = to;
+                }
+            }
+            m_vertexTriangles[to].push_back(triangle);
+        }
+        m_vertexTriangles[from].clear();
+
+        // drop the dead triangles, the lists only grow otherwise
+        auto& triangles = m_vertexTriangles[to];
+        triangles.erase(std::remove_if(triangles.begin(), triangles.end(), [this](uint32_t triangle) { return !m_triangleAlive[triangle]; }), triangles.end());
+
+        m_quadrics[to].Add(m_quadrics[from]);
+        m_removed[from] = true;
+        m_versions[to]++;
+
+        GatherNeighbours(to, m_scratchA);
+        for (uint32_t neighbour : m_scratchA)
+        {
+            PushCollapse(to, neighbour);
+        }
+    }
+
+    void Simplifier::Run(uint32_t targetIndexCount, float maxError)
+    {
+        // every interior edge is in two triangles, push it once
+        std::vector<uint64_t> edges;
+        edges.reserve(m_triangles.size() * 3);
+        for (auto const& t : m_triangles)
+        {
+            for (int e = 0; e < 3; ++e)
+            {
+                edges.push_back(EdgeKey(t[e], t[(e + 1) % 3]));
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+        for (uint64_t edge : edges)
+        {
+            PushCollapse(static_cast<uint32_t>(edge >> 32), static_cast<uint32_t>(edge & 0xffffffff));
+        }
+
+        double const maxCost = double(maxError) * double(maxError);
+        while (m_liveTriangles * 3 > targetIndexCount && !m_queue.empty())
+        {
+            Collapse const collapse = m_queue.top();
+            m_queue.pop();
+
+            if (m_removed[collapse.from] || m_removed[collapse.to]
+                || m_versions[collapse.from] != collapse.fromVersion || m_versions[collapse.to] != collapse.toVersion)
+                continue;
+
+            // the queue is sorted by cost, nothing cheaper is left
+            if (collapse.cost > maxCost)
+                break;
+
+            if (!IsValid(collapse.from, collapse.to))
+                continue;
+
+            DoCollapse(collapse.from, collapse.to);
+        }
+    }
+
+    void Simplifier::Write(std::vector<uint32_t>& outIndices) const
+    {
+        outIndices.clear();
+        outIndices.reserve(m_liveTriangles * 3);
+        for (size_t i = 0; i < m_triangles.size(); ++i)
+        {
+            if (!m_triangleAlive[i])
+                continue;
+
+            for (uint32_t v : m_triangles[i])
+            {
+                outIndices.push_back(m_representative[v]);
+            }
+        }
+    }
+}
+
+void MeshSimplifier::Simplify(float const* pPositions, uint32_t positionStride, uint32_t vertexCount,
+    uint32_t const* pIndices, uint32_t indexCount, uint32_t targetIndexCount, float maxError,
+    std::vector<uint32_t>& outIndices)
+{
+    Simplifier simplifier;
+    simplifier.Weld(pPositions, positionStride, vertexCount);
+    simplifier.AddTriangles(pIndices, indexCount);
+    simplifier.ComputeQuadrics();
+    simplifier.Run(targetIndexCount, maxError);
+    simplifier.Write(outIndices);
+}
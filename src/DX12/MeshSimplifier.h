@@ -0,0 +1,36 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#pragma once
+
+//--------------------------------------------------------------------------------------
+// Quadric error metric simplification for the shadow proxy meshes. Edges are collapsed
+// into one of their two vertices, so the simplified mesh indexes the original vertex
+// buffer and only needs a new index buffer. Vertices at the same position are welded
+// first, that way the normal and UV seams of the render mesh don't pin the
+// simplification. Only depends on the standard library.
+//--------------------------------------------------------------------------------------
+class MeshSimplifier
+{
+public:
+    // Collapses edges until the mesh is down to targetIndexCount indices or the cheapest
+    // collapse would move the surface further than maxError from the original.
+    static void Simplify(float const* pPositions, uint32_t positionStride, uint32_t vertexCount,
+        uint32_t const* pIndices, uint32_t indexCount, uint32_t targetIndexCount, float maxError,
+        std::vector<uint32_t>& outIndices);
+};
@@ -0,0 +1,189 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include "stdafx.h"
+
+#include "OpacityMicromap.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // Texel footprint of a micro triangle, bounding boxes bigger than this aren't worth scanning
+    uint32_t const MaxFootprintTexels = 4096;
+    // Micro triangle area the subdivision aims for, in texels
+    float const TargetTexelArea = 4.0f;
+    // Slack for the interpolation in the shader not rounding like the baker
+    float const FootprintEpsilon = 1.0f / 64.0f;
+
+    // The texels within a step of the cutoff count as both, the filtering and the block decompression
+    // on the GPU may not round like the baker does
+    OpacityMicromap::State Classify(OpacityMicromap::AlphaMask const& mask, uint8_t alphaCutoff, float const (&uvs)[3][2])
+    {
+        // fminf and fmaxf skip NaNs, so the corners are checked before they go into the bounds
+        float const limit = 1e6f;
+        float minX = INFINITY, minY = INFINITY, maxX = -INFINITY, maxY = -INFINITY;
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+            // bilinear samples at texel centers
+            float const x = uvs[i][0] * mask.width - 0.5f;
+            float const y = uvs[i][1] * mask.height - 0.5f;
+            if (!(fabsf(x) < limit && fabsf(y) < limit))
+                return OpacityMicromap::Unknown;
+
+            minX = fminf(minX, x);
+            minY = fminf(minY, y);
+            maxX = fmaxf(maxX, x);
+            maxY = fmaxf(maxY, y);
+        }
+
+        int64_t const x0 = (int64_t)floorf(minX - FootprintEpsilon);
+        int64_t const y0 = (int64_t)floorf(minY - FootprintEpsilon);
+        int64_t const x1 = (int64_t)floorf(maxX + FootprintEpsilon) + 1;
+        int64_t const y1 = (int64_t)floorf(maxY + FootprintEpsilon) + 1;
+        if ((x1 - x0 + 1) * (y1 - y0 + 1) > MaxFootprintTexels)
+            return OpacityMicromap::Unknown;
+
+        bool bAnyOpaque = false;
+        bool bAnyTransparent = false;
+        for (int64_t y = y0; y <= y1; ++y)
+        {
+            int64_t const wrappedY = ((y % mask.height) + mask.height) % mask.height;
+            uint8_t const* pRow = mask.alpha.data() + wrappedY * mask.width;
+            for (int64_t x = x0; x <= x1; ++x)
+            {
+                int64_t const wrappedX = ((x % mask.width) + mask.width) % mask.width;
+                uint8_t const alpha = pRow[wrappedX];
+                if (alpha > alphaCutoff + 1)
+                {
+                    bAnyOpaque = true;
+                }
+                else if (alpha < alphaCutoff)
+                {
+                    bAnyTransparent = true;
+                }
+                else
+                {
+                    bAnyOpaque = true;
+                    bAnyTransparent = true;
+                }
+
+                if (bAnyOpaque && bAnyTransparent)
+                    return OpacityMicromap::Unknown;
+            }
+        }
+
+        return bAnyOpaque ? OpacityMicromap::Opaque : OpacityMicromap::Transparent;
+    }
+}
+
+uint32_t OpacityMicromap::MakeUniform(State state)
+{
+    return (UniformLevel << 28) | state;
+}
+
+uint32_t OpacityMicromap::Rebase(uint32_t descriptor, uint32_t base)
+{
+    return (descriptor >> 28) == UniformLevel ? descriptor : descriptor + base;
+}
+
+uint32_t OpacityMicromap::GetMicroTriangleIndex(uint32_t level, float u, float v)
+{
+    uint32_t const segments = 1u << level;
+    float const x = u * segments;
+    float const y = v * segments;
+    uint32_t const iy = min((uint32_t)max(y, 0.0f), segments - 1);
+    uint32_t ix = min((uint32_t)max(x, 0.0f), segments - 1 - iy);
+
+    // the last micro triangle of a row is always upright
+    bool const bUpright = ix + iy == segments - 1 || (x - ix) + (y - iy) < 1.0f;
+    return iy * (2 * segments - iy) + 2 * ix + (bUpright ? 0 : 1);
+}
+
+OpacityMicromap::State OpacityMicromap::GetState(uint32_t descriptor, uint32_t const* pStates, float u, float v)
+{
+    uint32_t const level = descriptor >> 28;
+    if (level == UniformLevel)
+        return static_cast<State>(descriptor & 0x3);
+
+    uint32_t const index = GetMicroTriangleIndex(level, u, v);
+    uint32_t const offset = descriptor & 0x0fffffff;
+    return static_cast<State>((pStates[offset + index / 16] >> (2 * (index % 16))) & 0x3);
+}
+
+uint32_t OpacityMicromap::Bake(AlphaMask const& mask, float alphaCutoff, float const uv0[2], float const uv01[2], float const uv02[2],
+    uint32_t maxLevel, std::vector<uint32_t>& states)
+{
+    if (mask.width == 0 || mask.height == 0)
+        return MakeUniform(Unknown);
+
+    // alpha > alphaCutoff in the shader, for any blend of texels that are all above or all below the byte
+    uint8_t const cutoff = (uint8_t)min(max(floorf(alphaCutoff * 255.0f), 0.0f), 255.0f);
+
+    float const texelArea = 0.5f * fabsf(uv01[0] * uv02[1] - uv01[1] * uv02[0]) * mask.width * mask.height;
+    uint32_t level = 0;
+    while (level < min(maxLevel, MaxLevel) && texelArea > TargetTexelArea * (float)(1u << (2 * level)))
+    {
+        ++level;
+    }
+
+    uint32_t const segments = 1u << level;
+    std::vector<uint8_t> microStates;
+    microStates.reserve(segments * segments);
+
+    auto classify = [&](uint32_t const (&corners)[3][2])
+    {
+        float uvs[3][2];
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+            float const b1 = (float)corners[i][0] / segments;
+            float const b2 = (float)corners[i][1] / segments;
+            uvs[i][0] = uv0[0] + uv01[0] * b1 + uv02[0] * b2;
+            uvs[i][1] = uv0[1] + uv01[1] * b1 + uv02[1] * b2;
+        }
+        microStates.push_back((uint8_t)Classify(mask, cutoff, uvs));
+    };
+
+    for (uint32_t iy = 0; iy < segments; ++iy)
+    {
+        for (uint32_t ix = 0; ix + iy < segments; ++ix)
+        {
+            uint32_t const upright[3][2] = { { ix, iy }, { ix + 1, iy }, { ix, iy + 1 } };
+            classify(upright);
+
+            if (ix + iy + 1 < segments)
+            {
+                uint32_t const inverted[3][2] = { { ix + 1, iy }, { ix, iy + 1 }, { ix + 1, iy + 1 } };
+                classify(inverted);
+            }
+        }
+    }
+
+    if (std::all_of(microStates.cbegin(), microStates.cend(), [&](uint8_t state) { return state == microStates.front(); }))
+        return MakeUniform(static_cast<State>(microStates.front()));
+
+    uint32_t const offset = (uint32_t)states.size();
+    states.resize(offset + (microStates.size() + 15) / 16, 0);
+    for (size_t i = 0; i < microStates.size(); ++i)
+    {
+        states[offset + i / 16] |= (uint32_t)microStates[i] << (2 * (i % 16));
+    }
+
+    return (level << 28) | offset;
+}
@@ -0,0 +1,69 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#pragma once
+
+//--------------------------------------------------------------------------------------
+// Software opacity micromaps for the alpha masked shadow geometry. Each masked triangle
+// is subdivided in barycentric space and every micro triangle is classified against
+// the bilinear footprint of the mask texture, so the trace only has to sample the mask
+// where a micro triangle straddles the cut out. The shader reads the same layout, see
+// GetOpacityMicromapState in ShadowRaytrace.hlsl. Only depends on the standard library.
+//--------------------------------------------------------------------------------------
+class OpacityMicromap
+{
+public:
+    enum State : uint32_t
+    {
+        Transparent = 0,
+        Opaque = 1,
+        Unknown = 2,
+    };
+
+    // Alpha of the top mip of a mask texture, sampled with wrap addressing like ss_mask
+    struct AlphaMask
+    {
+        uint32_t width;
+        uint32_t height;
+        std::vector<uint8_t> alpha;
+    };
+
+    // A triangle is described by one dword, the subdivision level in the top 4 bits and the
+    // dword offset of its states in the rest, 16 states of 2 bits per dword. The triangles
+    // that classify the same everywhere use UniformLevel and keep their state in the low bits.
+    static const uint32_t UniformLevel = 0xf;
+    static const uint32_t MaxLevel = 8;
+
+    static uint32_t MakeUniform(State state);
+    // Adds base to the state offset of a descriptor returned by Bake
+    static uint32_t Rebase(uint32_t descriptor, uint32_t base);
+
+    // Micro triangles are numbered row by row along the second barycentric, alternating
+    // upright and inverted ones within a row
+    static uint32_t GetMicroTriangleIndex(uint32_t level, float u, float v);
+    static State GetState(uint32_t descriptor, uint32_t const* pStates, float u, float v);
+
+    // Subdivides the triangle until its micro triangles cover a few texels or maxLevel is reached,
+    // the UVs are the ones the shader interpolates. A micro triangle is opaque when all the texels
+    // its bilinear footprint touches are clearly above alphaCutoff, transparent when all are clearly
+    // below, a texel within one 8 bit step of the cutoff makes it unknown. The states of
+    // a non uniform triangle are appended to states, the offset in the returned descriptor is relative
+    // to the start of states.
+    static uint32_t Bake(AlphaMask const& mask, float alphaCutoff, float const uv0[2], float const uv01[2], float const uv02[2],
+        uint32_t maxLevel, std::vector<uint32_t>& states);
+};
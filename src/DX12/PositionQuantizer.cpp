@@ -0,0 +1,113 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+
+#include "PositionQuantizer.h"
+
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+    float const SnormScale = 32767.0f;
+
+    float const* GetPosition(float const* pPositions, uint32_t positionStride, uint32_t vertex)
+    {
+        return reinterpret_cast<float const*>(reinterpret_cast<char const*>(pPositions) + (size_t)positionStride * vertex);
+    }
+}
+
+PositionQuantizer::Bounds PositionQuantizer::GetBounds(float const* pPositions, uint32_t positionStride, uint32_t vertexCount)
+{
+    float lo[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (uint32_t v = 0; v < vertexCount; ++v)
+    {
+        float const* p = GetPosition(pPositions, positionStride, v);
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+            lo[i] = min(lo[i], p[i]);
+            hi[i] = max(hi[i], p[i]);
+        }
+    }
+
+    Bounds bounds = {};
+    float largest = 0.0f;
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        bounds.center[i] = vertexCount ? 0.5f * (lo[i] + hi[i]) : 0.0f;
+        bounds.halfExtent[i] = vertexCount ? 0.5f * (hi[i] - lo[i]) : 0.0f;
+        largest = max(largest, bounds.halfExtent[i]);
+    }
+
+    // a flat axis is only a step of the largest one thick, that keeps its precision without a
+    // singular transform, which the ray cone mip selection would divide by
+    float const smallest = largest > 0.0f ? largest / SnormScale : 1.0f;
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        bounds.halfExtent[i] = max(bounds.halfExtent[i], smallest);
+    }
+    return bounds;
+}
+
+float PositionQuantizer::GetMaxError(Bounds const& bounds)
+{
+    float const step[3] =
+    {
+        bounds.halfExtent[0] / SnormScale,
+        bounds.halfExtent[1] / SnormScale,
+        bounds.halfExtent[2] / SnormScale,
+    };
+    return 0.5f * std::sqrt(step[0] * step[0] + step[1] * step[1] + step[2] * step[2]);
+}
+
+void PositionQuantizer::Quantize(float const* pPositions, uint32_t positionStride, uint32_t vertexCount, Bounds const& bounds, int16_t* pQuantized)
+{
+    float const scale[3] =
+    {
+        SnormScale / bounds.halfExtent[0],
+        SnormScale / bounds.halfExtent[1],
+        SnormScale / bounds.halfExtent[2],
+    };
+
+    for (uint32_t v = 0; v < vertexCount; ++v, pQuantized += 4)
+    {
+        float const* p = GetPosition(pPositions, positionStride, v);
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+            float const q = std::round((p[i] - bounds.center[i]) * scale[i]);
+            pQuantized[i] = (int16_t)max(-SnormScale, min(SnormScale, q));
+        }
+        pQuantized[3] = 0;
+    }
+}
+
+void PositionQuantizer::Dequantize(int16_t const* pQuantized, uint32_t vertexCount, Bounds const& bounds, float* pPositions)
+{
+    for (uint32_t v = 0; v < vertexCount; ++v, pQuantized += 4, pPositions += 3)
+    {
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+            // -32768 decodes to -1 like -32767
+            float const snorm = max(-1.0f, pQuantized[i] / SnormScale);
+            pPositions[i] = bounds.center[i] + snorm * bounds.halfExtent[i];
+        }
+    }
+}
@@ -0,0 +1,47 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#pragma once
+
+//--------------------------------------------------------------------------------------
+// Quantizes the BLAS positions to R16G16B16A16_SNORM relative to the bounds of their
+// primitive, 8 bytes per vertex instead of 12. The bounds are mapped to [-1, 1] on each
+// axis, the transform from the bounds back to object space goes into the instance
+// transform. Only depends on the standard library.
+//--------------------------------------------------------------------------------------
+class PositionQuantizer
+{
+public:
+    struct Bounds
+    {
+        float center[3];
+        // never 0, flat axes get a small extent so the dequantization stays invertible
+        float halfExtent[3];
+    };
+
+    static Bounds GetBounds(float const* pPositions, uint32_t positionStride, uint32_t vertexCount);
+
+    // Largest distance between a position inside the bounds and its quantized one, half a
+    // step on every axis
+    static float GetMaxError(Bounds const& bounds);
+
+    // four components per vertex, the fourth is 0 and ignored by the BLAS build
+    static void Quantize(float const* pPositions, uint32_t positionStride, uint32_t vertexCount, Bounds const& bounds, int16_t* pQuantized);
+    // what the BLAS build reads back, in object space
+    static void Dequantize(int16_t const* pQuantized, uint32_t vertexCount, Bounds const& bounds, float* pPositions);
+};
@@ -0,0 +1,288 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+
+#include "RangeAllocator.h"
+
+#include <algorithm>
+
+namespace
+{
+	bool IsBefore(std::pair<uint64_t, uint32_t> const& used, uint64_t offset)
+	{
+		return used.first < offset;
+	}
+}
+
+namespace Raytracing
+{
+	RangeAllocator::RangeAllocator(void)
+		: m_blocks()
+		, m_unusedBlocks()
+		, m_usedBlocks()
+		, m_firstBlock(NoBlock)
+		, m_size(0)
+		, m_alignment(1)
+		, m_usedSize(0)
+		, m_allocationCount(0)
+	{
+		for (uint32_t i = 0; i < SizeClassCount; ++i)
+		{
+			m_freeLists[i] = NoBlock;
+		}
+	}
+
+	RangeAllocator::~RangeAllocator(void)
+	{
+	}
+
+	void RangeAllocator::Init(uint64_t size, uint64_t alignment)
+	{
+		assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+
+		m_alignment = alignment;
+		m_size = size & ~(alignment - 1);
+		Reset();
+	}
+
+	uint64_t RangeAllocator::Allocate(uint64_t size)
+	{
+		size = (max(size, 1ull) + m_alignment - 1) & ~(m_alignment - 1);
+
+		// Any range in the lists of the larger classes fits, only the list of the size's own class has to be searched
+		uint32_t const sizeClass = SizeClass(size);
+		uint32_t block = NoBlock;
+		for (uint32_t b = m_freeLists[sizeClass]; b != NoBlock; b = m_blocks[b].nextFree)
+		{
+			if (m_blocks[b].size >= size)
+			{
+				block = b;
+				break;
+			}
+		}
+		for (uint32_t c = sizeClass + 1; c < SizeClassCount && block == NoBlock; ++c)
+		{
+			block = m_freeLists[c];
+		}
+
+		if (block == NoBlock)
+			return InvalidOffset;
+
+		UnlinkFree(block);
+
+		// the rest of the range stays free, NewBlock can move the blocks so no references are kept across it
+		if (m_blocks[block].size > size)
+		{
+			uint32_t const rest = NewBlock(m_blocks[block].offset + size, m_blocks[block].size - size);
+			uint32_t const next = m_blocks[block].next;
+
+			m_blocks[rest].prev = block;
+			m_blocks[rest].next = next;
+			if (next != NoBlock)
+			{
+				m_blocks[next].prev = rest;
+			}
+			m_blocks[block].next = rest;
+			m_blocks[block].size = size;
+
+			LinkFree(rest);
+		}
+
+		m_usedSize += size;
+		m_allocationCount++;
+		uint64_t const offset = m_blocks[block].offset;
+		m_usedBlocks.insert(std::lower_bound(m_usedBlocks.begin(), m_usedBlocks.end(), offset, IsBefore), std::make_pair(offset, block));
+
+		return offset;
+	}
+
+	void RangeAllocator::Free(uint64_t offset)
+	{
+		auto const used = std::lower_bound(m_usedBlocks.begin(), m_usedBlocks.end(), offset, IsBefore);
+		assert(used != m_usedBlocks.end() && used->first == offset);
+		if (used == m_usedBlocks.end() || used->first != offset)
+			return;
+
+		uint32_t block = used->second;
+		m_usedBlocks.erase(used);
+
+		m_usedSize -= m_blocks[block].size;
+		m_allocationCount--;
+
+		// merge with the free neighbours
+		uint32_t const next = m_blocks[block].next;
+		if (next != NoBlock && m_blocks[next].bFree)
+		{
+			UnlinkFree(next);
+
+			m_blocks[block].size += m_blocks[next].size;
+			m_blocks[block].next = m_blocks[next].next;
+			if (m_blocks[next].next != NoBlock)
+			{
+				m_blocks[m_blocks[next].next].prev = block;
+			}
+			ReleaseBlock(next);
+		}
+
+		uint32_t const prev = m_blocks[block].prev;
+		if (prev != NoBlock && m_blocks[prev].bFree)
+		{
+			UnlinkFree(prev);
+
+			m_blocks[prev].size += m_blocks[block].size;
+			m_blocks[prev].next = m_blocks[block].next;
+			if (m_blocks[block].next != NoBlock)
+			{
+				m_blocks[m_blocks[block].next].prev = prev;
+			}
+			ReleaseBlock(block);
+			block = prev;
+		}
+
+		LinkFree(block);
+	}
+
+	void RangeAllocator::Reset(void)
+	{
+		// clear() keeps the capacity, resetting doesn't allocate
+		m_blocks.clear();
+		m_unusedBlocks.clear();
+		m_usedBlocks.clear();
+		for (uint32_t i = 0; i < SizeClassCount; ++i)
+		{
+			m_freeLists[i] = NoBlock;
+		}
+		m_usedSize = 0;
+		m_allocationCount = 0;
+
+		m_firstBlock = NoBlock;
+		if (m_size != 0)
+		{
+			m_firstBlock = NewBlock(0, m_size);
+			LinkFree(m_firstBlock);
+		}
+	}
+
+	uint64_t RangeAllocator::GetSize(void) const
+	{
+		return m_size;
+	}
+
+	uint64_t RangeAllocator::GetUsedSize(void) const
+	{
+		return m_usedSize;
+	}
+
+	uint64_t RangeAllocator::GetLargestFreeRange(void) const
+	{
+		for (uint32_t c = SizeClassCount; c-- > 0; )
+		{
+			uint64_t largest = 0;
+			for (uint32_t b = m_freeLists[c]; b != NoBlock; b = m_blocks[b].nextFree)
+			{
+				largest = max(largest, m_blocks[b].size);
+			}
+			if (largest != 0)
+				return largest;
+		}
+		return 0;
+	}
+
+	uint32_t RangeAllocator::GetAllocationCount(void) const
+	{
+		return m_allocationCount;
+	}
+
+	uint32_t RangeAllocator::SizeClass(uint64_t size)
+	{
+		assert(size != 0);
+
+		unsigned long index = 0;
+		_BitScanReverse64(&index, size);
+		return (uint32_t)index;
+	}
+
+	uint32_t RangeAllocator::NewBlock(uint64_t offset, uint64_t size)
+	{
+		uint32_t block;
+		if (!m_unusedBlocks.empty())
+		{
+			block = m_unusedBlocks.back();
+			m_unusedBlocks.pop_back();
+		}
+		else
+		{
+			block = (uint32_t)m_blocks.size();
+			m_blocks.emplace_back();
+		}
+
+		Block& b = m_blocks[block];
+		b.offset = offset;
+		b.size = size;
+		b.prev = NoBlock;
+		b.next = NoBlock;
+		b.prevFree = NoBlock;
+		b.nextFree = NoBlock;
+		b.bFree = false;
+		return block;
+	}
+
+	void RangeAllocator::ReleaseBlock(uint32_t block)
+	{
+		m_unusedBlocks.push_back(block);
+	}
+
+	void RangeAllocator::LinkFree(uint32_t block)
+	{
+		Block& b = m_blocks[block];
+		uint32_t const sizeClass = SizeClass(b.size);
+
+		b.bFree = true;
+		b.prevFree = NoBlock;
+		b.nextFree = m_freeLists[sizeClass];
+		if (b.nextFree != NoBlock)
+		{
+			m_blocks[b.nextFree].prevFree = block;
+		}
+		m_freeLists[sizeClass] = block;
+	}
+
+	void RangeAllocator::UnlinkFree(uint32_t block)
+	{
+		Block& b = m_blocks[block];
+
+		if (b.prevFree != NoBlock)
+		{
+			m_blocks[b.prevFree].nextFree = b.nextFree;
+		}
+		else
+		{
+			m_freeLists[SizeClass(b.size)] = b.nextFree;
+		}
+		if (b.nextFree != NoBlock)
+		{
+			m_blocks[b.nextFree].prevFree = b.prevFree;
+		}
+
+		b.bFree = false;
+		b.prevFree = NoBlock;
+		b.nextFree = NoBlock;
+	}
+}
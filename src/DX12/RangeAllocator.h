@@ -0,0 +1,87 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+namespace Raytracing
+{
+	// Suballocates ranges of a fixed size heap. It only does the bookkeeping, so it doesn't depend
+	// on the device. The free ranges are kept in one list per power of two size class and merged with
+	// their free neighbours when released, so the space gets reused instead of fragmenting. The used
+	// ranges are kept sorted by offset, so a release finds its range with a binary search. All the
+	// bookkeeping is in vectors that keep their capacity, once the peak number of ranges has been
+	// reached allocating and freeing don't touch the heap.
+	class RangeAllocator
+	{
+	public:
+		static const uint64_t InvalidOffset = ~0ull;
+
+		RangeAllocator(void);
+		~RangeAllocator(void);
+
+		// alignment has to be a power of two, every offset and size is a multiple of it
+		void Init(uint64_t size, uint64_t alignment);
+
+		// Returns InvalidOffset when no free range is large enough
+		uint64_t Allocate(uint64_t size);
+		void Free(uint64_t offset);
+		// frees everything at once
+		void Reset(void);
+
+		uint64_t GetSize(void) const;
+		uint64_t GetUsedSize(void) const;
+		uint64_t GetLargestFreeRange(void) const;
+		uint32_t GetAllocationCount(void) const;
+
+	private:
+		static const uint32_t SizeClassCount = 64;
+		static const uint32_t NoBlock = ~0u;
+
+		// a used or free range, linked to its neighbours in address order and to the other free
+		// ranges of its size class
+		struct Block
+		{
+			uint64_t offset;
+			uint64_t size;
+			uint32_t prev;
+			uint32_t next;
+			uint32_t prevFree;
+			uint32_t nextFree;
+			bool bFree;
+		};
+
+		static uint32_t SizeClass(uint64_t size);
+
+		uint32_t NewBlock(uint64_t offset, uint64_t size);
+		void ReleaseBlock(uint32_t block);
+		void LinkFree(uint32_t block);
+		void UnlinkFree(uint32_t block);
+
+		std::vector<Block> m_blocks;
+		std::vector<uint32_t> m_unusedBlocks;
+		std::vector<std::pair<uint64_t, uint32_t>> m_usedBlocks; // offset and block of the allocated ranges, sorted by offset
+		uint32_t m_freeLists[SizeClassCount];
+		uint32_t m_firstBlock;
+
+		uint64_t m_size;
+		uint64_t m_alignment;
+		uint64_t m_usedSize;
+		uint32_t m_allocationCount;
+	};
+}
@@ -20,223 +20,310 @@
 #include "stdafx.h"
 
 #include "Raytracer.h"
+#include "MeshSimplifier.h"
+#include "PositionQuantizer.h"
+#include "SceneCache.h"
+#include "OpacityMicromap.h"
+#include "AlphaMaskPacker.h"
+#include "TriangleUVPacker.h"
 #include "GLTF/GltfHelpers.h"
+#include "Misc/ImgLoader.h"
 
 namespace
 {
-	uint32_t GetIndex(tfAccessor const& indexBuffer, uint32_t indexIndex)
+	typedef TriangleUVPacker::UV UV;
+
+	// maps the [-1, 1] box of the quantized positions onto their bounds
+	math::Matrix4 GetDequantization(PositionQuantizer::Bounds const& bounds)
+	{
+		math::Vector3 const center(bounds.center[0], bounds.center[1], bounds.center[2]);
+		math::Vector3 const halfExtent(bounds.halfExtent[0], bounds.halfExtent[1], bounds.halfExtent[2]);
+		return math::Matrix4::translation(center) * math::Matrix4::scale(halfExtent);
+	}
+
+	// Octahedral encoding of a unit vector, UnpackNormal in ShadowRaytrace.hlsl reads it back
+	uint32_t PackNormal(float const normal[3])
 	{
-		void const* pIndex = indexBuffer.Get(indexIndex);
+		float const l1 = fabsf(normal[0]) + fabsf(normal[1]) + fabsf(normal[2]);
+		if (!(l1 > 0.0f))
+			return 0;
 
-		uint32_t index = ~0;
-		switch (indexBuffer.m_stride)
+		float x = normal[0] / l1;
+		float y = normal[1] / l1;
+		if (normal[2] < 0.0f)
 		{
-		case 1:
-			index = *reinterpret_cast<uint8_t const*>(pIndex);
-			break;
-		case 2:
-			index = *reinterpret_cast<uint16_t const*>(pIndex);
-			break;
-		case 4:
-			index = *reinterpret_cast<uint32_t const*>(pIndex);
-			break;
-		default:
-			break;
+			float const foldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+			float const foldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+			x = foldedX;
+			y = foldedY;
 		}
 
-		return index;
+		int32_t const sx = (int32_t)roundf(min(max(x, -1.0f), 1.0f) * 32767.0f);
+		int32_t const sy = (int32_t)roundf(min(max(y, -1.0f), 1.0f) * 32767.0f);
+		return ((uint32_t)sx & 0xffff) | ((uint32_t)sy << 16);
 	}
 
-	math::Point2 GetUV(tfAccessor const& uvBuffer, uint32_t indexIndex)
-	{
-		float const* pUV = reinterpret_cast<float const*>(uvBuffer.Get(indexIndex));
-
-		assert(uvBuffer.m_stride == 8);
-
-		math::Point2 uv = math::Point2(pUV[0], pUV[1]);
-
-		return uv;
-	}
-
-	///////////////////////////////////////////////////////////////////////////
-	//
-	// Copyright (c) 2002, Industrial Light & Magic, a division of Lucas
-	// Digital Ltd. LLC
-	// 
-	// All rights reserved.
-	// 
-	// Redistribution and use in source and binary forms, with or without
-	// modification, are permitted provided that the following conditions are
-	// met:
-	// *       Redistributions of source code must retain the above copyright
-	// notice, this list of conditions and the following disclaimer.
-	// *       Redistributions in binary form must reproduce the above
-	// copyright notice, this list of conditions and the following disclaimer
-	// in the documentation and/or other materials provided with the
-	// distribution.
-	// *       Neither the name of Industrial Light & Magic nor the names of
-	// its contributors may be used to endorse or promote products derived
-	// from this software without specific prior written permission. 
-	// 
-	// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
-	// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
-	// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
-	// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
-	// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
-	// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
-	// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
-	// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
-	// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
-	// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
-	// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
-	//
-	///////////////////////////////////////////////////////////////////////////
-	uint16_t ConvertToHalf(uint32_t i)
+	// The texel density the ray cones pick the alpha mask mip with, from the rounded UV deltas the
+	// shader reads, and the normal the shader scales it to world space with. pUVs has one entry per
+	// triangle of indices. The positions are scaled by pScale per axis first, when it's set, to
+	// move them into the space of the structure.
+	void SetUVDensities(void const* pPositions, size_t positionStride, std::vector<uint32_t> const& indices, UV* pUVs, float const* pScale = nullptr)
 	{
-		//
-		// Our floating point number, f, is represented by the bit
-		// pattern in integer i.  Disassemble that bit pattern into
-		// the sign, s, the exponent, e, and the significand, m.
-		// Shift s into the position where it will go in in the
-		// resulting half number.
-		// Adjust e, accounting for the different exponent bias
-		// of float and half (127 versus 15).
-		//
+		float const scale[3] = { pScale ? pScale[0] : 1.0f, pScale ? pScale[1] : 1.0f, pScale ? pScale[2] : 1.0f };
 
-		int s = (i >> 16) & 0x00008000;
-		int e = ((i >> 23) & 0x000000ff) - (127 - 15);
-		int m = i & 0x007fffff;
+		char const* pBytes = reinterpret_cast<char const*>(pPositions);
+		for (size_t prim = 0; prim < indices.size() / 3; ++prim)
+		{
+			float const* p0 = reinterpret_cast<float const*>(pBytes + positionStride * indices[3 * prim + 0]);
+			float const* p1 = reinterpret_cast<float const*>(pBytes + positionStride * indices[3 * prim + 1]);
+			float const* p2 = reinterpret_cast<float const*>(pBytes + positionStride * indices[3 * prim + 2]);
 
-		//
-		// Now reassemble s, e and m into a half:
-		//
+			float const edge1[3] = { (p1[0] - p0[0]) * scale[0], (p1[1] - p0[1]) * scale[1], (p1[2] - p0[2]) * scale[2] };
+			float const edge2[3] = { (p2[0] - p0[0]) * scale[0], (p2[1] - p0[1]) * scale[1], (p2[2] - p0[2]) * scale[2] };
+			float const uv01[2] = { TriangleUVPacker::FromF16(pUVs[prim].uv01[0]), TriangleUVPacker::FromF16(pUVs[prim].uv01[1]) };
+			float const uv02[2] = { TriangleUVPacker::FromF16(pUVs[prim].uv02[0]), TriangleUVPacker::FromF16(pUVs[prim].uv02[1]) };
+			pUVs[prim].uvDensity = AlphaMaskPacker::GetUVDensity(edge1, edge2, uv01, uv02);
 
-		if (e <= 0)
-		{
-			if (e < -10)
+			float const normal[3] =
 			{
-				//
-				// E is less than -10.  The absolute value of f is
-				// less than HALF_MIN (f may be a small normalized
-				// float, a denormalized float or a zero).
-				//
-				// We convert f to a half zero with the same sign as f.
-				//
+				edge1[1] * edge2[2] - edge1[2] * edge2[1],
+				edge1[2] * edge2[0] - edge1[0] * edge2[2],
+				edge1[0] * edge2[1] - edge1[1] * edge2[0],
+			};
+			pUVs[prim].normal = PackNormal(normal);
+		}
+	}
 
-				return s;
-			}
+	// Skinned structures are in world space under an identity transform, so the shader can't scale their
+	// bind pose densities. They're moved to the load pose with the mean area scale of the skinning matrices,
+	// the skinning keeps the areas otherwise.
+	float GetSkinnedAreaScaleLog2(GLTFCommon const* pC, int skinIndex)
+	{
+		auto const it = pC->m_worldSpaceSkeletonMats.find(skinIndex);
+		if (it == pC->m_worldSpaceSkeletonMats.end() || it->second.empty())
+			return 0.0f;
+
+		float sum = 0.0f;
+		for (Matrix2 const& matrix : it->second)
+		{
+			sum += powf(fabsf(math::determinant(matrix.GetCurrent().getUpper3x3())), 2.0f / 3.0f);
+		}
+		return log2f(max(sum / (float)it->second.size(), FLT_MIN));
+	}
+
+	// Mask texture indices with this bit set sample m_maskTextureTable instead of the alpha mask array,
+	// it's k_maskTextureFallback in ShadowRaytrace.hlsl and fits the 24 bits of the instance contribution
+	uint32_t const MaskFallbackBit = 0x800000;
+
+	// Reads the alpha of the top mip of a mask image, only the 8 bit RGBA and BGRA images can be
+	// read back, the block compressed ones are left to the texture test in the shader
+	bool LoadAlphaMask(std::string const& path, OpacityMicromap::AlphaMask& mask)
+	{
+		ImgLoader* pLoader = CreateImageLoader(path.c_str());
+		if (pLoader == nullptr)
+			return false;
+
+		IMG_INFO header = {};
+		bool bLoaded = pLoader->Load(path.c_str(), 1.0f, &header);
+		switch (header.format)
+		{
+		case DXGI_FORMAT_R8G8B8A8_UNORM:
+		case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+		case DXGI_FORMAT_B8G8R8A8_UNORM:
+		case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+			break;
+		default:
+			bLoaded = false;
+			break;
+		}
+
+		if (bLoaded)
+		{
+			std::vector<uint32_t> pixels((size_t)header.width * header.height);
+			pLoader->CopyPixels(pixels.data(), header.width * 4, header.width * 4, header.height);
 
-			//
-			// E is between -10 and 0.  F is a normalized float
-			// whose magnitude is less than HALF_NRM_MIN.
-			//
-			// We convert f to a denormalized half.
-			//
+			mask.width = header.width;
+			mask.height = header.height;
+			mask.alpha.resize(pixels.size());
+			AlphaMaskPacker::ExtractAlpha(pixels.data(), pixels.size(), mask.alpha.data());
+		}
 
-			//
-			// Add an explicit leading 1 to the significand.
-			// 
+		delete pLoader;
+		return bLoaded;
+	}
 
-			m = m | 0x00800000;
+	// Merged geometry is indexed with float3 positions, blended primitives aren't traced and the masked
+	// ones need their float2 UVs. The whole cluster shares the mask texture of its BLAS.
+	bool CanMergePrimitive(json const& materials, json const& accessors, json const& primitive, bool* pbIsOpaque, int* pMaskTextureId)
+	{
+		json const& attributes = primitive.at("attributes");
+		if (primitive.value("indices", -1) < 0 || attributes.find("POSITION") == attributes.end())
+			return false;
 
-			//
-			// Round to m to the nearest (10+e)-bit value (with e between
-			// -10 and 0); in case of a tie, round to the nearest even value.
-			//
-			// Rounding may cause the significand to overflow and make
-			// our number normalized.  Because of the way a half's bits
-			// are laid out, we don't have to treat this case separately;
-			// the code below will handle it correctly.
-			// 
+		json const& positions = accessors.at((int)attributes.at("POSITION"));
+		if (positions.value("type", "") != "VEC3" || positions.value("componentType", 0) != 5126)
+			return false;
 
-			int t = 14 - e;
-			int a = (1 << (t - 1)) - 1;
-			int b = (m >> t) & 1;
+		*pbIsOpaque = true;
+		*pMaskTextureId = -1;
 
-			m = (m + a + b) >> t;
+		auto mat = primitive.find("material");
+		if (mat == primitive.end())
+			return true;
 
-			//
-			// Assemble the half from s, e (zero) and m.
-			//
+		json const& material = materials[(size_t)mat.value()];
+		std::string const alphaMode = GetElementString(material, "alphaMode", "OPAQUE");
+		if (alphaMode == "BLEND")
+			return false;
 
-			return s | m;
-		}
-		else if (e == 0xff - (127 - 15))
+		if (alphaMode == "MASK")
 		{
-			if (m == 0)
-			{
-				//
-				// F is an infinity; convert f to a half
-				// infinity with the same sign as f.
-				//
+			if (attributes.find("TEXCOORD_0") == attributes.end())
+				return false;
 
-				return s | 0x7c00;
-			}
-			else
-			{
-				//
-				// F is a NAN; we produce a half NAN that preserves
-				// the sign bit and the 10 leftmost bits of the
-				// significand of f, with one exception: If the 10
-				// leftmost bits are all zero, the NAN would turn 
-				// into an infinity, so we have to set at least one
-				// bit in the significand.
-				//
+			json const& uvs = accessors.at((int)attributes.at("TEXCOORD_0"));
+			if (uvs.value("type", "") != "VEC2" || uvs.value("componentType", 0) != 5126)
+				return false;
+
+			*pbIsOpaque = false;
+			*pMaskTextureId = GetElementInt(material, "pbrMetallicRoughness/baseColorTexture/index", -1);
+		}
+
+		return true;
+	}
 
-				m >>= 13;
-				return s | 0x7c00 | m | (m == 0);
+	// Runs job(0) .. job(count - 1) on the pool and waits for all of them. The workers pull the next
+	// index from a shared counter, so the jobs of uneven size balance out.
+	template <typename Job>
+	void ParallelFor(AsyncPool* pAsyncPool, size_t count, Job const& job)
+	{
+		if (pAsyncPool == nullptr || count <= 1)
+		{
+			for (size_t i = 0; i < count; ++i)
+			{
+				job(i);
 			}
+			return;
 		}
-		else
+
+		std::atomic<size_t> next(0);
+		auto worker = [&]()
 		{
-			//
-			// E is greater than zero.  F is a normalized float.
-			// We try to convert f to a normalized half.
-			//
+			for (size_t i = next++; i < count; i = next++)
+			{
+				job(i);
+			}
+		};
 
-			//
-			// Round to m to the nearest 10-bit value.  In case of
-			// a tie, round to the nearest even value.
-			//
+		size_t const workerCount = min((size_t)max(std::thread::hardware_concurrency(), 1u), count);
+		for (size_t i = 0; i < workerCount; ++i)
+		{
+			pAsyncPool->AddAsyncTask(worker);
+		}
+		pAsyncPool->Flush();
+	}
 
-			m = m + 0x00000fff + ((m >> 13) & 1);
+	// Ids of the scene cache sections, the index of the primitive job, merged cluster or mask slice
+	// goes in the low 32 bits
+	enum SceneCacheSection : uint64_t
+	{
+		CacheJobUVs = 1ull << 32,
+		CacheJobQuantizationBounds = 2ull << 32,
+		CacheJobQuantizedPositions = 3ull << 32,
+		CacheJobProxyIndices = 4ull << 32,
+		CacheClusterPositions = 5ull << 32,
+		CacheClusterIndices = 6ull << 32,
+		CacheClusterUVs = 7ull << 32,
+		CacheMaskSize = 8ull << 32,
+		CacheMaskReadable = 9ull << 32,
+		CacheMaskSlice = 10ull << 32,
+		CacheMicromaps = 11ull << 32,
+	};
 
-			if (m & 0x00800000)
+	// Hashes everything the cached data is derived from: the glTF and its buffers, the images of the
+	// alpha masks and the settings, and for the merged clusters the world matrices and static nodes
+	uint64_t GetSceneCacheKey(GLTFCommon const* pC, AsyncPool* pAsyncPool, Raytracing::BLASBuildSettings const& settings)
+	{
+		json const& j3 = pC->j3;
+		std::string const gltf = j3.dump();
+
+		// the buffers are hashed in chunks, a scene usually has a single big one
+		size_t const chunkSize = 16 * 1024 * 1024;
+		std::vector<std::pair<char const*, size_t>> blobs;
+		blobs.push_back({ gltf.data(), gltf.size() });
+		if (j3.find("buffers") != j3.end())
+		{
+			json const& buffers = j3["buffers"];
+			for (size_t b = 0; b < buffers.size() && b < pC->m_buffersData.size(); ++b)
 			{
-				m = 0;		// overflow in significand,
-				e += 1;		// adjust exponent
+				size_t const size = buffers[b].value("byteLength", (size_t)0);
+				for (size_t offset = 0; offset < size; offset += chunkSize)
+				{
+					blobs.push_back({ pC->m_buffersData[b] + offset, min(chunkSize, size - offset) });
+				}
 			}
+		}
 
-			//
-			// Handle exponent overflow
-			//
+		std::vector<std::string> maskImages;
+		if (j3.find("materials") != j3.end() && j3.find("textures") != j3.end() && j3.find("images") != j3.end())
+		{
+			for (json const& material : j3["materials"])
+			{
+				int const id = GetElementInt(material, "pbrMetallicRoughness/baseColorTexture/index", -1);
+				if (GetElementString(material, "alphaMode", "OPAQUE") == "MASK" && id >= 0)
+				{
+					int const source = GetElementInt(j3["textures"][id], "source", -1);
+					if (source >= 0)
+					{
+						maskImages.push_back(pC->m_path + GetElementString(j3["images"][source], "uri", ""));
+					}
+				}
+			}
+		}
 
-			if (e > 30)
+		std::vector<uint64_t> hashes(blobs.size() + maskImages.size());
+		ParallelFor(pAsyncPool, hashes.size(), [&](size_t i)
+		{
+			if (i < blobs.size())
 			{
-				return s | 0x7c00;	// if this returns, the half becomes an
-			}   			// infinity with the same sign as f.
+				hashes[i] = SceneCache::Hash(blobs[i].first, blobs[i].second);
+				return;
+			}
 
-			//
-			// Assemble the half from s, e and m.
-			//
+			std::ifstream file(maskImages[i - blobs.size()], std::ios::binary);
+			std::vector<char> const contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+			hashes[i] = SceneCache::Hash(contents.data(), contents.size());
+		});
 
-			return s | (e << 10) | (m >> 13);
-		}
-	}
-	uint16_t ToF16(float const& f)
-	{
-		uint32_t x = *((uint32_t*)&f);
-		uint16_t h = ConvertToHalf(x);
+		float const values[] =
+		{
+			settings.proxyTriangleRatio,
+			settings.proxyMaxError,
+			settings.quantizationMaxError,
+			settings.mergeMaxSize,
+			settings.mergeClusterSize,
+			(float)settings.opacityMicromapMaxLevel,
+			(float)settings.alphaMaskSize,
+		};
+		uint64_t key = SceneCache::Hash(hashes.data(), sizeof(uint64_t) * hashes.size(), SceneCache::Version);
+		key = SceneCache::Hash(values, sizeof(values), key);
 
-		return h;
+		if (settings.pNodeClassification != nullptr)
+		{
+			std::vector<float> matrices;
+			std::vector<uint8_t> dynamicNodes;
+			for (uint32_t n = 0; n < pC->m_nodes.size(); ++n)
+			{
+				math::Matrix4 const mModelToWorld = pC->m_worldSpaceMats[n].GetCurrent();
+				float const* pMatrix = math::toFloatPtr(mModelToWorld);
+				matrices.insert(matrices.end(), pMatrix, pMatrix + 16);
+				dynamicNodes.push_back(settings.pNodeClassification->IsDynamic(n) ? 1 : 0);
+			}
+			key = SceneCache::Hash(matrices.data(), sizeof(float) * matrices.size(), key);
+			key = SceneCache::Hash(dynamicNodes.data(), dynamicNodes.size(), key);
+		}
+		return key;
 	}
-
-	struct UV
-	{
-		math::Point2 uv0;
-		uint16_t uv01[2];
-		uint16_t uv02[2];
-	};
 }
 
 namespace Raytracing
@@ -247,8 +334,11 @@ namespace Raytracing
 		, m_info{}
 		, m_address()
 		, m_bIsBLASOpaque(true)
+		, m_bIsDynamic(false)
+		, m_bIsQuantized(false)
 		, m_uvBufferOffset(~0u)
 		, m_textureIndex(~0u)
+		, m_dequantization(math::Matrix4::identity())
 	{
 	}
 
@@ -256,18 +346,21 @@ namespace Raytracing
 	{
 	}
 
-	void BLAS::Build(ID3D12GraphicsCommandList* pCmdList, ASBuffer& buffer)
+	void BLAS::Build(ID3D12GraphicsCommandList* pCmdList, ASBuffer& buffer, bool bUpdate)
 	{
-		UserMarker marker(pCmdList, "BLAS Build");
+		assert(!bUpdate || m_bIsDynamic);
 
-		D3D12_GPU_VIRTUAL_ADDRESS address = buffer.Suballoc((uint32_t)m_info.ScratchDataSizeInBytes);
+		UserMarker marker(pCmdList, bUpdate ? "BLAS Update" : "BLAS Build");
+
+		UINT64 const scratchSize = bUpdate ? m_info.UpdateScratchDataSizeInBytes : m_info.ScratchDataSizeInBytes;
+		D3D12_GPU_VIRTUAL_ADDRESS address = buffer.Suballoc(scratchSize);
 		if (address == 0)
 		{
 			// buffer is full so lets do a barrier and reset the buffer
 			buffer.Reset();
 
 			pCmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(nullptr));
-			address = buffer.Suballoc((uint32_t)m_info.ScratchDataSizeInBytes);
+			address = buffer.Suballoc(scratchSize);
 			assert(address != 0);
 		}
 
@@ -282,6 +375,12 @@ namespace Raytracing
 		desc.DestAccelerationStructureData = m_address;
 		desc.Inputs = m_inputs;
 		desc.ScratchAccelerationStructureData = address;
+		if (bUpdate)
+		{
+			// refit in place
+			desc.Inputs.Flags |= D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PERFORM_UPDATE;
+			desc.SourceAccelerationStructureData = m_address;
+		}
 
 		assert(desc.DestAccelerationStructureData != 0);
 		assert(desc.ScratchAccelerationStructureData != 0);
@@ -292,7 +391,7 @@ namespace Raytracing
 		pCmdList4->Release();
 	}
 
-	void BLAS::PreBuild(CAULDRON_DX12::Device* pDevice)
+	void BLAS::PreBuild(CAULDRON_DX12::Device* pDevice, bool bAllowCompaction)
 	{
 		auto device = pDevice->GetDevice();
 		ID3D12Device5* pDevice5 = nullptr;
@@ -301,6 +400,14 @@ namespace Raytracing
 		m_inputs = {};
 		m_inputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL;
 		m_inputs.Flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE;
+		if (m_bIsDynamic)
+		{
+			m_inputs.Flags |= D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_UPDATE;
+		}
+		else if (bAllowCompaction)
+		{
+			m_inputs.Flags |= D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_COMPACTION;
+		}
 		m_inputs.NumDescs = static_cast<UINT>(m_geometry.size());
 		m_inputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
 		m_inputs.pGeometryDescs = m_geometry.data();
@@ -310,6 +417,14 @@ namespace Raytracing
 		pDevice5->Release();
 	}
 
+	void BLAS::Compact(ID3D12GraphicsCommandList4* pCmdList4, D3D12_GPU_VIRTUAL_ADDRESS address)
+	{
+		assert(address != 0);
+
+		pCmdList4->CopyRaytracingAccelerationStructure(address, m_address, D3D12_RAYTRACING_ACCELERATION_STRUCTURE_COPY_MODE_COMPACT);
+		m_address = address;
+	}
+
 	size_t BLAS::GetStructureSize(void) const
 	{
 		return m_info.ResultDataMaxSizeInBytes;
@@ -343,12 +458,78 @@ namespace Raytracing
 		m_geometry.push_back(geo);
 	}
 
+	void BLAS::AddGeometry(D3D12_GPU_VIRTUAL_ADDRESS vertexBuffer, uint32_t vertexCount, D3D12_GPU_VIRTUAL_ADDRESS indexBuffer, uint32_t indexCount, bool bIsOpaque)
+	{
+		m_bIsBLASOpaque = m_bIsBLASOpaque && bIsOpaque;
+
+		D3D12_RAYTRACING_GEOMETRY_DESC geo = {};
+		geo.Type = D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES;
+		geo.Flags = (bIsOpaque) ? D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE : D3D12_RAYTRACING_GEOMETRY_FLAG_NONE;
+		geo.Triangles.Transform3x4 = 0; // no local transform
+		geo.Triangles.IndexFormat = DXGI_FORMAT_R32_UINT;
+		geo.Triangles.VertexFormat = DXGI_FORMAT_R32G32B32_FLOAT;
+		geo.Triangles.IndexCount = indexCount;
+		geo.Triangles.VertexCount = vertexCount;
+		geo.Triangles.IndexBuffer = indexBuffer;
+		geo.Triangles.VertexBuffer.StartAddress = vertexBuffer;
+		geo.Triangles.VertexBuffer.StrideInBytes = sizeof(float) * 3;
+		m_geometry.push_back(geo);
+	}
+
+	void BLAS::SetIndexBuffer(D3D12_GPU_VIRTUAL_ADDRESS address, DXGI_FORMAT format, uint32_t indexCount)
+	{
+		for (D3D12_RAYTRACING_GEOMETRY_DESC& geo : m_geometry)
+		{
+			geo.Triangles.IndexBuffer = address;
+			geo.Triangles.IndexFormat = format;
+			geo.Triangles.IndexCount = indexCount;
+		}
+	}
+
 	void BLAS::SetMaskParams(uint32_t uvBufferOffset, uint32_t textureIndex)
 	{
 		m_uvBufferOffset = uvBufferOffset;
 		m_textureIndex = textureIndex;
 	}
 
+	void BLAS::SetDynamicVertexBuffer(D3D12_GPU_VIRTUAL_ADDRESS address, uint32_t stride)
+	{
+		for (D3D12_RAYTRACING_GEOMETRY_DESC& geo : m_geometry)
+		{
+			geo.Triangles.VertexBuffer.StartAddress = address;
+			geo.Triangles.VertexBuffer.StrideInBytes = stride;
+			geo.Triangles.VertexFormat = DXGI_FORMAT_R32G32B32_FLOAT;
+		}
+		m_bIsDynamic = true;
+	}
+
+	void BLAS::SetQuantizedVertexBuffer(D3D12_GPU_VIRTUAL_ADDRESS address, math::Matrix4 const& dequantization)
+	{
+		for (D3D12_RAYTRACING_GEOMETRY_DESC& geo : m_geometry)
+		{
+			geo.Triangles.VertexBuffer.StartAddress = address;
+			geo.Triangles.VertexBuffer.StrideInBytes = sizeof(int16_t) * 4;
+			geo.Triangles.VertexFormat = DXGI_FORMAT_R16G16B16A16_SNORM;
+		}
+		m_bIsQuantized = true;
+		m_dequantization = dequantization;
+	}
+
+	bool BLAS::IsQuantized(void) const
+	{
+		return m_bIsQuantized;
+	}
+
+	math::Matrix4 const& BLAS::GetDequantization(void) const
+	{
+		return m_dequantization;
+	}
+
+	bool BLAS::IsDynamic(void) const
+	{
+		return m_bIsDynamic;
+	}
+
 	bool BLAS::IsOpaque(void) const
 	{
 		return m_bIsBLASOpaque;
@@ -366,9 +547,15 @@ namespace Raytracing
 
 	TLAS::TLAS(void)
 		: m_instances()
+		, m_builtInstances()
 		, m_inputs{}
 		, m_info{}
+		, m_instanceBuffers()
+		, m_numFramesInFlight(0)
 		, m_address()
+		, m_allocatedSize(0)
+		, m_buildMode(BuildMode::Full)
+		, m_bBuilt(false)
 	{
 	}
 
@@ -376,33 +563,129 @@ namespace Raytracing
 	{
 	}
 
-	void TLAS::Build(ID3D12GraphicsCommandList* pCmdList, ASBuffer& buffer, DynamicBufferRing& bufferRing)
+	void TLAS::OnCreate(uint32_t numFramesInFlight)
+	{
+		m_numFramesInFlight = numFramesInFlight;
+		m_instanceBuffers.resize(numFramesInFlight, InstanceBuffer());
+	}
+
+	void TLAS::OnDestroy()
+	{
+		for (InstanceBuffer& instanceBuffer : m_instanceBuffers)
+		{
+			if (instanceBuffer.pBuffer)
+			{
+				instanceBuffer.pBuffer->Unmap(0, nullptr);
+				instanceBuffer.pBuffer->Release();
+			}
+			instanceBuffer.pBuffer = nullptr;
+			instanceBuffer.pMapped = nullptr;
+			instanceBuffer.capacity = 0;
+			instanceBuffer.lastFrame = 0;
+			instanceBuffer.contents.clear();
+		}
+	}
+
+	D3D12_GPU_VIRTUAL_ADDRESS TLAS::UploadInstances(ID3D12GraphicsCommandList* pCmdList, uint32_t frame)
+	{
+		assert(m_numFramesInFlight != 0 && "TLAS::OnCreate wasn't called");
+
+		// The buffer of this frame was last read numFramesInFlight frames ago or earlier, the renderer waited
+		// for that frame before recording this one. Building twice in a frame would overwrite the instances
+		// the first build reads.
+		InstanceBuffer& instanceBuffer = m_instanceBuffers[frame % m_numFramesInFlight];
+		assert((instanceBuffer.lastFrame == 0 || instanceBuffer.lastFrame + m_numFramesInFlight <= frame + 1) && "a TLAS can only be built once per frame");
+		instanceBuffer.lastFrame = frame + 1;
+
+		uint32_t const numInstances = static_cast<uint32_t>(m_instances.size());
+		if (instanceBuffer.pBuffer == nullptr || numInstances > instanceBuffer.capacity)
+		{
+			// no build in flight reads this buffer, so it can go now
+			if (instanceBuffer.pBuffer)
+			{
+				instanceBuffer.pBuffer->Unmap(0, nullptr);
+				instanceBuffer.pBuffer->Release();
+			}
+
+			instanceBuffer.capacity = max(numInstances + numInstances / 2, 1u);
+
+			ID3D12Device* pDevice = nullptr;
+			pCmdList->GetDevice(IID_PPV_ARGS(&pDevice));
+			ThrowIfFailed(
+				pDevice->CreateCommittedResource(
+					&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+					D3D12_HEAP_FLAG_NONE,
+					&CD3DX12_RESOURCE_DESC::Buffer(sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * instanceBuffer.capacity),
+					D3D12_RESOURCE_STATE_GENERIC_READ,
+					nullptr,
+					IID_PPV_ARGS(&instanceBuffer.pBuffer))
+			);
+			SetName(instanceBuffer.pBuffer, "TLAS::InstanceBuffer");
+			pDevice->Release();
+
+			D3D12_RANGE readRange = { 0, 0 };
+			ThrowIfFailed(instanceBuffer.pBuffer->Map(0, &readRange, (void**)&instanceBuffer.pMapped));
+
+			// nothing valid in the new buffer yet
+			instanceBuffer.contents.clear();
+		}
+
+		// only write what changed since this buffer was last used, the mapped memory is write combined so the
+		// comparison is done against the CPU copy
+		size_t const numValid = min(instanceBuffer.contents.size(), m_instances.size());
+		for (size_t i = 0; i < numValid; ++i)
+		{
+			if (memcmp(&instanceBuffer.contents[i], &m_instances[i], sizeof(D3D12_RAYTRACING_INSTANCE_DESC)) != 0)
+			{
+				instanceBuffer.pMapped[i] = m_instances[i];
+			}
+		}
+		if (m_instances.size() > numValid)
+		{
+			memcpy(instanceBuffer.pMapped + numValid, m_instances.data() + numValid, sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * (m_instances.size() - numValid));
+		}
+		instanceBuffer.contents.assign(m_instances.cbegin(), m_instances.cend());
+
+		return instanceBuffer.pBuffer->GetGPUVirtualAddress();
+	}
+
+	void TLAS::Build(ID3D12GraphicsCommandList* pCmdList, ASBuffer& buffer, uint32_t frame)
 	{
-		UserMarker marker(pCmdList, "TLAS Build");
+		if (m_buildMode == BuildMode::None)
+			return;
 
-		D3D12_GPU_VIRTUAL_ADDRESS address = buffer.Suballoc((uint32_t)m_info.ScratchDataSizeInBytes);
+		bool const bUpdate = m_buildMode == BuildMode::Update;
+
+		UserMarker marker(pCmdList, bUpdate ? "TLAS Update" : "TLAS Build");
+
+		UINT64 const scratchSize = bUpdate ? m_info.UpdateScratchDataSizeInBytes : m_info.ScratchDataSizeInBytes;
+		D3D12_GPU_VIRTUAL_ADDRESS address = buffer.Suballoc(scratchSize);
 		if (address == 0)
 		{
 			// buffer is full so lets do a barrier and reset the buffer
 			buffer.Reset();
 
 			pCmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(buffer.GetResource()));
-			address = buffer.Suballoc((uint32_t)m_info.ScratchDataSizeInBytes);
+			address = buffer.Suballoc(scratchSize);
 			assert(address != 0);
 		}
 
 		ID3D12GraphicsCommandList4* pCmdList4 = nullptr;
 		pCmdList->QueryInterface(&pCmdList4);
 
-		D3D12_GPU_VIRTUAL_ADDRESS instanceAddress = bufferRing.AllocConstantBuffer((uint32_t)sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * (uint32_t)m_instances.size(), m_instances.data());
-		assert(instanceAddress != 0);
-		m_inputs.InstanceDescs = instanceAddress;
+		m_inputs.InstanceDescs = UploadInstances(pCmdList, frame);
 
 		D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC desc = {};
 
 		desc.DestAccelerationStructureData = m_address;
 		desc.Inputs = m_inputs;
 		desc.ScratchAccelerationStructureData = address;
+		if (bUpdate)
+		{
+			// refit in place
+			desc.Inputs.Flags |= D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PERFORM_UPDATE;
+			desc.SourceAccelerationStructureData = m_address;
+		}
 
 		assert(desc.DestAccelerationStructureData != 0);
 		assert(desc.ScratchAccelerationStructureData != 0);
@@ -411,6 +694,10 @@ namespace Raytracing
 			0, nullptr);
 
 		pCmdList4->Release();
+
+		// keeps the capacity, so the steady state doesn't allocate
+		m_builtInstances.assign(m_instances.cbegin(), m_instances.cend());
+		m_bBuilt = true;
 	}
 
 	void TLAS::PreBuild(CAULDRON_DX12::Device* pDevice)
@@ -421,7 +708,7 @@ namespace Raytracing
 
 		m_inputs = {};
 		m_inputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL;
-		m_inputs.Flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_NONE;
+		m_inputs.Flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_UPDATE;
 		m_inputs.NumDescs = static_cast<UINT>(m_instances.size());
 		m_inputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
 		m_inputs.InstanceDescs = 0; // should not need this for prebuild info since the cpu is able to touch it
@@ -436,20 +723,27 @@ namespace Raytracing
 		return m_info.ResultDataMaxSizeInBytes;
 	}
 
+	size_t TLAS::GetAllocatedSize(void) const
+	{
+		return m_allocatedSize;
+	}
+
 	D3D12_GPU_VIRTUAL_ADDRESS TLAS::GetGpuAddress(void) const
 	{
 		return m_address;
 	}
 
-	void TLAS::AssignBuffer(D3D12_GPU_VIRTUAL_ADDRESS address)
+	void TLAS::AssignBuffer(D3D12_GPU_VIRTUAL_ADDRESS address, size_t size)
 	{
 		m_address = address;
+		m_allocatedSize = size;
 	}
 
 	void TLAS::AddInstance(BLAS const& blas, math::Matrix4 const& matrix)
 	{
 		D3D12_RAYTRACING_INSTANCE_DESC desc = {};
-		memcpy(desc.Transform, math::toFloatPtr(math::transpose(matrix)), sizeof(desc.Transform));
+		math::Matrix4 const transform = blas.IsQuantized() ? matrix * blas.GetDequantization() : matrix;
+		memcpy(desc.Transform, math::toFloatPtr(math::transpose(transform)), sizeof(desc.Transform));
 		desc.InstanceID = blas.UVBufferOffset(); // using the id as the offset into the UV buffer
 		desc.InstanceMask = 0xFF;
 		desc.InstanceContributionToHitGroupIndex = blas.TextureIndex(); // using this for the texture index. This will only work with inline raytracing
@@ -459,11 +753,91 @@ namespace Raytracing
 		m_instances.emplace_back(std::move(desc));
 	}
 
+	void TLAS::Reset(void)
+	{
+		// keeps the capacity of the instance list, so gathering the same scene again doesn't allocate
+		m_instances.clear();
+	}
+
+	void TLAS::SelectBuildMode(bool bBLASChanged)
+	{
+		if (!m_bBuilt || m_instances.size() != m_builtInstances.size())
+		{
+			m_buildMode = BuildMode::Full;
+			return;
+		}
+
+		// the instances come from the node world matrices, so comparing the transforms is
+		// comparing the world matrices against the ones of the last build
+		m_buildMode = BuildMode::None;
+		for (size_t i = 0; i < m_instances.size(); ++i)
+		{
+			D3D12_RAYTRACING_INSTANCE_DESC const& instance = m_instances[i];
+			D3D12_RAYTRACING_INSTANCE_DESC const& built = m_builtInstances[i];
+
+			if (instance.AccelerationStructure != built.AccelerationStructure
+				|| instance.InstanceID != built.InstanceID
+				|| instance.InstanceContributionToHitGroupIndex != built.InstanceContributionToHitGroupIndex
+				|| instance.InstanceMask != built.InstanceMask
+				|| instance.Flags != built.Flags)
+			{
+				m_buildMode = BuildMode::Full;
+				return;
+			}
+
+			if (memcmp(instance.Transform, built.Transform, sizeof(instance.Transform)) != 0)
+			{
+				m_buildMode = BuildMode::Update;
+			}
+		}
+
+		if (m_buildMode == BuildMode::None && bBLASChanged)
+		{
+			m_buildMode = BuildMode::Update;
+		}
+	}
+
+	void TLAS::ForceFullBuild(void)
+	{
+		// the memory moved, so whatever was built before is gone
+		m_buildMode = BuildMode::Full;
+		m_bBuilt = false;
+	}
+
+	TLAS::BuildMode TLAS::GetBuildMode(void) const
+	{
+		return m_buildMode;
+	}
+
+	void TLAS::Invalidate(void)
+	{
+		m_instances.clear();
+		m_builtInstances.clear();
+		m_address = 0;
+		m_allocatedSize = 0;
+		m_buildMode = BuildMode::Full;
+		m_bBuilt = false;
+	}
+
 	ASFactory::ASFactory(void)
 		: m_buffers()
+		, m_retiredBuffers()
+		, m_pCompactedSizes(nullptr)
+		, m_pCompactedSizesReadback(nullptr)
+		, m_dynamicBuffers()
+		, m_compactedStructures()
+		, m_bAllowCompaction(false)
+		, m_bCompactionPending(false)
 		, m_structures()
-		, m_meshes()
+		, m_nodeStructs()
+		, m_mergedStructs()
+		, m_mergedNodes()
 		, m_tlasBuffer()
+		, m_skinnedGeometry()
+		, m_skinnedVertexCount(0)
+		, m_refitsSinceRebuild(0)
+		, m_bSkinnedBLASUpdated(false)
+		, m_bSkinnedBLASBuilt(false)
 	{
 	}
 
@@ -474,32 +848,206 @@ namespace Raytracing
 	void ASFactory::OnCreate(CAULDRON_DX12::Device* pDevice)
 	{
 		m_tlasBuffer.OnCreate(pDevice, 256 * 1024 * 1024, false, "TLAS");
+		m_skinning.OnCreate(pDevice);
 	}
 
 	void ASFactory::OnDestroy()
 	{
+		m_skinning.OnDestroy();
 		m_tlasBuffer.OnDestroy();
 		ClearBuiltStructures();
 	}
 
-	void ASFactory::BuildFromGltf(CAULDRON_DX12::Device* pDevice, GLTFTexturesAndBuffers* pGLTFTexturesAndBuffers, ResourceViewHeaps* pResourceViewHeaps, UploadHeap* pUpload)
+	void ASFactory::BuildFromGltf(CAULDRON_DX12::Device* pDevice, GLTFTexturesAndBuffers* pGLTFTexturesAndBuffers, ResourceViewHeaps* pResourceViewHeaps, UploadHeap* pUpload, AsyncPool* pAsyncPool, BLASBuildSettings const& settings)
 	{
-		const json& j3 = pGLTFTexturesAndBuffers->m_pGLTFCommon->j3;
+		m_bAllowCompaction = settings.bAllowCompaction;
+		bool const bUseProxies = settings.proxyTriangleRatio < 1.0f;
+
+		GLTFCommon* pC = pGLTFTexturesAndBuffers->m_pGLTFCommon;
+		const json& j3 = pC->j3;
+
+		// A cache that matches the scene and settings replaces the per primitive work, the ones of the
+		// glTF walk are cheap and create the geometry, so they always run. Without one the results are
+		// collected and written once everything is prepared.
+		SceneCache cache;
+		uint64_t cacheKey = 0;
+		if (settings.pCachePath)
+		{
+			cacheKey = GetSceneCacheKey(pC, pAsyncPool, settings);
+			if (cache.Open(settings.pCachePath, cacheKey))
+			{
+				Trace(format("Scene cache: using %s\n", settings.pCachePath));
+			}
+		}
+		bool const bCached = cache.IsOpen();
+		bool const bFillCache = settings.pCachePath && !bCached;
 
 		std::vector<UV> postProcessedUVs;
 
+		struct Proxy
+		{
+			size_t structureIndex;
+			uint32_t firstIndex;
+			uint32_t indexCount;
+		};
+		std::vector<uint32_t> proxyIndices;
+		std::vector<Proxy> proxies;
+
+		struct QuantizedStructure
+		{
+			size_t structureIndex;
+			size_t firstVertex;
+		};
+		std::vector<int16_t> quantizedPositions;
+		std::vector<QuantizedStructure> quantizedStructures;
+		uint64_t quantizedSourceSize = 0;
+		uint64_t renderTriangles = 0;
+		uint64_t proxyTriangles = 0;
+		uint64_t renderBLASSize = 0;
+		uint64_t proxyBLASSize = 0;
+
+		struct MergedPrimitive
+		{
+			uint32_t node;
+			uint32_t mesh;
+			uint32_t primitive;
+		};
+		// cell of the grid, then whether it's opaque and the mask texture since a BLAS has one of each
+		typedef std::tuple<int32_t, int32_t, int32_t, bool, int> ClusterKey;
+		std::map<ClusterKey, std::vector<MergedPrimitive>> clusters;
+
+		size_t const NoStructure = ~(size_t)0;
+
+		// the glTF texture of each mask texture and the UV ranges of the masked structures,
+		// the opacity micromaps are baked from them once all the UVs are known
+		std::vector<int> maskTextureIds;
+		struct MaskedRange
+		{
+			uint32_t uvOffset;
+			uint32_t triangleCount;
+			uint32_t textureIndex;
+		};
+		std::vector<MaskedRange> maskedRanges;
+		auto getMaskTextureIndex = [&](int id)
+		{
+			uint32_t const index = GetMaskTextureIndex(pGLTFTexturesAndBuffers->GetTextureViewByID(id));
+			if (index == maskTextureIds.size())
+			{
+				maskTextureIds.push_back(id);
+			}
+			return index;
+		};
+
 		//
 		if (j3.find("meshes") != j3.end())
 		{
 			const json& materials = j3["materials"];
 			const json& meshes = j3["meshes"];
-			m_meshes.resize(meshes.size());
+			const json& accessors = *pC->m_pAccessors;
+			std::vector<tfNode> const& nodes = pC->m_nodes;
+
+			// Small static primitives are pre-transformed and merged per cluster, a primitive only gets a
+			// BLAS of its own when a node still instances it
+			std::vector<std::vector<uint8_t>> merged(nodes.size());
+			std::vector<std::vector<uint8_t>> instanced(meshes.size());
+			for (uint32_t i = 0; i < meshes.size(); i++)
+			{
+				instanced[i].assign(meshes[i]["primitives"].size(), 0);
+			}
+
+			bool const bMergeStatic = settings.mergeMaxSize > 0.0f && settings.mergeClusterSize > 0.0f && settings.pNodeClassification != nullptr;
+			for (uint32_t n = 0; n < nodes.size(); n++)
+			{
+				int const meshIndex = nodes[n].meshIndex;
+				if (meshIndex < 0)
+					continue;
+
+				const json& primitives = meshes[meshIndex]["primitives"];
+				merged[n].assign(primitives.size(), 0);
+
+				bool const bStatic = bMergeStatic && !settings.pNodeClassification->IsDynamic(n) && pC->FindMeshSkinId(meshIndex) == -1;
+				math::Matrix4 const mModelToWorld = pC->m_worldSpaceMats[n].GetCurrent();
+				for (uint32_t p = 0; p < primitives.size(); p++)
+				{
+					bool bIsOpaque = true;
+					int maskTextureId = -1;
+					if (bStatic && CanMergePrimitive(materials, accessors, primitives[p], &bIsOpaque, &maskTextureId))
+					{
+						tfPrimitives const& bounds = pC->m_meshes[meshIndex].m_pPrimitives[p];
+						math::Vector4 vBoxMin, vBoxMax;
+						ShadowCasterCulling::TransformBox(mModelToWorld, bounds.m_center, bounds.m_radius, &vBoxMin, &vBoxMax);
+
+						math::Vector4 const vSize = vBoxMax - vBoxMin;
+						if (max(max(vSize.getX(), vSize.getY()), vSize.getZ()) <= settings.mergeMaxSize)
+						{
+							math::Vector4 const vCell = (vBoxMin + vBoxMax) * (0.5f / settings.mergeClusterSize);
+							ClusterKey const key((int32_t)floorf(vCell.getX()), (int32_t)floorf(vCell.getY()), (int32_t)floorf(vCell.getZ()), bIsOpaque, maskTextureId);
+							clusters[key].push_back({ n, (uint32_t)meshIndex, p });
+							continue;
+						}
+					}
+
+					instanced[meshIndex][p] = 1;
+				}
+			}
+
+			// a lone primitive gains nothing from being merged
+			for (auto cluster = clusters.begin(); cluster != clusters.end(); )
+			{
+				if (cluster->second.size() > 1)
+				{
+					for (MergedPrimitive const& source : cluster->second)
+					{
+						merged[source.node][source.primitive] = 1;
+					}
+					++cluster;
+				}
+				else
+				{
+					MergedPrimitive const& source = cluster->second.front();
+					instanced[source.mesh][source.primitive] = 1;
+					cluster = clusters.erase(cluster);
+				}
+			}
+
+			// The structures are prepared in three passes. The glTF is walked and the geometry is created on
+			// this thread, the buffer caches of GLTFTexturesAndBuffers aren't thread safe. The per primitive
+			// work, repacking the UVs, simplifying the proxies and the prebuild queries, runs on the pool.
+			// Then the results are gathered in primitive order, so they don't depend on the scheduling.
+			struct PrimitiveJob
+			{
+				uint32_t mesh;
+				uint32_t primitive;
+				Geometry geometry;
+				DXGI_FORMAT vertexFormat;
+				tfAccessor indexBufferAcc;
+				tfAccessor positionAcc;
+				tfAccessor uvAcc;
+				bool bHasIndices;
+				bool bIsOpaque;
+				uint32_t textureIndex;
+				uint32_t jointStride;
+				int skinIndex;
+
+				BLAS blas;
+				std::vector<UV> uvs;
+				std::vector<int16_t> quantizedPositions;
+				std::vector<uint32_t> proxyIndices;
+				size_t renderIndexCount;
+				size_t renderBLASSize;
+			};
+			std::vector<PrimitiveJob> jobs;
+
+			std::vector<std::vector<size_t>> meshStructs(meshes.size());
 			for (uint32_t i = 0; i < meshes.size(); i++)
 			{
 				const json& primitives = meshes[i]["primitives"];
-				m_meshes[i].structs.resize(primitives.size());
+				meshStructs[i].assign(primitives.size(), NoStructure);
 				for (uint32_t p = 0; p < primitives.size(); p++)
 				{
+					if (!instanced[i][p])
+						continue;
+
 					const json& primitive = primitives[p];
 
 					int indexBufferId = primitive.value("indices", -1);
@@ -508,53 +1056,56 @@ namespace Raytracing
 					std::vector<int> requiredAttributes;
 					requiredAttributes.push_back(attr);
 
-					Geometry geometry = { };
-					pGLTFTexturesAndBuffers->CreateGeometry(indexBufferId, requiredAttributes, &geometry);
-
-					uint32_t uvOffset = ~0;
-					uint32_t textureIndex = ~0;
-					bool bIsOpaque = true;
-					auto mat = primitive.find("material");
-					if (mat != primitive.end())
+					// skinned primitives also need the joints and weights for skinning the positions every frame
+					int const skinIndex = pGLTFTexturesAndBuffers->m_pGLTFCommon->FindMeshSkinId(i);
+					uint32_t jointStride = 0;
+					if (skinIndex != -1 && attributes.find("JOINTS_0") != attributes.end() && attributes.find("WEIGHTS_0") != attributes.end())
 					{
-						auto material = materials[(size_t)mat.value()];
-						bIsOpaque = GetElementString(material, "alphaMode", "OPAQUE") != "MASK";
-						// todo: filter out blends
-						// todo: pass alpha cut out value
+						int const jointsAttr = attributes.find("JOINTS_0").value();
+						int const weightsAttr = attributes.find("WEIGHTS_0").value();
 
-						if (GetElementString(material, "alphaMode", "OPAQUE") == "BLEND")
-							continue;
+						tfAccessor jointsAcc;
+						pGLTFTexturesAndBuffers->m_pGLTFCommon->GetBufferDetails(jointsAttr, &jointsAcc);
+						tfAccessor weightsAcc;
+						pGLTFTexturesAndBuffers->m_pGLTFCommon->GetBufferDetails(weightsAttr, &weightsAcc);
 
-						if (bIsOpaque == false)
+						// the skinning shader handles 8 and 16 bit joints with float weights, anything else keeps the bind pose
+						if ((jointsAcc.m_stride == 4 || jointsAcc.m_stride == 8) && weightsAcc.m_stride == 16)
 						{
-							int const texAttr = attributes.find("TEXCOORD_0").value();
+							jointStride = jointsAcc.m_stride;
+							requiredAttributes.push_back(jointsAttr);
+							requiredAttributes.push_back(weightsAttr);
+						}
+						else
+						{
+							Trace(format("Mesh %u: unsupported joint or weight format, the raytraced shadows use the bind pose\n", i));
+						}
+					}
 
-							tfAccessor vertexBufferAcc;
-							pGLTFTexturesAndBuffers->m_pGLTFCommon->GetBufferDetails(texAttr, &vertexBufferAcc);
+					PrimitiveJob job = {};
+					job.mesh = i;
+					job.primitive = p;
+					job.bHasIndices = indexBufferId >= 0;
+					job.bIsOpaque = true;
+					job.textureIndex = ~0u;
+					job.jointStride = jointStride;
+					job.skinIndex = skinIndex;
 
-							tfAccessor indexBufferAcc;
-							pGLTFTexturesAndBuffers->m_pGLTFCommon->GetBufferDetails(indexBufferId, &indexBufferAcc);
+					auto mat = primitive.find("material");
+					if (mat != primitive.end())
+					{
+						auto material = materials[(size_t)mat.value()];
+						job.bIsOpaque = GetElementString(material, "alphaMode", "OPAQUE") != "MASK";
+						// todo: filter out blends
+						// todo: pass alpha cut out value
 
-							uvOffset = (uint32_t)postProcessedUVs.size();
-							for (uint32_t prim = 0; prim < (uint32_t)indexBufferAcc.m_count / 3; ++prim)
-							{
-								uint32_t i0 = GetIndex(indexBufferAcc, prim * 3 + 0);
-								uint32_t i1 = GetIndex(indexBufferAcc, prim * 3 + 1);
-								uint32_t i2 = GetIndex(indexBufferAcc, prim * 3 + 2);
-
-								math::Point2 uv0 = GetUV(vertexBufferAcc, i0);
-								math::Point2 uv1 = GetUV(vertexBufferAcc, i1);
-								math::Point2 uv2 = GetUV(vertexBufferAcc, i2);
-
-								UV out;
-								out.uv0 = uv0;
-								out.uv01[0] = ToF16((uv1 - uv0).getX());
-								out.uv01[1] = ToF16((uv1 - uv0).getY());
-								out.uv02[0] = ToF16((uv2 - uv0).getX());
-								out.uv02[1] = ToF16((uv2 - uv0).getY());
-
-								postProcessedUVs.emplace_back(std::move(out));
-							}
+						if (GetElementString(material, "alphaMode", "OPAQUE") == "BLEND")
+							continue;
+
+						if (job.bIsOpaque == false)
+						{
+							int const texAttr = attributes.find("TEXCOORD_0").value();
+							pGLTFTexturesAndBuffers->m_pGLTFCommon->GetBufferDetails(texAttr, &job.uvAcc);
 
 							auto pbrMetallicRoughnessIt = material.find("pbrMetallicRoughness");
 							if (pbrMetallicRoughnessIt != material.end())
@@ -564,117 +1115,1119 @@ namespace Raytracing
 								int id = GetElementInt(pbrMetallicRoughness, "baseColorTexture/index", -1);
 								if (id >= 0)
 								{
-									Texture* pTexture = pGLTFTexturesAndBuffers->GetTextureViewByID(id);
-
-									auto find = std::find(m_alphaTextures.cbegin(), m_alphaTextures.cend(), pTexture);
-									if (find == m_alphaTextures.cend())
-									{
-										textureIndex =(uint32_t) m_alphaTextures.size();
-										m_alphaTextures.push_back(pTexture);
-									}
-									else
-									{
-										textureIndex = (uint32_t) (find - m_alphaTextures.cbegin());
-									}
+									job.textureIndex = getMaskTextureIndex(id);
 								}
 							}
 						}
 					}
+
+					pGLTFTexturesAndBuffers->CreateGeometry(indexBufferId, requiredAttributes, &job.geometry);
+
 					const json& inAccessor = pGLTFTexturesAndBuffers->m_pGLTFCommon->m_pAccessors->at(attr);
+					job.vertexFormat = CAULDRON_DX12::GetFormat(inAccessor["type"], inAccessor["componentType"]);
 
+					if (job.bHasIndices)
+					{
+						pGLTFTexturesAndBuffers->m_pGLTFCommon->GetBufferDetails(indexBufferId, &job.indexBufferAcc);
+					}
+					pGLTFTexturesAndBuffers->m_pGLTFCommon->GetBufferDetails(attr, &job.positionAcc);
 
-					bool bUsingSkinning = pGLTFTexturesAndBuffers->m_pGLTFCommon->FindMeshSkinId(i) != -1;
+					jobs.push_back(std::move(job));
+				}
+			}
 
-					
-					BLAS blas;
-					blas.SetMaskParams(uvOffset, textureIndex);
-					blas.AddGeometry(geometry, CAULDRON_DX12::GetFormat(inAccessor["type"], inAccessor["componentType"]), bIsOpaque);
+			ParallelFor(pAsyncPool, jobs.size(), [&](size_t j)
+			{
+				PrimitiveJob& job = jobs[j];
+
+				job.blas.AddGeometry(job.geometry, job.vertexFormat, job.bIsOpaque);
+				if (job.jointStride != 0)
+				{
+					// the address is patched in once the skinned positions buffer exists
+					job.blas.SetDynamicVertexBuffer(0, sizeof(float) * 3);
+				}
+				else if (bCached)
+				{
+					size_t boundsSize = 0;
+					void const* pBounds = cache.Find(CacheJobQuantizationBounds | j, &boundsSize);
+					if (pBounds && boundsSize == sizeof(PositionQuantizer::Bounds))
+					{
+						cache.Read(CacheJobQuantizedPositions | j, job.quantizedPositions);
+						job.blas.SetQuantizedVertexBuffer(0, GetDequantization(*reinterpret_cast<PositionQuantizer::Bounds const*>(pBounds)));
+					}
+				}
+				else if (settings.quantizationMaxError > 0.0f && job.vertexFormat == DXGI_FORMAT_R32G32B32_FLOAT)
+				{
+					float const* pPositions = reinterpret_cast<float const*>(job.positionAcc.m_data);
+					uint32_t const stride = (uint32_t)job.positionAcc.m_stride;
+					uint32_t const vertexCount = (uint32_t)job.positionAcc.m_count;
+					PositionQuantizer::Bounds const bounds = PositionQuantizer::GetBounds(pPositions, stride, vertexCount);
+					if (PositionQuantizer::GetMaxError(bounds) <= settings.quantizationMaxError)
+					{
+						job.quantizedPositions.resize((size_t)vertexCount * 4);
+						PositionQuantizer::Quantize(pPositions, stride, vertexCount, bounds, job.quantizedPositions.data());
+
+						// the address is patched in once the quantized positions buffer exists
+						job.blas.SetQuantizedVertexBuffer(0, GetDequantization(bounds));
+
+						if (bFillCache)
+						{
+							cache.Add(CacheJobQuantizationBounds | j, &bounds, sizeof(bounds));
+							cache.Add(CacheJobQuantizedPositions | j, job.quantizedPositions);
+						}
+					}
+				}
+
+				if (!job.bIsOpaque && bCached)
+				{
+					cache.Read(CacheJobUVs | j, job.uvs);
+				}
+				else if (!job.bIsOpaque)
+				{
+					TriangleUVPacker::AppendTriangleUVs(job.uvAcc, job.indexBufferAcc, job.uvs);
+
+					std::vector<uint32_t> indices;
+					TriangleUVPacker::ReadIndices(job.indexBufferAcc, indices);
+
+					// The shader scales the densities to world space with the transform of the instance, which
+					// includes the dequantization, so they're in the space of the quantized positions.
+					if (job.blas.IsQuantized())
+					{
+						math::Matrix4 const dequantization = job.blas.GetDequantization();
+						float const scale[3] =
+						{
+							1.0f / dequantization.getCol0().getX(),
+							1.0f / dequantization.getCol1().getY(),
+							1.0f / dequantization.getCol2().getZ(),
+						};
+						SetUVDensities(job.positionAcc.m_data, job.positionAcc.m_stride, indices, job.uvs.data(), scale);
+					}
+					else
+					{
+						SetUVDensities(job.positionAcc.m_data, job.positionAcc.m_stride, indices, job.uvs.data());
+					}
+
+					if (job.jointStride != 0)
+					{
+						float const bias = -0.5f * GetSkinnedAreaScaleLog2(pC, job.skinIndex);
+						for (UV& uv : job.uvs)
+						{
+							uv.uvDensity += bias;
+						}
+					}
+
+					if (bFillCache)
+					{
+						cache.Add(CacheJobUVs | j, job.uvs);
+					}
+				}
+				job.blas.PreBuild(pDevice, settings.bAllowCompaction);
+				job.renderBLASSize = job.blas.GetStructureSize();
+
+				// alpha masked primitives keep their geometry, the UV buffer is indexed by their triangles
+				if (bUseProxies && job.bIsOpaque && job.bHasIndices && bCached)
+				{
+					job.renderIndexCount = job.indexBufferAcc.m_count;
+					cache.Read(CacheJobProxyIndices | j, job.proxyIndices);
+					if (!job.proxyIndices.empty())
+					{
+						job.blas.SetIndexBuffer(0, DXGI_FORMAT_R32_UINT, (uint32_t)job.proxyIndices.size());
+						job.blas.PreBuild(pDevice, settings.bAllowCompaction);
+					}
+				}
+				else if (bUseProxies && job.bIsOpaque && job.bHasIndices)
+				{
+					std::vector<uint32_t> renderIndices;
+					TriangleUVPacker::ReadIndices(job.indexBufferAcc, renderIndices);
+					job.renderIndexCount = renderIndices.size();
 
-					blas.PreBuild(pDevice);
+					std::vector<uint32_t> simplifiedIndices;
+					uint32_t const targetIndexCount = max(3u, (uint32_t)(renderIndices.size() * settings.proxyTriangleRatio) / 3 * 3);
+					MeshSimplifier::Simplify(reinterpret_cast<float const*>(job.positionAcc.m_data), (uint32_t)job.positionAcc.m_stride, (uint32_t)job.positionAcc.m_count,
+						renderIndices.data(), (uint32_t)renderIndices.size(), targetIndexCount, settings.proxyMaxError, simplifiedIndices);
 
-					size_t size = blas.GetStructureSize();
-					D3D12_GPU_VIRTUAL_ADDRESS address = 0;
-					for (auto&& buffer : m_buffers)
+					if (!simplifiedIndices.empty() && simplifiedIndices.size() < renderIndices.size())
 					{
-						address = buffer->Suballoc((uint32_t)size);
-						if (address != 0)
+						// the address is patched in once the proxy index buffer exists
+						job.blas.SetIndexBuffer(0, DXGI_FORMAT_R32_UINT, (uint32_t)simplifiedIndices.size());
+						job.blas.PreBuild(pDevice, settings.bAllowCompaction);
+						job.proxyIndices = std::move(simplifiedIndices);
+
+						if (bFillCache)
 						{
-							break;
+							cache.Add(CacheJobProxyIndices | j, job.proxyIndices);
 						}
 					}
+				}
+			});
+
+			for (PrimitiveJob& job : jobs)
+			{
+				uint32_t uvOffset = ~0u;
+				if (!job.bIsOpaque)
+				{
+					uvOffset = (uint32_t)postProcessedUVs.size();
+					postProcessedUVs.insert(postProcessedUVs.end(), job.uvs.cbegin(), job.uvs.cend());
+					maskedRanges.push_back({ uvOffset, (uint32_t)job.uvs.size(), job.textureIndex });
+				}
+				job.blas.SetMaskParams(uvOffset, job.textureIndex);
+
+				if (job.blas.IsQuantized())
+				{
+					quantizedStructures.push_back({ m_structures.size(), quantizedPositions.size() / 4 });
+					quantizedPositions.insert(quantizedPositions.end(), job.quantizedPositions.cbegin(), job.quantizedPositions.cend());
+					quantizedSourceSize += sizeof(float) * 3 * job.quantizedPositions.size() / 4;
+				}
+
+				bool const bUsingSkinning = job.jointStride != 0;
+				if (bUsingSkinning)
+				{
+					Geometry const& geometry = job.geometry;
+
+					SkinnedGeometry skinned = {};
+					skinned.positions = geometry.m_VBV[0].BufferLocation;
+					skinned.joints = geometry.m_VBV[1].BufferLocation;
+					skinned.weights = geometry.m_VBV[2].BufferLocation;
+					skinned.vertexCount = geometry.m_VBV[0].SizeInBytes / geometry.m_VBV[0].StrideInBytes;
+					skinned.jointStride = job.jointStride;
+					skinned.outputOffset = m_skinnedVertexCount * (uint32_t)sizeof(float) * 3;
+					skinned.skinIndex = job.skinIndex;
+					skinned.structureIndex = m_structures.size();
+					m_skinnedGeometry.push_back(skinned);
+					m_skinnedVertexCount += skinned.vertexCount;
+				}
+
+				if (bUseProxies && job.bIsOpaque && job.bHasIndices)
+				{
+					renderTriangles += job.renderIndexCount / 3;
+					renderBLASSize += job.renderBLASSize;
+
+					size_t builtIndexCount = job.renderIndexCount;
+					if (!job.proxyIndices.empty())
+					{
+						proxies.push_back({ m_structures.size(), (uint32_t)proxyIndices.size(), (uint32_t)job.proxyIndices.size() });
+						proxyIndices.insert(proxyIndices.end(), job.proxyIndices.cbegin(), job.proxyIndices.cend());
+						builtIndexCount = job.proxyIndices.size();
+					}
+
+					proxyTriangles += builtIndexCount / 3;
+					proxyBLASSize += job.blas.GetStructureSize();
+				}
+
+				size_t size = job.blas.GetStructureSize();
+				D3D12_GPU_VIRTUAL_ADDRESS address = bUsingSkinning
+					? SuballocStructure(pDevice, m_dynamicBuffers, size, "Dynamic BLAS buffer")
+					: SuballocStructure(pDevice, m_buffers, size, "BLAS buffer");
+
+				job.blas.AssignBuffer(address);
+
+				meshStructs[job.mesh][job.primitive] = m_structures.size();
+				m_structures.push_back(job.blas);
+			}
+
+			m_nodeStructs.assign(nodes.size(), std::vector<size_t>());
+			for (uint32_t n = 0; n < nodes.size(); n++)
+			{
+				int const meshIndex = nodes[n].meshIndex;
+				if (meshIndex < 0)
+					continue;
+
+				for (size_t p = 0; p < meshStructs[meshIndex].size(); p++)
+				{
+					if (!merged[n][p] && meshStructs[meshIndex][p] != NoStructure)
+					{
+						m_nodeStructs[n].push_back(meshStructs[meshIndex][p]);
+					}
+				}
+			}
+
+			// the merged clusters are written into shared world space buffers, the masked ones get a copy of
+			// their UVs in the order of the merged triangles so that one UV offset covers the whole cluster
+			struct MergedSource
+			{
+				tfAccessor indexBufferAcc;
+				tfAccessor positionAcc;
+				tfAccessor uvAcc;
+				math::Matrix4 mModelToWorld;
+			};
+			struct MergedCluster
+			{
+				std::vector<MergedSource> sources;
+				uint32_t textureIndex;
+				bool bIsOpaque;
+
+				std::vector<float> positions;
+				std::vector<uint32_t> indices;
+				std::vector<UV> uvs;
+			};
+			std::vector<MergedCluster> mergedClusters;
+			uint32_t mergedPrimitiveCount = 0;
+			mergedClusters.reserve(clusters.size());
+			m_mergedNodes.reserve(clusters.size());
+			for (auto const& cluster : clusters)
+			{
+				bool const bIsOpaque = std::get<3>(cluster.first);
+				int const maskTextureId = std::get<4>(cluster.first);
+
+				MergedCluster mergedCluster = {};
+				mergedCluster.textureIndex = maskTextureId >= 0 ? getMaskTextureIndex(maskTextureId) : ~0u;
+				mergedCluster.bIsOpaque = bIsOpaque;
+
+				std::vector<uint32_t> mergedNodes;
+				for (MergedPrimitive const& source : cluster.second)
+				{
+					const json& primitive = meshes[source.mesh]["primitives"][source.primitive];
+					const json& attributes = primitive.at("attributes");
+
+					MergedSource mergedSource = {};
+					pC->GetBufferDetails(primitive.value("indices", -1), &mergedSource.indexBufferAcc);
+					pC->GetBufferDetails((int)attributes.at("POSITION"), &mergedSource.positionAcc);
+					if (!bIsOpaque)
+					{
+						pC->GetBufferDetails((int)attributes.at("TEXCOORD_0"), &mergedSource.uvAcc);
+					}
+					mergedSource.mModelToWorld = pC->m_worldSpaceMats[source.node].GetCurrent();
+					mergedCluster.sources.push_back(mergedSource);
+
+					if (std::find(mergedNodes.cbegin(), mergedNodes.cend(), source.node) == mergedNodes.cend())
+					{
+						mergedNodes.push_back(source.node);
+					}
+				}
+				m_mergedNodes.push_back(std::move(mergedNodes));
+
+				mergedPrimitiveCount += (uint32_t)cluster.second.size();
+				mergedClusters.push_back(std::move(mergedCluster));
+			}
+
+			ParallelFor(pAsyncPool, mergedClusters.size(), [&](size_t c)
+			{
+				MergedCluster& mergedCluster = mergedClusters[c];
+
+				if (bCached)
+				{
+					cache.Read(CacheClusterPositions | c, mergedCluster.positions);
+					cache.Read(CacheClusterIndices | c, mergedCluster.indices);
+					cache.Read(CacheClusterUVs | c, mergedCluster.uvs);
+					return;
+				}
 
-					if (address == 0)
+				std::vector<uint32_t> renderIndices;
+				std::vector<uint32_t> simplifiedIndices;
+				for (MergedSource const& source : mergedCluster.sources)
+				{
+					TriangleUVPacker::ReadIndices(source.indexBufferAcc, renderIndices);
+					std::vector<uint32_t> const* pIndices = &renderIndices;
+					if (!mergedCluster.bIsOpaque)
+					{
+						TriangleUVPacker::AppendTriangleUVs(source.uvAcc, source.indexBufferAcc, mergedCluster.uvs);
+					}
+					else if (bUseProxies)
 					{
-						uint32_t allocSize = 16 * 1024 * 1024; // 16MB pool
-						if (size > allocSize)
+						// simplified before the transform, the error bound is in object space
+						uint32_t const targetIndexCount = max(3u, (uint32_t)(renderIndices.size() * settings.proxyTriangleRatio) / 3 * 3);
+						MeshSimplifier::Simplify(reinterpret_cast<float const*>(source.positionAcc.m_data), (uint32_t)source.positionAcc.m_stride, (uint32_t)source.positionAcc.m_count,
+							renderIndices.data(), (uint32_t)renderIndices.size(), targetIndexCount, settings.proxyMaxError, simplifiedIndices);
+
+						if (!simplifiedIndices.empty() && simplifiedIndices.size() < renderIndices.size())
 						{
-							allocSize = static_cast<uint32_t>(size);
+							pIndices = &simplifiedIndices;
 						}
-						ASBuffer* pNewPool = new ASBuffer();
-						pNewPool->OnCreate(pDevice, allocSize, false, "BLAS buffer");
+					}
+
+					// the geometry of the cluster starts at its first vertex, so the indices are relative to it
+					uint32_t const baseVertex = (uint32_t)(mergedCluster.positions.size() / 3);
+					for (uint32_t v = 0; v < (uint32_t)source.positionAcc.m_count; ++v)
+					{
+						float const* pPosition = reinterpret_cast<float const*>(source.positionAcc.Get(v));
+						math::Vector4 const position = source.mModelToWorld * math::Point3(pPosition[0], pPosition[1], pPosition[2]);
+						mergedCluster.positions.push_back(position.getX());
+						mergedCluster.positions.push_back(position.getY());
+						mergedCluster.positions.push_back(position.getZ());
+					}
+
+					for (uint32_t index : *pIndices)
+					{
+						mergedCluster.indices.push_back(baseVertex + index);
+					}
+				}
+
+				// in world space, the merged structures have no instance transform
+				if (!mergedCluster.bIsOpaque)
+				{
+					SetUVDensities(mergedCluster.positions.data(), sizeof(float) * 3, mergedCluster.indices, mergedCluster.uvs.data());
+				}
+
+				if (bFillCache)
+				{
+					cache.Add(CacheClusterPositions | c, mergedCluster.positions);
+					cache.Add(CacheClusterIndices | c, mergedCluster.indices);
+					cache.Add(CacheClusterUVs | c, mergedCluster.uvs);
+				}
+			});
+
+			if (mergedClusters.size())
+			{
+				std::vector<float> mergedPositions;
+				std::vector<uint32_t> mergedIndices;
+				for (MergedCluster const& mergedCluster : mergedClusters)
+				{
+					mergedPositions.insert(mergedPositions.end(), mergedCluster.positions.cbegin(), mergedCluster.positions.cend());
+					mergedIndices.insert(mergedIndices.end(), mergedCluster.indices.cbegin(), mergedCluster.indices.cend());
+				}
 
-						address = pNewPool->Suballoc((uint32_t)size);
-						m_buffers.push_back(pNewPool);
+				m_mergedVertexBuffer.InitBuffer(pDevice, "Merged BLAS positions", &CD3DX12_RESOURCE_DESC::Buffer(sizeof(float) * mergedPositions.size()), sizeof(float) * 3, D3D12_RESOURCE_STATE_COPY_DEST);
+				pUpload->AddBufferCopy(mergedPositions.data(), (uint32_t)(sizeof(float) * mergedPositions.size()), m_mergedVertexBuffer.GetResource());
+				m_mergedIndexBuffer.InitBuffer(pDevice, "Merged BLAS indices", &CD3DX12_RESOURCE_DESC::Buffer(sizeof(uint32_t) * mergedIndices.size()), sizeof(uint32_t), D3D12_RESOURCE_STATE_COPY_DEST);
+				pUpload->AddBufferCopy(mergedIndices.data(), (uint32_t)(sizeof(uint32_t) * mergedIndices.size()), m_mergedIndexBuffer.GetResource());
+
+				D3D12_GPU_VIRTUAL_ADDRESS mergedVertexBuffer = m_mergedVertexBuffer.GetResource()->GetGPUVirtualAddress();
+				D3D12_GPU_VIRTUAL_ADDRESS mergedIndexBuffer = m_mergedIndexBuffer.GetResource()->GetGPUVirtualAddress();
+				for (MergedCluster const& mergedCluster : mergedClusters)
+				{
+					uint32_t uvOffset = ~0u;
+					if (!mergedCluster.bIsOpaque)
+					{
+						uvOffset = (uint32_t)postProcessedUVs.size();
+						postProcessedUVs.insert(postProcessedUVs.end(), mergedCluster.uvs.cbegin(), mergedCluster.uvs.cend());
+						maskedRanges.push_back({ uvOffset, (uint32_t)mergedCluster.uvs.size(), mergedCluster.textureIndex });
 					}
 
-					blas.AssignBuffer(address);
+					BLAS blas;
+					blas.SetMaskParams(uvOffset, mergedCluster.textureIndex);
+					blas.AddGeometry(mergedVertexBuffer, (uint32_t)(mergedCluster.positions.size() / 3), mergedIndexBuffer, (uint32_t)mergedCluster.indices.size(), mergedCluster.bIsOpaque);
+					blas.PreBuild(pDevice, settings.bAllowCompaction);
+					blas.AssignBuffer(SuballocStructure(pDevice, m_buffers, blas.GetStructureSize(), "BLAS buffer"));
 
-					m_meshes[i].structs[p] = m_structures.size();
+					m_mergedStructs.push_back(m_structures.size());
 					m_structures.push_back(blas);
+
+					mergedVertexBuffer += sizeof(float) * mergedCluster.positions.size();
+					mergedIndexBuffer += sizeof(uint32_t) * mergedCluster.indices.size();
+				}
+
+				Trace(format("BLAS merging: %u static primitive instances merged into %zu structures\n", mergedPrimitiveCount, mergedClusters.size()));
+			}
+
+			// The alpha of the masks that can be read back is packed into one BC4 texture array, a slice per
+			// mask, and the structures get the slice as their texture index. The others are block compressed
+			// on disk, they keep sampling their base color texture through m_maskTextureTable.
+			std::vector<OpacityMicromap::AlphaMask> masks(m_alphaTextures.size());
+			if (!m_alphaTextures.empty())
+			{
+				const json& textures = j3["textures"];
+				const json& images = j3["images"];
+				std::vector<std::string> maskPaths(maskTextureIds.size());
+				for (size_t t = 0; t < maskTextureIds.size(); ++t)
+				{
+					int const source = GetElementInt(textures[maskTextureIds[t]], "source", -1);
+					if (source >= 0)
+					{
+						maskPaths[t] = pC->m_path + GetElementString(images[source], "uri", "");
+					}
+				}
+
+				// all the slices have the size of the biggest mask, up to alphaMaskSize, with mips down to 4x4
+				std::vector<OpacityMicromap::AlphaMask> sources(maskTextureIds.size());
+				std::vector<uint8_t> readable(maskTextureIds.size());
+				uint32_t maskSize = 4;
+				if (bCached)
+				{
+					cache.Read(CacheMaskReadable, readable);
+					readable.resize(maskTextureIds.size());
+
+					size_t size = 0;
+					void const* pMaskSize = cache.Find(CacheMaskSize, &size);
+					if (pMaskSize && size == sizeof(maskSize))
+					{
+						memcpy(&maskSize, pMaskSize, sizeof(maskSize));
+					}
+				}
+				else
+				{
+					ParallelFor(pAsyncPool, sources.size(), [&](size_t t)
+					{
+						if (!maskPaths[t].empty() && !LoadAlphaMask(maskPaths[t], sources[t]))
+						{
+							Trace(format("Alpha masks: can't read back %s, it's sampled from its texture\n", maskPaths[t].c_str()));
+						}
+					});
+
+					for (size_t t = 0; t < sources.size(); ++t)
+					{
+						readable[t] = sources[t].width != 0 ? 1 : 0;
+						while (readable[t] && maskSize < max(sources[t].width, sources[t].height) && maskSize < settings.alphaMaskSize)
+						{
+							maskSize *= 2;
+						}
+					}
+
+					if (bFillCache)
+					{
+						cache.Add(CacheMaskReadable, readable);
+						cache.Add(CacheMaskSize, &maskSize, sizeof(maskSize));
+					}
+				}
+
+				std::vector<uint32_t> maskIndices(sources.size());
+				std::vector<size_t> readableMasks;
+				std::vector<Texture*> fallbackTextures;
+				for (size_t t = 0; t < sources.size(); ++t)
+				{
+					if (readable[t])
+					{
+						maskIndices[t] = (uint32_t)readableMasks.size();
+						readableMasks.push_back(t);
+					}
+					else
+					{
+						maskIndices[t] = MaskFallbackBit | (uint32_t)fallbackTextures.size();
+						fallbackTextures.push_back(m_alphaTextures[t]);
+					}
+				}
+
+				uint32_t mipCount = 1;
+				while ((maskSize >> mipCount) >= 4)
+				{
+					++mipCount;
+				}
+
+				// the micromaps are baked against the decoded top mip, the same alpha the shader reads
+				std::vector<std::vector<std::vector<uint8_t>>> sliceBlocks(readableMasks.size());
+				ParallelFor(pAsyncPool, readableMasks.size(), [&](size_t slice)
+				{
+					size_t const t = readableMasks[slice];
+
+					// the cached slices have their mips one after the other, the micromaps are cached too
+					if (bCached)
+					{
+						size_t size = 0;
+						uint8_t const* pBlocks = reinterpret_cast<uint8_t const*>(cache.Find(CacheMaskSlice | slice, &size));
+						sliceBlocks[slice].resize(mipCount);
+						for (uint32_t mip = 0; mip < mipCount; ++mip)
+						{
+							size_t const mipSize = AlphaMaskPacker::GetBC4Size(maskSize >> mip, maskSize >> mip);
+							sliceBlocks[slice][mip].resize(mipSize);
+							if (pBlocks && mipSize <= size)
+							{
+								memcpy(sliceBlocks[slice][mip].data(), pBlocks, mipSize);
+								pBlocks += mipSize;
+								size -= mipSize;
+							}
+						}
+						return;
+					}
+
+					OpacityMicromap::AlphaMask top;
+					AlphaMaskPacker::Resample(sources[t], maskSize, maskSize, top);
+					std::vector<OpacityMicromap::AlphaMask> mips;
+					AlphaMaskPacker::BuildMipChain(top, mipCount, 0.5f, mips);
+
+					sliceBlocks[slice].resize(mipCount);
+					for (uint32_t mip = 0; mip < mipCount; ++mip)
+					{
+						sliceBlocks[slice][mip].resize(AlphaMaskPacker::GetBC4Size(mips[mip].width, mips[mip].height));
+						AlphaMaskPacker::EncodeBC4(mips[mip], sliceBlocks[slice][mip].data());
+					}
+					AlphaMaskPacker::DecodeBC4(sliceBlocks[slice][0].data(), maskSize, maskSize, masks[t]);
+
+					if (bFillCache)
+					{
+						std::vector<uint8_t> blocks;
+						for (std::vector<uint8_t> const& mipBlocks : sliceBlocks[slice])
+						{
+							blocks.insert(blocks.end(), mipBlocks.cbegin(), mipBlocks.cend());
+						}
+						cache.Add(CacheMaskSlice | slice, blocks);
+					}
+				});
+
+				if (!readableMasks.empty())
+				{
+					CD3DX12_RESOURCE_DESC const desc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_BC4_UNORM, maskSize, maskSize, (UINT16)readableMasks.size(), (UINT16)mipCount);
+					uint32_t const subresourceCount = (uint32_t)readableMasks.size() * mipCount;
+					m_alphaMaskFootprints.resize(subresourceCount);
+					std::vector<UINT> rowCounts(subresourceCount);
+					std::vector<UINT64> rowSizes(subresourceCount);
+					UINT64 uploadSize = 0;
+					pDevice->GetDevice()->GetCopyableFootprints(&desc, 0, subresourceCount, 0, m_alphaMaskFootprints.data(), rowCounts.data(), rowSizes.data(), &uploadSize);
+
+					std::vector<uint8_t> upload((size_t)uploadSize);
+					for (uint32_t slice = 0; slice < readableMasks.size(); ++slice)
+					{
+						for (uint32_t mip = 0; mip < mipCount; ++mip)
+						{
+							uint32_t const subresource = D3D12CalcSubresource(mip, slice, 0, mipCount, (uint32_t)readableMasks.size());
+							D3D12_PLACED_SUBRESOURCE_FOOTPRINT const& footprint = m_alphaMaskFootprints[subresource];
+							for (UINT row = 0; row < rowCounts[subresource]; ++row)
+							{
+								memcpy(upload.data() + footprint.Offset + row * footprint.Footprint.RowPitch, sliceBlocks[slice][mip].data() + row * rowSizes[subresource], (size_t)rowSizes[subresource]);
+							}
+						}
+					}
+
+					m_alphaMaskArray.Init(pDevice, "Alpha mask array", &desc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr);
+					m_alphaMaskUpload.InitBuffer(pDevice, "Alpha mask upload", &CD3DX12_RESOURCE_DESC::Buffer(uploadSize), sizeof(uint32_t), D3D12_RESOURCE_STATE_COPY_DEST);
+					pUpload->AddBufferCopy(upload.data(), (uint32_t)uploadSize, m_alphaMaskUpload.GetResource());
+				}
+
+				for (BLAS& blas : m_structures)
+				{
+					if (blas.TextureIndex() < maskIndices.size())
+					{
+						blas.SetMaskParams(blas.UVBufferOffset(), maskIndices[blas.TextureIndex()]);
+					}
+				}
+
+				pResourceViewHeaps->AllocCBV_SRV_UAVDescriptor((uint32_t)fallbackTextures.size(), &m_maskTextureTable);
+				for (size_t i = 0; i < fallbackTextures.size(); ++i)
+				{
+					fallbackTextures[i]->CreateSRV((uint32_t)i, &m_maskTextureTable);
+				}
+
+				Trace(format("Alpha masks: %zu slices of %ux%u BC4 with %u mips, %zu sampled from their textures\n", readableMasks.size(), maskSize, maskSize, mipCount, fallbackTextures.size()));
+			}
+			else
+			{
+				pResourceViewHeaps->AllocCBV_SRV_UAVDescriptor(0, &m_maskTextureTable);
+			}
+
+			if (m_skinnedVertexCount)
+			{
+				uint32_t const skinnedPositionsSize = m_skinnedVertexCount * (uint32_t)sizeof(float) * 3;
+				m_skinnedPositions.InitBuffer(pDevice, "Skinned BLAS positions", &CD3DX12_RESOURCE_DESC::Buffer(skinnedPositionsSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS), sizeof(float), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+
+				D3D12_GPU_VIRTUAL_ADDRESS const skinnedPositions = m_skinnedPositions.GetResource()->GetGPUVirtualAddress();
+				for (SkinnedGeometry const& skinned : m_skinnedGeometry)
+				{
+					m_structures[skinned.structureIndex].SetDynamicVertexBuffer(skinnedPositions + skinned.outputOffset, sizeof(float) * 3);
+				}
+			}
+
+			if (quantizedPositions.size())
+			{
+				uint32_t const quantizedSize = (uint32_t)(sizeof(int16_t) * quantizedPositions.size());
+				m_quantizedVertexBuffer.InitBuffer(pDevice, "Quantized BLAS positions", &CD3DX12_RESOURCE_DESC::Buffer(quantizedSize), sizeof(int16_t) * 4, D3D12_RESOURCE_STATE_COPY_DEST);
+				pUpload->AddBufferCopy(quantizedPositions.data(), quantizedSize, m_quantizedVertexBuffer.GetResource());
+
+				D3D12_GPU_VIRTUAL_ADDRESS const quantizedVertexBuffer = m_quantizedVertexBuffer.GetResource()->GetGPUVirtualAddress();
+				for (QuantizedStructure const& quantized : quantizedStructures)
+				{
+					BLAS& blas = m_structures[quantized.structureIndex];
+					blas.SetQuantizedVertexBuffer(quantizedVertexBuffer + sizeof(int16_t) * 4 * quantized.firstVertex, blas.GetDequantization());
+				}
+
+				Trace(format("BLAS quantization: %zu primitives, %.2f MB -> %.2f MB of positions\n", quantizedStructures.size(),
+					quantizedSourceSize / (1024.0f * 1024.0f), quantizedSize / (1024.0f * 1024.0f)));
+			}
+
+			if (proxyIndices.size())
+			{
+				m_proxyIndexBuffer.InitBuffer(pDevice, "BLAS shadow proxy indices", &CD3DX12_RESOURCE_DESC::Buffer(sizeof(uint32_t) * proxyIndices.size()), sizeof(uint32_t), D3D12_RESOURCE_STATE_COPY_DEST);
+				pUpload->AddBufferCopy(proxyIndices.data(), (uint32_t)(sizeof(uint32_t) * proxyIndices.size()), m_proxyIndexBuffer.GetResource());
+
+				D3D12_GPU_VIRTUAL_ADDRESS const proxyIndexBuffer = m_proxyIndexBuffer.GetResource()->GetGPUVirtualAddress();
+				for (Proxy const& proxy : proxies)
+				{
+					m_structures[proxy.structureIndex].SetIndexBuffer(proxyIndexBuffer + sizeof(uint32_t) * proxy.firstIndex, DXGI_FORMAT_R32_UINT, proxy.indexCount);
 				}
 			}
 
-			pResourceViewHeaps->AllocCBV_SRV_UAVDescriptor((uint32_t)m_alphaTextures.size(), &m_maskTextureTable);
-			for (size_t i = 0; i < m_alphaTextures.size(); ++i)
+			if (bUseProxies)
 			{
-				m_alphaTextures[i]->CreateSRV((uint32_t)i, &m_maskTextureTable);
+				Trace(format("BLAS shadow proxies: %llu -> %llu triangles, %.2f MB -> %.2f MB of BLAS\n", renderTriangles, proxyTriangles,
+					renderBLASSize / (1024.0f * 1024.0f), proxyBLASSize / (1024.0f * 1024.0f)));
 			}
 
 			if (postProcessedUVs.size())
 			{
 				m_blasUVBuffer.InitBuffer(pDevice, "BLAS UV buffer", &CD3DX12_RESOURCE_DESC::Buffer(sizeof(UV) * postProcessedUVs.size()), sizeof(UV), D3D12_RESOURCE_STATE_COPY_DEST);
 				pUpload->AddBufferCopy(postProcessedUVs.data(), (uint32_t)(sizeof(UV) * postProcessedUVs.size()), m_blasUVBuffer.GetResource());
+
+				// Every masked triangle gets a micromap descriptor, the states of the subdivided ones follow the
+				// descriptors in the same buffer. The triangles that couldn't be baked sample their texture everywhere.
+				// The cached ones are uploaded straight from the mapping. The masks aren't decoded on a cached
+				// load, so a cache without them leaves every triangle unknown rather than baking.
+				uint32_t const maskedTriangleCount = (uint32_t)postProcessedUVs.size();
+				size_t micromapsSize = 0;
+				void const* pMicromaps = bCached ? cache.Find(CacheMicromaps, &micromapsSize) : nullptr;
+				std::vector<uint32_t> micromaps;
+				if (pMicromaps == nullptr)
+				{
+					micromaps.assign(maskedTriangleCount, OpacityMicromap::MakeUniform(OpacityMicromap::Unknown));
+				}
+				if (!bCached && settings.opacityMicromapMaxLevel >= 0)
+				{
+					// the big foliage meshes are split so that they don't end up on a single worker
+					struct MicromapChunk
+					{
+						uint32_t firstTriangle;
+						uint32_t triangleCount;
+						uint32_t textureIndex;
+						std::vector<uint32_t> states;
+					};
+					std::vector<MicromapChunk> chunks;
+					uint32_t const chunkSize = 4096;
+					for (MaskedRange const& range : maskedRanges)
+					{
+						if (range.textureIndex >= masks.size())
+							continue;
+
+						for (uint32_t first = 0; first < range.triangleCount; first += chunkSize)
+						{
+							chunks.push_back({ range.uvOffset + first, min(chunkSize, range.triangleCount - first), range.textureIndex, {} });
+						}
+					}
+
+					ParallelFor(pAsyncPool, chunks.size(), [&](size_t c)
+					{
+						MicromapChunk& chunk = chunks[c];
+						for (uint32_t i = chunk.firstTriangle; i < chunk.firstTriangle + chunk.triangleCount; ++i)
+						{
+							// the UVs the shader interpolates, with the deltas rounded to half
+							UV const& uv = postProcessedUVs[i];
+							float const uv0[2] = { uv.uv0.getX(), uv.uv0.getY() };
+							float const uv01[2] = { TriangleUVPacker::FromF16(uv.uv01[0]), TriangleUVPacker::FromF16(uv.uv01[1]) };
+							float const uv02[2] = { TriangleUVPacker::FromF16(uv.uv02[0]), TriangleUVPacker::FromF16(uv.uv02[1]) };
+							micromaps[i] = OpacityMicromap::Bake(masks[chunk.textureIndex], 0.5f, uv0, uv01, uv02, (uint32_t)settings.opacityMicromapMaxLevel, chunk.states);
+						}
+					});
+
+					uint32_t resolvedTriangles = 0;
+					uint32_t subdividedTriangles = 0;
+					for (MicromapChunk const& chunk : chunks)
+					{
+						// the state offsets have 28 bits
+						bool const bFits = micromaps.size() + chunk.states.size() <= 0x0fffffff;
+						uint32_t const base = (uint32_t)micromaps.size();
+						for (uint32_t i = chunk.firstTriangle; i < chunk.firstTriangle + chunk.triangleCount; ++i)
+						{
+							uint32_t const level = micromaps[i] >> 28;
+							if (level != OpacityMicromap::UniformLevel)
+							{
+								micromaps[i] = bFits ? OpacityMicromap::Rebase(micromaps[i], base) : OpacityMicromap::MakeUniform(OpacityMicromap::Unknown);
+								subdividedTriangles += bFits ? 1 : 0;
+							}
+							else if (micromaps[i] != OpacityMicromap::MakeUniform(OpacityMicromap::Unknown))
+							{
+								++resolvedTriangles;
+							}
+						}
+
+						if (bFits)
+						{
+							micromaps.insert(micromaps.end(), chunk.states.cbegin(), chunk.states.cend());
+						}
+					}
+
+					Trace(format("Opacity micromaps: %u masked triangles, %u fully opaque or transparent, %u subdivided, %.2f MB\n", maskedTriangleCount,
+						resolvedTriangles, subdividedTriangles, sizeof(uint32_t) * micromaps.size() / (1024.0f * 1024.0f)));
+				}
+
+				if (pMicromaps == nullptr)
+				{
+					pMicromaps = micromaps.data();
+					micromapsSize = sizeof(uint32_t) * micromaps.size();
+				}
+				if (bFillCache)
+				{
+					cache.Add(CacheMicromaps, pMicromaps, micromapsSize);
+				}
+
+				m_opacityMicromapBuffer.InitBuffer(pDevice, "BLAS opacity micromaps", &CD3DX12_RESOURCE_DESC::Buffer(micromapsSize), sizeof(uint32_t), D3D12_RESOURCE_STATE_COPY_DEST);
+				pUpload->AddBufferCopy(pMicromaps, (uint32_t)micromapsSize, m_opacityMicromapBuffer.GetResource());
+			}
+		}
+
+		if (bFillCache)
+		{
+			if (cache.Save(settings.pCachePath, cacheKey))
+			{
+				Trace(format("Scene cache: written to %s\n", settings.pCachePath));
+			}
+			else
+			{
+				Trace(format("Scene cache: can't write %s\n", settings.pCachePath));
+			}
+		}
+	}
+
+	void ASFactory::BuildBLAS(ID3D12GraphicsCommandList* pCmdList, ASBuffer& scratchBuffer)
+	{
+		// the skinning matrices only exist once a frame sets them, so the skinned structures are
+		// built by their first update instead
+		for (auto&& blas : m_structures)
+		{
+			if (!blas.IsDynamic())
+			{
+				blas.Build(pCmdList, scratchBuffer);
+			}
+		}
+
+		// the dynamic structures are rebuilt in place, so they keep their full size
+		m_compactedStructures.clear();
+		for (size_t i = 0; i < m_structures.size(); ++i)
+		{
+			if (!m_structures[i].IsDynamic())
+			{
+				m_compactedStructures.push_back(i);
+			}
+		}
+
+		if (!m_bAllowCompaction || m_compactedStructures.empty())
+			return;
+
+		ID3D12Device* pDevice = nullptr;
+		pCmdList->GetDevice(IID_PPV_ARGS(&pDevice));
+
+		// one D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE_DESC per structure
+		UINT64 const sizesBytes = sizeof(UINT64) * m_compactedStructures.size();
+		ThrowIfFailed(
+			pDevice->CreateCommittedResource(
+				&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+				D3D12_HEAP_FLAG_NONE,
+				&CD3DX12_RESOURCE_DESC::Buffer(sizesBytes, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
+				D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+				nullptr,
+				IID_PPV_ARGS(&m_pCompactedSizes))
+		);
+		SetName(m_pCompactedSizes, "ASFactory::m_pCompactedSizes");
+
+		ThrowIfFailed(
+			pDevice->CreateCommittedResource(
+				&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK),
+				D3D12_HEAP_FLAG_NONE,
+				&CD3DX12_RESOURCE_DESC::Buffer(sizesBytes),
+				D3D12_RESOURCE_STATE_COPY_DEST,
+				nullptr,
+				IID_PPV_ARGS(&m_pCompactedSizesReadback))
+		);
+		SetName(m_pCompactedSizesReadback, "ASFactory::m_pCompactedSizesReadback");
+		pDevice->Release();
+
+		std::vector<D3D12_GPU_VIRTUAL_ADDRESS> addresses(m_compactedStructures.size());
+		for (size_t i = 0; i < m_compactedStructures.size(); ++i)
+		{
+			addresses[i] = m_structures[m_compactedStructures[i]].GetGpuAddress();
+		}
+
+		ID3D12GraphicsCommandList4* pCmdList4 = nullptr;
+		pCmdList->QueryInterface(&pCmdList4);
+
+		// the builds have to be done before their compacted size can be read
+		pCmdList4->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(nullptr));
+
+		D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_DESC info = {};
+		info.DestBuffer = m_pCompactedSizes->GetGPUVirtualAddress();
+		info.InfoType = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE;
+		pCmdList4->EmitRaytracingAccelerationStructurePostbuildInfo(&info, (UINT)addresses.size(), addresses.data());
+
+		pCmdList4->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_pCompactedSizes, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE));
+		pCmdList4->CopyBufferRegion(m_pCompactedSizesReadback, 0, m_pCompactedSizes, 0, sizesBytes);
+
+		pCmdList4->Release();
+
+		m_bCompactionPending = true;
+	}
+
+	bool ASFactory::IsCompactionPending(void) const
+	{
+		return m_bCompactionPending;
+	}
+
+	void ASFactory::CompactBLAS(CAULDRON_DX12::Device* pDevice, ID3D12GraphicsCommandList* pCmdList)
+	{
+		assert(m_bCompactionPending);
+
+		UINT64 const sizesBytes = sizeof(UINT64) * m_compactedStructures.size();
+		D3D12_RANGE readRange = { 0, (SIZE_T)sizesBytes };
+		UINT64 const* pCompactedSizes = nullptr;
+		ThrowIfFailed(m_pCompactedSizesReadback->Map(0, &readRange, (void**)&pCompactedSizes));
+
+		uint64_t const alignment = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT;
+		uint64_t compactedSize = 0;
+		for (size_t i = 0; i < m_compactedStructures.size(); ++i)
+		{
+			compactedSize += (pCompactedSizes[i] + alignment - 1) & ~(alignment - 1);
+		}
+
+		uint64_t uncompactedSize = 0;
+		for (auto&& buffer : m_buffers)
+		{
+			uncompactedSize += buffer->GetSize();
+		}
+
+		ASBuffer* pCompactedPool = new ASBuffer();
+		pCompactedPool->OnCreate(pDevice, compactedSize, false, "Compacted BLAS buffer");
+
+		ID3D12GraphicsCommandList4* pCmdList4 = nullptr;
+		pCmdList->QueryInterface(&pCmdList4);
+
+		UserMarker marker(pCmdList, "BLAS Compaction");
+		for (size_t i = 0; i < m_compactedStructures.size(); ++i)
+		{
+			m_structures[m_compactedStructures[i]].Compact(pCmdList4, pCompactedPool->Suballoc(pCompactedSizes[i]));
+		}
+		pCmdList4->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(pCompactedPool->GetResource()));
+
+		pCmdList4->Release();
+
+		D3D12_RANGE writeRange = { 0, 0 };
+		m_pCompactedSizesReadback->Unmap(0, &writeRange);
+
+		// the sizes were read back before this was called, so nothing on the GPU uses them anymore
+		m_pCompactedSizes->Release();
+		m_pCompactedSizes = nullptr;
+		m_pCompactedSizesReadback->Release();
+		m_pCompactedSizesReadback = nullptr;
+
+		m_retiredBuffers.insert(m_retiredBuffers.end(), m_buffers.begin(), m_buffers.end());
+		m_buffers.clear();
+		m_buffers.push_back(pCompactedPool);
+
+		m_bCompactionPending = false;
+
+		Trace(format("BLAS compaction: %zu structures, %.2f MB -> %.2f MB\n", m_compactedStructures.size(),
+			uncompactedSize / (1024.0f * 1024.0f), compactedSize / (1024.0f * 1024.0f)));
+	}
+
+	void ASFactory::ReleaseRetiredBuffers(void)
+	{
+		for (auto&& iter : m_retiredBuffers)
+		{
+			iter->OnDestroy();
+			delete iter;
+		}
+		m_retiredBuffers.clear();
+
+		// the copies into the alpha mask array are done by now too
+		m_alphaMaskUpload.OnDestroy();
+		m_alphaMaskFootprints.clear();
+	}
+
+	void ASFactory::CopyAlphaMasks(ID3D12GraphicsCommandList* pCmdList)
+	{
+		if (m_alphaMaskUpload.GetResource() == nullptr)
+			return;
+
+		for (uint32_t i = 0; i < m_alphaMaskFootprints.size(); ++i)
+		{
+			CD3DX12_TEXTURE_COPY_LOCATION const destination(m_alphaMaskArray.GetResource(), i);
+			CD3DX12_TEXTURE_COPY_LOCATION const source(m_alphaMaskUpload.GetResource(), m_alphaMaskFootprints[i]);
+			pCmdList->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
+		}
+		pCmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_alphaMaskArray.GetResource(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
+	}
+
+	D3D12_GPU_VIRTUAL_ADDRESS ASFactory::SuballocStructure(CAULDRON_DX12::Device* pDevice, std::vector<ASBuffer*>& pools, size_t size, const char* name)
+	{
+		D3D12_GPU_VIRTUAL_ADDRESS address = 0;
+		for (auto&& buffer : pools)
+		{
+			address = buffer->Suballoc(size);
+			if (address != 0)
+			{
+				break;
+			}
+		}
+
+		if (address == 0)
+		{
+			uint64_t allocSize = 16 * 1024 * 1024; // 16MB pool
+			if (size > allocSize)
+			{
+				allocSize = size;
 			}
+			ASBuffer* pNewPool = new ASBuffer();
+			pNewPool->OnCreate(pDevice, allocSize, false, name);
+
+			address = pNewPool->Suballoc(size);
+			pools.push_back(pNewPool);
+		}
+
+		return address;
+	}
+
+	uint32_t ASFactory::GetMaskTextureIndex(Texture* pTexture)
+	{
+		auto find = m_alphaTextureIndices.find(pTexture);
+		if (find != m_alphaTextureIndices.end())
+		{
+			return find->second;
+		}
+
+		uint32_t const index = (uint32_t)m_alphaTextures.size();
+		m_alphaTextureIndices.emplace(pTexture, index);
+		m_alphaTextures.push_back(pTexture);
+		return index;
+	}
+
+	void ASFactory::UpdateSkinnedBLAS(ID3D12GraphicsCommandList* pCmdList, GLTFTexturesAndBuffers* pGLTFTexturesAndBuffers, ASBuffer& scratchBuffer, uint32_t rebuildInterval)
+	{
+		m_bSkinnedBLASUpdated = false;
+		if (m_skinnedGeometry.empty())
+			return;
+
+		UserMarker marker(pCmdList, "Skinned BLAS update");
+
+		pCmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_skinnedPositions.GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
+
+		D3D12_GPU_VIRTUAL_ADDRESS const skinnedPositions = m_skinnedPositions.GetResource()->GetGPUVirtualAddress();
+		for (SkinnedGeometry const& skinned : m_skinnedGeometry)
+		{
+			m_skinning.Dispatch(pCmdList, skinned, pGLTFTexturesAndBuffers->GetSkinningMatricesBuffer(skinned.skinIndex), skinnedPositions);
 		}
+
+		pCmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_skinnedPositions.GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
+
+		// the refit keeps the topology of the last build, which gets worse to trace as the pose drifts from it.
+		// There is nothing to refit before the first build.
+		bool const bRebuild = ++m_refitsSinceRebuild >= max(rebuildInterval, 1u) || !m_bSkinnedBLASBuilt;
+		if (bRebuild)
+		{
+			m_refitsSinceRebuild = 0;
+		}
+
+		for (SkinnedGeometry const& skinned : m_skinnedGeometry)
+		{
+			m_structures[skinned.structureIndex].Build(pCmdList, scratchBuffer, !bRebuild);
+		}
+
+		// the TLAS builds read the updated structures
+		pCmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(nullptr));
+
+		m_bSkinnedBLASUpdated = true;
+		m_bSkinnedBLASBuilt = true;
 	}
 
-	TLAS ASFactory::BuildTLASFromGLTF(CAULDRON_DX12::Device* pDevice, GLTFTexturesAndBuffers* pGLTFTexturesAndBuffers, bool bGatherOpaque, bool bGatherNonOpaque)
+	void ASFactory::BuildTLASFromGLTF(CAULDRON_DX12::Device* pDevice, GLTFTexturesAndBuffers* pGLTFTexturesAndBuffers, bool bGatherNonOpaque, TLAS& tlas, TLAS* pNonOpaqueTlas, std::vector<uint8_t> const* pNodeMask)
 	{
 		// loop through nodes
 	   //
 		std::vector<tfNode> const& nodes = pGLTFTexturesAndBuffers->m_pGLTFCommon->m_nodes;
 		Matrix2* pNodesMatrices = pGLTFTexturesAndBuffers->m_pGLTFCommon->m_worldSpaceMats.data();
 
-		TLAS tlas;
+		tlas.Reset();
+		if (pNonOpaqueTlas)
+		{
+			pNonOpaqueTlas->Reset();
+		}
 
+		math::Matrix4 const identity = math::Matrix4::identity();
 		for (uint32_t i = 0; i < nodes.size(); i++)
 		{
 			tfNode const& node = nodes[i];
-			if (node.meshIndex < 0)
+			if (node.meshIndex < 0 || i >= m_nodeStructs.size())
+				continue;
+			if (pNodeMask && (i >= pNodeMask->size() || !(*pNodeMask)[i]))
 				continue;
 
 			math::Matrix4 mModelToWorld = pNodesMatrices[i].GetCurrent();
 
-			Mesh mesh = m_meshes[node.meshIndex];
-			for (uint32_t j = 0; j < mesh.structs.size(); j++)
+			for (size_t structureIndex : m_nodeStructs[i])
 			{
-				BLAS& blas = m_structures[mesh.structs[j]];
+				BLAS& blas = m_structures[structureIndex];
 
-				if ((blas.IsOpaque() && bGatherOpaque)
-					|| (!blas.IsOpaque() && bGatherNonOpaque))
+				// the skinned structures stay out of the TLAS until an update has built them in a skinned pose
+				if (blas.IsDynamic() && !m_bSkinnedBLASBuilt)
+					continue;
+
+				// skinned positions are already in world space
+				math::Matrix4 const& matrix = blas.IsDynamic() ? identity : mModelToWorld;
+
+				if (blas.IsOpaque() || bGatherNonOpaque)
+				{
+					tlas.AddInstance(blas, matrix);
+				}
+				if (!blas.IsOpaque() && pNonOpaqueTlas)
+				{
+					pNonOpaqueTlas->AddInstance(blas, matrix);
+				}
+			}
+		}
+
+		// the merged static primitives were pre-transformed on load
+		for (size_t m = 0; m < m_mergedStructs.size(); m++)
+		{
+			if (pNodeMask)
+			{
+				bool bGather = false;
+				for (uint32_t nodeIndex : m_mergedNodes[m])
 				{
-					tlas.AddInstance(blas, mModelToWorld);
+					bGather = bGather || (nodeIndex < pNodeMask->size() && (*pNodeMask)[nodeIndex]);
 				}
+				if (!bGather)
+					continue;
 			}
+
+			BLAS& blas = m_structures[m_mergedStructs[m]];
+			if (blas.IsOpaque() || bGatherNonOpaque)
+			{
+				tlas.AddInstance(blas, identity);
+			}
+			if (!blas.IsOpaque() && pNonOpaqueTlas)
+			{
+				pNonOpaqueTlas->AddInstance(blas, identity);
+			}
+		}
+
+		// the bounds of the skinned BLASes changed, the TLASes have to be refit even if no instance moved
+		tlas.SelectBuildMode(m_bSkinnedBLASUpdated);
+		if (tlas.GetBuildMode() == TLAS::BuildMode::Full)
+		{
+			tlas.PreBuild(pDevice);
 		}
+		if (pNonOpaqueTlas)
+		{
+			pNonOpaqueTlas->SelectBuildMode(m_bSkinnedBLASUpdated);
+			if (pNonOpaqueTlas->GetBuildMode() == TLAS::BuildMode::Full)
+			{
+				pNonOpaqueTlas->PreBuild(pDevice);
+			}
+		}
+	}
+
+	void ASFactory::AllocateTLAS(CAULDRON_DX12::Device* pDevice, TLAS** ppTLAS, uint32_t numTLAS)
+	{
+		bool bOutOfMemory = false;
+		for (uint32_t i = 0; i < numTLAS && !bOutOfMemory; ++i)
+		{
+			TLAS& tlas = *ppTLAS[i];
+			if (tlas.GetBuildMode() != TLAS::BuildMode::Full || tlas.GetStructureSize() <= tlas.GetAllocatedSize())
+				continue;
 
-		tlas.PreBuild(pDevice);
+			// the TLAS outgrew its allocation, the GPU runs the frames in order so nothing reads the old one
+			// anymore by the time this frame's build writes over it
+			if (tlas.GetAllocatedSize() != 0)
+			{
+				m_tlasBuffer.Free(tlas.GetGpuAddress());
+			}
 
-		size_t size = tlas.GetStructureSize();
-		D3D12_GPU_VIRTUAL_ADDRESS address = m_tlasBuffer.Suballoc((uint32_t)size);
-		tlas.AssignBuffer(address);
+			size_t size = tlas.GetStructureSize();
+			D3D12_GPU_VIRTUAL_ADDRESS address = m_tlasBuffer.Suballoc(size);
+			bOutOfMemory = address == 0;
+			tlas.AssignBuffer(address, size);
+		}
 
-		return std::move(tlas);
+		if (bOutOfMemory)
+		{
+			// too fragmented, start over and every TLAS gets rebuilt in its new place
+			m_tlasBuffer.Reset();
+			for (uint32_t i = 0; i < numTLAS; ++i)
+			{
+				TLAS& tlas = *ppTLAS[i];
+				if (tlas.GetBuildMode() != TLAS::BuildMode::Full)
+				{
+					tlas.PreBuild(pDevice);
+				}
+				tlas.ForceFullBuild();
+
+				size_t size = tlas.GetStructureSize();
+				D3D12_GPU_VIRTUAL_ADDRESS address = m_tlasBuffer.Suballoc(size);
+				assert(address != 0);
+				tlas.AssignBuffer(address, size);
+			}
+		}
 	}
 
 	void ASFactory::SyncTLASBuilds(ID3D12GraphicsCommandList* pCmdList)
@@ -688,21 +2241,57 @@ namespace Raytracing
 	void ASFactory::ClearBuiltStructures(void)
 	{
 		m_structures.clear();
+		m_nodeStructs.clear();
+		m_mergedStructs.clear();
+		m_mergedNodes.clear();
 
 		for (auto&& iter : m_buffers)
 		{
 			iter->OnDestroy();
 		}
 		m_buffers.clear();
+		ReleaseRetiredBuffers();
+
+		for (auto&& iter : m_dynamicBuffers)
+		{
+			iter->OnDestroy();
+			delete iter;
+		}
+		m_dynamicBuffers.clear();
+		m_compactedStructures.clear();
+
+		m_skinnedGeometry.clear();
+		m_skinnedPositions.OnDestroy();
+		m_skinnedVertexCount = 0;
+		m_refitsSinceRebuild = 0;
+		m_bSkinnedBLASUpdated = false;
+		m_bSkinnedBLASBuilt = false;
+
+		m_tlasBuffer.Reset();
 
+		if (m_pCompactedSizes)
+		{
+			m_pCompactedSizes->Release();
+			m_pCompactedSizes = nullptr;
+		}
+		if (m_pCompactedSizesReadback)
+		{
+			m_pCompactedSizesReadback->Release();
+			m_pCompactedSizesReadback = nullptr;
+		}
+		m_bCompactionPending = false;
 
 		m_blasUVBuffer.OnDestroy();
+		m_opacityMicromapBuffer.OnDestroy();
+		m_proxyIndexBuffer.OnDestroy();
+		m_quantizedVertexBuffer.OnDestroy();
+		m_mergedVertexBuffer.OnDestroy();
+		m_mergedIndexBuffer.OnDestroy();
 		m_alphaTextures.clear();
-	}
-
-	void ASFactory::ResetTLAS(void)
-	{
-		m_tlasBuffer.Reset();
+		m_alphaTextureIndices.clear();
+		m_alphaMaskArray.OnDestroy();
+		m_alphaMaskUpload.OnDestroy();
+		m_alphaMaskFootprints.clear();
 	}
 
 	CBV_SRV_UAV& ASFactory::GetMaskTextureTable(void)
@@ -715,13 +2304,22 @@ namespace Raytracing
 		return &m_blasUVBuffer;
 	}
 
+	Texture* ASFactory::GetOpacityMicromapBuffer(void)
+	{
+		return &m_opacityMicromapBuffer;
+	}
+
+	Texture* ASFactory::GetAlphaMaskArray(void)
+	{
+		return &m_alphaMaskArray;
+	}
+
 	std::vector<BLAS>& ASFactory::GetBLASVector(void)
 	{
 		return m_structures;
 	}
 	ASBuffer::ASBuffer(void)
-		: m_memOffset(0)
-		, m_totalMemSize(0)
+		: m_allocator()
 		, m_pBuffer(nullptr)
 	{
 	}
@@ -730,15 +2328,17 @@ namespace Raytracing
 	{
 	}
 
-	void ASBuffer::OnCreate(Device* pDevice, uint32_t totalMemSize, bool isScratch, const char* name)
+	void ASBuffer::OnCreate(Device* pDevice, uint64_t totalMemSize, bool isScratch, const char* name)
 	{
-		m_totalMemSize = AlignUp(totalMemSize, (uint32_t)D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT);
+		uint64_t const alignment = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT;
+		totalMemSize = (totalMemSize + alignment - 1) & ~(alignment - 1);
+		m_allocator.Init(totalMemSize, alignment);
 
 		ThrowIfFailed(
 			pDevice->GetDevice()->CreateCommittedResource(
 				&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
 				D3D12_HEAP_FLAG_NONE,
-				&CD3DX12_RESOURCE_DESC::Buffer(m_totalMemSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
+				&CD3DX12_RESOURCE_DESC::Buffer(totalMemSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
 				(isScratch) ? D3D12_RESOURCE_STATE_UNORDERED_ACCESS : D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE,
 				nullptr,
 				IID_PPV_ARGS(&m_pBuffer))
@@ -755,22 +2355,24 @@ namespace Raytracing
 			m_pBuffer = nullptr;
 		}
 
-		m_memOffset = 0;
-		m_totalMemSize = 0;
+		m_allocator.Init(0, D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT);
 
 	}
 
-	D3D12_GPU_VIRTUAL_ADDRESS ASBuffer::Suballoc(uint32_t byteSize)
+	D3D12_GPU_VIRTUAL_ADDRESS ASBuffer::Suballoc(uint64_t byteSize)
 	{
-		uint32_t size = AlignUp(byteSize, (uint32_t)D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT);
-		
-		D3D12_GPU_VIRTUAL_ADDRESS address = 0;
-		if (m_memOffset + size <= m_totalMemSize)
+		uint64_t const offset = m_allocator.Allocate(byteSize);
+		if (offset == RangeAllocator::InvalidOffset)
 		{
-			address = m_memOffset + m_pBuffer->GetGPUVirtualAddress();
-			m_memOffset += size;
+			return 0;
 		}
-		return address;
+		return offset + m_pBuffer->GetGPUVirtualAddress();
+	}
+
+	void ASBuffer::Free(D3D12_GPU_VIRTUAL_ADDRESS address)
+	{
+		assert(address >= m_pBuffer->GetGPUVirtualAddress());
+		m_allocator.Free(address - m_pBuffer->GetGPUVirtualAddress());
 	}
 
 	ID3D12Resource* ASBuffer::GetResource(void) const
@@ -778,9 +2380,19 @@ namespace Raytracing
 		return m_pBuffer;
 	}
 
+	uint64_t ASBuffer::GetSize(void) const
+	{
+		return m_allocator.GetSize();
+	}
+
+	uint64_t ASBuffer::GetUsedSize(void) const
+	{
+		return m_allocator.GetUsedSize();
+	}
+
 	void ASBuffer::Reset(void)
 	{
-		m_memOffset = 0;
+		m_allocator.Reset();
 	}
 
 }
\ No newline at end of file
@@ -19,26 +19,67 @@
 #pragma once
 
 #include "GLTF/GLTFTexturesAndBuffers.h"
+#include "BLASSkinning.h"
+#include "RangeAllocator.h"
 
 namespace Raytracing
 {
+	// Applied when the structures of a scene are created
+	struct BLASBuildSettings
+	{
+		bool bAllowCompaction;
+
+		// Opaque primitives are traced against simplified shadow proxies with at most this
+		// fraction of their triangles, 1 uses the render geometry
+		float proxyTriangleRatio;
+		// object space distance the proxy surface may move away from the render geometry
+		float proxyMaxError;
+
+		// The float3 positions of the static primitives are quantized to 16 bit SNORM when that moves
+		// them at most this far in object space, 0 keeps the render vertex buffers
+		float quantizationMaxError;
+
+		// Static primitives whose world space bounds are at most mergeMaxSize across are pre-transformed
+		// and merged into one BLAS per mergeClusterSize cell of the scene, 0 keeps one BLAS per primitive.
+		// Which nodes are static is taken from pNodeClassification, nothing is merged without it.
+		float mergeMaxSize;
+		float mergeClusterSize;
+		ShadowCasterCulling const* pNodeClassification;
+
+		// The alpha masked triangles are subdivided into up to 4^opacityMicromapMaxLevel micro triangles that
+		// are classified against their mask, a negative level doesn't bake and every hit samples the mask
+		int opacityMicromapMaxLevel;
+
+		// largest size of the alpha mask array slices, the masks are resampled to the size of the biggest one
+		uint32_t alphaMaskSize;
+
+		// The prepared UVs, positions, proxies, masks and micromaps are cached in this file and reused by
+		// the next load of the same scene with the same settings, nullptr doesn't cache
+		char const* pCachePath;
+	};
+
 	class ASBuffer
 	{
 	public:
 		ASBuffer(void);
 		~ASBuffer(void);
 
-		void OnCreate(Device* pDevice, uint32_t totalMemSize, bool isScratch, const char* name);
+		void OnCreate(Device* pDevice, uint64_t totalMemSize, bool isScratch, const char* name);
 		void OnDestroy();
 
-		D3D12_GPU_VIRTUAL_ADDRESS Suballoc(uint32_t byteSize);
+		// Returns 0 when there is no free range large enough. Freed ranges are reused right away, so
+		// they must not be in use by the GPU anymore.
+		D3D12_GPU_VIRTUAL_ADDRESS Suballoc(uint64_t byteSize);
+		void Free(D3D12_GPU_VIRTUAL_ADDRESS address);
 
 		ID3D12Resource* GetResource(void) const;
+		uint64_t GetSize(void) const;
+		uint64_t GetUsedSize(void) const;
 
+		// frees all the suballocations
 		void Reset(void);
 	private:
-		uint32_t         m_memOffset;
-		uint32_t         m_totalMemSize;
+		RangeAllocator   m_allocator;
 
 		ID3D12Resource* m_pBuffer;
 	};
@@ -49,8 +90,9 @@ namespace Raytracing
 		BLAS(void);
 		~BLAS(void);
 
-		void Build(ID3D12GraphicsCommandList* pCmdList, ASBuffer& buffer);
-		void PreBuild(CAULDRON_DX12::Device* pDevice);
+		void Build(ID3D12GraphicsCommandList* pCmdList, ASBuffer& buffer, bool bUpdate = false);
+		void PreBuild(CAULDRON_DX12::Device* pDevice, bool bAllowCompaction);
+		void Compact(ID3D12GraphicsCommandList4* pCmdList4, D3D12_GPU_VIRTUAL_ADDRESS address);
 		
 		size_t GetStructureSize(void) const;
 		D3D12_GPU_VIRTUAL_ADDRESS GetGpuAddress(void) const;
@@ -58,8 +100,22 @@ namespace Raytracing
 		void AssignBuffer(D3D12_GPU_VIRTUAL_ADDRESS address);
 
 		void AddGeometry(Geometry const& geo, DXGI_FORMAT vertexFormat, bool bIsOpaque);
+		// float3 positions with 32 bit indices
+		void AddGeometry(D3D12_GPU_VIRTUAL_ADDRESS vertexBuffer, uint32_t vertexCount, D3D12_GPU_VIRTUAL_ADDRESS indexBuffer, uint32_t indexCount, bool bIsOpaque);
+		void SetIndexBuffer(D3D12_GPU_VIRTUAL_ADDRESS address, DXGI_FORMAT format, uint32_t indexCount);
 		void SetMaskParams(uint32_t uvBufferOffset, uint32_t textureIndex);
 
+		// R16G16B16A16_SNORM positions from PositionQuantizer, the instances of the structure are
+		// transformed by dequantization first
+		void SetQuantizedVertexBuffer(D3D12_GPU_VIRTUAL_ADDRESS address, math::Matrix4 const& dequantization);
+		bool IsQuantized(void) const;
+		math::Matrix4 const& GetDequantization(void) const;
+
+		// dynamic structures read their positions from a buffer that changes every frame, they
+		// are built for refitting and already are in world space
+		void SetDynamicVertexBuffer(D3D12_GPU_VIRTUAL_ADDRESS address, uint32_t stride);
+		bool IsDynamic(void) const;
+
 		bool IsOpaque(void) const;
 		uint32_t UVBufferOffset(void) const;
 		uint32_t TextureIndex(void) const;
@@ -71,30 +127,75 @@ namespace Raytracing
 		D3D12_GPU_VIRTUAL_ADDRESS m_address;
 
 		bool m_bIsBLASOpaque;
+		bool m_bIsDynamic;
+		bool m_bIsQuantized;
 		uint32_t m_uvBufferOffset;
 		uint32_t m_textureIndex;
+		math::Matrix4 m_dequantization;
 	};
 
 	class TLAS
 	{
 	public:
+		enum class BuildMode
+		{
+			None,   // same instances and transforms as the last build
+			Update, // only the transforms changed, refit the last build
+			Full,   // the instances changed
+		};
+
 		TLAS(void);
 		~TLAS(void);
 
-		void Build(ID3D12GraphicsCommandList* pCmdList, ASBuffer& buffer, DynamicBufferRing& bufferRing);
+		// The instances are uploaded to one buffer per frame in flight, frame picks the one a build
+		// writes to. A TLAS is built at most once per frame, so the GPU is done with that buffer.
+		void OnCreate(uint32_t numFramesInFlight);
+		void OnDestroy();
+
+		void Build(ID3D12GraphicsCommandList* pCmdList, ASBuffer& buffer, uint32_t frame);
 		void PreBuild(CAULDRON_DX12::Device* pDevice);
 
 		size_t GetStructureSize(void) const;
+		size_t GetAllocatedSize(void) const;
 		D3D12_GPU_VIRTUAL_ADDRESS GetGpuAddress(void) const;
-		void AssignBuffer(D3D12_GPU_VIRTUAL_ADDRESS address);
+		void AssignBuffer(D3D12_GPU_VIRTUAL_ADDRESS address, size_t size);
 
 		void AddInstance(BLAS const& blas, math::Matrix4 const& matrix);
+		void Reset(void);
+
+		// compares the gathered instances against the ones of the last build, a BLAS that
+		// changed in place needs at least a refit
+		void SelectBuildMode(bool bBLASChanged);
+		void ForceFullBuild(void);
+		BuildMode GetBuildMode(void) const;
+
+		// forgets the last build, its memory is gone or the BLASes it references are
+		void Invalidate(void);
 	private:
+		// persistently mapped upload buffer, with a CPU copy of what was written to it so that
+		// only the instances that changed since its last use are written again
+		struct InstanceBuffer
+		{
+			ID3D12Resource* pBuffer;
+			D3D12_RAYTRACING_INSTANCE_DESC* pMapped;
+			uint32_t capacity;
+			uint32_t lastFrame; // frame + 1 of the last build that read it, 0 when none did
+			std::vector<D3D12_RAYTRACING_INSTANCE_DESC> contents;
+		};
+
+		D3D12_GPU_VIRTUAL_ADDRESS UploadInstances(ID3D12GraphicsCommandList* pCmdList, uint32_t frame);
+
 		std::vector<D3D12_RAYTRACING_INSTANCE_DESC> m_instances;
+		std::vector<D3D12_RAYTRACING_INSTANCE_DESC> m_builtInstances;
+		std::vector<InstanceBuffer> m_instanceBuffers; // one per frame in flight
+		uint32_t m_numFramesInFlight;
 		D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS m_inputs;
 		D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO m_info;
 
 		D3D12_GPU_VIRTUAL_ADDRESS m_address;
+		size_t m_allocatedSize;
+		BuildMode m_buildMode;
+		bool m_bBuilt;
 	};
 
 	class ASFactory
@@ -106,35 +207,84 @@ namespace Raytracing
 		void OnCreate(CAULDRON_DX12::Device* pDevice);
 		void OnDestroy();
 
-		void BuildFromGltf(CAULDRON_DX12::Device* pDevice, GLTFTexturesAndBuffers* pGLTFTexturesAndBuffers, ResourceViewHeaps* pResourceViewHeaps, UploadHeap* pUpload);
+		// The proxy index and merged geometry buffers are added to pUpload, it has to be flushed before BuildBLAS runs.
+		// The merged geometry is pre-transformed with the current world matrices of the nodes.
+		// The per primitive preparation runs on pAsyncPool when there is one, the results don't depend on its scheduling.
+		void BuildFromGltf(CAULDRON_DX12::Device* pDevice, GLTFTexturesAndBuffers* pGLTFTexturesAndBuffers, ResourceViewHeaps* pResourceViewHeaps, UploadHeap* pUpload, AsyncPool* pAsyncPool, BLASBuildSettings const& settings);
+		void BuildBLAS(ID3D12GraphicsCommandList* pCmdList, ASBuffer& scratchBuffer);
+
+		// Compaction runs in two steps, BuildBLAS queues the readback of the compacted sizes, then once
+		// that has finished CompactBLAS copies the structures into a tightly packed pool. The original
+		// pools are kept until the copies have finished too.
+		bool IsCompactionPending(void) const;
+		void CompactBLAS(CAULDRON_DX12::Device* pDevice, ID3D12GraphicsCommandList* pCmdList);
+		void ReleaseRetiredBuffers(void);
+
+		// Copies the alpha masks from the upload heap into their array, once pUpload has been flushed
+		void CopyAlphaMasks(ID3D12GraphicsCommandList* pCmdList);
+
+		// Skins the positions of the skinned BLASes and refits them, with a full rebuild every
+		// rebuildInterval frames since the refits get slower to trace the further the pose moves
+		void UpdateSkinnedBLAS(ID3D12GraphicsCommandList* pCmdList, GLTFTexturesAndBuffers* pGLTFTexturesAndBuffers, ASBuffer& scratchBuffer, uint32_t rebuildInterval);
 
-		TLAS BuildTLASFromGLTF(CAULDRON_DX12::Device* pDevice, GLTFTexturesAndBuffers* pGLTFTexturesAndBuffers, bool bGatherOpaque, bool bGatherNonOpaque);
+		// Gathers both TLASes in one pass over the nodes, the non opaque one is optional. Only the nodes
+		// with a non zero entry in pNodeMask are gathered, all of them without one.
+		void BuildTLASFromGLTF(CAULDRON_DX12::Device* pDevice, GLTFTexturesAndBuffers* pGLTFTexturesAndBuffers, bool bGatherNonOpaque, TLAS& tlas, TLAS* pNonOpaqueTlas, std::vector<uint8_t> const* pNodeMask = nullptr);
+		// Gives memory to the TLASes that need a full build and don't fit in their old allocation,
+		// all the live TLASes have to be passed in since running out of memory moves all of them,
+		// including the ones that weren't gathered this frame
+		void AllocateTLAS(CAULDRON_DX12::Device* pDevice, TLAS** ppTLAS, uint32_t numTLAS);
 		void SyncTLASBuilds(ID3D12GraphicsCommandList* pCmdList);
 
 
 		void ClearBuiltStructures(void);
-		void ResetTLAS(void);
 
 		CBV_SRV_UAV& GetMaskTextureTable(void);
 		Texture* GetUVBuffer(void);
+		Texture* GetOpacityMicromapBuffer(void);
+		Texture* GetAlphaMaskArray(void);
 		std::vector<BLAS>& GetBLASVector(void);
 
 	private:
-		struct Mesh
-		{
-			std::vector<size_t> structs;
-		};
+		D3D12_GPU_VIRTUAL_ADDRESS SuballocStructure(CAULDRON_DX12::Device* pDevice, std::vector<ASBuffer*>& pools, size_t size, const char* name);
+		uint32_t GetMaskTextureIndex(Texture* pTexture);
 
 
 		std::vector<ASBuffer*> m_buffers;
+		std::vector<ASBuffer*> m_retiredBuffers;
+		std::vector<ASBuffer*> m_dynamicBuffers; // never compacted, the rebuilds need the full size
+		std::vector<size_t> m_compactedStructures;
+		ID3D12Resource* m_pCompactedSizes;
+		ID3D12Resource* m_pCompactedSizesReadback;
+		bool m_bAllowCompaction;
+		bool m_bCompactionPending;
 		std::vector<Texture*> m_alphaTextures;
+		std::unordered_map<Texture*, uint32_t> m_alphaTextureIndices;
 		std::vector<BLAS> m_structures;
-		std::vector<Mesh> m_meshes;
+		std::vector<std::vector<size_t>> m_nodeStructs; // instanced with the transform of the node
+		std::vector<size_t> m_mergedStructs; // in world space
+		std::vector<std::vector<uint32_t>> m_mergedNodes; // the nodes each merged structure was made of
 
 		ASBuffer m_tlasBuffer;
 
 		CBV_SRV_UAV m_maskTextureTable;
 		Texture m_blasUVBuffer;
+		Texture m_opacityMicromapBuffer; // one descriptor per entry of m_blasUVBuffer, then the micro triangle states
+		Texture m_alphaMaskArray; // BC4, a slice per mask texture that could be read back
+		Texture m_alphaMaskUpload;
+		std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> m_alphaMaskFootprints;
+		Texture m_proxyIndexBuffer;
+		Texture m_quantizedVertexBuffer;
+		Texture m_mergedVertexBuffer;
+		Texture m_mergedIndexBuffer;
+
+		BLASSkinning m_skinning;
+		std::vector<SkinnedGeometry> m_skinnedGeometry;
+		Texture m_skinnedPositions;
+		uint32_t m_skinnedVertexCount;
+		uint32_t m_refitsSinceRebuild;
+		bool m_bSkinnedBLASUpdated;
+		bool m_bSkinnedBLASBuilt;
 
 		
 	};
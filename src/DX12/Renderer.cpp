@@ -27,6 +27,21 @@
 
 constexpr float GOLDEN_RATIO = 1.6180339887f;
 
+// Frames the per frame containers get to reach their size after a scene load or a resize
+constexpr uint32_t ALLOCATION_WARMUP_FRAMES = 8;
+
+// every shadowed light gets a slice of the ray hits and a channel of the shadow mask
+static_assert(Renderer::MaxShadowedLights <= Raytracing::k_maxLights, "the raytraced shadows don't have enough slices for the lights");
+static_assert(Renderer::MaxShadowedLights <= ShadowMaskCombine::MaxLights, "the shadow mask doesn't have enough channels for the lights");
+
+static char const* const k_cascadePassNames[Renderer::MaxShadowedLights][CSMManager::MaxCascades] =
+{
+	{ "Shadow Cascade Pass0", "Shadow Cascade Pass1", "Shadow Cascade Pass2", "Shadow Cascade Pass3" },
+	{ "Shadow Cascade Pass0 Light1", "Shadow Cascade Pass1 Light1", "Shadow Cascade Pass2 Light1", "Shadow Cascade Pass3 Light1" },
+	{ "Shadow Cascade Pass0 Light2", "Shadow Cascade Pass1 Light2", "Shadow Cascade Pass2 Light2", "Shadow Cascade Pass3 Light2" },
+	{ "Shadow Cascade Pass0 Light3", "Shadow Cascade Pass1 Light3", "Shadow Cascade Pass2 Light3", "Shadow Cascade Pass3 Light3" },
+};
+
 //--------------------------------------------------------------------------------------
 //
 // OnCreate
@@ -91,7 +106,8 @@ void Renderer::OnCreate(Device* pDevice, SwapChain *pSwapChain, float fontSize,
 	m_resourceViewHeaps.AllocCBV_SRV_UAVDescriptor(1, &m_ShadowMaskSRV);
 
 	// Create a Shadowmap atlas to hold 4 cascades/spotlights
-	m_resourceViewHeaps.AllocDSVDescriptor(5, &m_ShadowMapDSV);
+	m_resourceViewHeaps.AllocDSVDescriptor(1 + MaxShadowedLights * CSMManager::MaxCascades, &m_ShadowMapDSV);
+	m_resourceViewHeaps.AllocDSVDescriptor(MaxShadowedLights * CSMManager::MaxCascades, &m_staticShadowMapDSV);
 	m_resourceViewHeaps.AllocCBV_SRV_UAVDescriptor(1, &m_ShadowMapSRV);
 
 	m_skyDome.OnCreate(pDevice, &m_UploadHeap, &m_resourceViewHeaps, &m_ConstantBufferRing, &m_VidMemBufferPool, "..\\media\\cauldron-media\\envmaps\\papermill\\diffuse.dds", "..\\media\\cauldron-media\\Brutalism\\Cubemap_layered_half.dds", DXGI_FORMAT_R16G16B16A16_FLOAT, 1);
@@ -116,8 +132,14 @@ void Renderer::OnCreate(Device* pDevice, SwapChain *pSwapChain, float fontSize,
 
 	m_asFactory.OnCreate(m_pDevice);
 	m_scratchBuffer.OnCreate(m_pDevice, 128 * 1024 * 1024, true, "AS Scratch buffer");
+	for (Raytracing::TLAS& tlas : m_tlas)
+	{
+		tlas.OnCreate(backBufferCount);
+	}
 
 	m_shadowTrace.OnCreate(m_pDevice, &m_resourceViewHeaps);
+	m_depthReduction.OnCreate(m_pDevice, &m_resourceViewHeaps, backBufferCount);
+	m_shadowMaskCombine.OnCreate(m_pDevice, &m_resourceViewHeaps);
 	m_shadowTrace.SetBlueNoise(m_blueNoise);
 
 	OnResizeShadowMapWidth(pState);
@@ -139,6 +161,7 @@ void Renderer::OnDestroy()
 	m_asyncPool.Flush();
 
 	m_shadowMap.OnDestroy();
+	m_staticShadowMap.OnDestroy();
 	m_ImGUI.OnDestroy();
 	m_colorConversionPS.OnDestroy();
 	m_toneMappingCS.OnDestroy();
@@ -164,8 +187,14 @@ void Renderer::OnDestroy()
 
 	m_asFactory.OnDestroy();
 	m_scratchBuffer.OnDestroy();
+	for (Raytracing::TLAS& tlas : m_tlas)
+	{
+		tlas.OnDestroy();
+	}
 
 	m_shadowTrace.OnDestroy();
+	m_depthReduction.OnDestroy();
+	m_shadowMaskCombine.OnDestroy();
 }
 
 //--------------------------------------------------------------------------------------
@@ -182,11 +211,15 @@ void Renderer::OnCreateWindowSizeDependentResources(SwapChain* pSwapChain, uint3
 	m_viewport = { 0.0f, 0.0f, static_cast<float>(Width), static_cast<float>(Height), 0.0f, 1.0f };
 	m_rectScissor = { 0, 0, (LONG)Width, (LONG)Height };
 
+	// the cascades are fit to the camera frustum, which changes with the aspect ratio
+	m_bForceCascadeUpdate = true;
+
 	// Create shadow mask
 	//
 	m_ShadowMask.Init(m_pDevice, "shadowbuffer", &CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, Width, Height, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, NULL);
 	m_ShadowMask.CreateUAV(0, &m_ShadowMaskUAV);
 	m_ShadowMask.CreateSRV(0, &m_ShadowMaskSRV);
+	m_shadowMaskCombine.OnCreateWindowSizeDependentResources(m_pDevice, m_ShadowMask, Width, Height);
 
 	// Create GBuffer
 	//
@@ -204,6 +237,7 @@ void Renderer::OnCreateWindowSizeDependentResources(SwapChain* pSwapChain, uint3
 
 	m_shadowTrace.OnCreateWindowSizeDependentResources(m_pDevice, Width, Height);
 	m_shadowTrace.BindDepthTexture(m_GBuffer.m_DepthBuffer);
+	m_depthReduction.BindDepthTexture(m_GBuffer.m_DepthBuffer, Width, Height);
 	m_shadowTrace.BindNormalTexture(m_GBuffer.m_NormalBuffer);
 	m_shadowTrace.BindMotionVectorTexture(m_GBuffer.m_MotionVectors);
 
@@ -230,6 +264,7 @@ void Renderer::OnDestroyWindowSizeDependentResources()
 	m_magnifierPS.OnDestroyWindowSizeDependentResources();
 
 	m_ShadowMask.OnDestroy();
+	m_shadowMaskCombine.OnDestroyWindowSizeDependentResources();
 
 	m_shadowTrace.OnDestroyWindowSizeDependentResources();
 }
@@ -247,7 +282,7 @@ void Renderer::OnUpdateDisplayDependentResources(SwapChain* pSwapChain)
 // LoadScene
 //
 //--------------------------------------------------------------------------------------
-int Renderer::LoadScene(GLTFCommon* pGLTFCommon, int stage)
+int Renderer::LoadScene(GLTFCommon* pGLTFCommon, const UIState* pState, int stage)
 {
 	// show loading progress
 	//
@@ -273,6 +308,18 @@ int Renderer::LoadScene(GLTFCommon* pGLTFCommon, int stage)
 
 		m_pGLTFTexturesAndBuffers = new GLTFTexturesAndBuffers();
 		m_pGLTFTexturesAndBuffers->OnCreate(m_pDevice, pGLTFCommon, &m_UploadHeap, &m_VidMemBufferPool, &m_ConstantBufferRing);
+
+		for (LightShadows& light : m_lightShadows)
+		{
+			light.csmManager.InvalidateSceneBounds();
+			light.casterCulling.ClassifyNodes(pGLTFCommon);
+			memset(light.bStaticCascadeValid, 0, sizeof(light.bStaticCascadeValid));
+		}
+		m_bForceCascadeUpdate = true;
+		m_bDepthReductionActive = false;
+		m_casterNodeMask.reserve(pGLTFCommon->m_nodes.size());
+		m_tlasNodeMask.reserve(pGLTFCommon->m_nodes.size());
+		m_steadyStateFrame = m_frame + ALLOCATION_WARMUP_FRAMES;
 	}
 	else if (stage == 4)
 	{
@@ -290,15 +337,34 @@ int Renderer::LoadScene(GLTFCommon* pGLTFCommon, int stage)
 	{
 		Profile p("BLAS build");
 
-		m_asFactory.BuildFromGltf(m_pDevice, m_pGLTFTexturesAndBuffers, &m_resourceViewHeaps, &m_UploadHeap);
+		Raytracing::BLASBuildSettings settings = {};
+		settings.bAllowCompaction = pState->bCompactBLAS;
+		settings.proxyTriangleRatio = pState->shadowProxyRatio;
+		settings.proxyMaxError = pState->shadowProxyMaxError;
+		settings.quantizationMaxError = pState->shadowQuantizationMaxError;
+		settings.mergeMaxSize = pState->staticMergeMaxSize;
+		settings.mergeClusterSize = pState->staticMergeClusterSize;
+		settings.pNodeClassification = &m_lightShadows[0].casterCulling;
+		settings.opacityMicromapMaxLevel = pState->opacityMicromapMaxLevel;
+		settings.alphaMaskSize = pState->alphaMaskSize;
+		settings.pCachePath = pState->sceneCachePath.empty() ? nullptr : pState->sceneCachePath.c_str();
+
+		// the merged static geometry is pre-transformed with the world matrices
+		pGLTFCommon->TransformScene(0, math::Matrix4::identity());
+
+		m_asFactory.BuildFromGltf(m_pDevice, m_pGLTFTexturesAndBuffers, &m_resourceViewHeaps, &m_UploadHeap, pAsyncPool, settings);
 		m_shadowTrace.SetUVBuffer(*m_asFactory.GetUVBuffer());
+		m_shadowTrace.SetOpacityMicromaps(*m_asFactory.GetOpacityMicromapBuffer());
+		m_shadowTrace.SetAlphaMasks(m_pDevice, *m_asFactory.GetAlphaMaskArray());
+
+		// the builds read the shadow proxy index buffers
+		m_UploadHeap.FlushAndFinish();
 
 		ID3D12GraphicsCommandList* pCmdLst1 = m_CommandListRing.GetNewCommandList();
 
-		for (auto&& blas : m_asFactory.GetBLASVector())
-		{
-			blas.Build(pCmdLst1, m_scratchBuffer);
-		}
+		// also queues the readback of the compacted sizes when compaction is enabled
+		m_asFactory.BuildBLAS(pCmdLst1, m_scratchBuffer);
+		m_asFactory.CopyAlphaMasks(pCmdLst1);
 
 		ThrowIfFailed(pCmdLst1->Close());
 		ID3D12CommandList* CmdListList1[] = { pCmdLst1 };
@@ -308,6 +374,20 @@ int Renderer::LoadScene(GLTFCommon* pGLTFCommon, int stage)
 	}
 	else if (stage == 6)
 	{
+		if (m_asFactory.IsCompactionPending())
+		{
+			Profile p("BLAS compaction");
+
+			// the compacted sizes are ready since the previous stage waited on the BLAS builds
+			ID3D12GraphicsCommandList* pCmdLst1 = m_CommandListRing.GetNewCommandList();
+
+			m_asFactory.CompactBLAS(m_pDevice, pCmdLst1);
+
+			ThrowIfFailed(pCmdLst1->Close());
+			ID3D12CommandList* CmdListList1[] = { pCmdLst1 };
+			m_pDevice->GetGraphicsQueue()->ExecuteCommandLists(1, CmdListList1);
+		}
+
 		Profile p("m_gltfMotionVector->OnCreate");
 
 		//create the glTF's textures, VBs, IBs, shaders and descriptors for this particular pass
@@ -390,6 +470,9 @@ int Renderer::LoadScene(GLTFCommon* pGLTFCommon, int stage)
 		//once everything is uploaded we dont need he upload heaps anymore
 		m_VidMemBufferPool.FreeUploadHeap();
 
+		// the compaction copies are done by now, so the uncompacted BLAS pools can go
+		m_asFactory.ReleaseRetiredBuffers();
+
 		// tell caller that we are done loading the map
 		return 0;
 	}
@@ -446,6 +529,88 @@ void Renderer::UnloadScene()
 	}
 
 	m_asFactory.ClearBuiltStructures();
+	for (Raytracing::TLAS& tlas : m_tlas)
+	{
+		tlas.Invalidate();
+	}
+}
+
+//--------------------------------------------------------------------------------------
+//
+// TimeStamp
+//
+//--------------------------------------------------------------------------------------
+void Renderer::TimeStamp(ID3D12GraphicsCommandList* pCommandList, const char* label)
+{
+	// Cauldron's timer keeps the labels in std::strings, those aren't the frame's allocations
+	AllocationCounter::Pause pause;
+	m_GPUTimer.GetTimeStamp(pCommandList, label);
+}
+
+//--------------------------------------------------------------------------------------
+//
+// DrawShadowCasters
+//
+//--------------------------------------------------------------------------------------
+void Renderer::DrawShadowCasters(ID3D12GraphicsCommandList* pCommandList, int lightIndex, int cascadeIndex, int volumeIndex, ShadowCasterCulling::CasterFilter filter)
+{
+	// The depth pass only draws the nodes with a non zero entry in the mask, the scene isn't touched
+	m_lightShadows[lightIndex].casterCulling.GetVisibleNodes(volumeIndex, filter, &m_casterNodeMask);
+
+	AllocationCounter::Pause pause;
+	m_gltfDepth->Draw(pCommandList, cascadeIndex + 1, &m_casterNodeMask);
+}
+
+//--------------------------------------------------------------------------------------
+//
+// DrawCachedShadowCasters
+//
+//--------------------------------------------------------------------------------------
+void Renderer::DrawCachedShadowCasters(ID3D12GraphicsCommandList* pCommandList, int lightIndex, int cascadeIndex, int numCascades, int slice, math::Matrix4 const& viewProj)
+{
+	LightShadows& light = m_lightShadows[lightIndex];
+
+	// The static casters only need to be rendered again when the cascade projection or the light moved.
+	// They are culled against the whole projection rather than the receiver volume, which moves with the
+	// camera, so the cached casters are exactly the ones the projection covers.
+	UINT const subresource = static_cast<UINT>(slice);
+	if (!light.bStaticCascadeValid[cascadeIndex] || memcmp(&viewProj, &light.staticCascadeViewProj[cascadeIndex], sizeof(math::Matrix4)) != 0)
+	{
+		pCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_staticShadowMap.GetResource(), D3D12_RESOURCE_STATE_DEPTH_READ, D3D12_RESOURCE_STATE_DEPTH_WRITE, subresource));
+
+		pCommandList->ClearDepthStencilView(m_staticShadowMapDSV.GetCPU(slice), D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+		pCommandList->OMSetRenderTargets(0, nullptr, false, &m_staticShadowMapDSV.GetCPU(slice));
+		DrawShadowCasters(pCommandList, lightIndex, cascadeIndex, numCascades + cascadeIndex, ShadowCasterCulling::CasterFilter::Static);
+
+		pCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_staticShadowMap.GetResource(), D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_COPY_SOURCE, subresource));
+
+		light.staticCascadeViewProj[cascadeIndex] = viewProj;
+		light.bStaticCascadeValid[cascadeIndex] = true;
+	}
+	else
+	{
+		pCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_staticShadowMap.GetResource(), D3D12_RESOURCE_STATE_DEPTH_READ, D3D12_RESOURCE_STATE_COPY_SOURCE, subresource));
+	}
+
+	// Copy the static casters in, this replaces the clear
+	pCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_shadowMap.GetResource(), D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_COPY_DEST, subresource));
+
+	CD3DX12_TEXTURE_COPY_LOCATION const dst(m_shadowMap.GetResource(), subresource);
+	CD3DX12_TEXTURE_COPY_LOCATION const src(m_staticShadowMap.GetResource(), subresource);
+	pCommandList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+
+	D3D12_RESOURCE_BARRIER const postCopy[] = {
+		CD3DX12_RESOURCE_BARRIER::Transition(m_shadowMap.GetResource(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_DEPTH_WRITE, subresource),
+		CD3DX12_RESOURCE_BARRIER::Transition(m_staticShadowMap.GetResource(), D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_DEPTH_READ, subresource),
+	};
+	pCommandList->ResourceBarrier(ARRAYSIZE(postCopy), postCopy);
+
+	// And depth test the dynamic ones on top
+	if (light.casterCulling.HasDynamicNodes())
+	{
+		pCommandList->OMSetRenderTargets(0, nullptr, false, &m_ShadowMapDSV.GetCPU(slice + 1));
+		DrawShadowCasters(pCommandList, lightIndex, cascadeIndex, cascadeIndex, ShadowCasterCulling::CasterFilter::Dynamic);
+	}
 }
 
 //--------------------------------------------------------------------------------------
@@ -466,6 +631,8 @@ void Renderer::OnRender(const UIState* pState, const Camera& cam, SwapChain* pSw
 
 	// Sets the perFrame data 
 	per_frame* pPerFrame = NULL;
+	Light* shadowedLights[MaxShadowedLights] = {};
+	int numShadowedLights = 0;
 	if (m_pGLTFTexturesAndBuffers)
 	{
 		// fill as much as possible using the GLTF (camera, lights, ...)
@@ -482,6 +649,23 @@ void Renderer::OnRender(const UIState* pState, const Camera& cam, SwapChain* pSw
 		pPerFrame->wireframeOptions.setZ(pState->WireframeColor[2]);
 		pPerFrame->wireframeOptions.setW(pState->WireframeMode == UIState::WireframeMode::WIREFRAME_MODE_SOLID_COLOR ? 1.0f : 0.0f);
 
+		// Every directional light up to the number of cascade sets gets a channel of the shadow mask
+		for (uint32_t i = 0; i < pPerFrame->lightCount; i++)
+		{
+			if (pPerFrame->lights[i].type != LightType_Directional)
+				continue;
+
+			if (numShadowedLights < m_numShadowedLights)
+			{
+				pPerFrame->lights[i].shadowMapIndex = numShadowedLights;
+				shadowedLights[numShadowedLights++] = &pPerFrame->lights[i];
+			}
+			else
+			{
+				pPerFrame->lights[i].shadowMapIndex = -1;
+			}
+		}
+
 		m_pGLTFTexturesAndBuffers->SetPerFrameConstants();
 		m_pGLTFTexturesAndBuffers->SetSkinningMatricesForSkeletons();
 	}
@@ -545,224 +729,386 @@ void Renderer::OnRender(const UIState* pState, const Camera& cam, SwapChain* pSw
 		pCmdLst1->ResourceBarrier(ARRAYSIZE(barrier), barrier);
 	}
 
-	// Find directional light
-	Light* directionalLightptr = NULL;
-	if (pPerFrame != NULL)
+	// The CPU side of the shadows and the raytracing is one allocation scope, none of it may allocate
+	// in the steady state frame. Cauldron's calls in there are paused.
 	{
-		for (uint32_t i = 0; i < pPerFrame->lightCount; i++)
+		AllocationCounter::Scope allocations("Shadows", m_frame >= m_steadyStateFrame);
+
+		// Render shadow maps
+		if (m_gltfDepth && pPerFrame != NULL && bNeedCascades)
 		{
-			if (pPerFrame->lights[i].type != LightType_Directional)
-				continue;
+			pCmdLst1->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_shadowMap.GetResource(), D3D12_RESOURCE_STATE_DEPTH_READ, D3D12_RESOURCE_STATE_DEPTH_WRITE));
+			UserMarker marker(pCmdLst1, "Shadow Cascade Pass");
 
-			directionalLightptr = &pPerFrame->lights[i];
-			break;
-		}
-	}
+			// Scene MUST HAVE directional light
+			assert(numShadowedLights > 0);
 
-	// Render shadow maps
-	if (m_gltfDepth && pPerFrame != NULL && bNeedCascades)
-	{
-		pCmdLst1->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_shadowMap.GetResource(), D3D12_RESOURCE_STATE_DEPTH_READ, D3D12_RESOURCE_STATE_DEPTH_WRITE));
-		UserMarker marker(pCmdLst1, "Shadow Cascade Pass");
-		pCmdLst1->ClearDepthStencilView(m_ShadowMapDSV.GetCPU(), D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
-		m_GPUTimer.GetTimeStamp(pCmdLst1, "Clear shadow map cascades");
+			// Fit the cascade partitions to the depth range visible a few frames ago, the readback never waits on the GPU
+			bool bHasDepthPartitions = false;
+			if (pState->bSampleDistributionCascades)
+			{
+				// Results from before the toggle or from another projection or fit would place the partitions
+				// wrong, the static split points are used until fresh ones come back.
+				DepthReductionSettings settings;
+				memset(&settings, 0, sizeof(DepthReductionSettings));
+				settings.cameraProjection = cam.GetProjection();
+				settings.cascadeType = pState->cascadeType;
+				settings.cascadeFitType = pState->cascadeFitType;
+				if (!m_bDepthReductionActive || memcmp(&settings, &m_depthReductionSettings, sizeof(DepthReductionSettings)) != 0)
+				{
+					m_depthReduction.Invalidate();
+					memcpy(&m_depthReductionSettings, &settings, sizeof(DepthReductionSettings));
+					m_bDepthReductionActive = true;
+				}
 
+				float minDepth, maxDepth;
+				if (m_depthReduction.Reduce(pCmdLst1, m_frame, &minDepth, &maxDepth))
+				{
+					math::Matrix4 const inverseProjection = math::inverse(cam.GetProjection());
+					math::Vector4 const minView = inverseProjection * math::Vector4(0.0f, 0.0f, minDepth, 1.0f);
+					math::Vector4 const maxView = inverseProjection * math::Vector4(0.0f, 0.0f, maxDepth, 1.0f);
 
-		m_CSMManager.OnCreate(pState->numCascades);
+					// pad the range a bit so the latency doesn't leave geometry outside of the cascades when moving
+					float const minDistance = max(cam.GetNearPlane(), -minView.getZ() / minView.getW() * 0.9f);
+					float const maxDistance = -maxView.getZ() / maxView.getW() * 1.1f;
 
-		m_CSMManager.SetupCascades(cam.GetProjection(), cam.GetView(),
-			directionalLightptr->mLightView, cam.GetNearPlane(), m_pGLTFTexturesAndBuffers->m_pGLTFCommon, pState->numCascades,
-			pState->cascadeSplitPoint, pState->cascadeType, static_cast<float>(m_shadowMap.GetWidth()),
-			pState->bMoveLightTexelSize);
+					CSMManager::ComputeDepthPartitions(minDistance, maxDistance, pState->numCascades, pState->cascadePartitionLogWeight, m_cascadePartitions);
+					bHasDepthPartitions = true;
+				}
+				TimeStamp(pCmdLst1, "Depth reduction");
+			}
+			else
+			{
+				m_bDepthReductionActive = false;
+			}
 
-		// Scene MUST HAVE directional light
-		assert(directionalLightptr != nullptr);
+			for (int l = 0; l < numShadowedLights; ++l)
+			{
+				LightShadows& light = m_lightShadows[l];
+				Light const* pLight = shadowedLights[l];
+
+				// Cascades are only re-rendered on their own schedule, unless anything they depend on changed.
+				// The settings are compared with memcmp, so the padding is cleared too.
+				CascadeSettings settings;
+				memset(&settings, 0, sizeof(CascadeSettings));
+				settings.lightView = pLight->mLightView;
+				memcpy(settings.cascadeSplitPoint, pState->cascadeSplitPoint, sizeof(settings.cascadeSplitPoint));
+				settings.cascadeType = pState->cascadeType;
+				settings.cascadeFitType = pState->cascadeFitType;
+				settings.bMoveLightTexelSize = pState->bMoveLightTexelSize;
+				// switching between the static and the sample distribution partitions moves every split
+				settings.bSampleDistributionCascades = bHasDepthPartitions;
+
+				bool const bForceUpdate = m_bForceCascadeUpdate || memcmp(&settings, &light.cascadeSettings, sizeof(CascadeSettings)) != 0;
+				memcpy(&light.cascadeSettings, &settings, sizeof(CascadeSettings));
+				if (bForceUpdate)
+				{
+					light.cascadeValidMask = 0;
+				}
 
-		std::vector<math::Matrix4> matShadowProj = m_CSMManager.GetShadowProj();
+				// a cascade that wasn't rendered since its contents were invalidated can't wait for its turn
+				uint32_t const allCascadesMask = (1u << pState->numCascades) - 1;
+				uint32_t const cascadeUpdateMask = light.csmManager.ScheduleCascadeUpdates(m_frame, pState->numCascades, pState->cascadeUpdateInterval, bForceUpdate)
+					| (allCascadesMask & ~light.cascadeValidMask);
+
+				light.csmManager.SetupCascades(cam.GetProjection(), cam.GetView(), math::Point3(cam.GetPosition().getXYZ()),
+					pLight->mLightView, cam.GetNearPlane(), m_pGLTFTexturesAndBuffers->m_pGLTFCommon, pState->numCascades,
+					pState->cascadeSplitPoint, pState->cascadeType, pState->cascadeFitType, static_cast<float>(m_shadowMap.GetWidth()),
+					pState->bMoveLightTexelSize, bHasDepthPartitions ? m_cascadePartitions : nullptr, cascadeUpdateMask);
+
+				// the receiver volumes for the dynamic casters, the projection volumes for the cached static ones
+				static_assert(2 * CSMManager::MaxCascades <= ShadowCasterCulling::MaxVolumes, "Not enough cull volumes for the cascades");
+				light.casterCulling.Cull(m_pGLTFTexturesAndBuffers->m_pGLTFCommon, pLight->mLightView,
+					light.csmManager.GetCasterCullVolumes().data(), 2 * pState->numCascades);
+
+				std::vector<math::Matrix4> const& matShadowProj = light.csmManager.GetShadowProj();
+
+				for (int i = 0; i < pState->numCascades; ++i)
+				{
+					if ((cascadeUpdateMask & (1u << i)) == 0) continue;
+
+					int const slice = l * pState->numCascades + i;
+
+					// Skipped cascades are cleared rather than left with stale contents, they stay invalid
+					// so they are rendered as soon as they aren't skipped anymore.
+					if (pState->cascadeSkipIndexes[i])
+					{
+						pCmdLst1->ClearDepthStencilView(m_ShadowMapDSV.GetCPU(slice + 1), D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+						light.cascadeValidMask &= ~(1u << i);
+						continue;
+					}
+
+					pCmdLst1->RSSetViewports(1, &m_shadowViewport);
+					pCmdLst1->RSSetScissorRects(1, &m_shadowRectScissor);
+
+					GltfDepthPass::per_frame* cbDepthPerFrame = m_gltfDepth->SetPerFrameConstants(i + 1);
+
+					cbDepthPerFrame->mViewProj = matShadowProj[i] * pLight->mLightView;
+
+					char const* pass = k_cascadePassNames[l][i];
+					UserMarker marker(pCmdLst1, pass);
+
+					if (pState->bCacheStaticShadowCasters)
+					{
+						DrawCachedShadowCasters(pCmdLst1, l, i, pState->numCascades, slice, cbDepthPerFrame->mViewProj);
+					}
+					else
+					{
+						pCmdLst1->ClearDepthStencilView(m_ShadowMapDSV.GetCPU(slice + 1), D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+						pCmdLst1->OMSetRenderTargets(0, nullptr, false, &m_ShadowMapDSV.GetCPU(slice + 1));
+						DrawShadowCasters(pCmdLst1, l, i, i, ShadowCasterCulling::CasterFilter::All);
+					}
+
+					light.cascadeValidMask |= 1u << i;
+					TimeStamp(pCmdLst1, pass);
+				}
+			}
+			m_bForceCascadeUpdate = false;
 
-		for (int i = 0; i < pState->numCascades; ++i)
+			pCmdLst1->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_shadowMap.GetResource(), D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_DEPTH_READ));
+		}
+		else
 		{
-			if (pState->cascadeSkipIndexes[i]) continue;
-
-			pCmdLst1->OMSetRenderTargets(0, nullptr, false, &m_ShadowMapDSV.GetCPU(i + 1));
-			pCmdLst1->RSSetViewports(1, &m_shadowViewport);
-			pCmdLst1->RSSetScissorRects(1, &m_shadowRectScissor);
+			// the cascades are not kept up to date while nothing uses them
+			m_bForceCascadeUpdate = true;
+			m_bDepthReductionActive = false;
+		}
 
-			GltfDepthPass::per_frame* cbDepthPerFrame = m_gltfDepth->SetPerFrameConstants(i + 1);
 
-			cbDepthPerFrame->mViewProj = matShadowProj[i] * directionalLightptr->mLightView;
+		// Shadow resolve ---------------------------------------------------------------------------
+		//
+		if (m_gltfDepth && pPerFrame != NULL && bNeedShadowResolve)
+		{
+			Texture& lightMasks = m_shadowMaskCombine.GetLightMasks();
+			const D3D12_RESOURCE_BARRIER preShadowResolve[] =
+			{
+				CD3DX12_RESOURCE_BARRIER::Transition(lightMasks.GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+			};
+			pCmdLst1->ResourceBarrier(ARRAYSIZE(preShadowResolve), preShadowResolve);
+
+			CustomShadowResolveFrame shadowResolveFrame;
+			shadowResolveFrame.m_Width = m_Width;
+			shadowResolveFrame.m_Height = m_Height;
+			shadowResolveFrame.m_ShadowMapSRV = m_ShadowMapSRV;
+			shadowResolveFrame.m_DepthBufferSRV = m_GBuffer.m_DepthBufferSRV;
+			shadowResolveFrame.m_ShadowBufferUAV = m_shadowMaskCombine.GetLightMasksUAV();
+
+			// every light writes its own slice of the light masks
+			for (int l = 0; l < numShadowedLights; ++l)
+			{
+				Light const* pLight = shadowedLights[l];
+
+				CustomShadowResolvePass::per_frame* cbShadowResolvePerFrame = m_customShadowResolve.SetPerFrameConstants();
+				cbShadowResolvePerFrame->m_mInverseCameraCurrViewProj = pPerFrame->mInverseCameraCurrViewProj;
+				cbShadowResolvePerFrame->m_mLightView = pLight->mLightView;
+				cbShadowResolvePerFrame->m_fCascadeBlendArea = pState->blurBetweenCascadesAmount;
+				cbShadowResolvePerFrame->m_fShadowBiasFromGUI = pState->pcfOffset;
+				cbShadowResolvePerFrame->m_nTextureSizeX = m_Width;
+				cbShadowResolvePerFrame->m_nTextureSizeY = m_Height;
+				math::Matrix4 matTextureScale = math::Matrix4::scale(math::Vector3(0.5f, -0.5f, 1.0f));
+				math::Matrix4 matTextureTranslation = math::Matrix4::translation(math::Vector3(.5f, .5f, 0.f));
+				std::vector<math::Matrix4> const& matShadowProj = m_lightShadows[l].csmManager.GetShadowProj();
+				for (int shadowMapCascadeIndex = 0; shadowMapCascadeIndex < pState->numCascades; ++shadowMapCascadeIndex)
+				{
+					math::Matrix4 mShadowTexture = matTextureTranslation * matTextureScale * matShadowProj[shadowMapCascadeIndex];
+					cbShadowResolvePerFrame->m_vCascadeScale[shadowMapCascadeIndex] =
+						math::Vector4(mShadowTexture.getCol0().getX(), mShadowTexture.getCol1().getY(), mShadowTexture.getCol2().getZ(), 1.0f);
+					cbShadowResolvePerFrame->m_vCascadeOffset[shadowMapCascadeIndex] =
+						math::Vector4(mShadowTexture.getCol3().getX(), mShadowTexture.getCol3().getY(), mShadowTexture.getCol3().getZ(), 0.0f);
+				}
 
-			std::string pass = "Shadow Cascade Pass" + std::to_string(i);
-			UserMarker marker(pCmdLst1, pass.c_str());
+				cbShadowResolvePerFrame->m_fMaxBorderPadding = ((float)pState->shadowMapWidth - 1.0f) /
+					(float)pState->shadowMapWidth;
+				cbShadowResolvePerFrame->m_fMinBorderPadding = 1.0f /
+					(float)pState->shadowMapWidth;
+				cbShadowResolvePerFrame->m_nCascadeLevels = pState->numCascades;
+				cbShadowResolvePerFrame->m_fSunSize = tanf(0.5f * pState->sunSizeAngle);
+				cbShadowResolvePerFrame->m_fLightDir[0] = -pLight->direction[0];
+				cbShadowResolvePerFrame->m_fLightDir[1] = -pLight->direction[1];
+				cbShadowResolvePerFrame->m_fLightDir[2] = -pLight->direction[2];
+				cbShadowResolvePerFrame->m_nCascadeSliceOffset = l * pState->numCascades;
+				cbShadowResolvePerFrame->m_nOutputSlice = l;
+
+				m_customShadowResolve.Draw(pCmdLst1, m_pGLTFTexturesAndBuffers, &shadowResolveFrame, 0);
+			}
 
-			m_gltfDepth->Draw(pCmdLst1, i + 1);
 
-			m_GPUTimer.GetTimeStamp(pCmdLst1, pass.c_str());
+			const D3D12_RESOURCE_BARRIER postShadowResolve[] =
+			{
+				CD3DX12_RESOURCE_BARRIER::Transition(lightMasks.GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
+			};
+			pCmdLst1->ResourceBarrier(ARRAYSIZE(postShadowResolve), postShadowResolve);
+			TimeStamp(pCmdLst1, "Shadow resolve");
 		}
-		pCmdLst1->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_shadowMap.GetResource(), D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_DEPTH_READ));
-	}
-
 
-	// Shadow resolve ---------------------------------------------------------------------------
-	//
-	if (m_gltfDepth && pPerFrame != NULL && bNeedShadowResolve)
-	{
-		const D3D12_RESOURCE_BARRIER preShadowResolve[] =
+		// raytracing
+		if (pPerFrame != NULL && m_gltfDepth && bNeedRt)
 		{
-			CD3DX12_RESOURCE_BARRIER::Transition(m_ShadowMask.GetResource(), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
-		};
-		pCmdLst1->ResourceBarrier(ARRAYSIZE(preShadowResolve), preShadowResolve);
-
-		CustomShadowResolveFrame shadowResolveFrame;
-		shadowResolveFrame.m_Width = m_Width;
-		shadowResolveFrame.m_Height = m_Height;
-		shadowResolveFrame.m_ShadowMapSRV = m_ShadowMapSRV;
-		shadowResolveFrame.m_DepthBufferSRV = m_GBuffer.m_DepthBufferSRV;
-		shadowResolveFrame.m_ShadowBufferUAV = m_ShadowMaskUAV;
-
-		CustomShadowResolvePass::per_frame* cbShadowResolvePerFrame = m_customShadowResolve.SetPerFrameConstants();
-		cbShadowResolvePerFrame->m_mInverseCameraCurrViewProj = pPerFrame->mInverseCameraCurrViewProj;
-		cbShadowResolvePerFrame->m_mLightView = directionalLightptr->mLightView;
-		cbShadowResolvePerFrame->m_fCascadeBlendArea = pState->blurBetweenCascadesAmount;
-		cbShadowResolvePerFrame->m_fShadowBiasFromGUI = pState->pcfOffset;
-		cbShadowResolvePerFrame->m_nTextureSizeX = m_Width;
-		cbShadowResolvePerFrame->m_nTextureSizeY = m_Height;
-		math::Matrix4 matTextureScale = math::Matrix4::scale(math::Vector3(0.5f, -0.5f, 1.0f));
-		math::Matrix4 matTextureTranslation = math::Matrix4::translation(math::Vector3(.5f, .5f, 0.f));
-		std::vector<math::Matrix4> matShadowProj = m_CSMManager.GetShadowProj();
-		for (int shadowMapCascadeIndex = 0; shadowMapCascadeIndex < pState->numCascades; ++shadowMapCascadeIndex)
-		{
-			math::Matrix4 mShadowTexture = matTextureTranslation * matTextureScale * matShadowProj[shadowMapCascadeIndex];
-			cbShadowResolvePerFrame->m_vCascadeScale[shadowMapCascadeIndex] =
-				math::Vector4(mShadowTexture.getCol0().getX(), mShadowTexture.getCol1().getY(), mShadowTexture.getCol2().getZ(), 1.0f);
-			cbShadowResolvePerFrame->m_vCascadeOffset[shadowMapCascadeIndex] =
-				math::Vector4(mShadowTexture.getCol3().getX(), mShadowTexture.getCol3().getY(), mShadowTexture.getCol3().getZ(), 0.0f);
-		}
-
-		cbShadowResolvePerFrame->m_fMaxBorderPadding = ((float)pState->shadowMapWidth - 1.0f) /
-			(float)pState->shadowMapWidth;
-		cbShadowResolvePerFrame->m_fMinBorderPadding = 1.0f /
-			(float)pState->shadowMapWidth;
-		cbShadowResolvePerFrame->m_nCascadeLevels = pState->numCascades;
-		cbShadowResolvePerFrame->m_fSunSize = tanf(0.5f * pState->sunSizeAngle);
-		cbShadowResolvePerFrame->m_fLightDir[0] = -directionalLightptr->direction[0];
-		cbShadowResolvePerFrame->m_fLightDir[1] = -directionalLightptr->direction[1];
-		cbShadowResolvePerFrame->m_fLightDir[2] = -directionalLightptr->direction[2];
+			Raytracing::TraceMethod method = Raytracing::TraceMethod::ForceOpaque;
+			bool bGatherNonOpaque = false;
+			switch (pState->amMode)
+			{
+			case RtAlphaMaskMode::SkipMaskedObjs:
+				method = Raytracing::TraceMethod::ForceOpaque;
+				break;
+			case RtAlphaMaskMode::ForceMasksOff:
+				method = Raytracing::TraceMethod::ForceOpaque;
+				bGatherNonOpaque = true;
+				break;
+			case RtAlphaMaskMode::Mixed:
+				method = Raytracing::TraceMethod::MixedTlas;
+				bGatherNonOpaque = true;
+				break;
+			default:
+				break;
+			}
 
-		m_customShadowResolve.Draw(pCmdLst1, m_pGLTFTexturesAndBuffers, &shadowResolveFrame, 0);
+			bool const bSplitTlas = method == Raytracing::TraceMethod::SplitTlas;
 
+			m_asFactory.UpdateSkinnedBLAS(pCmdLst1, m_pGLTFTexturesAndBuffers, m_scratchBuffer, pState->skinnedBLASRebuildInterval);
+			TimeStamp(pCmdLst1, "Skinned BLAS update");
 
-		const D3D12_RESOURCE_BARRIER postShadowResolve[] =
-		{
-			CD3DX12_RESOURCE_BARRIER::Transition(m_ShadowMask.GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE),
-		};
-		pCmdLst1->ResourceBarrier(ARRAYSIZE(postShadowResolve), postShadowResolve);
-		m_GPUTimer.GetTimeStamp(pCmdLst1, "Shadow resolve");
-	}
+			// the TLASes persist between frames, they are only refit when just the transforms changed
+			// and not built at all when nothing did
+			Raytracing::TLAS& tlas0 = m_tlas[0];
+			Raytracing::TLAS& tlas1 = m_tlas[1];
+			// Only the nodes that can shadow something on screen for one of the lights are gathered, those
+			// overlap the view frustum clipped to the scene once it's extruded towards the light
+			std::vector<uint8_t> const* pTlasNodeMask = nullptr;
+			if (pState->bCullTLASInstances)
+			{
+				GLTFCommon* pC = m_pGLTFTexturesAndBuffers->m_pGLTFCommon;
+				m_tlasNodeMask.assign(pC->m_nodes.size(), 0);
+				for (int l = 0; l < numShadowedLights; ++l)
+				{
+					LightShadows& light = m_lightShadows[l];
+					Light const* pLight = shadowedLights[l];
+
+					CasterCullVolume receivers;
+					light.csmManager.ComputeReceiverVolume(cam.GetProjection(), cam.GetView(), pLight->mLightView, cam.GetNearPlane(),
+						tanf(0.5f * pState->sunSizeAngle), pC, &receivers);
+					light.receiverCulling.Cull(pC, pLight->mLightView, &receivers, 1);
+
+					std::vector<uint8_t> const& masks = light.receiverCulling.GetNodeMasks();
+					for (size_t i = 0; i < masks.size(); ++i)
+					{
+						m_tlasNodeMask[i] |= masks[i];
+					}
+				}
+				pTlasNodeMask = &m_tlasNodeMask;
+			}
 
-	// raytracing
-	if (pPerFrame != NULL && m_gltfDepth && bNeedRt)
-	{
-		Raytracing::TraceMethod method = Raytracing::TraceMethod::ForceOpaque;
-		bool bGatherNonOpaque = false;
-		switch (pState->amMode)
-		{
-		case RtAlphaMaskMode::SkipMaskedObjs:
-			method = Raytracing::TraceMethod::ForceOpaque;
-			break;
-		case RtAlphaMaskMode::ForceMasksOff:
-			method = Raytracing::TraceMethod::ForceOpaque;
-			bGatherNonOpaque = true;
-			break;
-		case RtAlphaMaskMode::Mixed:
-			method = Raytracing::TraceMethod::MixedTlas;
-			bGatherNonOpaque = true;
-			break;
-		default:
-			break;
-		}
+			// the non opaque TLAS is only traced separately by the split method
+			m_asFactory.BuildTLASFromGLTF(m_pDevice, m_pGLTFTexturesAndBuffers, bGatherNonOpaque, tlas0, bSplitTlas ? &tlas1 : nullptr, pTlasNodeMask);
 
-		m_asFactory.ResetTLAS();
-		Raytracing::TLAS tlas0 = m_asFactory.BuildTLASFromGLTF(m_pDevice, m_pGLTFTexturesAndBuffers, true, bGatherNonOpaque);
-		Raytracing::TLAS tlas1 = m_asFactory.BuildTLASFromGLTF(m_pDevice, m_pGLTFTexturesAndBuffers, false, true);
-		tlas0.Build(pCmdLst1, m_scratchBuffer, m_ConstantBufferRing);
-		if (method == Raytracing::TraceMethod::SplitTlas)
-		{
-			tlas1.Build(pCmdLst1, m_scratchBuffer, m_ConstantBufferRing);
-		}
-		m_asFactory.SyncTLASBuilds(pCmdLst1);
+			Raytracing::TLAS* pTLAS[] = { &tlas0, &tlas1 };
+			m_asFactory.AllocateTLAS(m_pDevice, pTLAS, _countof(pTLAS));
+			tlas0.Build(pCmdLst1, m_scratchBuffer, m_frame);
+			if (bSplitTlas)
+			{
+				tlas1.Build(pCmdLst1, m_scratchBuffer, m_frame);
+			}
+			m_asFactory.SyncTLASBuilds(pCmdLst1);
 
-		m_GPUTimer.GetTimeStamp(pCmdLst1, "Build TLAS");
+			TimeStamp(pCmdLst1, "Build TLAS");
 
-		Raytracing::TraceControls tc = {};
-		tc.sunSize = tanf(0.5f * pState->sunSizeAngle);
-		tc.noisePhase = (m_frame & 0xff) * GOLDEN_RATIO; // use golden ratio to animiate noise 
-		tc.bRejectLitPixels = pState->bRejectLitPixels;
-		// only vaild for hybrid mode
-		tc.bUseCascadesForRayT = pState->bUseCascadesForRayT && (pState->hMode == RtHybridMode::HybridRaytracing);
+			Raytracing::TraceControls tc = {};
+			tc.sunSize = tanf(0.5f * pState->sunSizeAngle);
+			tc.noisePhase = (m_frame & 0xff) * GOLDEN_RATIO; // use golden ratio to animiate noise 
+			tc.bRejectLitPixels = pState->bRejectLitPixels;
+			// only vaild for hybrid mode
+			tc.bUseCascadesForRayT = pState->bUseCascadesForRayT && (pState->hMode == RtHybridMode::HybridRaytracing);
 
-		tc.tileTolerance = pState->tileCutoff;
-		tc.cascadeCount = pState->numCascades;
-		tc.activeCascades = 0x0;
-		for (int i = 0; i < pState->numCascades; ++i)
-		{
-			tc.activeCascades |= pState->cascadeSkipIndexes[i] << i;
-		}
-		tc.cascadePixelSize = 1.f / pState->shadowMapWidth;
-		tc.cascadeSize = static_cast<float>(pState->shadowMapWidth);
-		tc.blockerOffset = pState->pcfOffset;
-
-		tc.lightView = directionalLightptr->mLightView;
-		math::Matrix4 const matTextureScale = math::Matrix4::scale(math::Vector3(0.5f, -0.5f, 1.0f));
-		math::Matrix4 const matTextureTranslation = math::Matrix4::translation(math::Vector3(.5f, .5f, 0.f));
-		std::vector<math::Matrix4> const matShadowProj = m_CSMManager.GetShadowProj();
-		const std::vector<float> cascadePartitionsFrustum = m_CSMManager.GetCascadePartitionsFrustum();
-		for (int index = 0; index < pState->numCascades; ++index)
-		{
-			math::Matrix4 mShadowTexture = matTextureTranslation * matTextureScale * matShadowProj[index];
-			tc.cascadeScale[index] =
-				math::Vector4(mShadowTexture.getCol0().getX(), mShadowTexture.getCol1().getY(), mShadowTexture.getCol2().getZ(), 1.0f);
-			tc.cascadeOffset[index] =
-				math::Vector4(mShadowTexture.getCol3().getX(), mShadowTexture.getCol3().getY(), mShadowTexture.getCol3().getZ(), 0.0f);
-		}
-		D3D12_GPU_VIRTUAL_ADDRESS tcAddress = m_shadowTrace.BuildTraceControls(m_ConstantBufferRing, *directionalLightptr, pPerFrame->mInverseCameraCurrViewProj, tc);
+			tc.tileTolerance = pState->tileCutoff;
+			tc.cascadeCount = pState->numCascades;
+			tc.activeCascades = 0x0;
+			for (int i = 0; i < pState->numCascades; ++i)
+			{
+				tc.activeCascades |= pState->cascadeSkipIndexes[i] << i;
+			}
+			tc.cascadePixelSize = 1.f / pState->shadowMapWidth;
+			tc.cascadeSize = static_cast<float>(pState->shadowMapWidth);
+			tc.blockerOffset = pState->pcfOffset;
+
+			// Every light gets its own tile list from the one classification, the trace is dispatched
+			// indirectly from those so each light only costs the tiles it needs rays for.
+			math::Matrix4 const matTextureScale = math::Matrix4::scale(math::Vector3(0.5f, -0.5f, 1.0f));
+			math::Matrix4 const matTextureTranslation = math::Matrix4::translation(math::Vector3(.5f, .5f, 0.f));
+			for (int l = 0; l < numShadowedLights; ++l)
+			{
+				Raytracing::LightControls& lc = tc.lights[l];
+				lc.lightView = shadowedLights[l]->mLightView;
+				lc.cascadeSliceOffset = l * pState->numCascades;
+				std::vector<math::Matrix4> const& matShadowProj = m_lightShadows[l].csmManager.GetShadowProj();
+				for (int index = 0; index < pState->numCascades; ++index)
+				{
+					math::Matrix4 mShadowTexture = matTextureTranslation * matTextureScale * matShadowProj[index];
+					lc.cascadeScale[index] =
+						math::Vector4(mShadowTexture.getCol0().getX(), mShadowTexture.getCol1().getY(), mShadowTexture.getCol2().getZ(), 1.0f);
+					lc.cascadeOffset[index] =
+						math::Vector4(mShadowTexture.getCol3().getX(), mShadowTexture.getCol3().getY(), mShadowTexture.getCol3().getZ(), 0.0f);
+				}
+			}
+			D3D12_GPU_VIRTUAL_ADDRESS tcAddress = m_shadowTrace.BuildTraceControls(m_ConstantBufferRing, shadowedLights, numShadowedLights, pPerFrame->mInverseCameraCurrViewProj, tc);
 
-		m_shadowTrace.Classify(pCmdLst1, classifyMethod, tcAddress);
+			m_shadowTrace.Classify(pCmdLst1, classifyMethod, tcAddress, numShadowedLights);
 
-		m_GPUTimer.GetTimeStamp(pCmdLst1, "Classify tiles");
+			TimeStamp(pCmdLst1, "Classify tiles");
 
-		m_shadowTrace.Trace(pCmdLst1, tlas0, tlas1, m_asFactory.GetMaskTextureTable(), method, tcAddress);
+			// tlas1 isn't gathered unless it is traced, the slot still needs a valid structure
+			m_shadowTrace.Trace(pCmdLst1, tlas0, bSplitTlas ? tlas1 : tlas0, m_asFactory.GetMaskTextureTable(), method, tcAddress, numShadowedLights);
 
-		m_GPUTimer.GetTimeStamp(pCmdLst1, "Trace shadows");
+			TimeStamp(pCmdLst1, "Trace shadows");
 
-		const D3D12_RESOURCE_BARRIER preShadowResolve[] =
-		{
-			CD3DX12_RESOURCE_BARRIER::Transition(m_ShadowMask.GetResource(), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
-		};
-		pCmdLst1->ResourceBarrier(ARRAYSIZE(preShadowResolve), preShadowResolve);
+			Texture& lightMasks = m_shadowMaskCombine.GetLightMasks();
+			const D3D12_RESOURCE_BARRIER preShadowResolve[] =
+			{
+				CD3DX12_RESOURCE_BARRIER::Transition(lightMasks.GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+			};
+			pCmdLst1->ResourceBarrier(ARRAYSIZE(preShadowResolve), preShadowResolve);
 
-		if (pState->bUseDenoiser)
-		{
-			m_shadowTrace.DenoiseHitsToShadowMask(pCmdLst1, m_ConstantBufferRing, cam, m_ShadowMaskUAV, &m_GPUTimer);
-		}
-		else
-		{
-			if (classifyMethod == Raytracing::ClassifyMethod::ByCascadeRange)
+			if (pState->bUseDenoiser)
 			{
-				m_shadowTrace.BlendHitsToShadowMask(pCmdLst1, m_ShadowMaskUAV);
+				m_shadowTrace.DenoiseHitsToShadowMask(pCmdLst1, m_ConstantBufferRing, cam, m_shadowMaskCombine.GetLightMasksUAV(), numShadowedLights, &m_GPUTimer);
 			}
 			else
 			{
-				m_shadowTrace.ResolveHitsToShadowMask(pCmdLst1, m_ShadowMaskUAV);
+				if (classifyMethod == Raytracing::ClassifyMethod::ByCascadeRange)
+				{
+					m_shadowTrace.BlendHitsToShadowMask(pCmdLst1, m_shadowMaskCombine.GetLightMasksUAV(), numShadowedLights);
+				}
+				else
+				{
+					m_shadowTrace.ResolveHitsToShadowMask(pCmdLst1, m_shadowMaskCombine.GetLightMasksUAV(), numShadowedLights);
+				}
+				TimeStamp(pCmdLst1, "Resolve ray hits");
 			}
-			m_GPUTimer.GetTimeStamp(pCmdLst1, "Resolve ray hits");
+
+			const D3D12_RESOURCE_BARRIER postShadowResolve[] =
+			{
+				CD3DX12_RESOURCE_BARRIER::Transition(lightMasks.GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
+			};
+			pCmdLst1->ResourceBarrier(ARRAYSIZE(postShadowResolve), postShadowResolve);
 		}
+	}
+
+	// the lighting samples one channel per light
+	if (pPerFrame != NULL && m_gltfDepth && (bNeedShadowResolve || bNeedRt))
+	{
+		const D3D12_RESOURCE_BARRIER preCombine[] =
+		{
+			CD3DX12_RESOURCE_BARRIER::Transition(m_ShadowMask.GetResource(), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+		};
+		pCmdLst1->ResourceBarrier(ARRAYSIZE(preCombine), preCombine);
+
+		m_shadowMaskCombine.Combine(pCmdLst1, numShadowedLights);
 
-		const D3D12_RESOURCE_BARRIER postShadowResolve[] =
+		const D3D12_RESOURCE_BARRIER postCombine[] =
 		{
 			CD3DX12_RESOURCE_BARRIER::Transition(m_ShadowMask.GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE),
 		};
-		pCmdLst1->ResourceBarrier(ARRAYSIZE(postShadowResolve), postShadowResolve);
+		pCmdLst1->ResourceBarrier(ARRAYSIZE(postCombine), postCombine);
+		m_GPUTimer.GetTimeStamp(pCmdLst1, "Combine shadow masks");
 	}
 
 	{
@@ -785,7 +1131,11 @@ void Renderer::OnRender(const UIState* pState, const Camera& cam, SwapChain* pSw
 		{
 			const bool bWireframe = pState->WireframeMode != UIState::WireframeMode::WIREFRAME_MODE_OFF;
 
-			std::vector<GltfPbrPass::BatchList> opaque, transparent;
+			// the batch lists are kept between frames so they don't have to grow again every frame
+			std::vector<GltfPbrPass::BatchList>& opaque = m_opaqueBatchList;
+			std::vector<GltfPbrPass::BatchList>& transparent = m_transparentBatchList;
+			opaque.clear();
+			transparent.clear();
 			m_gltfPBR->BuildBatchLists(&opaque, &transparent, bWireframe);
 
 			{
@@ -923,7 +1273,7 @@ void Renderer::OnRender(const UIState* pState, const Camera& cam, SwapChain* pSw
 		}
 		else if (pState->debugMode == 1)
 		{
-			m_shadowTrace.ResolveHitsToShadowMask(pCmdLst1, m_GBuffer.m_HDRUAV);
+			m_shadowTrace.DebugRayHits(pCmdLst1, m_GBuffer.m_HDRUAV);
 		}
 
 		D3D12_RESOURCE_BARRIER postDebug[] = {
@@ -1060,21 +1410,42 @@ void Renderer::OnRender(const UIState* pState, const Camera& cam, SwapChain* pSw
 //--------------------------------------------------------------------------------------
 void Renderer::OnResizeShadowMapWidth(const UIState* pState)
 {
+	// The cascades of all the shadowed lights share one array, light i owns slices [i * numCascades, (i + 1) * numCascades)
+	m_numShadowedLights = max(1, min(pState->numShadowedLights, MaxShadowedLights));
+	int const numSlices = pState->numCascades * m_numShadowedLights;
+
 	m_shadowMap.OnDestroy();
 
-	m_shadowMap.InitDepthStencil(m_pDevice, "m_pShadowMap", &CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_D16_UNORM, pState->shadowMapWidth, pState->shadowMapWidth, pState->numCascades, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL));
-	m_shadowMap.CreateDSV(0, &m_ShadowMapDSV, 0, pState->numCascades);
-	for (int i = 0; i < pState->numCascades; ++i)
+	m_shadowMap.InitDepthStencil(m_pDevice, "m_pShadowMap", &CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_D16_UNORM, pState->shadowMapWidth, pState->shadowMapWidth, numSlices, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL));
+	m_shadowMap.CreateDSV(0, &m_ShadowMapDSV, 0, numSlices);
+	for (int i = 0; i < numSlices; ++i)
 	{
 		m_shadowMap.CreateDSV(i + 1, &m_ShadowMapDSV, i);
 	}
 	m_shadowMap.CreateSRV(0, &m_ShadowMapSRV);
 
+	m_staticShadowMap.OnDestroy();
+	m_staticShadowMap.InitDepthStencil(m_pDevice, "m_pStaticShadowMap", &CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_D16_UNORM, pState->shadowMapWidth, pState->shadowMapWidth, numSlices, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL));
+	for (int i = 0; i < numSlices; ++i)
+	{
+		m_staticShadowMap.CreateDSV(i, &m_staticShadowMapDSV, i);
+	}
+
+	for (int l = 0; l < m_numShadowedLights; ++l)
+	{
+		m_lightShadows[l].csmManager.OnCreate(pState->numCascades);
+		memset(m_lightShadows[l].bStaticCascadeValid, 0, sizeof(m_lightShadows[l].bStaticCascadeValid));
+		m_lightShadows[l].cascadeValidMask = 0;
+	}
+	m_bForceCascadeUpdate = true;
+	m_steadyStateFrame = m_frame + ALLOCATION_WARMUP_FRAMES;
+
 
 	// Set viewport and scissor rect for shadow map passes
 	m_shadowViewport = { 0.0f , 0.0f, static_cast<float>(pState->shadowMapWidth), static_cast<float>(pState->shadowMapWidth), 0.0f, 1.0f };
 	m_shadowRectScissor = { 0 , 0, static_cast<LONG>(pState->shadowMapWidth), static_cast<LONG>(pState->shadowMapWidth) };
 
 	m_shadowTrace.BindShadowTexture(m_shadowMap);
+	m_shadowTrace.SetLightCount(m_pDevice, m_numShadowedLights);
 }
 
@@ -46,7 +46,7 @@ public:
 
     void OnUpdateDisplayDependentResources(SwapChain *pSwapChain);
 
-    int LoadScene(GLTFCommon *pGLTFCommon, int stage = 0);
+    int LoadScene(GLTFCommon *pGLTFCommon, const UIState* pState, int stage = 0);
     void UnloadScene();
 
 
@@ -57,7 +57,14 @@ public:
 
     void OnResizeShadowMapWidth(const UIState* pState);
 
+    // Every shadowed directional light writes its own channel of the shadow mask
+    static const int MaxShadowedLights = 4;
+
 private:
+    void TimeStamp(ID3D12GraphicsCommandList* pCommandList, const char* label);
+    void DrawShadowCasters(ID3D12GraphicsCommandList* pCommandList, int lightIndex, int cascadeIndex, int volumeIndex, ShadowCasterCulling::CasterFilter filter);
+    void DrawCachedShadowCasters(ID3D12GraphicsCommandList* pCommandList, int lightIndex, int cascadeIndex, int numCascades, int slice, math::Matrix4 const& viewProj);
+
     Device                         *m_pDevice;
 
     uint32_t                        m_frame;
@@ -116,7 +123,56 @@ private:
     DSV                             m_ShadowMapDSV;
     CBV_SRV_UAV                     m_ShadowMapSRV;
 
-    CSMManager                      m_CSMManager;
+    // static casters only, copied into the shadow map before the dynamic casters are drawn
+    Texture                         m_staticShadowMap;
+    DSV                             m_staticShadowMapDSV;
+
+    DepthReduction                  m_depthReduction;
+    ShadowMaskCombine               m_shadowMaskCombine;
+    float                           m_cascadePartitions[5];
+
+    // settings the depth reductions in flight were made with, they are dropped when these change
+    struct DepthReductionSettings
+    {
+        math::Matrix4               cameraProjection;
+        int                         cascadeType;
+        int                         cascadeFitType;
+    };
+    DepthReductionSettings          m_depthReductionSettings;
+    bool                            m_bDepthReductionActive = false;
+
+    // settings the cascades were last rendered with, any change forces all cascades to update
+    struct CascadeSettings
+    {
+        math::Matrix4               lightView;
+        float                       cascadeSplitPoint[4];
+        int                         cascadeType;
+        int                         cascadeFitType;
+        bool                        bMoveLightTexelSize;
+        bool                        bSampleDistributionCascades;
+    };
+
+    // Cascades of one directional light, each light owns numCascades consecutive slices of the shadow map
+    struct LightShadows
+    {
+        CSMManager                  csmManager;
+        ShadowCasterCulling         casterCulling;
+        ShadowCasterCulling         receiverCulling; // potential occluders of anything visible, for the TLAS
+        CascadeSettings             cascadeSettings;
+        uint32_t                    cascadeValidMask; // cascades whose slice was rendered since the contents were last invalidated
+        math::Matrix4               staticCascadeViewProj[CSMManager::MaxCascades];
+        bool                        bStaticCascadeValid[CSMManager::MaxCascades];
+    };
+    LightShadows                    m_lightShadows[MaxShadowedLights];
+    int                             m_numShadowedLights = 1;
+    bool                            m_bForceCascadeUpdate = true;
+    std::vector<uint8_t>            m_casterNodeMask; // the nodes the depth pass draws into the current cascade
+    std::vector<uint8_t>            m_tlasNodeMask;
+
+    // persistent per frame scratch, the steady state frame shouldn't allocate
+    std::vector<GltfPbrPass::BatchList> m_opaqueBatchList;
+    std::vector<GltfPbrPass::BatchList> m_transparentBatchList;
+    uint32_t                        m_steadyStateFrame = 0;
 
     // widgets
     Wireframe                       m_wireframe;
@@ -131,6 +187,7 @@ private:
 
     Raytracing::ASBuffer m_scratchBuffer;
     Raytracing::ASFactory m_asFactory;
+    Raytracing::TLAS m_tlas[2];
 
     Raytracing::ShadowTrace m_shadowTrace;
 
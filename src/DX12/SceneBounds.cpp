@@ -0,0 +1,121 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+
+#include "SceneBounds.h"
+
+namespace
+{
+    const math::Vector4 g_vEmptyMin = { FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX };
+    const math::Vector4 g_vEmptyMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+    bool IsSameMatrix(math::Matrix4 const& a, math::Matrix4 const& b)
+    {
+        return memcmp(&a, &b, sizeof(math::Matrix4)) == 0;
+    }
+
+    bool IsSameVector(math::Vector4 const& a, math::Vector4 const& b)
+    {
+        return memcmp(&a, &b, sizeof(math::Vector4)) == 0;
+    }
+}
+
+void SceneBounds::ComputeNodeBounds(GLTFCommon const* pC, uint32_t nodeIndex)
+{
+    math::Vector4 vNodeMin = g_vEmptyMin;
+    math::Vector4 vNodeMax = g_vEmptyMax;
+
+    tfNode const* pNode = &pC->m_nodes[nodeIndex];
+    if (pNode->meshIndex >= 0)
+    {
+        tfMesh const* pMesh = &pC->m_meshes[pNode->meshIndex];
+        for (uint32_t p = 0; p < pMesh->m_pPrimitives.size(); p++)
+        {
+            math::Vector4 vBoxMin, vBoxMax;
+            ShadowCasterCulling::TransformBox(m_worldMats[nodeIndex], pMesh->m_pPrimitives[p].m_center, pMesh->m_pPrimitives[p].m_radius, &vBoxMin, &vBoxMax);
+            vNodeMin = math::SSE::minPerElem(vBoxMin, vNodeMin);
+            vNodeMax = math::SSE::maxPerElem(vBoxMax, vNodeMax);
+        }
+    }
+
+    m_treeMin[m_leafOffset + nodeIndex] = vNodeMin;
+    m_treeMax[m_leafOffset + nodeIndex] = vNodeMax;
+}
+
+void SceneBounds::Update(GLTFCommon const* pC)
+{
+    uint32_t nodeCount = static_cast<uint32_t>(pC->m_nodes.size());
+
+    if (!m_bValid || nodeCount != m_worldMats.size())
+    {
+        m_leafOffset = 1;
+        while (m_leafOffset < nodeCount)
+            m_leafOffset <<= 1;
+
+        m_treeMin.assign(2 * m_leafOffset, g_vEmptyMin);
+        m_treeMax.assign(2 * m_leafOffset, g_vEmptyMax);
+
+        m_worldMats.resize(nodeCount);
+        for (uint32_t i = 0; i < nodeCount; i++)
+        {
+            m_worldMats[i] = pC->m_worldSpaceMats[i].GetCurrent();
+            ComputeNodeBounds(pC, i);
+        }
+
+        for (uint32_t i = m_leafOffset - 1; i > 0; i--)
+        {
+            m_treeMin[i] = math::SSE::minPerElem(m_treeMin[2 * i], m_treeMin[2 * i + 1]);
+            m_treeMax[i] = math::SSE::maxPerElem(m_treeMax[2 * i], m_treeMax[2 * i + 1]);
+        }
+
+        m_bValid = true;
+        return;
+    }
+
+    m_dirtyLeaves.clear();
+    for (uint32_t i = 0; i < nodeCount; i++)
+    {
+        if (pC->m_nodes[i].meshIndex < 0)
+            continue;
+
+        math::Matrix4 const& matWorld = pC->m_worldSpaceMats[i].GetCurrent();
+        if (IsSameMatrix(matWorld, m_worldMats[i]))
+            continue;
+
+        m_worldMats[i] = matWorld;
+        ComputeNodeBounds(pC, i);
+        m_dirtyLeaves.push_back(m_leafOffset + i);
+    }
+
+    // Walk up from every dirty leaf, stopping as soon as a parent was already refreshed by a sibling.
+    for (uint32_t leaf : m_dirtyLeaves)
+    {
+        for (uint32_t i = leaf >> 1; i > 0; i >>= 1)
+        {
+            math::Vector4 vMin = math::SSE::minPerElem(m_treeMin[2 * i], m_treeMin[2 * i + 1]);
+            math::Vector4 vMax = math::SSE::maxPerElem(m_treeMax[2 * i], m_treeMax[2 * i + 1]);
+            if (IsSameVector(vMin, m_treeMin[i]) && IsSameVector(vMax, m_treeMax[i]))
+                break;
+
+            m_treeMin[i] = vMin;
+            m_treeMax[i] = vMax;
+        }
+    }
+}
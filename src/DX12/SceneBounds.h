@@ -0,0 +1,55 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+//--------------------------------------------------------------------------------------
+// World space bounds of the scene, cached per node. Only nodes whose world matrix changed
+// since the last update are re-transformed, their boxes are then merged up a binary
+// reduction tree so the scene box costs O(dirty nodes * log(nodes)) per frame.
+//--------------------------------------------------------------------------------------
+class SceneBounds
+{
+public:
+    // Forces a full rebuild on the next update, call it whenever a new scene is loaded.
+    void Invalidate() { m_bValid = false; }
+
+    void Update(GLTFCommon const* pC);
+
+    math::Vector4 GetMin() const { return m_treeMin[1]; }
+    math::Vector4 GetMax() const { return m_treeMax[1]; }
+
+    math::Vector4 GetNodeMin(uint32_t nodeIndex) const { return m_treeMin[m_leafOffset + nodeIndex]; }
+    math::Vector4 GetNodeMax(uint32_t nodeIndex) const { return m_treeMax[m_leafOffset + nodeIndex]; }
+
+    uint32_t GetNodeCount() const { return static_cast<uint32_t>(m_worldMats.size()); }
+
+private:
+    void ComputeNodeBounds(GLTFCommon const* pC, uint32_t nodeIndex);
+
+    bool m_bValid = false;
+
+    // Leaves start at m_leafOffset, node 1 is the root.
+    uint32_t m_leafOffset = 1;
+    std::vector<math::Vector4> m_treeMin = std::vector<math::Vector4>(2);
+    std::vector<math::Vector4> m_treeMax = std::vector<math::Vector4>(2);
+
+    std::vector<math::Matrix4> m_worldMats;
+    std::vector<uint32_t> m_dirtyLeaves;
+};
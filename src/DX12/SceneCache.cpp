@@ -0,0 +1,245 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+
+#include "SceneCache.h"
+
+#include <algorithm>
+
+namespace Raytracing
+{
+	SceneCache::SceneCache(void)
+		: m_file(INVALID_HANDLE_VALUE)
+		, m_mapping(nullptr)
+		, m_pView(nullptr)
+		, m_pSections(nullptr)
+		, m_sectionCount(0)
+		, m_pending()
+	{
+	}
+
+	SceneCache::~SceneCache(void)
+	{
+		Close();
+	}
+
+	uint64_t SceneCache::Hash(void const* pData, size_t size, uint64_t seed)
+	{
+		// FNV-1a over 64 bit words with a final avalanche, fast enough to run over the glTF buffers
+		uint64_t const prime = 0x100000001b3ull;
+		uint64_t hash = (seed ^ 0xcbf29ce484222325ull) * prime;
+
+		uint8_t const* pBytes = reinterpret_cast<uint8_t const*>(pData);
+		size_t i = 0;
+		for (; i + 8 <= size; i += 8)
+		{
+			uint64_t word;
+			memcpy(&word, pBytes + i, sizeof(word));
+			hash = (hash ^ word) * prime;
+			hash ^= hash >> 32;
+		}
+		for (; i < size; ++i)
+		{
+			hash = (hash ^ pBytes[i]) * prime;
+		}
+		hash = (hash ^ size) * prime;
+
+		hash ^= hash >> 33;
+		hash *= 0xff51afd7ed558ccdull;
+		hash ^= hash >> 33;
+		hash *= 0xc4ceb9fe1a85ec53ull;
+		hash ^= hash >> 33;
+		return hash;
+	}
+
+	std::string SceneCache::GetUserCachePath(char const* pScenePath)
+	{
+		char localAppData[MAX_PATH];
+		DWORD const length = GetEnvironmentVariableA("LOCALAPPDATA", localAppData, MAX_PATH);
+		if (length == 0 || length >= MAX_PATH)
+			return std::string();
+
+		std::string directory = std::string(localAppData) + "\\HybridShadows";
+		for (char const* pSubDirectory : { "", "\\SceneCache" })
+		{
+			directory += pSubDirectory;
+			if (!CreateDirectoryA(directory.c_str(), nullptr) && GetLastError() != ERROR_ALREADY_EXISTS)
+				return std::string();
+		}
+
+		// scenes with the same file name in different directories get different caches
+		char fullPath[MAX_PATH];
+		DWORD const fullLength = GetFullPathNameA(pScenePath, MAX_PATH, fullPath, nullptr);
+		std::string const scenePath = (fullLength != 0 && fullLength < MAX_PATH) ? std::string(fullPath) : std::string(pScenePath);
+		uint64_t const pathHash = Hash(scenePath.data(), scenePath.size());
+
+		size_t const separator = scenePath.find_last_of("\\/");
+		std::string const fileName = separator == std::string::npos ? scenePath : scenePath.substr(separator + 1);
+		return directory + "\\" + fileName + format("-%016llx.blascache", pathHash);
+	}
+
+	bool SceneCache::Open(char const* pPath, uint64_t key)
+	{
+		Close();
+
+		m_file = CreateFileA(pPath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (m_file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER fileSize = {};
+		if (GetFileSizeEx(m_file, &fileSize) && (uint64_t)fileSize.QuadPart >= sizeof(Header))
+		{
+			m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (m_mapping)
+			{
+				m_pView = reinterpret_cast<uint8_t const*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+			}
+		}
+
+		bool bValid = m_pView != nullptr;
+		if (bValid)
+		{
+			Header const* pHeader = reinterpret_cast<Header const*>(m_pView);
+			uint64_t const size = (uint64_t)fileSize.QuadPart;
+			bValid = pHeader->magic == Magic && pHeader->version == Version && pHeader->key == key
+				&& pHeader->sectionCount <= (size - sizeof(Header)) / sizeof(Section);
+
+			m_pSections = reinterpret_cast<Section const*>(m_pView + sizeof(Header));
+			m_sectionCount = bValid ? pHeader->sectionCount : 0;
+			for (uint64_t i = 0; i < m_sectionCount && bValid; ++i)
+			{
+				bValid = m_pSections[i].offset <= size && m_pSections[i].size <= size - m_pSections[i].offset;
+			}
+		}
+
+		if (!bValid)
+		{
+			Close();
+		}
+		return bValid;
+	}
+
+	void SceneCache::Close(void)
+	{
+		if (m_pView)
+		{
+			UnmapViewOfFile(m_pView);
+		}
+		if (m_mapping)
+		{
+			CloseHandle(m_mapping);
+		}
+		if (m_file != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(m_file);
+		}
+
+		m_file = INVALID_HANDLE_VALUE;
+		m_mapping = nullptr;
+		m_pView = nullptr;
+		m_pSections = nullptr;
+		m_sectionCount = 0;
+	}
+
+	bool SceneCache::IsOpen(void) const
+	{
+		return m_pView != nullptr;
+	}
+
+	void const* SceneCache::Find(uint64_t id, size_t* pSize) const
+	{
+		Section const* pEnd = m_pSections + m_sectionCount;
+		Section const* pSection = std::lower_bound(m_pSections, pEnd, id, [](Section const& section, uint64_t id) { return section.id < id; });
+		if (pSection == pEnd || pSection->id != id)
+		{
+			*pSize = 0;
+			return nullptr;
+		}
+
+		*pSize = (size_t)pSection->size;
+		return m_pView + pSection->offset;
+	}
+
+	void SceneCache::Add(uint64_t id, void const* pData, size_t size)
+	{
+		std::vector<uint8_t> data(reinterpret_cast<uint8_t const*>(pData), reinterpret_cast<uint8_t const*>(pData) + size);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pending.emplace_back(id, std::move(data));
+	}
+
+	bool SceneCache::Save(char const* pPath, uint64_t key)
+	{
+		std::vector<std::pair<uint64_t, std::vector<uint8_t>>> pending;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			pending.swap(m_pending);
+		}
+		std::sort(pending.begin(), pending.end(), [](auto const& a, auto const& b) { return a.first < b.first; });
+
+		Header header = {};
+		header.magic = Magic;
+		header.version = Version;
+		header.key = key;
+		header.sectionCount = pending.size();
+
+		std::vector<Section> sections(pending.size());
+		uint64_t offset = sizeof(Header) + sizeof(Section) * sections.size();
+		for (size_t i = 0; i < pending.size(); ++i)
+		{
+			offset = (offset + SectionAlignment - 1) & ~(SectionAlignment - 1);
+			sections[i] = { pending[i].first, offset, pending[i].second.size() };
+			offset += pending[i].second.size();
+		}
+
+		// the mapping of the file that gets replaced has to be gone
+		Close();
+
+		std::string const tempPath = std::string(pPath) + ".tmp";
+		{
+			std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+			if (!file.is_open())
+			{
+				return false;
+			}
+
+			file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+			file.write(reinterpret_cast<char const*>(sections.data()), sizeof(Section) * sections.size());
+
+			char const padding[SectionAlignment] = {};
+			uint64_t position = sizeof(Header) + sizeof(Section) * sections.size();
+			for (size_t i = 0; i < pending.size(); ++i)
+			{
+				file.write(padding, (std::streamsize)(sections[i].offset - position));
+				file.write(reinterpret_cast<char const*>(pending[i].second.data()), (std::streamsize)pending[i].second.size());
+				position = sections[i].offset + sections[i].size;
+			}
+
+			if (!file)
+			{
+				file.close();
+				DeleteFileA(tempPath.c_str());
+				return false;
+			}
+		}
+
+		return MoveFileExA(tempPath.c_str(), pPath, MOVEFILE_REPLACE_EXISTING) != 0;
+	}
+}
@@ -0,0 +1,106 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#pragma once
+
+namespace Raytracing
+{
+	// Binary cache of the data the structures are prepared from, so a scene that didn't change
+	// doesn't redo the work on every load. The file is a table of sections, blobs with a 64 bit id,
+	// and it is memory mapped, the sections are read in place. It carries a version and the key of
+	// the inputs it was made from, a file whose version or key doesn't match is ignored and
+	// replaced on the next Save.
+	class SceneCache
+	{
+	public:
+		// bumped whenever the layout of the file or of the cached data changes
+		static const uint32_t Version = 3;
+
+		SceneCache(void);
+		~SceneCache(void);
+
+		// 64 bit hash of a blob, chained through seed to key several of them
+		static uint64_t Hash(void const* pData, size_t size, uint64_t seed = 0);
+
+		// Path of the cache of a scene in the user's local app data, the directory is created if
+		// needed. Empty when there is no such directory.
+		static std::string GetUserCachePath(char const* pScenePath);
+
+		// Maps the file, it only stays open when its version and key match
+		bool Open(char const* pPath, uint64_t key);
+		void Close(void);
+		bool IsOpen(void) const;
+
+		// Points into the mapping, nullptr when there is no such section
+		void const* Find(uint64_t id, size_t* pSize) const;
+		// copies a section out, empty when it's missing
+		template <typename T>
+		void Read(uint64_t id, std::vector<T>& data) const
+		{
+			size_t size = 0;
+			void const* pSection = Find(id, &size);
+			data.resize(pSection ? size / sizeof(T) : 0);
+			if (!data.empty())
+			{
+				memcpy(data.data(), pSection, data.size() * sizeof(T));
+			}
+		}
+
+		// Collects a section for Save, can be called from several threads
+		void Add(uint64_t id, void const* pData, size_t size);
+		template <typename T>
+		void Add(uint64_t id, std::vector<T> const& data)
+		{
+			Add(id, data.data(), data.size() * sizeof(T));
+		}
+
+		// Writes the collected sections and forgets them. The file is written next to pPath and
+		// then moved over it, so a load never maps a partly written cache. Returns false if the
+		// file can't be created or written.
+		bool Save(char const* pPath, uint64_t key);
+
+	private:
+		static const uint32_t Magic = 0x43534248; // "HBSC"
+		static const uint64_t SectionAlignment = 16;
+
+		struct Header
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint64_t key;
+			uint64_t sectionCount;
+		};
+
+		// sorted by id, the offsets are from the start of the file
+		struct Section
+		{
+			uint64_t id;
+			uint64_t offset;
+			uint64_t size;
+		};
+
+		HANDLE m_file;
+		HANDLE m_mapping;
+		uint8_t const* m_pView;
+		Section const* m_pSections;
+		uint64_t m_sectionCount;
+
+		std::mutex m_mutex;
+		std::vector<std::pair<uint64_t, std::vector<uint8_t>>> m_pending;
+	};
+}
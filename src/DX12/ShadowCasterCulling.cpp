@@ -0,0 +1,150 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+
+#include "ShadowCasterCulling.h"
+
+uint32_t ShadowCasterCulling::CullBox(math::Vector4 const& vBoxMin, math::Vector4 const& vBoxMax, CasterCullVolume const* pVolumes, int numVolumes)
+{
+    uint32_t mask = 0;
+    for (int i = 0; i < numVolumes; ++i)
+    {
+        CasterCullVolume const& volume = pVolumes[i];
+
+        // Only the far side of the volume bounds casters in Z, everything above it is towards the light.
+        if (vBoxMax.getX() < volume.vMin.getX() || vBoxMin.getX() > volume.vMax.getX())
+            continue;
+        if (vBoxMax.getY() < volume.vMin.getY() || vBoxMin.getY() > volume.vMax.getY())
+            continue;
+        if (vBoxMax.getZ() < volume.vMin.getZ())
+            continue;
+
+        mask |= 1u << i;
+    }
+    return mask;
+}
+
+void ShadowCasterCulling::TransformBox(math::Matrix4 const& matWorldToLight, math::Vector4 const& vCenter, math::Vector4 const& vRadius, math::Vector4* pBoxMin, math::Vector4* pBoxMax)
+{
+    // Transform the center and project the extents on the light axes, this is the same box
+    // as transforming the 8 corners but a lot cheaper.
+    math::Vector3 vLightCenter = (matWorldToLight * math::Point3(vCenter.getXYZ())).getXYZ();
+    math::Vector3 vLightRadius = math::absPerElem(matWorldToLight.getUpper3x3()) * vRadius.getXYZ();
+
+    *pBoxMin = math::Vector4(vLightCenter - vLightRadius, 1.0f);
+    *pBoxMax = math::Vector4(vLightCenter + vLightRadius, 1.0f);
+}
+
+void ShadowCasterCulling::Cull(GLTFCommon const* pC, math::Matrix4 const& matLightCameraView, CasterCullVolume const* pVolumes, int numVolumes)
+{
+    assert(numVolumes <= MaxVolumes);
+
+    m_nodeMasks.resize(pC->m_nodes.size());
+
+    for (uint32_t i = 0; i < pC->m_nodes.size(); i++)
+    {
+        m_nodeMasks[i] = 0;
+
+        tfNode const* pNode = &pC->m_nodes[i];
+        if (pNode->meshIndex < 0)
+            continue;
+
+        math::Matrix4 matWorldToLight = matLightCameraView * pC->m_worldSpaceMats[i].GetCurrent();
+
+        uint32_t mask = 0;
+        tfMesh const* pMesh = &pC->m_meshes[pNode->meshIndex];
+        for (uint32_t p = 0; p < pMesh->m_pPrimitives.size(); p++)
+        {
+            math::Vector4 vBoxMin, vBoxMax;
+            TransformBox(matWorldToLight, pMesh->m_pPrimitives[p].m_center, pMesh->m_pPrimitives[p].m_radius, &vBoxMin, &vBoxMax);
+            mask |= CullBox(vBoxMin, vBoxMax, pVolumes, numVolumes);
+        }
+        m_nodeMasks[i] = static_cast<uint8_t>(mask);
+    }
+}
+
+void ShadowCasterCulling::ClassifyNodes(GLTFCommon const* pC)
+{
+    m_dynamicNodes.assign(pC->m_nodes.size(), 0);
+    m_nodeStack.clear();
+
+    for (uint32_t i = 0; i < pC->m_nodes.size(); i++)
+    {
+        if (pC->m_nodes[i].skinIndex >= 0)
+            m_nodeStack.push_back(i);
+    }
+
+    for (tfAnimation const& animation : pC->m_animations)
+    {
+        for (auto const& channel : animation.m_channels)
+        {
+            m_nodeStack.push_back(static_cast<uint32_t>(channel.first));
+        }
+    }
+
+    // Anything below a moving node moves with it
+    while (!m_nodeStack.empty())
+    {
+        uint32_t nodeIndex = m_nodeStack.back();
+        m_nodeStack.pop_back();
+
+        if (m_dynamicNodes[nodeIndex])
+            continue;
+
+        m_dynamicNodes[nodeIndex] = 1;
+        for (tfNodeIdx child : pC->m_nodes[nodeIndex].m_children)
+        {
+            m_nodeStack.push_back(static_cast<uint32_t>(child));
+        }
+    }
+
+    m_bHasDynamicNodes = false;
+    for (uint32_t i = 0; i < pC->m_nodes.size(); i++)
+    {
+        m_bHasDynamicNodes |= m_dynamicNodes[i] && pC->m_nodes[i].meshIndex >= 0;
+    }
+}
+
+bool ShadowCasterCulling::IsVisible(uint32_t nodeIndex, int volumeIndex, CasterFilter filter) const
+{
+    if (!IsVisible(nodeIndex, volumeIndex))
+        return false;
+
+    bool bIsDynamic = IsDynamic(nodeIndex);
+    switch (filter)
+    {
+    case CasterFilter::Static:
+        return !bIsDynamic;
+    case CasterFilter::Dynamic:
+        return bIsDynamic;
+    default:
+        return true;
+    }
+}
+
+void ShadowCasterCulling::GetVisibleNodes(int volumeIndex, CasterFilter filter, std::vector<uint8_t>* pNodeMask) const
+{
+    // the mask keeps its capacity, the steady state frame doesn't allocate
+    pNodeMask->resize(m_nodeMasks.size());
+    for (uint32_t i = 0; i < m_nodeMasks.size(); ++i)
+    {
+        (*pNodeMask)[i] = IsVisible(i, volumeIndex, filter) ? 1 : 0;
+    }
+}
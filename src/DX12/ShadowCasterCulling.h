@@ -0,0 +1,73 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+//--------------------------------------------------------------------------------------
+// Light space volume a cascade receives shadows in. The light looks down -Z, so a
+// caster anywhere between the light and the volume (larger Z) can still cast into it.
+//--------------------------------------------------------------------------------------
+struct CasterCullVolume
+{
+    math::Vector4 vMin;
+    math::Vector4 vMax;
+};
+
+//--------------------------------------------------------------------------------------
+// Computes for each node a bit mask of the cascades it may cast a shadow into.
+// Culling is done per node since the depth pass draws whole nodes.
+//--------------------------------------------------------------------------------------
+class ShadowCasterCulling
+{
+public:
+    static const int MaxVolumes = 8;
+
+    enum class CasterFilter
+    {
+        All,
+        Static,
+        Dynamic
+    };
+
+    // Nodes that are animated, skinned or parented to either can move and are dynamic, everything else is static.
+    void ClassifyNodes(GLTFCommon const* pC);
+
+    // Returns a bit per volume the light space box overlaps once the volume is extruded towards the light.
+    static uint32_t CullBox(math::Vector4 const& vBoxMin, math::Vector4 const& vBoxMax, CasterCullVolume const* pVolumes, int numVolumes);
+
+    // Light space bounds of a world space box given as center + radius.
+    static void TransformBox(math::Matrix4 const& matWorldToLight, math::Vector4 const& vCenter, math::Vector4 const& vRadius, math::Vector4* pBoxMin, math::Vector4* pBoxMax);
+
+    void Cull(GLTFCommon const* pC, math::Matrix4 const& matLightCameraView, CasterCullVolume const* pVolumes, int numVolumes);
+
+    bool IsVisible(uint32_t nodeIndex, int volumeIndex) const { return (m_nodeMasks[nodeIndex] & (1u << volumeIndex)) != 0; }
+    bool IsVisible(uint32_t nodeIndex, int volumeIndex, CasterFilter filter) const;
+    // Fills a non zero entry for every node IsVisible accepts, the mask the depth pass draws the casters with
+    void GetVisibleNodes(int volumeIndex, CasterFilter filter, std::vector<uint8_t>* pNodeMask) const;
+    bool HasDynamicNodes() const { return m_bHasDynamicNodes; }
+    // Nodes loaded after the classification are treated as dynamic
+    bool IsDynamic(uint32_t nodeIndex) const { return nodeIndex >= m_dynamicNodes.size() || m_dynamicNodes[nodeIndex] != 0; }
+    std::vector<uint8_t> const& GetNodeMasks() const { return m_nodeMasks; }
+
+private:
+    std::vector<uint8_t> m_nodeMasks;
+    std::vector<uint8_t> m_dynamicNodes;
+    std::vector<uint32_t> m_nodeStack;
+    bool m_bHasDynamicNodes = false;
+};
@@ -27,6 +27,13 @@ namespace
 	{
 		return (a + b - 1) / b;
 	}
+
+	// Cauldron's timer keeps the labels in std::strings, those aren't the frame's allocations
+	void TimeStamp(GPUTimestamps* pGpuTimer, ID3D12GraphicsCommandList* pCommandList, const char* label)
+	{
+		AllocationCounter::Pause pause;
+		pGpuTimer->GetTimeStamp(pCommandList, label);
+	}
 }
 
 namespace Raytracing
@@ -35,7 +42,11 @@ namespace Raytracing
 	constexpr uint32_t k_tileSizeY = 4;
 
 	ShadowDenoiser::ShadowDenoiser(void)
-		: m_momentIndex(0)
+		: m_width(0)
+		, m_height(0)
+		, m_lightCount(1)
+		, m_momentIndex{}
+		, m_bIsFristFrame{}
 	{
 	}
 
@@ -45,7 +56,7 @@ namespace Raytracing
 
 	void ShadowDenoiser::OnCreate(Device* pDevice, ResourceViewHeaps* pResourceViewHeaps)
 	{
-		pResourceViewHeaps->AllocCBV_SRV_UAVDescriptor(4, &m_momentsTable);
+		pResourceViewHeaps->AllocCBV_SRV_UAVDescriptor(4 * k_maxLights, &m_momentsTable);
 		pResourceViewHeaps->AllocCBV_SRV_UAVDescriptor(4, &m_scratchTable);
 
 		// prepare
@@ -269,22 +280,7 @@ namespace Raytracing
 			m_depthHistory.CreateSRV(4, &m_tileClassificationTable);
 		}
 		// moments
-		{
-			CD3DX12_RESOURCE_DESC const desc = CD3DX12_RESOURCE_DESC::Tex2D(
-				DXGI_FORMAT_R11G11B10_FLOAT,
-				// DXGI_FORMAT_R16G16B16A16_FLOAT,
-				Width,
-				Height,
-				1, 1, 1, 0,
-				D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
-			m_moments[0].Init(pDevice, "Moments 0", &desc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr);
-			m_moments[1].Init(pDevice, "Moments 1", &desc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, nullptr);
-
-			m_moments[0].CreateSRV(0, &m_momentsTable);
-			m_moments[1].CreateSRV(1, &m_momentsTable);
-			m_moments[0].CreateUAV(2, &m_momentsTable);
-			m_moments[1].CreateUAV(3, &m_momentsTable);
-		}
+		CreateMoments(pDevice);
 		// scratch
 		{
 			CD3DX12_RESOURCE_DESC const desc = CD3DX12_RESOURCE_DESC::Tex2D(
@@ -334,22 +330,75 @@ namespace Raytracing
 			m_tileBuffer.CreateBufferUAV(0, nullptr, &m_prepareTable);
 			m_tileBuffer.CreateSRV(5, &m_tileClassificationTable);
 		}
-
-		m_momentIndex = 0;
-		m_bIsFristFrame = true;
 	}
 
 	void ShadowDenoiser::OnDestroyWindowSizeDependentResources(void)
 	{
 		m_depthHistory.OnDestroy();
-		m_moments[0].OnDestroy();
-		m_moments[1].OnDestroy();
+		DestroyMoments();
 		m_scratch[0].OnDestroy();
 		m_scratch[1].OnDestroy();
 		m_tileMetaBuffer.OnDestroy();
 		m_tileBuffer.OnDestroy();
 	}
 
+	void ShadowDenoiser::CreateMoments(Device* pDevice)
+	{
+		CD3DX12_RESOURCE_DESC const desc = CD3DX12_RESOURCE_DESC::Tex2D(
+			DXGI_FORMAT_R11G11B10_FLOAT,
+			// DXGI_FORMAT_R16G16B16A16_FLOAT,
+			m_width,
+			m_height,
+			1, 1, 1, 0,
+			D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+
+		// only the lights in use get a history, light l owns descriptors [4 * l, 4 * l + 4)
+		for (uint32_t l = 0; l < m_lightCount; ++l)
+		{
+			m_moments[l][0].Init(pDevice, "Moments 0", &desc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr);
+			m_moments[l][1].Init(pDevice, "Moments 1", &desc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, nullptr);
+
+			m_moments[l][0].CreateSRV(4 * l + 0, &m_momentsTable);
+			m_moments[l][1].CreateSRV(4 * l + 1, &m_momentsTable);
+			m_moments[l][0].CreateUAV(4 * l + 2, &m_momentsTable);
+			m_moments[l][1].CreateUAV(4 * l + 3, &m_momentsTable);
+
+			m_momentIndex[l] = 0;
+			m_bIsFristFrame[l] = true;
+		}
+	}
+
+	void ShadowDenoiser::DestroyMoments(void)
+	{
+		for (uint32_t l = 0; l < m_lightCount; ++l)
+		{
+			m_moments[l][0].OnDestroy();
+			m_moments[l][1].OnDestroy();
+		}
+	}
+
+	void ShadowDenoiser::SetLightCount(Device* pDevice, uint32_t lightCount)
+	{
+		if (lightCount == m_lightCount)
+		{
+			return;
+		}
+
+		// the histories are created with the other window size dependent resources
+		bool const bHasMoments = m_moments[0][0].GetResource() != nullptr;
+		if (bHasMoments)
+		{
+			DestroyMoments();
+		}
+
+		m_lightCount = lightCount;
+
+		if (bHasMoments)
+		{
+			CreateMoments(pDevice);
+		}
+	}
+
 	void ShadowDenoiser::BindNormalTexture(Texture& normal)
 	{
 		normal.CreateSRV(2, &m_tileClassificationTable);
@@ -369,219 +418,243 @@ namespace Raytracing
 		motionVector.CreateSRV(1, &m_tileClassificationTable);
 	}
 
-	void ShadowDenoiser::Denoise(ID3D12GraphicsCommandList* pCommandList, DynamicBufferRing& pDynamicBufferRing, DenoiserControl const& dc, CBV_SRV_UAV& input, CBV_SRV_UAV& output, GPUTimestamps* pGpuTimer)
+	void ShadowDenoiser::Denoise(ID3D12GraphicsCommandList* pCommandList, DynamicBufferRing& pDynamicBufferRing, DenoiserControl const& dc, CBV_SRV_UAV& input, CBV_SRV_UAV& output, uint32_t lightCount, GPUTimestamps* pGpuTimer)
 	{
 		UserMarker marker(pCommandList, "Denoise shadows");
 
+		assert(lightCount <= m_lightCount);
+
 		uint32_t const ThreadGroupCountX = DivRoundUp(m_width, k_tileSizeX);
 		uint32_t const ThreadGroupCountY = DivRoundUp(m_height, k_tileSizeX);
 
-		// prepare
+		// The lights share the scratch and tile buffers, so they are denoised one after the other.
+		// Only the moments are kept per light.
+		for (uint32_t l = 0; l < lightCount; ++l)
 		{
-			UserMarker marker(pCommandList, "prepare");
+			uint32_t& momentIndex = m_momentIndex[l];
+			Texture* const moments = m_moments[l];
 
+			// prepare
 			{
-				D3D12_RESOURCE_BARRIER barrier[] = {
-					CD3DX12_RESOURCE_BARRIER::Transition(m_tileBuffer.GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
-				};
-				pCommandList->ResourceBarrier(ARRAYSIZE(barrier), barrier);
+				UserMarker marker(pCommandList, "prepare");
+
+				{
+					D3D12_RESOURCE_BARRIER barrier[] = {
+						CD3DX12_RESOURCE_BARRIER::Transition(m_tileBuffer.GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+					};
+					pCommandList->ResourceBarrier(ARRAYSIZE(barrier), barrier);
+				}
+
+				// Bind the descriptor heaps and root signature
+				pCommandList->SetComputeRootSignature(m_pPrepareRootSig);
+
+				// Bind the pipeline state
+				//
+				pCommandList->SetPipelineState(m_pPreparePso);
+
+				struct
+				{
+					uint32_t width;
+					uint32_t height;
+					uint32_t lightIndex;
+				} cb = { m_width, m_height, l };
+				D3D12_GPU_VIRTUAL_ADDRESS const cbAddress = pDynamicBufferRing.AllocConstantBuffer(sizeof(cb), &cb);
+
+				// Bind the descriptor set
+				//
+				pCommandList->SetComputeRootConstantBufferView(0, cbAddress);
+				pCommandList->SetComputeRootDescriptorTable(1, input.GetGPU());
+				pCommandList->SetComputeRootDescriptorTable(2, m_prepareTable.GetGPU());
+
+				uint32_t const ThreadGroupCountX2 = DivRoundUp(m_width, k_tileSizeX * 4);
+				uint32_t const ThreadGroupCountY2 = DivRoundUp(m_height, k_tileSizeY * 4);
+				pCommandList->Dispatch(ThreadGroupCountX2, ThreadGroupCountY2, 1);
+
+				TimeStamp(pGpuTimer, pCommandList, "Denoiser prepare");
 			}
 
-			// Bind the descriptor heaps and root signature
-			pCommandList->SetComputeRootSignature(m_pPrepareRootSig);
+			// tile class
+			{
+				UserMarker marker(pCommandList, "tile classification");
+
+				{
+					D3D12_RESOURCE_BARRIER barrier[] = {
+						CD3DX12_RESOURCE_BARRIER::Transition(m_tileBuffer.GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
+						CD3DX12_RESOURCE_BARRIER::Transition(m_tileMetaBuffer.GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+						CD3DX12_RESOURCE_BARRIER::Transition(m_scratch[0].GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+						CD3DX12_RESOURCE_BARRIER::Transition(moments[momentIndex].GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
+						CD3DX12_RESOURCE_BARRIER::Transition(moments[momentIndex ^ 1].GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+					};
+					pCommandList->ResourceBarrier(ARRAYSIZE(barrier), barrier);
+				}
+
+				// Bind the descriptor heaps and root signature
+				pCommandList->SetComputeRootSignature(m_pTileClassificationRootSig);
+
+				// Bind the pipeline state
+				//
+				pCommandList->SetPipelineState(m_pTileClassificationPso);
+
+
+				struct
+				{
+					float eye[3];
+					int bIsFristFrame;
+					int width;
+					int height;
+					float invWidth;
+					float invHeight;
+					math::Matrix4 inverseProj;
+					math::Matrix4 reproj;
+					math::Matrix4 inverseViewProj;
+				} cb =
+				{
+					dc.camPos.getX(), dc.camPos.getY(), dc.camPos.getZ(),
+					m_bIsFristFrame[l],
+					(int)m_width, (int)m_height,
+					1.f / m_width, 1.f / m_height,
+					dc.inverseProj,
+					dc.reprojection,
+					dc.inverseViewProj
 
-			// Bind the pipeline state
-			//
-			pCommandList->SetPipelineState(m_pPreparePso);
+				};
+				D3D12_GPU_VIRTUAL_ADDRESS const cbAddress = pDynamicBufferRing.AllocConstantBuffer(sizeof(cb), &cb);
 
-			struct
-			{
-				uint32_t width;
-				uint32_t height;
-			} cb = { m_width, m_height };
-			D3D12_GPU_VIRTUAL_ADDRESS const cbAddress = pDynamicBufferRing.AllocConstantBuffer(sizeof(cb), &cb);
+				// Bind the descriptor set
+				//
+				pCommandList->SetComputeRootConstantBufferView(0, cbAddress);
+				pCommandList->SetComputeRootDescriptorTable(1, m_tileClassificationTable.GetGPU());
+				pCommandList->SetComputeRootDescriptorTable(2, m_momentsTable.GetGPU(4 * l + momentIndex));
+				pCommandList->SetComputeRootDescriptorTable(3, m_momentsTable.GetGPU(4 * l + 2 + (momentIndex ^ 1)));
 
-			// Bind the descriptor set
-			//
-			pCommandList->SetComputeRootConstantBufferView(0, cbAddress);
-			pCommandList->SetComputeRootDescriptorTable(1, input.GetGPU());
-			pCommandList->SetComputeRootDescriptorTable(2, m_prepareTable.GetGPU());
+				pCommandList->Dispatch(ThreadGroupCountX, ThreadGroupCountY, 1);
 
-			uint32_t const ThreadGroupCountX2 = DivRoundUp(m_width, k_tileSizeX * 4);
-			uint32_t const ThreadGroupCountY2 = DivRoundUp(m_height, k_tileSizeY * 4);
-			pCommandList->Dispatch(ThreadGroupCountX2, ThreadGroupCountY2, 1);
+				momentIndex ^= 1;
 
-			pGpuTimer->GetTimeStamp(pCommandList, "Denoiser prepare");
-		}
+				TimeStamp(pGpuTimer, pCommandList, "Denoiser tile classification");
 
-		// tile class
-		{
-			UserMarker marker(pCommandList, "tile classification");
+			}
 
 			{
 				D3D12_RESOURCE_BARRIER barrier[] = {
-					CD3DX12_RESOURCE_BARRIER::Transition(m_tileBuffer.GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
-					CD3DX12_RESOURCE_BARRIER::Transition(m_tileMetaBuffer.GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
-					CD3DX12_RESOURCE_BARRIER::Transition(m_scratch[0].GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
-					CD3DX12_RESOURCE_BARRIER::Transition(m_moments[m_momentIndex].GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
-					CD3DX12_RESOURCE_BARRIER::Transition(m_moments[m_momentIndex ^ 1].GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+					CD3DX12_RESOURCE_BARRIER::Transition(m_tileMetaBuffer.GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
+					CD3DX12_RESOURCE_BARRIER::Transition(m_scratch[1].GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+					CD3DX12_RESOURCE_BARRIER::Transition(m_scratch[0].GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
 				};
 				pCommandList->ResourceBarrier(ARRAYSIZE(barrier), barrier);
 			}
 
-			// Bind the descriptor heaps and root signature
-			pCommandList->SetComputeRootSignature(m_pTileClassificationRootSig);
+			// filter
+			{
+				UserMarker marker(pCommandList, "filter");
+
+				// Bind the descriptor heaps and root signature
+				pCommandList->SetComputeRootSignature(m_pFilterPassRootSig);
+
+				struct
+				{
+					math::Matrix4 inverseProj;
+					int width;
+					int height;
+					float invWidth;
+					float invHeight;
+
+					float depthSimilaritySigma;
+					uint32_t lightIndex;
+					float _pad[2];
+				} cb =
+				{
+					dc.inverseProj,
+					(int)m_width, (int)m_height,
+					1.f / m_width, 1.f / m_height,
+					1.f,
+					l,
+				};
+				D3D12_GPU_VIRTUAL_ADDRESS const cbAddress = pDynamicBufferRing.AllocConstantBuffer(sizeof(cb), &cb);
 
-			// Bind the pipeline state
-			//
-			pCommandList->SetPipelineState(m_pTileClassificationPso);
+				// Bind the descriptor set
+				//
+				pCommandList->SetComputeRootConstantBufferView(0, cbAddress);
+				pCommandList->SetComputeRootDescriptorTable(1, m_filterPassTable.GetGPU());
 
+				// pass 0
+				// Bind the pipeline state
+				//
+				pCommandList->SetPipelineState(m_pFilterPassPso[0]);
 
-			struct
-			{
-				float eye[3];
-				int bIsFristFrame;
-				int width;
-				int height;
-				float invWidth;
-				float invHeight;
-				math::Matrix4 inverseProj;
-				math::Matrix4 reproj;
-				math::Matrix4 inverseViewProj;
-			} cb =
-			{
-				dc.camPos.getX(), dc.camPos.getY(), dc.camPos.getZ(),
-				m_bIsFristFrame,
-				(int)m_width, (int)m_height,
-				1.f / m_width, 1.f / m_height,
-				dc.inverseProj,
-				dc.reprojection,
-				dc.inverseViewProj
-
-			};
-			D3D12_GPU_VIRTUAL_ADDRESS const cbAddress = pDynamicBufferRing.AllocConstantBuffer(sizeof(cb), &cb);
-
-			// Bind the descriptor set
-			//
-			pCommandList->SetComputeRootConstantBufferView(0, cbAddress);
-			pCommandList->SetComputeRootDescriptorTable(1, m_tileClassificationTable.GetGPU());
-			pCommandList->SetComputeRootDescriptorTable(2, m_momentsTable.GetGPU(m_momentIndex));
-			pCommandList->SetComputeRootDescriptorTable(3, m_momentsTable.GetGPU(m_momentIndex ^ 1 + 2));
+				pCommandList->SetComputeRootDescriptorTable(2, m_scratchTable.GetGPU(0));
+				pCommandList->SetComputeRootDescriptorTable(3, m_scratchTable.GetGPU(1 + 2));
 
-			pCommandList->Dispatch(ThreadGroupCountX, ThreadGroupCountY, 1);
+				pCommandList->Dispatch(ThreadGroupCountX, ThreadGroupCountY, 1);
 
-			m_momentIndex ^= 1;
+				{
+					D3D12_RESOURCE_BARRIER barrier[] = {
+						CD3DX12_RESOURCE_BARRIER::Transition(m_scratch[0].GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+						CD3DX12_RESOURCE_BARRIER::Transition(m_scratch[1].GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
+					};
+					pCommandList->ResourceBarrier(ARRAYSIZE(barrier), barrier);
+				}
 
-			pGpuTimer->GetTimeStamp(pCommandList, "Denoiser tile classification");
+				TimeStamp(pGpuTimer, pCommandList, "Denoiser filter 1");
 
-		}
+				// pass 1
+				// Bind the pipeline state
+				//
+				pCommandList->SetPipelineState(m_pFilterPassPso[1]);
 
-		// copy depth, do it here to prim/use the Infinity cache
-		{
-			UserMarker marker(pCommandList, "copy depth");
+				pCommandList->SetComputeRootDescriptorTable(2, m_scratchTable.GetGPU(1));
+				pCommandList->SetComputeRootDescriptorTable(3, m_scratchTable.GetGPU(0 + 2));
 
-			{
-				D3D12_RESOURCE_BARRIER barrier[] = {
-					CD3DX12_RESOURCE_BARRIER::Transition(m_depthHistory.GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST),
-					CD3DX12_RESOURCE_BARRIER::Transition(m_tileMetaBuffer.GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
-					CD3DX12_RESOURCE_BARRIER::Transition(m_scratch[1].GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
-					CD3DX12_RESOURCE_BARRIER::Transition(m_scratch[0].GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
-				};
-				pCommandList->ResourceBarrier(ARRAYSIZE(barrier), barrier);
-			}
+				pCommandList->Dispatch(ThreadGroupCountX, ThreadGroupCountY, 1);
 
-			pCommandList->CopyResource(m_depthHistory.GetResource(), m_pDepth->GetResource());
+				{
+					D3D12_RESOURCE_BARRIER barrier[] = {
+						CD3DX12_RESOURCE_BARRIER::Transition(m_scratch[0].GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
+					};
+					pCommandList->ResourceBarrier(ARRAYSIZE(barrier), barrier);
+				}
 
-			pGpuTimer->GetTimeStamp(pCommandList, "Denoiser depth copy");
-		}
+				TimeStamp(pGpuTimer, pCommandList, "Denoiser filter 2");
 
-		// filter
-		{
-			UserMarker marker(pCommandList, "filter");
+				// pass 2, writes the light's slice
+				// Bind the pipeline state
+				//
+				pCommandList->SetPipelineState(m_pFilterPassPso[2]);
 
-			// Bind the descriptor heaps and root signature
-			pCommandList->SetComputeRootSignature(m_pFilterPassRootSig);
+				pCommandList->SetComputeRootDescriptorTable(2, m_scratchTable.GetGPU(0));
+				pCommandList->SetComputeRootDescriptorTable(3, output.GetGPU());
 
-			struct
-			{
-				math::Matrix4 inverseProj;
-				int width;
-				int height;
-				float invWidth;
-				float invHeight;
-
-				float depthSimilaritySigma;
-				float _pad[3];
-			} cb =
-			{
-				dc.inverseProj,
-				(int)m_width, (int)m_height,
-				1.f / m_width, 1.f / m_height,
-				1.f,
-			};
-			D3D12_GPU_VIRTUAL_ADDRESS const cbAddress = pDynamicBufferRing.AllocConstantBuffer(sizeof(cb), &cb);
-
-			// Bind the descriptor set
-			//
-			pCommandList->SetComputeRootConstantBufferView(0, cbAddress);
-			pCommandList->SetComputeRootDescriptorTable(1, m_filterPassTable.GetGPU());
+				pCommandList->Dispatch(ThreadGroupCountX, ThreadGroupCountY, 1);
 
-			// pass 0
-			// Bind the pipeline state
-			//
-			pCommandList->SetPipelineState(m_pFilterPassPso[0]);
+				TimeStamp(pGpuTimer, pCommandList, "Denoiser filter 3");
+
+			}
 
-			pCommandList->SetComputeRootDescriptorTable(2, m_scratchTable.GetGPU(0));
-			pCommandList->SetComputeRootDescriptorTable(3, m_scratchTable.GetGPU(1 + 2));
+			m_bIsFristFrame[l] = false;
+		}
 
-			pCommandList->Dispatch(ThreadGroupCountX, ThreadGroupCountY, 1);
+		// copy depth, once all the lights reprojected with the previous one
+		{
+			UserMarker marker(pCommandList, "copy depth");
 
 			{
 				D3D12_RESOURCE_BARRIER barrier[] = {
-					CD3DX12_RESOURCE_BARRIER::Transition(m_scratch[0].GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
-					CD3DX12_RESOURCE_BARRIER::Transition(m_scratch[1].GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
+					CD3DX12_RESOURCE_BARRIER::Transition(m_depthHistory.GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST),
 				};
 				pCommandList->ResourceBarrier(ARRAYSIZE(barrier), barrier);
 			}
 
-			pGpuTimer->GetTimeStamp(pCommandList, "Denoiser filter 1");
-
-			// pass 1
-			// Bind the pipeline state
-			//
-			pCommandList->SetPipelineState(m_pFilterPassPso[1]);
-
-			pCommandList->SetComputeRootDescriptorTable(2, m_scratchTable.GetGPU(1));
-			pCommandList->SetComputeRootDescriptorTable(3, m_scratchTable.GetGPU(0 + 2));
-
-			pCommandList->Dispatch(ThreadGroupCountX, ThreadGroupCountY, 1);
+			pCommandList->CopyResource(m_depthHistory.GetResource(), m_pDepth->GetResource());
 
 			{
 				D3D12_RESOURCE_BARRIER barrier[] = {
 					CD3DX12_RESOURCE_BARRIER::Transition(m_depthHistory.GetResource(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
-					CD3DX12_RESOURCE_BARRIER::Transition(m_scratch[0].GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
 				};
 				pCommandList->ResourceBarrier(ARRAYSIZE(barrier), barrier);
 			}
 
-			pGpuTimer->GetTimeStamp(pCommandList, "Denoiser filter 2");
-
-			// pass 2
-			// Bind the pipeline state
-			//
-			pCommandList->SetPipelineState(m_pFilterPassPso[2]);
-
-			pCommandList->SetComputeRootDescriptorTable(2, m_scratchTable.GetGPU(0));
-			pCommandList->SetComputeRootDescriptorTable(3, output.GetGPU());
-
-			pCommandList->Dispatch(ThreadGroupCountX, ThreadGroupCountY, 1);
-
-			pGpuTimer->GetTimeStamp(pCommandList, "Denoiser filter 3");
-
+			TimeStamp(pGpuTimer, pCommandList, "Denoiser depth copy");
 		}
-
-		m_bIsFristFrame = false;
-
 	}
 
 }
\ No newline at end of file
@@ -21,6 +21,8 @@
 
 namespace Raytracing
 {
+	// must match MAX_LIGHTS in RaytracingCommon.h
+	constexpr uint32_t k_maxLights = 4;
 
 	struct DenoiserControl
 	{
@@ -46,19 +48,27 @@ namespace Raytracing
 		void BindDepthTexture(Texture& depth);
 		void BindMotionVectorTexture(Texture& motionVector);
 
-		void Denoise(ID3D12GraphicsCommandList* pCommandList, DynamicBufferRing& pDynamicBufferRing, DenoiserControl const& dc, CBV_SRV_UAV& input, CBV_SRV_UAV& output, GPUTimestamps* pGpuTimer);
+		// every light keeps its own history, the GPU has to be idle when the count changes
+		void SetLightCount(Device* pDevice, uint32_t lightCount);
+
+		// input holds the ray hit masks and output the shadow masks, both with a slice per light
+		void Denoise(ID3D12GraphicsCommandList* pCommandList, DynamicBufferRing& pDynamicBufferRing, DenoiserControl const& dc, CBV_SRV_UAV& input, CBV_SRV_UAV& output, uint32_t lightCount, GPUTimestamps* pGpuTimer);
 
 	private:
+		void CreateMoments(Device* pDevice);
+		void DestroyMoments(void);
+
 		uint32_t m_width;
 		uint32_t m_height;
 
-		uint32_t m_momentIndex;
-		bool     m_bIsFristFrame;
+		uint32_t m_lightCount;
+		uint32_t m_momentIndex[k_maxLights];
+		bool     m_bIsFristFrame[k_maxLights];
 
 		Texture* m_pDepth;
 
 		Texture m_depthHistory;
-		Texture m_moments[2];
+		Texture m_moments[k_maxLights][2];
 		Texture m_scratch[2];
 
 		Texture m_tileMetaBuffer;
@@ -0,0 +1,151 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+#include "ShadowMaskCombine.h"
+
+namespace
+{
+    const uint32_t s_TileSize = 8;
+}
+
+//--------------------------------------------------------------------------------------
+//
+// OnCreate
+//
+//--------------------------------------------------------------------------------------
+void ShadowMaskCombine::OnCreate(Device* pDevice, ResourceViewHeaps* pResourceViewHeaps)
+{
+    pResourceViewHeaps->AllocCBV_SRV_UAVDescriptor(2, &m_table);
+    pResourceViewHeaps->AllocCBV_SRV_UAVDescriptor(1, &m_lightMasksUAV);
+
+    // Create root signature
+    //
+    {
+        CD3DX12_DESCRIPTOR_RANGE descriptorRanges[2] = {};
+        descriptorRanges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1u, 0u);
+        descriptorRanges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1u, 0u);
+
+        CD3DX12_ROOT_PARAMETER rootParameters[2] = {};
+        rootParameters[0].InitAsConstants(3, 0);
+        rootParameters[1].InitAsDescriptorTable(2, descriptorRanges);
+
+        CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc;
+        rootSignatureDesc.Init(2, rootParameters, 0, nullptr);
+
+        ID3DBlob* pOutBlob, * pErrorBlob = NULL;
+        ThrowIfFailed(D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &pOutBlob, &pErrorBlob));
+        ThrowIfFailed(
+            pDevice->GetDevice()->CreateRootSignature(0, pOutBlob->GetBufferPointer(), pOutBlob->GetBufferSize(), IID_PPV_ARGS(&m_pRootSignature))
+        );
+        SetName(m_pRootSignature, "ShadowMaskCombine");
+
+        pOutBlob->Release();
+        if (pErrorBlob)
+            pErrorBlob->Release();
+    }
+
+    // Create pipeline
+    //
+    {
+        D3D12_SHADER_BYTECODE shaderByteCode = {};
+        CompileShaderFromFile("ShadowMaskCombine.hlsl", NULL, "main", "-T cs_6_0", &shaderByteCode);
+
+        D3D12_COMPUTE_PIPELINE_STATE_DESC pipelineStateDesc = {};
+        pipelineStateDesc.pRootSignature = m_pRootSignature;
+        pipelineStateDesc.CS = shaderByteCode;
+
+        ThrowIfFailed(pDevice->GetDevice()->CreateComputePipelineState(&pipelineStateDesc, IID_PPV_ARGS(&m_pPipelineState)));
+        SetName(m_pPipelineState, "ShadowMaskCombine");
+    }
+}
+
+//--------------------------------------------------------------------------------------
+//
+// OnDestroy
+//
+//--------------------------------------------------------------------------------------
+void ShadowMaskCombine::OnDestroy()
+{
+    if (m_pPipelineState)
+    {
+        m_pPipelineState->Release();
+        m_pPipelineState = nullptr;
+    }
+
+    if (m_pRootSignature)
+    {
+        m_pRootSignature->Release();
+        m_pRootSignature = nullptr;
+    }
+}
+
+//--------------------------------------------------------------------------------------
+//
+// OnCreateWindowSizeDependentResources
+//
+//--------------------------------------------------------------------------------------
+void ShadowMaskCombine::OnCreateWindowSizeDependentResources(Device* pDevice, Texture& shadowMask, uint32_t width, uint32_t height)
+{
+    m_width = width;
+    m_height = height;
+
+    m_lightMasks.Init(pDevice, "light shadow masks", &CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8_UNORM, width, height, MaxLights, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, NULL);
+
+    // Texture::CreateUAV only views the first slice
+    D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+    uavDesc.Format = DXGI_FORMAT_R8_UNORM;
+    uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2DARRAY;
+    uavDesc.Texture2DArray.MipSlice = 0;
+    uavDesc.Texture2DArray.FirstArraySlice = 0;
+    uavDesc.Texture2DArray.ArraySize = MaxLights;
+    pDevice->GetDevice()->CreateUnorderedAccessView(m_lightMasks.GetResource(), nullptr, &uavDesc, m_lightMasksUAV.GetCPU());
+
+    m_lightMasks.CreateSRV(0, &m_table);
+    shadowMask.CreateUAV(1, &m_table);
+}
+
+//--------------------------------------------------------------------------------------
+//
+// OnDestroyWindowSizeDependentResources
+//
+//--------------------------------------------------------------------------------------
+void ShadowMaskCombine::OnDestroyWindowSizeDependentResources()
+{
+    m_lightMasks.OnDestroy();
+}
+
+//--------------------------------------------------------------------------------------
+//
+// Combine
+//
+//--------------------------------------------------------------------------------------
+void ShadowMaskCombine::Combine(ID3D12GraphicsCommandList* pCommandList, uint32_t lightCount)
+{
+    UserMarker marker(pCommandList, "Combine shadow masks");
+
+    pCommandList->SetComputeRootSignature(m_pRootSignature);
+    pCommandList->SetPipelineState(m_pPipelineState);
+
+    uint32_t const constants[3] = { m_width, m_height, lightCount };
+    pCommandList->SetComputeRoot32BitConstants(0, 3, constants, 0);
+    pCommandList->SetComputeRootDescriptorTable(1, m_table.GetGPU());
+
+    pCommandList->Dispatch((m_width + s_TileSize - 1) / s_TileSize, (m_height + s_TileSize - 1) / s_TileSize, 1);
+}
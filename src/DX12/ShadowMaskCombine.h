@@ -0,0 +1,56 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+using namespace CAULDRON_DX12;
+
+//--------------------------------------------------------------------------------------
+// Packs the shadow masks of the lights into the channels of the mask the lighting samples.
+// Every light is resolved to its own R8 slice, merging the channels in place would need
+// typed UAV loads of RGBA8, which not every device supports.
+//--------------------------------------------------------------------------------------
+class ShadowMaskCombine
+{
+public:
+    static const uint32_t MaxLights = 4; // one per channel of the shadow mask
+
+    void OnCreate(Device* pDevice, ResourceViewHeaps* pResourceViewHeaps);
+    void OnDestroy();
+
+    void OnCreateWindowSizeDependentResources(Device* pDevice, Texture& shadowMask, uint32_t width, uint32_t height);
+    void OnDestroyWindowSizeDependentResources();
+
+    // one slice per light, kept in NON_PIXEL_SHADER_RESOURCE outside of the passes writing them
+    Texture& GetLightMasks() { return m_lightMasks; }
+    CBV_SRV_UAV& GetLightMasksUAV() { return m_lightMasksUAV; }
+
+    void Combine(ID3D12GraphicsCommandList* pCommandList, uint32_t lightCount);
+
+private:
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+
+    Texture m_lightMasks;
+    CBV_SRV_UAV m_lightMasksUAV;
+
+    ID3D12RootSignature* m_pRootSignature = nullptr;
+    ID3D12PipelineState* m_pPipelineState = nullptr;
+    CBV_SRV_UAV m_table;
+};
@@ -35,6 +35,21 @@ namespace
 
 		return math::SSE::normalize(math::SSE::cross(up, normal));
 	}
+
+	// Texture::CreateUAV only views the first slice of an array
+	void CreateArrayUAV(Device* pDevice, Texture& texture, uint32_t index, CBV_SRV_UAV* pTable)
+	{
+		D3D12_RESOURCE_DESC const desc = texture.GetResource()->GetDesc();
+
+		D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+		uavDesc.Format = desc.Format;
+		uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2DARRAY;
+		uavDesc.Texture2DArray.MipSlice = 0;
+		uavDesc.Texture2DArray.FirstArraySlice = 0;
+		uavDesc.Texture2DArray.ArraySize = desc.DepthOrArraySize;
+
+		pDevice->GetDevice()->CreateUnorderedAccessView(texture.GetResource(), nullptr, &uavDesc, pTable->GetCPU(index));
+	}
 }
 
 namespace Raytracing
@@ -63,6 +78,7 @@ namespace Raytracing
 		, m_pDebugPso(nullptr)
 		, m_debugTable()
 		, m_pDispatchIndirect(nullptr)
+		, m_pTraceIndirect(nullptr)
 		, m_cpuHeap()
 		, m_cpuTable()
 	{
@@ -203,27 +219,28 @@ namespace Raytracing
 		// raytracer
 		{
 			// Alloc descriptors
-			pResourceViewHeaps->AllocCBV_SRV_UAVDescriptor(6, &m_raytracerTable);
+			pResourceViewHeaps->AllocCBV_SRV_UAVDescriptor(8, &m_raytracerTable);
 
 			// Create root signature
 			//
 			CD3DX12_DESCRIPTOR_RANGE descriptorRanges[3] = {};
-			descriptorRanges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 5u, 0u);
+			descriptorRanges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 7u, 0u);
 			descriptorRanges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1u, 0u);
 			descriptorRanges[2].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, UINT_MAX, 0u, 2u);
 
-			CD3DX12_ROOT_PARAMETER rootParameters[5] = {};
+			CD3DX12_ROOT_PARAMETER rootParameters[6] = {};
 			rootParameters[0].InitAsConstantBufferView(0);
 			rootParameters[1].InitAsShaderResourceView(0, 1);
 			rootParameters[2].InitAsShaderResourceView(1, 1);
 			rootParameters[3].InitAsDescriptorTable(2, descriptorRanges);
 			rootParameters[4].InitAsDescriptorTable(1, descriptorRanges + 2);
+			rootParameters[5].InitAsConstants(1, 1);
 
 			CD3DX12_STATIC_SAMPLER_DESC staticSamplerDescs[1] = {};
 			staticSamplerDescs[0].Init(0, D3D12_FILTER_MIN_MAG_MIP_LINEAR);
 
 			CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc;
-			rootSignatureDesc.Init(5, rootParameters, 1, staticSamplerDescs);
+			rootSignatureDesc.Init(6, rootParameters, 1, staticSamplerDescs);
 
 			ID3DBlob* pOutBlob, * pErrorBlob = NULL;
 			ThrowIfFailed(D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &pOutBlob, &pErrorBlob));
@@ -236,6 +253,24 @@ namespace Raytracing
 			if (pErrorBlob)
 				pErrorBlob->Release();
 
+			// one command per light, the light index followed by the group count of its tile list
+			D3D12_INDIRECT_ARGUMENT_DESC args[2] = {};
+			args[0].Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT;
+			args[0].Constant.RootParameterIndex = 5;
+			args[0].Constant.DestOffsetIn32BitValues = 0;
+			args[0].Constant.Num32BitValuesToSet = 1;
+			args[1].Type = D3D12_INDIRECT_ARGUMENT_TYPE_DISPATCH;
+
+			D3D12_COMMAND_SIGNATURE_DESC desc = {};
+			desc.ByteStride = 4 * sizeof(uint32_t);
+			desc.NumArgumentDescs = 2;
+			desc.pArgumentDescs = args;
+
+			ThrowIfFailed(pDevice->GetDevice()->CreateCommandSignature(
+				&desc,
+				m_pRaytracerRootSig,
+				IID_PPV_ARGS(&m_pTraceIndirect)));
+
 			D3D12_COMPUTE_PIPELINE_STATE_DESC pipelineStateDesc = {};
 			pipelineStateDesc.pRootSignature = m_pRaytracerRootSig;
 
@@ -272,7 +307,7 @@ namespace Raytracing
 			descriptorRanges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1u, 0u);
 
 			CD3DX12_ROOT_PARAMETER rootParameters[3] = {};
-			rootParameters[0].InitAsConstantBufferView(0);
+			rootParameters[0].InitAsConstants(2, 1);
 			rootParameters[1].InitAsDescriptorTable(1, descriptorRanges);
 			rootParameters[2].InitAsDescriptorTable(1, descriptorRanges + 1);
 
@@ -306,9 +341,16 @@ namespace Raytracing
 
 			pDevice->GetDevice()->CreateComputePipelineState(&pipelineStateDesc, IID_PPV_ARGS(&m_pResolvePso[1]));
 			SetName(m_pResolvePso[1], "m_pResolvePso blend");
+
+			CompileShaderFromFile("ResloveRaytracing.hlsl", NULL, "debug", "-enable-16bit-types -T cs_6_5", &shaderByteCode);
+			pipelineStateDesc.CS = shaderByteCode;
+
+			pDevice->GetDevice()->CreateComputePipelineState(&pipelineStateDesc, IID_PPV_ARGS(&m_pResolvePso[2]));
+			SetName(m_pResolvePso[2], "m_pResolvePso debug");
 		}
 
-		m_workQueueCount.InitBuffer(pDevice, "Work Queue Counter", &CD3DX12_RESOURCE_DESC::Buffer(sizeof(uint32_t) * 3, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS), sizeof(uint32_t), D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
+		// per light the light index and the dispatch arguments of its tile list
+		m_workQueueCount.InitBuffer(pDevice, "Work Queue Counter", &CD3DX12_RESOURCE_DESC::Buffer(sizeof(uint32_t) * 4 * k_maxLights, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS), sizeof(uint32_t), D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
 		m_workQueueCount.CreateBufferUAV(4, nullptr, &m_classifyTable);
 
 		m_denoiser.OnCreate(pDevice, pResourceViewHeaps);
@@ -382,6 +424,12 @@ namespace Raytracing
 			m_pResolvePso[1] = nullptr;
 		}
 
+		if (m_pResolvePso[2])
+		{
+			m_pResolvePso[2]->Release();
+			m_pResolvePso[2] = nullptr;
+		}
+
 		if (m_pDebugRootSig)
 		{
 			m_pDebugRootSig->Release();
@@ -400,6 +448,12 @@ namespace Raytracing
 			m_pDispatchIndirect = nullptr;
 		}
 
+		if (m_pTraceIndirect)
+		{
+			m_pTraceIndirect->Release();
+			m_pTraceIndirect = nullptr;
+		}
+
 		m_cpuHeap.OnDestroy();
 
 		m_workQueueCount.OnDestroy();
@@ -411,26 +465,28 @@ namespace Raytracing
 	{
 		uint32_t const xTiles = DivRoundUp(Width, k_tileSizeX);
 		uint32_t const yTiles = DivRoundUp(Height, k_tileSizeY);
+		// a slice per light
 		CD3DX12_RESOURCE_DESC const desc = CD3DX12_RESOURCE_DESC::Tex2D(
 			DXGI_FORMAT_R32_UINT,
 			xTiles,
 			yTiles,
-			1, 1, 1, 0,
+			k_maxLights, 1, 1, 0,
 			D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
 		m_rayHitTexture.Init(pDevice, "Ray hit texture", &desc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, nullptr);
 
-		m_rayHitTexture.CreateUAV(5, &m_classifyTable);
-		m_rayHitTexture.CreateUAV(5, &m_raytracerTable);
+		CreateArrayUAV(pDevice, m_rayHitTexture, 5, &m_classifyTable);
+		CreateArrayUAV(pDevice, m_rayHitTexture, 7, &m_raytracerTable);
 		m_rayHitTexture.CreateSRV(0, &m_resolveTable);
-		m_rayHitTexture.CreateUAV(0, &m_cpuTable);
+		CreateArrayUAV(pDevice, m_rayHitTexture, 0, &m_cpuTable);
 
 
+		// a list per light, each large enough for all the tiles
 		uint32_t const tileCount = xTiles * yTiles;
 		size_t const tileSize = sizeof(uint32_t) * 4;
 		m_workQueue.InitBuffer(
 			pDevice, 
 			"Work Queue", 
-			&CD3DX12_RESOURCE_DESC::Buffer(tileSize * tileCount, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
+			&CD3DX12_RESOURCE_DESC::Buffer(tileSize * tileCount * k_maxLights, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
 			tileSize,
 			D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
 
@@ -492,31 +548,78 @@ namespace Raytracing
 		}
 	}
 
-	D3D12_GPU_VIRTUAL_ADDRESS ShadowTrace::BuildTraceControls(DynamicBufferRing& pDynamicBufferRing, Light const& light, math::Matrix4 const& viewToWorld, TraceControls& tc)
+	void ShadowTrace::SetOpacityMicromaps(Texture& buffer)
+	{
+		if (buffer.GetResource())
+		{
+			buffer.CreateSRV(5, &m_raytracerTable);
+		}
+	}
+
+	void ShadowTrace::SetAlphaMasks(Device* pDevice, Texture& masks)
+	{
+		if (masks.GetResource())
+		{
+			// an array view even with a single slice, which Texture::CreateSRV would make a 2D view
+			D3D12_RESOURCE_DESC const desc = masks.GetResource()->GetDesc();
+
+			D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+			srvDesc.Format = desc.Format;
+			srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+			srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+			srvDesc.Texture2DArray.MostDetailedMip = 0;
+			srvDesc.Texture2DArray.MipLevels = desc.MipLevels;
+			srvDesc.Texture2DArray.FirstArraySlice = 0;
+			srvDesc.Texture2DArray.ArraySize = desc.DepthOrArraySize;
+
+			pDevice->GetDevice()->CreateShaderResourceView(masks.GetResource(), &srvDesc, m_raytracerTable.GetCPU(6));
+		}
+	}
+
+	void ShadowTrace::SetLightCount(Device* pDevice, uint32_t lightCount)
 	{
-		math::Vector3 const lightDir = math::Vector3(light.direction[0], light.direction[1], light.direction[2]);
-		math::Vector3 const coneVec = math::SSE::normalize(lightDir) + CreateTangentVector(lightDir) * tc.sunSize;
-		math::Vector3 const lightSpaceConeVec = (tc.lightView * math::Vector4(coneVec, 0)).getXYZ();
+		assert(lightCount > 0 && lightCount <= k_maxLights);
 
-		tc.sunSizeLightSpace = math::length(math::Vector2(lightSpaceConeVec.getX(), lightSpaceConeVec.getY())) / lightSpaceConeVec.getZ();
+		m_denoiser.SetLightCount(pDevice, lightCount);
+	}
+
+	D3D12_GPU_VIRTUAL_ADDRESS ShadowTrace::BuildTraceControls(DynamicBufferRing& pDynamicBufferRing, Light const* const* ppLights, uint32_t lightCount, math::Matrix4 const& viewToWorld, TraceControls& tc)
+	{
+		assert(lightCount <= k_maxLights);
+
+		for (uint32_t l = 0; l < lightCount; ++l)
+		{
+			Light const& light = *ppLights[l];
+			LightControls& lc = tc.lights[l];
+
+			math::Vector3 const lightDir = math::Vector3(light.direction[0], light.direction[1], light.direction[2]);
+			math::Vector3 const coneVec = math::SSE::normalize(lightDir) + CreateTangentVector(lightDir) * tc.sunSize;
+			math::Vector3 const lightSpaceConeVec = (lc.lightView * math::Vector4(coneVec, 0)).getXYZ();
+
+			lc.sunSizeLightSpace = math::length(math::Vector2(lightSpaceConeVec.getX(), lightSpaceConeVec.getY())) / lightSpaceConeVec.getZ();
+
+			lc.lightDir[0] = -light.direction[0];
+			lc.lightDir[1] = -light.direction[1];
+			lc.lightDir[2] = -light.direction[2];
+
+			lc.inverseLightView = math::affineInverse(lc.lightView);
+		}
+
+		tc.lightCount = lightCount;
 		tc.textureWidth = static_cast<float>(m_width);
 		tc.textureHeight = static_cast<float>(m_height);
 		tc.textureInvWidth = 1.f / m_width;
 		tc.textureInvHeight = 1.f / m_height;
 
-		tc.lightDir[0] = -light.direction[0];
-		tc.lightDir[1] = -light.direction[1];
-		tc.lightDir[2] = -light.direction[2];
 		tc.skyHeight = FLT_MAX;
 		tc.pixelThickness = 1e-4f;
 
 		tc.viewToWorld = viewToWorld;
-		tc.inverseLightView = math::affineInverse(tc.lightView);
 
 		return pDynamicBufferRing.AllocConstantBuffer(sizeof(tc), &tc);
 	}
 
-	void ShadowTrace::Classify(ID3D12GraphicsCommandList* pCommandList, ClassifyMethod method, D3D12_GPU_VIRTUAL_ADDRESS traceControls)
+	void ShadowTrace::Classify(ID3D12GraphicsCommandList* pCommandList, ClassifyMethod method, D3D12_GPU_VIRTUAL_ADDRESS traceControls, uint32_t lightCount)
 	{
 		UserMarker marker(pCommandList, "Classify tiles");
 
@@ -529,14 +632,17 @@ namespace Raytracing
 		ID3D12GraphicsCommandList4* pCmdList4 = nullptr;
 		pCommandList->QueryInterface(&pCmdList4);
 
+		// the trace command of each light sets its index before dispatching the tiles
 		D3D12_GPU_VIRTUAL_ADDRESS address = m_workQueueCount.GetResource()->GetGPUVirtualAddress();
-		D3D12_WRITEBUFFERIMMEDIATE_PARAMETER const params[3] =
+		D3D12_WRITEBUFFERIMMEDIATE_PARAMETER params[4 * k_maxLights] = {};
+		for (uint32_t l = 0; l < lightCount; ++l)
 		{
-			{address + sizeof(uint32_t) * 0, 0},
-			{address + sizeof(uint32_t) * 1, 1},
-			{address + sizeof(uint32_t) * 2, 1},
-		};
-		pCmdList4->WriteBufferImmediate(3, params, nullptr);
+			params[4 * l + 0] = { address + sizeof(uint32_t) * (4 * l + 0), l };
+			params[4 * l + 1] = { address + sizeof(uint32_t) * (4 * l + 1), 0 };
+			params[4 * l + 2] = { address + sizeof(uint32_t) * (4 * l + 2), 1 };
+			params[4 * l + 3] = { address + sizeof(uint32_t) * (4 * l + 3), 1 };
+		}
+		pCmdList4->WriteBufferImmediate(4 * lightCount, params, nullptr);
 		pCmdList4->Release();
 
 		D3D12_RESOURCE_BARRIER postClear[] = {
@@ -558,7 +664,7 @@ namespace Raytracing
 		pCommandList->SetComputeRootDescriptorTable(1, m_classifyTable.GetGPU());
 
 
-		// Dispatch
+		// Dispatch, every group loops over the lights
 		//
 		uint32_t const ThreadGroupCountX = DivRoundUp(m_width, k_tileSizeX);
 		uint32_t const ThreadGroupCountY = DivRoundUp(m_height, k_tileSizeY);
@@ -566,7 +672,7 @@ namespace Raytracing
 
 	}
 
-	void ShadowTrace::Trace(ID3D12GraphicsCommandList* pCommandList, TLAS const& tlas0, TLAS const& tlas1, CBV_SRV_UAV& maskTextures, TraceMethod method, D3D12_GPU_VIRTUAL_ADDRESS traceControls)
+	void ShadowTrace::Trace(ID3D12GraphicsCommandList* pCommandList, TLAS const& tlas0, TLAS const& tlas1, CBV_SRV_UAV& maskTextures, TraceMethod method, D3D12_GPU_VIRTUAL_ADDRESS traceControls, uint32_t lightCount)
 	{
 		UserMarker marker(pCommandList, "Trace shadows");
 
@@ -594,18 +700,18 @@ namespace Raytracing
 
 		assert(tlas0.GetGpuAddress() != 0);
 		assert(tlas1.GetGpuAddress() != 0);
-		// Dispatch
+		// Dispatch, one command per light, a light without tiles costs an empty dispatch
 		//
 		pCommandList->ExecuteIndirect(
-			m_pDispatchIndirect,
-			1,
+			m_pTraceIndirect,
+			lightCount,
 			m_workQueueCount.GetResource(), 0,
 			nullptr, 0);
 
 		m_bIsRayHitShaderRead = false;
 	}
 
-	void ShadowTrace::ResolveHitsToShadowMask(ID3D12GraphicsCommandList* pCommandList, CBV_SRV_UAV& target)
+	void ShadowTrace::ResolveHitsToShadowMask(ID3D12GraphicsCommandList* pCommandList, CBV_SRV_UAV& target, uint32_t lightCount)
 	{
 		UserMarker marker(pCommandList, "Resolve shadow hits");
 
@@ -627,19 +733,18 @@ namespace Raytracing
 
 		// Bind the descriptor set
 		//
-		//pCommandList->SetComputeRootConstantBufferView(0, traceControls);
 		pCommandList->SetComputeRootDescriptorTable(1, m_resolveTable.GetGPU());
 		pCommandList->SetComputeRootDescriptorTable(2, target.GetGPU());
 
 
-		// Dispatch
+		// Dispatch, a slice of groups per light
 		//
 		uint32_t const ThreadGroupCountX = DivRoundUp(m_width, k_tileSizeX);
 		uint32_t const ThreadGroupCountY = DivRoundUp(m_height, k_tileSizeY);
-		pCommandList->Dispatch(ThreadGroupCountX, ThreadGroupCountY, 1);
+		pCommandList->Dispatch(ThreadGroupCountX, ThreadGroupCountY, lightCount);
 	}
 
-	void ShadowTrace::BlendHitsToShadowMask(ID3D12GraphicsCommandList* pCommandList, CBV_SRV_UAV& target)
+	void ShadowTrace::BlendHitsToShadowMask(ID3D12GraphicsCommandList* pCommandList, CBV_SRV_UAV& target, uint32_t lightCount)
 	{
 		UserMarker marker(pCommandList, "Blend shadow hits");
 
@@ -661,21 +766,27 @@ namespace Raytracing
 
 		// Bind the descriptor set
 		//
-		//pCommandList->SetComputeRootConstantBufferView(0, traceControls);
 		pCommandList->SetComputeRootDescriptorTable(1, m_resolveTable.GetGPU());
 		pCommandList->SetComputeRootDescriptorTable(2, target.GetGPU());
 
 
-		// Dispatch
+		// Dispatch, the lights write separate slices so they don't need barriers in between
 		//
-		pCommandList->ExecuteIndirect(
-			m_pDispatchIndirect,
-			1,
-			m_workQueueCount.GetResource(), 0,
-			nullptr, 0);
+		uint32_t const tileCount = DivRoundUp(m_width, k_tileSizeX) * DivRoundUp(m_height, k_tileSizeY);
+		for (uint32_t l = 0; l < lightCount; ++l)
+		{
+			uint32_t const constants[2] = { l, l * tileCount };
+			pCommandList->SetComputeRoot32BitConstants(0, 2, constants, 0);
+
+			pCommandList->ExecuteIndirect(
+				m_pDispatchIndirect,
+				1,
+				m_workQueueCount.GetResource(), sizeof(uint32_t) * (4 * l + 1),
+				nullptr, 0);
+		}
 	}
 
-	void ShadowTrace::DenoiseHitsToShadowMask(ID3D12GraphicsCommandList* pCommandList, DynamicBufferRing& pDynamicBufferRing, Camera const& cam, CBV_SRV_UAV& target, GPUTimestamps* pGpuTimer)
+	void ShadowTrace::DenoiseHitsToShadowMask(ID3D12GraphicsCommandList* pCommandList, DynamicBufferRing& pDynamicBufferRing, Camera const& cam, CBV_SRV_UAV& target, uint32_t lightCount, GPUTimestamps* pGpuTimer)
 	{
 		if (m_bIsRayHitShaderRead == false)
 		{
@@ -692,7 +803,42 @@ namespace Raytracing
 		dc.inverseViewProj = math::affineInverse(cam.GetView()) * dc.inverseProj;
 		dc.reprojection = cam.GetProjection() * (cam.GetPrevView() * dc.inverseViewProj);
 
-		m_denoiser.Denoise(pCommandList, pDynamicBufferRing, dc, m_resolveTable, target, pGpuTimer);
+		m_denoiser.Denoise(pCommandList, pDynamicBufferRing, dc, m_resolveTable, target, lightCount, pGpuTimer);
+	}
+
+	void ShadowTrace::DebugRayHits(ID3D12GraphicsCommandList* pCommandList, CBV_SRV_UAV& target)
+	{
+		UserMarker marker(pCommandList, "Debug ray hits");
+
+		if (m_bIsRayHitShaderRead == false)
+		{
+			D3D12_RESOURCE_BARRIER preResolve[] = {
+				CD3DX12_RESOURCE_BARRIER::Transition(m_rayHitTexture.GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
+			};
+			pCommandList->ResourceBarrier(ARRAYSIZE(preResolve), preResolve);
+			m_bIsRayHitShaderRead = true;
+		}
+
+		// Bind the descriptor heaps and root signature
+		pCommandList->SetComputeRootSignature(m_pResolveRootSig);
+
+		// Bind the pipeline state
+		//
+		pCommandList->SetPipelineState(m_pResolvePso[2]);
+
+		// Bind the descriptor set
+		//
+		uint32_t const constants[2] = { 0, 0 };
+		pCommandList->SetComputeRoot32BitConstants(0, 2, constants, 0);
+		pCommandList->SetComputeRootDescriptorTable(1, m_resolveTable.GetGPU());
+		pCommandList->SetComputeRootDescriptorTable(2, target.GetGPU());
+
+
+		// Dispatch
+		//
+		uint32_t const ThreadGroupCountX = DivRoundUp(m_width, k_tileSizeX);
+		uint32_t const ThreadGroupCountY = DivRoundUp(m_height, k_tileSizeY);
+		pCommandList->Dispatch(ThreadGroupCountX, ThreadGroupCountY, 1);
 	}
 
 	void ShadowTrace::DebugTileClassification(ID3D12GraphicsCommandList* pCommandList, uint32_t debugMode, CBV_SRV_UAV& target)
@@ -712,12 +858,12 @@ namespace Raytracing
 		pCommandList->SetComputeRootDescriptorTable(1, m_debugTable.GetGPU());
 		pCommandList->SetComputeRootDescriptorTable(2, target.GetGPU());
 
-		// Dispatch
+		// Dispatch, the first light's list starts at the beginning of the work queue
 		//
 		pCommandList->ExecuteIndirect(
 			m_pDispatchIndirect,
 			1,
-			m_workQueueCount.GetResource(), 0,
+			m_workQueueCount.GetResource(), sizeof(uint32_t),
 			nullptr, 0);
 	}
 }
\ No newline at end of file
@@ -38,36 +38,49 @@ namespace Raytracing
 		MixedTlas
 	};
 
+	struct LightControls
+	{
+		float lightDir[3];
+		float sunSizeLightSpace;
+
+		math::Vector4 cascadeScale[4];
+		math::Vector4 cascadeOffset[4];
+
+		math::Matrix4 lightView;
+		math::Matrix4 inverseLightView;
+
+		uint32_t cascadeSliceOffset;
+		uint32_t _pad[3];
+	};
+
 	struct TraceControls
 	{
 		float textureWidth;
 		float textureHeight;
 		float textureInvWidth;
 		float textureInvHeight;
-		float lightDir[3];
-		float  skyHeight;
 
+		uint32_t lightCount;
+		float  skyHeight;
 		float pixelThickness;
 		float sunSize;
+
 		float noisePhase;
 		bool  bRejectLitPixels;
+		uint32_t tileTolerance;
+		bool   bUseCascadesForRayT;
 
 		uint32_t cascadeCount;
 		uint32_t activeCascades;
-		uint32_t tileTolerance;
-		float  blockerOffset;
-
 		float  cascadePixelSize;
 		float  cascadeSize;
-		float  sunSizeLightSpace;
-		bool   bUseCascadesForRayT;
 
-		math::Vector4 cascadeScale[4];
-		math::Vector4 cascadeOffset[4];
+		float  blockerOffset;
+		float  _pad[3];
 
 		math::Matrix4 viewToWorld;
-		math::Matrix4 lightView;
-		math::Matrix4 inverseLightView;
+
+		LightControls lights[k_maxLights];
 	};
 
 	class ShadowTrace
@@ -89,17 +102,26 @@ namespace Raytracing
 
 		void SetBlueNoise(Texture& noise);
 		void SetUVBuffer(Texture& buffer);
+		void SetOpacityMicromaps(Texture& buffer);
+		void SetAlphaMasks(Device* pDevice, Texture& masks);
+
+		void SetLightCount(Device* pDevice, uint32_t lightCount);
 
 
-		D3D12_GPU_VIRTUAL_ADDRESS BuildTraceControls(DynamicBufferRing& pDynamicBufferRing, Light const& light, math::Matrix4 const& viewToWorld, TraceControls& tc);
+		// The lightView, cascade and slice offset members of tc.lights have to be set by the caller
+		D3D12_GPU_VIRTUAL_ADDRESS BuildTraceControls(DynamicBufferRing& pDynamicBufferRing, Light const* const* ppLights, uint32_t lightCount, math::Matrix4 const& viewToWorld, TraceControls& tc);
 
-		void Classify(ID3D12GraphicsCommandList* pCommandList, ClassifyMethod method, D3D12_GPU_VIRTUAL_ADDRESS traceControls);
-		void Trace(ID3D12GraphicsCommandList* pCommandList, TLAS const& tlas0, TLAS const& tlas1, CBV_SRV_UAV& maskTextures, TraceMethod method, D3D12_GPU_VIRTUAL_ADDRESS traceControls);
+		// All the lights are classified and traced together, each one only traces the tiles of its own list.
+		void Classify(ID3D12GraphicsCommandList* pCommandList, ClassifyMethod method, D3D12_GPU_VIRTUAL_ADDRESS traceControls, uint32_t lightCount);
+		void Trace(ID3D12GraphicsCommandList* pCommandList, TLAS const& tlas0, TLAS const& tlas1, CBV_SRV_UAV& maskTextures, TraceMethod method, D3D12_GPU_VIRTUAL_ADDRESS traceControls, uint32_t lightCount);
 
-		void ResolveHitsToShadowMask(ID3D12GraphicsCommandList* pCommandList, CBV_SRV_UAV& target);
-		void BlendHitsToShadowMask(ID3D12GraphicsCommandList* pCommandList, CBV_SRV_UAV& target);
-		void DenoiseHitsToShadowMask(ID3D12GraphicsCommandList *pCommandList, DynamicBufferRing& pDynamicBufferRing, Camera const& cam, CBV_SRV_UAV& target, GPUTimestamps* pGpuTimer = nullptr);
+		// The targets are R8 texture arrays with a slice per light
+		void ResolveHitsToShadowMask(ID3D12GraphicsCommandList* pCommandList, CBV_SRV_UAV& target, uint32_t lightCount);
+		void BlendHitsToShadowMask(ID3D12GraphicsCommandList* pCommandList, CBV_SRV_UAV& target, uint32_t lightCount);
+		void DenoiseHitsToShadowMask(ID3D12GraphicsCommandList *pCommandList, DynamicBufferRing& pDynamicBufferRing, Camera const& cam, CBV_SRV_UAV& target, uint32_t lightCount, GPUTimestamps* pGpuTimer = nullptr);
 
+		// Debug views of the first light
+		void DebugRayHits(ID3D12GraphicsCommandList* pCommandList, CBV_SRV_UAV& target);
 		void DebugTileClassification(ID3D12GraphicsCommandList* pCommandList, uint32_t debugMode, CBV_SRV_UAV& target);
 
 	private:
@@ -124,7 +146,7 @@ namespace Raytracing
 		CBV_SRV_UAV m_classifyTable;
 
 		ID3D12RootSignature* m_pResolveRootSig;
-		ID3D12PipelineState* m_pResolvePso[2];
+		ID3D12PipelineState* m_pResolvePso[3];
 		CBV_SRV_UAV m_resolveTable;
 
 		ID3D12RootSignature* m_pDebugRootSig;
@@ -132,6 +154,7 @@ namespace Raytracing
 		CBV_SRV_UAV m_debugTable;
 
 		ID3D12CommandSignature* m_pDispatchIndirect;
+		ID3D12CommandSignature* m_pTraceIndirect;
 
 		StaticResourceViewHeap m_cpuHeap;
 		CBV_SRV_UAV m_cpuTable;
@@ -0,0 +1,345 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+#include <intrin.h>
+
+#include "TriangleUVPacker.h"
+
+namespace
+{
+    typedef TriangleUVPacker::UV UV;
+
+    // The index width is a template parameter so that the decode loops don't switch per index
+    template <typename Index>
+    void DecodeIndices(tfAccessor const& indexBuffer, uint32_t* pIndices)
+    {
+        Index const* pSource = reinterpret_cast<Index const*>(indexBuffer.Get(0));
+        for (uint32_t index = 0; index < (uint32_t)indexBuffer.m_count; ++index)
+        {
+            pIndices[index] = pSource[index];
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    //
+    // Copyright (c) 2002, Industrial Light & Magic, a division of Lucas
+    // Digital Ltd. LLC
+    // 
+    // All rights reserved.
+    // 
+    // Redistribution and use in source and binary forms, with or without
+    // modification, are permitted provided that the following conditions are
+    // met:
+    // *       Redistributions of source code must retain the above copyright
+    // notice, this list of conditions and the following disclaimer.
+    // *       Redistributions in binary form must reproduce the above
+    // copyright notice, this list of conditions and the following disclaimer
+    // in the documentation and/or other materials provided with the
+    // distribution.
+    // *       Neither the name of Industrial Light & Magic nor the names of
+    // its contributors may be used to endorse or promote products derived
+    // from this software without specific prior written permission. 
+    // 
+    // THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+    // "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+    // LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+    // A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+    // OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+    // SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+    // LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+    // DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+    // THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    // (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+    //
+    ///////////////////////////////////////////////////////////////////////////
+    uint16_t ConvertToHalf(uint32_t i)
+    {
+        //
+        // Our floating point number, f, is represented by the bit
+        // pattern in integer i.  Disassemble that bit pattern into
+        // the sign, s, the exponent, e, and the significand, m.
+        // Shift s into the position where it will go in in the
+        // resulting half number.
+        // Adjust e, accounting for the different exponent bias
+        // of float and half (127 versus 15).
+        //
+
+        int s = (i >> 16) & 0x00008000;
+        int e = ((i >> 23) & 0x000000ff) - (127 - 15);
+        int m = i & 0x007fffff;
+
+        //
+        // Now reassemble s, e and m into a half:
+        //
+
+        if (e <= 0)
+        {
+            if (e < -10)
+            {
+                //
+                // E is less than -10.  The absolute value of f is
+                // less than HALF_MIN (f may be a small normalized
+                // float, a denormalized float or a zero).
+                //
+                // We convert f to a half zero with the same sign as f.
+                //
+
+                return s;
+            }
+
+            //
+            // E is between -10 and 0.  F is a normalized float
+            // whose magnitude is less than HALF_NRM_MIN.
+            //
+            // We convert f to a denormalized half.
+            //
+
+            //
+            // Add an explicit leading 1 to the significand.
+            // 
+
+            m = m | 0x00800000;
+
+            //
+            // Round to m to the nearest (10+e)-bit value (with e between
+            // -10 and 0); in case of a tie, round to the nearest even value.
+            //
+            // Rounding may cause the significand to overflow and make
+            // our number normalized.  Because of the way a half's bits
+            // are laid out, we don't have to treat this case separately;
+            // the code below will handle it correctly.
+            // 
+
+            int t = 14 - e;
+            int a = (1 << (t - 1)) - 1;
+            int b = (m >> t) & 1;
+
+            m = (m + a + b) >> t;
+
+            //
+            // Assemble the half from s, e (zero) and m.
+            //
+
+            return s | m;
+        }
+        else if (e == 0xff - (127 - 15))
+        {
+            if (m == 0)
+            {
+                //
+                // F is an infinity; convert f to a half
+                // infinity with the same sign as f.
+                //
+
+                return s | 0x7c00;
+            }
+            else
+            {
+                //
+                // F is a NAN; we produce a half NAN that preserves
+                // the sign bit and the 10 leftmost bits of the
+                // significand of f, with one exception: If the 10
+                // leftmost bits are all zero, the NAN would turn 
+                // into an infinity, so we have to set at least one
+                // bit in the significand.
+                //
+
+                m >>= 13;
+                return s | 0x7c00 | m | (m == 0);
+            }
+        }
+        else
+        {
+            //
+            // E is greater than zero.  F is a normalized float.
+            // We try to convert f to a normalized half.
+            //
+
+            //
+            // Round to m to the nearest 10-bit value.  In case of
+            // a tie, round to the nearest even value.
+            //
+
+            m = m + 0x00000fff + ((m >> 13) & 1);
+
+            if (m & 0x00800000)
+            {
+                m = 0;		// overflow in significand,
+                e += 1;		// adjust exponent
+            }
+
+            //
+            // Handle exponent overflow
+            //
+
+            if (e > 30)
+            {
+                return s | 0x7c00;	// if this returns, the half becomes an
+            }   			// infinity with the same sign as f.
+
+            //
+            // Assemble the half from s, e and m.
+            //
+
+            return s | (e << 10) | (m >> 13);
+        }
+    }
+
+    // F16C needs the OS to save the AVX state too
+    bool DetectF16C(void)
+    {
+        int info[4];
+        __cpuid(info, 1);
+
+        bool const bOSXSave = (info[2] & (1 << 27)) != 0;
+        bool const bAVX = (info[2] & (1 << 28)) != 0;
+        bool const bF16C = (info[2] & (1 << 29)) != 0;
+        return bOSXSave && bAVX && bF16C && (_xgetbv(0) & 0x6) == 0x6;
+    }
+
+    // F16C rounds to nearest even like ConvertToHalf. They would only differ on signaling NaNs, where
+    // F16C also sets the quiet bit, but the subtraction has already made every NaN a quiet one.
+    template <typename Index, bool bF16C>
+    void PackTriangleUVs(tfAccessor const& uvBuffer, tfAccessor const& indexBuffer, std::vector<UV>& uvs)
+    {
+        uint32_t const triangleCount = (uint32_t)indexBuffer.m_count / 3;
+        size_t const firstUV = uvs.size();
+        uvs.resize(firstUV + triangleCount);
+
+        Index const* pIndices = reinterpret_cast<Index const*>(indexBuffer.Get(0));
+        char const* pUVs = reinterpret_cast<char const*>(uvBuffer.Get(0));
+        size_t const uvStride = uvBuffer.m_stride;
+        UV* pOut = uvs.data() + firstUV;
+        for (uint32_t prim = 0; prim < triangleCount; ++prim, pIndices += 3, ++pOut)
+        {
+            float const* pUV0 = reinterpret_cast<float const*>(pUVs + uvStride * pIndices[0]);
+            float const* pUV1 = reinterpret_cast<float const*>(pUVs + uvStride * pIndices[1]);
+            float const* pUV2 = reinterpret_cast<float const*>(pUVs + uvStride * pIndices[2]);
+
+            // uv1 - uv0 in the low half, uv2 - uv0 in the high half, in the layout of uv01 and uv02
+            __m128 const uv0 = _mm_castpd_ps(_mm_load1_pd(reinterpret_cast<double const*>(pUV0)));
+            __m128 const uv12 = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<__m64 const*>(pUV1)), reinterpret_cast<__m64 const*>(pUV2));
+            __m128 const deltas = _mm_sub_ps(uv12, uv0);
+
+            pOut->uv0 = math::Point2(pUV0[0], pUV0[1]);
+            if (bF16C)
+            {
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(pOut->uv01), _mm_cvtps_ph(deltas, _MM_FROUND_TO_NEAREST_INT));
+            }
+            else
+            {
+                float delta[4];
+                _mm_storeu_ps(delta, deltas);
+                pOut->uv01[0] = TriangleUVPacker::ToF16(delta[0]);
+                pOut->uv01[1] = TriangleUVPacker::ToF16(delta[1]);
+                pOut->uv02[0] = TriangleUVPacker::ToF16(delta[2]);
+                pOut->uv02[1] = TriangleUVPacker::ToF16(delta[3]);
+            }
+        }
+    }
+
+    template <bool bF16C>
+    void PackTriangleUVs(tfAccessor const& uvBuffer, tfAccessor const& indexBuffer, std::vector<UV>& uvs)
+    {
+        switch (indexBuffer.m_stride)
+        {
+        case 1:
+            PackTriangleUVs<uint8_t, bF16C>(uvBuffer, indexBuffer, uvs);
+            break;
+        case 2:
+            PackTriangleUVs<uint16_t, bF16C>(uvBuffer, indexBuffer, uvs);
+            break;
+        case 4:
+            PackTriangleUVs<uint32_t, bF16C>(uvBuffer, indexBuffer, uvs);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void TriangleUVPacker::ReadIndices(tfAccessor const& indexBuffer, std::vector<uint32_t>& indices)
+{
+    indices.resize(indexBuffer.m_count);
+    switch (indexBuffer.m_stride)
+    {
+    case 1:
+        DecodeIndices<uint8_t>(indexBuffer, indices.data());
+        break;
+    case 2:
+        DecodeIndices<uint16_t>(indexBuffer, indices.data());
+        break;
+    case 4:
+        DecodeIndices<uint32_t>(indexBuffer, indices.data());
+        break;
+    default:
+        std::fill(indices.begin(), indices.end(), ~0u);
+        break;
+    }
+}
+
+uint16_t TriangleUVPacker::ToF16(float f)
+{
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+    return ConvertToHalf(x);
+}
+
+float TriangleUVPacker::FromF16(uint16_t h)
+{
+    uint32_t const s = (uint32_t)(h & 0x8000) << 16;
+    uint32_t const e = (h >> 10) & 0x1f;
+    uint32_t const m = h & 0x3ff;
+
+    if (e == 0)
+    {
+        // zero or denormal, exact in a float
+        float const f = ldexpf((float)m, -24);
+        return s ? -f : f;
+    }
+
+    uint32_t const x = e == 0x1f
+        ? s | 0x7f800000 | (m << 13)
+        : s | ((e + (127 - 15)) << 23) | (m << 13);
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+bool TriangleUVPacker::IsF16CSupported(void)
+{
+    static bool const bF16C = DetectF16C();
+    return bF16C;
+}
+
+void TriangleUVPacker::AppendTriangleUVs(tfAccessor const& uvBuffer, tfAccessor const& indexBuffer, std::vector<UV>& uvs, bool bUseF16C)
+{
+    assert(uvBuffer.m_stride == 8);
+
+    if (bUseF16C && IsF16CSupported())
+    {
+        PackTriangleUVs<true>(uvBuffer, indexBuffer, uvs);
+    }
+    else
+    {
+        PackTriangleUVs<false>(uvBuffer, indexBuffer, uvs);
+    }
+}
@@ -0,0 +1,51 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+//--------------------------------------------------------------------------------------
+// Reads the glTF index buffers and packs the UVs of the alpha masked triangles, one entry
+// per triangle with uv0 as floats and the deltas to the other two corners as halfs. The
+// deltas are converted with F16C when the CPU has it, the result is the same as ToF16.
+//--------------------------------------------------------------------------------------
+class TriangleUVPacker
+{
+public:
+    // UV in RaytracingCommon.h, uvDensity and normal are filled in after the packing
+    struct UV
+    {
+        math::Point2 uv0;
+        uint16_t uv01[2];
+        uint16_t uv02[2];
+        float uvDensity;
+        uint32_t normal; // octahedral, 16 bit snorm x in the low half and y in the high half
+    };
+
+    // Indices of any width as 32 bit ones, ~0 for a width glTF doesn't allow
+    static void ReadIndices(tfAccessor const& indexBuffer, std::vector<uint32_t>& indices);
+
+    static uint16_t ToF16(float f);
+    static float FromF16(uint16_t h);
+
+    static bool IsF16CSupported(void);
+
+    // One entry per triangle, in the order of the index buffer. bUseF16C = false forces the
+    // scalar conversion, which gives the same result.
+    static void AppendTriangleUVs(tfAccessor const& uvBuffer, tfAccessor const& indexBuffer, std::vector<UV>& uvs, bool bUseF16C = true);
+};
@@ -308,6 +308,8 @@ void HybridRaytracer::BuildUI()
             ImGui::Checkbox("Use shadow maps to get Ray TMin and TMax", &m_UIState.bUseCascadesForRayT);
 
             ImGui::SliderInt("Tile cut off", (int*)&m_UIState.tileCutoff, 0, 32);
+            ImGui::SliderInt("Skinned BLAS rebuild interval", &m_UIState.skinnedBLASRebuildInterval, 1, 120);
+            ImGui::Checkbox("Cull TLAS instances that can't shadow the view", &m_UIState.bCullTLASInstances);
 
             {
                 char const* modes[] =
@@ -354,16 +356,29 @@ void HybridRaytracer::BuildUI()
                 }
             }
 
-            for (int i = 0; i < m_UIState.numCascades - 1; ++i)
+            ImGui::Checkbox("Fit cascades to visible depth (SDSM)", &m_UIState.bSampleDistributionCascades);
+            if (m_UIState.bSampleDistributionCascades)
+            {
+                ImGui::SliderFloat("Partition log weight", &m_UIState.cascadePartitionLogWeight, 0.0f, 1.0f);
+            }
+
+            for (int i = 0; m_UIState.bSampleDistributionCascades == false && i < m_UIState.numCascades - 1; ++i)
             {
                 ImGui::SliderFloat(format("Cascade splitpoints %i", i).c_str(), &m_UIState.cascadeSplitPoint[i],
                     0.0f, 100.0f, "%.2f%%");
             }
 
-            const char* cascadeType[] = { "FIT_TO_CASCADES", "FIT_TO_SCENE" };
+            const char* cascadeType[] = { "FIT_TO_CASCADES", "FIT_TO_SCENE", "FIT_TO_BOUNDING_SPHERE" };
             ImGui::Combo("cascadeType", &m_UIState.cascadeType, cascadeType, _countof(cascadeType));
+            for (int i = 0; i < m_UIState.numCascades; ++i)
+            {
+                ImGui::SliderInt(format("Cascade update interval %i", i).c_str(), &m_UIState.cascadeUpdateInterval[i], 1, 8);
+            }
+
+            ImGui::Checkbox("Cache static shadow casters", &m_UIState.bCacheStaticShadowCasters);
             ImGui::Checkbox("bMoveLightTexelSize", &m_UIState.bMoveLightTexelSize);
-            const char* cascadeFitType[] = { "FIT_NEARFAR_PANCAKING", "FIT_NEARFAR_ZERO_ONE", "FIT_NEARFAR_AABB", "FIT_NEARFAR_SCENE_AABB" };
+            const char* cascadeFitType[] = { "FIT_NEARFAR_ZERO_ONE", "FIT_NEARFAR_AABB", "FIT_NEARFAR_SCENE_AABB" };
+            ImGui::Combo("cascadeFitType", &m_UIState.cascadeFitType, cascadeFitType, _countof(cascadeFitType));
             ImGui::SliderFloat("Blur Between Cascades Amount", &m_UIState.blurBetweenCascadesAmount,
                 0.0f, 0.01f);
             ImGui::SliderFloat("PCF offset", &m_UIState.pcfOffset,
@@ -477,6 +492,7 @@ void UIState::Initialize()
     this->shadowMapWidthIndex = 4;
     this->shadowMapWidth = k_shadowMapWidths[this->shadowMapWidthIndex];
     this->numCascades = 3;
+    this->numShadowedLights = 1;
     this->cascadeSplitPoint[0] = 10.0f;
     this->cascadeSplitPoint[1] = 20.0f;
     this->cascadeSplitPoint[2] = 60.0f;
@@ -485,7 +501,15 @@ void UIState::Initialize()
     this->cascadeSkipIndexes[1] = false;
     this->cascadeSkipIndexes[2] = false;
     this->cascadeSkipIndexes[3] = false;
+    this->cascadeUpdateInterval[0] = 1;
+    this->cascadeUpdateInterval[1] = 2;
+    this->cascadeUpdateInterval[2] = 4;
+    this->cascadeUpdateInterval[3] = 4;
+    this->bCacheStaticShadowCasters = true;
     this->cascadeType = 1;
+    this->cascadeFitType = 2;
+    this->bSampleDistributionCascades = false;
+    this->cascadePartitionLogWeight = 0.7f;
     this->bMoveLightTexelSize = true;
     this->blurBetweenCascadesAmount = 0.005f;
     this->pcfOffset = 0.002f;
@@ -498,6 +522,16 @@ void UIState::Initialize()
     this->amMode = RtAlphaMaskMode::Mixed;
     this->hMode = RtHybridMode::RaytracingOnly;
     this->tileCutoff = 0;
+    this->bCompactBLAS = false;
+    this->shadowProxyRatio = 1.0f;
+    this->shadowProxyMaxError = 0.01f;
+    this->shadowQuantizationMaxError = 0.001f;
+    this->staticMergeMaxSize = 1.0f;
+    this->staticMergeClusterSize = 8.0f;
+    this->opacityMicromapMaxLevel = 4;
+    this->alphaMaskSize = 512;
+    this->skinnedBLASRebuildInterval = 30;
+    this->bCullTLASInstances = true;
 }
 
 
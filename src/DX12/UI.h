@@ -88,13 +88,30 @@ struct UIState
     RtAlphaMaskMode amMode;
     RtHybridMode    hMode;
     uint32_t tileCutoff;
+    bool bCompactBLAS; // applied on scene load
+    float shadowProxyRatio; // applied on scene load, 1 traces the render geometry
+    float shadowProxyMaxError;
+    float shadowQuantizationMaxError; // applied on scene load, 0 keeps float positions in the BLASes
+    float staticMergeMaxSize; // applied on scene load, static primitives up to this size share BLASes, 0 disables
+    float staticMergeClusterSize;
+    int opacityMicromapMaxLevel; // applied on scene load, masked triangles are split into up to 4^level micro triangles, -1 disables
+    uint32_t alphaMaskSize; // applied on scene load, largest slice of the alpha mask array
+    std::string sceneCachePath; // applied on scene load, where the prepared BLAS inputs are cached, empty doesn't cache
+    int skinnedBLASRebuildInterval; // in frames, refit in between
+    bool bCullTLASInstances; // leave out the instances that can't shadow anything visible
 
     int shadowMapWidthIndex;
     int shadowMapWidth;
     int numCascades;
+    int numShadowedLights; // directional lights with their own cascades, set on scene load
     float cascadeSplitPoint[4]; // max of 4 cascades
     int cascadeSkipIndexes[4];
+    int cascadeUpdateInterval[4]; // in frames
+    bool bCacheStaticShadowCasters;
     int cascadeType;
+    int cascadeFitType;
+    bool bSampleDistributionCascades;
+    float cascadePartitionLogWeight;
     bool bMoveLightTexelSize;
     float blurBetweenCascadesAmount;
     float pcfOffset;
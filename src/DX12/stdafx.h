@@ -13,7 +13,10 @@
 #include <malloc.h>
 #include <map>
 #include <mutex>
+#include <atomic>
+#include <thread>
 #include <vector>
+#include <unordered_map>
 #include <fstream>
 
 #include "../../libs/d3d12x/d3dx12.h"
@@ -68,8 +71,13 @@
 
 #include "Widgets/wireframe.h"
 
+#include "ShadowCasterCulling.h"
+#include "SceneBounds.h"
 #include "CSMManager.h"
 #include "CustomShadowResolvePass.h"
+#include "DepthReduction.h"
+#include "ShadowMaskCombine.h"
+#include "AllocationCounter.h"
 
 
 using namespace CAULDRON_DX12;
@@ -0,0 +1,88 @@
+// AMD Cauldron code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#define THREADGROUP_SIZE 64
+
+//--------------------------------------------------------------------------------------
+// Constant Buffers
+//--------------------------------------------------------------------------------------
+cbuffer cb_skinning : register(b0)
+{
+	uint vertexCount;
+	uint jointStride;  // 4 for 8 bit joint indices, 8 for 16 bit ones
+	uint outputOffset; // in bytes
+};
+
+struct Matrix2
+{
+	matrix current;
+	matrix previous;
+};
+
+// same layout as GLTFTexturesAndBuffers::SetSkinningMatricesForSkeletons
+cbuffer cb_skeleton : register(b1)
+{
+	Matrix2 skinningMatrices[200];
+};
+
+//--------------------------------------------------------------------------------------
+// Buffer definitions
+//--------------------------------------------------------------------------------------
+ByteAddressBuffer   rb_positions : register(t0); // float3
+ByteAddressBuffer   rb_joints    : register(t1); // uint8_t4 or uint16_t4
+ByteAddressBuffer   rb_weights   : register(t2); // float4
+
+RWByteAddressBuffer rwb_skinnedPositions : register(u0);
+
+uint4 LoadJoints(uint vertexIndex)
+{
+	if (jointStride == 4)
+	{
+		uint const packed = rb_joints.Load(vertexIndex * 4);
+		return uint4(packed & 0xff, (packed >> 8) & 0xff, (packed >> 16) & 0xff, packed >> 24);
+	}
+
+	uint2 const packed = rb_joints.Load2(vertexIndex * 8);
+	return uint4(packed.x & 0xffff, packed.x >> 16, packed.y & 0xffff, packed.y >> 16);
+}
+
+//--------------------------------------------------------------------------------------
+// Main function
+//--------------------------------------------------------------------------------------
+[numthreads(THREADGROUP_SIZE, 1, 1)]
+void main(uint vertexIndex : SV_DispatchThreadID)
+{
+	if (vertexIndex >= vertexCount)
+		return;
+
+	float3 const bindPosition = asfloat(rb_positions.Load3(vertexIndex * 12));
+	uint4 const joints = LoadJoints(vertexIndex);
+	float4 const weights = asfloat(rb_weights.Load4(vertexIndex * 16));
+
+	// the skinning matrices already include the node transform, so the result is in world space
+	matrix const skinningMatrix =
+		weights.x * skinningMatrices[joints.x].current +
+		weights.y * skinningMatrices[joints.y].current +
+		weights.z * skinningMatrices[joints.z].current +
+		weights.w * skinningMatrices[joints.w].current;
+
+	float3 const position = mul(skinningMatrix, float4(bindPosition, 1)).xyz;
+
+	rwb_skinnedPositions.Store3(outputOffset + vertexIndex * 12, asuint(position));
+}
@@ -41,9 +41,10 @@ Texture2DArray<float>  t2d_shadowMap : register(t2);
 
 // using uint4 so we can pack the tile ourselves
 RWStructuredBuffer<uint4> rwsb_tiles : register(u0);
+// per light the dispatch arguments of its tile list, the light index followed by the group count
 globallycoherent RWBuffer<uint> rwb_tileCount : register(u1);
 
-RWTexture2D<uint> rwt2d_rayHitResults : register(u2);
+RWTexture2DArray<uint> rwt2da_rayHitResults : register(u2);
 
 SamplerState ss_point : register(s0);
 SamplerComparisonState scs_shadows : register(s1);
@@ -52,15 +53,16 @@ SamplerComparisonState scs_shadows : register(s1);
 // Main function
 //--------------------------------------------------------------------------------------
 
-void WriteTile(Tile const currentTile)
+void WriteTile(Tile const currentTile, uint const lightIndex)
 {
 	uint index = ~0;
-	InterlockedAdd(rwb_tileCount[0], 1, index);
-	rwsb_tiles[index] = Tile::ToUint(currentTile);
+	InterlockedAdd(rwb_tileCount[4 * lightIndex + 1], 1, index);
+	rwsb_tiles[GetLightTileOffset(lightIndex) + index] = Tile::ToUint(currentTile);
 }
 
 ClassifyResults Classify(
 	uint2 const pixelCoord,
+	LightControls const light,
 	bool const bUseNormal,
 	bool const bUseCascadeSplits,
 	bool const bUseCascadeBlocking)
@@ -77,7 +79,7 @@ ClassifyResults Classify(
 	if (bUseNormal && bIsActiveLane)
 	{
 		float3 const normal = normalize(t2d_normals[pixelCoord].xyz * 2 - 1.f);
-		bool const bIsNormalFacingLight = dot(normal, -lightDir) > 0;
+		bool const bIsNormalFacingLight = dot(normal, -light.lightDir) > 0;
 
 		bIsActiveLane = bIsActiveLane && bIsNormalFacingLight;
 	}
@@ -88,7 +90,7 @@ ClassifyResults Classify(
 		float4 const homogeneous = mul(viewToWorld, float4(2.0f * float2(uv.x, 1.0f - uv.y) - 1.0f, depth, 1));
 		float3 const worldPos = homogeneous.xyz / homogeneous.w;
 
-		float3 const lightViewSpacePos = mul(lightView, float4(worldPos, 1)).xyz;
+		float3 const lightViewSpacePos = mul(light.lightView, float4(worldPos, 1)).xyz;
 
 		bool bIsInActiveCascade = false;
 		if (bUseCascadeSplits)
@@ -97,7 +99,7 @@ ClassifyResults Classify(
 			{
 				uint const cascadeMask = 1 << i;
 
-				float3 const shadowCoord = lightViewSpacePos * cascadeScale[i].xyz + cascadeOffset[i].xyz;
+				float3 const shadowCoord = lightViewSpacePos * light.cascadeScale[i].xyz + light.cascadeOffset[i].xyz;
 				if (min(shadowCoord.x, shadowCoord.y) > 0 && max(shadowCoord.x, shadowCoord.y) < 1)
 				{
 					bIsInActiveCascade = cascadeMask & activeCascades;
@@ -108,13 +110,13 @@ ClassifyResults Classify(
 
 		if (bUseCascadeBlocking)
 		{
-			float const radius = sunSizeLightSpace * lightViewSpacePos.z;
+			float const radius = light.sunSizeLightSpace * lightViewSpacePos.z;
 
 			float3 shadowCoord = float3(0, 0, 0);
 			uint cascadeIndex = 0;
 			for (uint i = 0; i < cascadeCount; ++i)
 			{
-				shadowCoord = lightViewSpacePos * cascadeScale[i].xyz + cascadeOffset[i].xyz;
+				shadowCoord = lightViewSpacePos * light.cascadeScale[i].xyz + light.cascadeOffset[i].xyz;
 				if (all(shadowCoord.xy > 0) && all(shadowCoord.xy < 1))
 				{
 					cascadeIndex = i;
@@ -124,7 +126,7 @@ ClassifyResults Classify(
 
 			// grow search area by a pixel to make sure we search a wide enough area
 			// also scale everything from UV to pixel coord for image loads.
-			float2 const radiusCoord = abs(radius * cascadeScale[cascadeIndex].xy) * cascadeSize + 1.xx;
+			float2 const radiusCoord = abs(radius * light.cascadeScale[cascadeIndex].xy) * cascadeSize + 1.xx;
 			shadowCoord.xy *= cascadeSize;
 
 			float const depthCmp = shadowCoord.z - blockerOffset;
@@ -139,7 +141,7 @@ ClassifyResults Classify(
 			for (uint x = 0; x < k_poissonDiscSampleCountHigh; ++x)
 			{
 				float2 const sampleUV = shadowCoord.xy + k_poissonDisc[x] * radiusCoord + 0.5f;
-				float const pixelDepth = t2d_shadowMap.Load(uint4(sampleUV, cascadeIndex, 0));
+				float const pixelDepth = t2d_shadowMap.Load(uint4(sampleUV, light.cascadeSliceOffset + cascadeIndex, 0));
 
 				// using min and max to reduce number of cmps
 				maxD = max(maxD, pixelDepth);
@@ -158,12 +160,12 @@ ClassifyResults Classify(
 
 			if (bIsInActiveCascade && bUseCascadesForRayT)
 			{
-				float const viewMinT = abs(max(shadowCoord.z - closetDepth - blockerOffset, 0) / cascadeScale[cascadeIndex].z);
-				float const viewMaxT = abs((shadowCoord.z - minD + blockerOffset) / cascadeScale[cascadeIndex].z);
+				float const viewMinT = abs(max(shadowCoord.z - closetDepth - blockerOffset, 0) / light.cascadeScale[cascadeIndex].z);
+				float const viewMaxT = abs((shadowCoord.z - minD + blockerOffset) / light.cascadeScale[cascadeIndex].z);
 
 				// if its knowen that the light view matrix is only a rotation or has unifrom scale this can be optimized.
-				minT = length(mul(inverseLightView, float4(0, 0, viewMinT, 0)).xyz);
-				maxT = length(mul(inverseLightView, float4(0, radius, viewMaxT, 0)).xyz);
+				minT = length(mul(light.inverseLightView, float4(0, 0, viewMinT, 0)).xyz);
+				maxT = length(mul(light.inverseLightView, float4(0, radius, viewMaxT, 0)).xyz);
 
 			}
 		}
@@ -176,104 +178,84 @@ ClassifyResults Classify(
 	return results;
 }
 
-[numthreads(TILE_SIZE_X * TILE_SIZE_Y, 1, 1)]
-void ClassifyByNormal(uint localIndex : SV_GroupIndex, uint3 groupID : SV_GroupID)
+// Classifies the tile for all the lights in one dispatch, every light gets its own tile list and
+// ray hit mask so the trace only runs on the tiles each light needs.
+void ClassifyTile(
+	uint const localIndex,
+	uint2 const groupID,
+	bool const bUseNormal,
+	bool const bUseCascadeSplits,
+	bool const bUseCascadeBlocking)
 {
 	uint2 const localID = FXX_Rmp8x8(localIndex);
-	uint2 const pixelCoord = groupID.xy * k_tileSize + localID.xy;
-
-	ClassifyResults const results =
-		Classify(
-			pixelCoord,
-			true,
-			false,
-			false);
+	uint2 const pixelCoord = groupID * k_tileSize + localID.xy;
 
-	Tile currentTile = Tile::Create(groupID.xy);
-	uint const mask = BoolToWaveMask(results.bIsActiveLane, localID);
-	currentTile.mask = mask;
-
-	uint const lightMask = BoolToWaveMask(results.bIsInLight, localID);
-
-	bool const bDiscardTile = (countbits(mask) <= tileTolerance);
-	if (localIndex == 0)
+	for (uint lightIndex = 0; lightIndex < lightCount; ++lightIndex)
 	{
-		if (!bDiscardTile)
+		ClassifyResults const results =
+			Classify(
+				pixelCoord,
+				lights[lightIndex],
+				bUseNormal,
+				bUseCascadeSplits,
+				bUseCascadeBlocking);
+
+		Tile currentTile = Tile::Create(groupID);
+		uint const mask = BoolToWaveMask(results.bIsActiveLane, localID);
+		currentTile.mask = mask;
+		if (bUseCascadeBlocking && bUseCascadesForRayT)
 		{
-			WriteTile(currentTile);
+			// At lest one lane must be active for the tile to be written out, so the infinitly and zero will be removed by the wave min and max.
+			// Otherwise we will get minT to be infinite and maxT to be 0
+			currentTile.minT = max(WaveActiveMin(results.minT), currentTile.minT);
+			currentTile.maxT = min(WaveActiveMax(results.maxT), currentTile.maxT);
 		}
 
-		rwt2d_rayHitResults[groupID.xy] = ~lightMask;
+		uint const lightMask = BoolToWaveMask(results.bIsInLight, localID);
+
+		bool const bDiscardTile = (countbits(mask) <= tileTolerance);
+		if (localIndex == 0)
+		{
+			if (!bDiscardTile)
+			{
+				WriteTile(currentTile, lightIndex);
+			}
+
+			rwt2da_rayHitResults[uint3(groupID, lightIndex)] = ~lightMask;
+		}
 	}
 }
 
 [numthreads(TILE_SIZE_X * TILE_SIZE_Y, 1, 1)]
-void ClassifyByCascadeRange(uint localIndex : SV_GroupIndex, uint3 groupID : SV_GroupID)
+void ClassifyByNormal(uint localIndex : SV_GroupIndex, uint3 groupID : SV_GroupID)
 {
-	uint2 const localID = FXX_Rmp8x8(localIndex);
-	uint2 const pixelCoord = groupID.xy * k_tileSize + localID.xy;
-
-	ClassifyResults const results =
-		Classify(
-			pixelCoord,
-			true,
-			true,
-			false);
-
-	Tile currentTile = Tile::Create(groupID.xy);
-	uint const mask = BoolToWaveMask(results.bIsActiveLane, localID);
-	currentTile.mask = mask;
-
-	uint const lightMask = BoolToWaveMask(results.bIsInLight, localID);
-
-	bool const bDiscardTile = (countbits(mask) <= tileTolerance);
-	if (localIndex == 0)
-	{
-		if (!bDiscardTile)
-		{
-			WriteTile(currentTile);
-		}
+	ClassifyTile(
+		localIndex,
+		groupID.xy,
+		true,
+		false,
+		false);
+}
 
-		rwt2d_rayHitResults[groupID.xy] = ~lightMask;
-	}
+[numthreads(TILE_SIZE_X * TILE_SIZE_Y, 1, 1)]
+void ClassifyByCascadeRange(uint localIndex : SV_GroupIndex, uint3 groupID : SV_GroupID)
+{
+	ClassifyTile(
+		localIndex,
+		groupID.xy,
+		true,
+		true,
+		false);
 }
 
 
 [numthreads(TILE_SIZE_X * TILE_SIZE_Y, 1, 1)]
 void ClassifyByCascades(uint localIndex : SV_GroupIndex, uint3 groupID : SV_GroupID)
 {
-	uint2 const localID = FXX_Rmp8x8(localIndex);
-	uint2 const pixelCoord = groupID.xy * k_tileSize + localID.xy;
-
-	ClassifyResults const results =
-		Classify(
-			pixelCoord,
-			true,
-			false,
-			true);
-
-	Tile currentTile = Tile::Create(groupID.xy);
-	uint const mask = BoolToWaveMask(results.bIsActiveLane, localID);
-	currentTile.mask = mask;
-	if (bUseCascadesForRayT)
-	{
-		// At lest one lane must be active for the tile to be written out, so the infinitly and zero will be removed by the wave min and max.
-		// Otherwise we will get minT to be infinite and maxT to be 0
-		currentTile.minT = max(WaveActiveMin(results.minT), currentTile.minT);
-		currentTile.maxT = min(WaveActiveMax(results.maxT), currentTile.maxT);
-	}
-
-	uint const lightMask = BoolToWaveMask(results.bIsInLight, localID);
-
-	bool const bDiscardTile = (countbits(mask) <= tileTolerance);
-	if (localIndex == 0)
-	{
-		if (!bDiscardTile)
-		{
-			WriteTile(currentTile);
-		}
-
-		rwt2d_rayHitResults[groupID.xy] = ~lightMask;
-
-	}
-}
\ No newline at end of file
+	ClassifyTile(
+		localIndex,
+		groupID.xy,
+		true,
+		false,
+		true);
+}
@@ -38,7 +38,7 @@ cbuffer cbPerFrame : register(b0)
 
     uint            m_nCascadeLevels; // Number of Cascades
     uint2           m_nTextureSize;
-    float           _pad;
+    uint            m_nCascadeSliceOffset; // first slice of this light's cascades in the shadow map array
 
     // For Map based selection scheme, this keeps the pixels inside of the the valid range.
     // When there is no boarder, these values are 0 and 1 respectivley.
@@ -50,6 +50,9 @@ cbuffer cbPerFrame : register(b0)
 
     float3          m_fLightDir;
     float           m_fSunSize;
+
+    uint            m_nOutputSlice; // slice of the shadow masks this light is written to
+    uint3           _pad;
 };
 
 //--------------------------------------------------------------------------------------
@@ -57,7 +60,7 @@ cbuffer cbPerFrame : register(b0)
 //--------------------------------------------------------------------------------------
 Texture2DArray<float> CascadeBuffer : register(t0);
 Texture2D DepthBuffer : register(t1);
-RWTexture2D<float4> OutputBuffer : register(u0);
+RWTexture2DArray<unorm float> OutputBuffer : register(u0);
 
 SamplerComparisonState     shadowSampler    : register(s0);
 SamplerState               sSampler         : register(s1);
@@ -80,7 +83,7 @@ float CalculatePCFPercentLit(in float4 vShadowTexCoord,
     for (uint x = 0; x < k_poissonDiscSampleCountMid; ++x)
     {
         float2 const sampleUV = vShadowTexCoord.xy + k_poissonDisc[x] * radiusCoord;
-        fPercentLit += CascadeBuffer.SampleCmpLevelZero(shadowSampler, float3(sampleUV, cascadeIndex), depthcompare);
+        fPercentLit += CascadeBuffer.SampleCmpLevelZero(shadowSampler, float3(sampleUV, m_nCascadeSliceOffset + cascadeIndex), depthcompare);
     }
 
     return fPercentLit / k_poissonDiscSampleCountMid;
@@ -96,7 +99,7 @@ float GetPenumbraSize(in float4 vShadowMapTextureCoord, in float radius, in int
     for (uint x = 0; x < k_poissonDiscSampleCountMid; ++x)
     {
         float2 const sampleUV = vShadowMapTextureCoord.xy + k_poissonDisc[x] * radiusCoord;
-        float const shadowDepth = CascadeBuffer.SampleLevel(sSampler, float3(sampleUV, cascadeIndex), 0);
+        float const shadowDepth = CascadeBuffer.SampleLevel(sSampler, float3(sampleUV, m_nCascadeSliceOffset + cascadeIndex), 0);
 
         if (shadowDepth < vShadowMapTextureCoord.z - m_fShadowBiasFromGUI)
         {
@@ -187,8 +190,6 @@ void mainCS(uint3 Tid : SV_DispatchThreadID)
        
         if (penumbraSize > 0.0f)
         {
-            OutputBuffer[Tid.xy] = 1.f;
-
             fPercentLit = CalculatePCFPercentLit(vShadowMapTextureCoord, iCurrentCascadeIndex, penumbraSize);
 
             if (m_nCascadeLevels > 1)
@@ -213,6 +214,6 @@ void mainCS(uint3 Tid : SV_DispatchThreadID)
         }
     }
 
-    // Write the results out to memory
-    OutputBuffer[Tid.xy] = fPercentLit;
+    // Write the results out to memory, every light has its own slice
+    OutputBuffer[uint3(Tid.xy, m_nOutputSlice)] = fPercentLit;
 }
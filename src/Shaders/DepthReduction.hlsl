@@ -0,0 +1,62 @@
+// AMD Cauldron code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#define TILE_SIZE 8
+
+//--------------------------------------------------------------------------------------
+// Constant Buffer
+//--------------------------------------------------------------------------------------
+cbuffer cb_reduction : register(b0)
+{
+	uint2 textureSize;
+};
+
+//--------------------------------------------------------------------------------------
+// Texture definitions
+//--------------------------------------------------------------------------------------
+Texture2D<float> t2d_depth : register(t0);
+
+// [0] min depth, [1] max depth as uint, positive floats keep their order when compared as uints
+RWByteAddressBuffer rwb_minMax : register(u0);
+
+//--------------------------------------------------------------------------------------
+// Main function
+//--------------------------------------------------------------------------------------
+
+[numthreads(TILE_SIZE, TILE_SIZE, 1)]
+void main(uint3 globalID : SV_DispatchThreadID)
+{
+	float depth = 1;
+	if (all(globalID.xy < textureSize))
+	{
+		depth = t2d_depth.Load(int3(globalID.xy, 0));
+	}
+
+	// depth is cleared to 1, those pixels are sky and don't receive shadows
+	bool const bIsGeometry = depth < 1;
+
+	uint const minDepth = WaveActiveMin(bIsGeometry ? asuint(depth) : 0xffffffff);
+	uint const maxDepth = WaveActiveMax(bIsGeometry ? asuint(depth) : 0);
+
+	if (WaveIsFirstLane() && maxDepth != 0)
+	{
+		rwb_minMax.InterlockedMin(0, minDepth);
+		rwb_minMax.InterlockedMax(4, maxDepth);
+	}
+}
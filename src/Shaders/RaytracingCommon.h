@@ -23,36 +23,51 @@ static const float k_pushOff = 4e-2f;
 
 static const uint2 k_tileSize = uint2(TILE_SIZE_X, TILE_SIZE_Y);
 
+#define MAX_LIGHTS 4
+
 //--------------------------------------------------------------------------------------
 // Constant Buffer
 //--------------------------------------------------------------------------------------
+struct LightControls
+{
+	float3 lightDir;
+	float  sunSizeLightSpace;
+
+	float4 cascadeScale[4];
+	float4 cascadeOffset[4];
+
+	float4x4 lightView;
+	float4x4 inverseLightView;
+
+	uint   cascadeSliceOffset; // first slice of the light's cascades in the shadow map array
+	uint3  _pad;
+};
+
 cbuffer cb_controls : register(b0)
 {
 	float4 textureSize;
-	float3 lightDir;
+
+	uint   lightCount;
 	float  skyHeight;
+	float  pixelThickness;
+	float  sunSize;
 
-	float pixelThickness;
-	float sunSize;
-	float noisePhase;
-	bool  bRejectLitPixels;
+	float  noisePhase;
+	bool   bRejectLitPixels;
+	uint   tileTolerance;
+	bool   bUseCascadesForRayT;
 
 	uint   cascadeCount;
 	uint   activeCascades;
-	uint   tileTolerance;
-	float  blockerOffset;
-
 	float  cascadePixelSize;
 	float  cascadeSize;
-	float  sunSizeLightSpace;
-	bool   bUseCascadesForRayT;
 
-	float4 cascadeScale[4];
-	float4 cascadeOffset[4];
+	float  blockerOffset;
+	float3 _pad;
 
 	float4x4 viewToWorld;
-	float4x4 lightView;
-	float4x4 inverseLightView;
+
+	LightControls lights[MAX_LIGHTS];
 };
 
 //--------------------------------------------------------------------------------------
@@ -65,6 +80,8 @@ struct UV
 
 	float16_t2 uv01;
 	float16_t2 uv02;
+	float uvDensity; // in object space
+	uint normal; // object space, octahedral
 };
 
 struct Tile
@@ -103,6 +120,13 @@ struct Tile
 // helper functions
 //--------------------------------------------------------------------------------------
 
+// every light has its own list in the work queue, large enough for all the tiles on screen
+uint GetLightTileOffset(uint lightIndex)
+{
+	uint2 const tiles = (uint2(textureSize.xy) + k_tileSize - 1) / k_tileSize;
+	return lightIndex * tiles.x * tiles.y;
+}
+
 uint LaneIdToBitShift(uint2 localID)
 {
 	return localID.y * k_tileSize.x + localID.x;
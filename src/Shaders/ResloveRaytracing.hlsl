@@ -27,42 +27,57 @@
 //--------------------------------------------------------------------------------------
 // Texture definitions
 //--------------------------------------------------------------------------------------
-Texture2D<uint> t2d_hitMaskResults : register(t0);
+Texture2DArray<uint> t2da_hitMaskResults : register(t0);
 
 StructuredBuffer<Tile> sb_tiles : register(t1);
 
-RWTexture2D<float4> rwt2d_output : register(u0);
+// every light has its own slice, so no light has to load what the others wrote
+RWTexture2DArray<unorm float> rwt2da_output : register(u0);
+
+RWTexture2D<float4> rwt2d_debugOutput : register(u0);
+
+cbuffer cb_resolve : register(b1)
+{
+	uint lightIndex;
+	uint tileOffset;
+}
 
 //--------------------------------------------------------------------------------------
 // Main function
 //--------------------------------------------------------------------------------------
 
+// one slice of groups per light
 [numthreads(TILE_SIZE_X, TILE_SIZE_Y, 1)]
 void main(uint3 globalID : SV_DispatchThreadID, uint3 localID : SV_GroupThreadID, uint localIndex : SV_GroupIndex, uint3 groupID : SV_GroupID)
 {
-	uint const mask = t2d_hitMaskResults[groupID.xy];
+	uint const mask = t2da_hitMaskResults[groupID];
 	bool const threadHit = WaveMaskToBool(mask, localID.xy);
 
-	float4 const old = float4(0, 0, 0, 0);
-
-	float4 const output = (threadHit == true) ? old : float4(1, 0, 0, 0);
-
-	rwt2d_output[globalID.xy] = output;
+	rwt2da_output[globalID] = (threadHit == true) ? 0 : 1;
 }
 
 [numthreads(TILE_SIZE_X, TILE_SIZE_Y, 1)]
 void blend(uint3 globalID : SV_DispatchThreadID, uint3 localID : SV_GroupThreadID, uint localIndex : SV_GroupIndex, uint3 groupID : SV_GroupID)
 {
-	Tile const currentTile = sb_tiles[groupID.x];
+	Tile const currentTile = sb_tiles[tileOffset + groupID.x];
+
+	uint const mask = t2da_hitMaskResults[uint3(currentTile.location, lightIndex)];
+	bool const threadHit = WaveMaskToBool(mask, localID.xy);
+
+	uint2 const pixelCoord = currentTile.location * k_tileSize + localID.xy;
+	if(WaveMaskToBool(currentTile.mask, localID.xy))
+		rwt2da_output[uint3(pixelCoord, lightIndex)] = (threadHit == true) ? 0 : 1;
+}
 
-	uint const mask = t2d_hitMaskResults[currentTile.location];
+[numthreads(TILE_SIZE_X, TILE_SIZE_Y, 1)]
+void debug(uint3 globalID : SV_DispatchThreadID, uint3 localID : SV_GroupThreadID, uint localIndex : SV_GroupIndex, uint3 groupID : SV_GroupID)
+{
+	uint const mask = t2da_hitMaskResults[uint3(groupID.xy, lightIndex)];
 	bool const threadHit = WaveMaskToBool(mask, localID.xy);
 
 	float4 const old = float4(0, 0, 0, 0);
 
 	float4 const output = (threadHit == true) ? old : float4(1, 0, 0, 0);
 
-	uint2 const pixelCoord = currentTile.location * k_tileSize + localID.xy;
-	if(WaveMaskToBool(currentTile.mask, localID.xy))
-		rwt2d_output[pixelCoord] = output;
+	rwt2d_debugOutput[globalID.xy] = output;
 }
@@ -0,0 +1,56 @@
+// AMD Cauldron code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#define TILE_SIZE 8
+
+//--------------------------------------------------------------------------------------
+// Constant Buffer
+//--------------------------------------------------------------------------------------
+cbuffer cb_combine : register(b0)
+{
+	uint2 textureSize;
+	uint  lightCount;
+};
+
+//--------------------------------------------------------------------------------------
+// Texture definitions
+//--------------------------------------------------------------------------------------
+Texture2DArray<float> t2da_lightMasks : register(t0);
+
+// the lit fraction of light i in channel i, the other channels are left lit
+RWTexture2D<unorm float4> rwt2d_shadowMask : register(u0);
+
+//--------------------------------------------------------------------------------------
+// Main function
+//--------------------------------------------------------------------------------------
+
+[numthreads(TILE_SIZE, TILE_SIZE, 1)]
+void main(uint3 globalID : SV_DispatchThreadID)
+{
+	if (any(globalID.xy >= textureSize))
+		return;
+
+	float4 shadowMask = float4(1, 1, 1, 1);
+	for (uint i = 0; i < lightCount; ++i)
+	{
+		shadowMask[i] = t2da_lightMasks.Load(int4(globalID.xy, i, 0));
+	}
+
+	rwt2d_shadowMask[globalID.xy] = shadowMask;
+}
@@ -50,32 +50,119 @@ Texture2D         t2d_blueNoise : register(t2);
 
 StructuredBuffer<uint4> sb_tiles  : register(t3);
 StructuredBuffer<UV> sb_uvBuffer : register(t4);
+StructuredBuffer<uint> sb_opacityMicromaps : register(t5);
+Texture2DArray<float> t2da_alphaMasks : register(t6);
 
 RaytracingAccelerationStructure ras_opaque : register(t0, space1);
 RaytracingAccelerationStructure ras_nonOpaque : register(t1, space1);
 
 Texture2D t2d_maskTextures[] : register(t0, space2);
 
-RWTexture2D<uint> rwt2d_rayHitResults : register(u0);
+RWTexture2DArray<uint> rwt2da_rayHitResults : register(u0);
 
 SamplerState ss_mask : register(s0);
 
+// set by the indirect command of the light's tile list
+cbuffer cb_trace : register(b1)
+{
+	uint lightIndex;
+}
+
 //--------------------------------------------------------------------------------------
 // Main function
 //--------------------------------------------------------------------------------------
 
-bool CheckAlphaMask(uint primIndex, uint textureIndex, float2 barycentrics, float t)
+static const uint k_microTriangleTransparent = 0;
+static const uint k_microTriangleOpaque = 1;
+static const uint k_microTriangleUnknown = 2;
+static const uint k_micromapUniformLevel = 0xf;
+
+// the masks that couldn't be packed into t2da_alphaMasks are sampled from their base color texture
+static const uint k_maskTextureFallback = 0x800000;
+
+// Same layout as OpacityMicromap on the CPU, one descriptor per masked triangle with the
+// subdivision level in the top 4 bits and the offset of the 2 bit states in the rest
+uint GetOpacityMicromapState(uint primIndex, float2 barycentrics)
+{
+	uint const descriptor = sb_opacityMicromaps[primIndex];
+	uint const level = descriptor >> 28;
+	if (level == k_micromapUniformLevel)
+	{
+		return descriptor & 0x3;
+	}
+
+	// micro triangles go row by row along the second barycentric, upright and inverted ones alternating
+	uint const segments = 1u << level;
+	float2 const p = barycentrics * segments;
+	uint const iy = min(uint(max(p.y, 0)), segments - 1);
+	uint const ix = min(uint(max(p.x, 0)), segments - 1 - iy);
+	bool const bUpright = ix + iy == segments - 1 || (p.x - ix) + (p.y - iy) < 1;
+	uint const index = iy * (2 * segments - iy) + 2 * ix + (bUpright ? 0 : 1);
+
+	uint const states = sb_opacityMicromaps[(descriptor & 0x0fffffff) + index / 16];
+	return (states >> (2 * (index % 16))) & 0x3;
+}
+
+// Width of the cone of rays towards the sun disk at the hit, in world space.
+// The cone starts at the receiver, which is at coneApexT along the ray.
+float GetConeWidth(float t, float coneApexT)
+{
+	return 2 * sunSize * abs(t - coneApexT);
+}
+
+float3 UnpackNormal(uint packed)
 {
+	float2 const e = float2(int2(packed << 16, packed) >> 16) / 32767.0f;
+	float3 n = float3(e, 1 - abs(e.x) - abs(e.y));
+	if (n.z < 0)
+	{
+		n.xy = float2((1 - abs(n.y)) * (n.x >= 0 ? 1 : -1), (1 - abs(n.x)) * (n.y >= 0 ? 1 : -1));
+	}
+	return normalize(n);
+}
+
+// World space area of a triangle over its object space area. The cofactor matrix of the transform
+// maps the object space normal to the world space one scaled by that ratio, so any scale and shear
+// of the instance is accounted for.
+float GetAreaScale(float3 normal, float3x4 objectToWorld)
+{
+	float3 const c0 = float3(objectToWorld._m00, objectToWorld._m10, objectToWorld._m20);
+	float3 const c1 = float3(objectToWorld._m01, objectToWorld._m11, objectToWorld._m21);
+	float3 const c2 = float3(objectToWorld._m02, objectToWorld._m12, objectToWorld._m22);
+	return length(normal.x * cross(c1, c2) + normal.y * cross(c2, c0) + normal.z * cross(c0, c1));
+}
+
+bool CheckAlphaMask(uint primIndex, uint textureIndex, float2 barycentrics, float coneWidth, float3x4 objectToWorld)
+{
+	// only the micro triangles that straddle the cut out need the texture
+	uint const state = GetOpacityMicromapState(primIndex, barycentrics);
+	if (state != k_microTriangleUnknown)
+	{
+		return state == k_microTriangleOpaque;
+	}
+
 	UV const packedUVs = sb_uvBuffer[primIndex];
 	float2 const uv = packedUVs.uv0 + packedUVs.uv01 * barycentrics.x + packedUVs.uv02 * barycentrics.y;
 
-	//float const coneR = t * tanOfConeAngle;
-	//float2 const grad0 = coneR * packedUVs.uv01;
-	//float2 const grad1 = coneR * packedUVs.uv02;
+	// ray cone mip selection, same math as AlphaMaskPacker::GetConeMipLevel with the density moved to world space
+	float const uvDensity = packedUVs.uvDensity - 0.5f * log2(max(GetAreaScale(UnpackNormal(packedUVs.normal), objectToWorld), 1e-20f));
+	float const coneLod = log2(coneWidth) + uvDensity;
 
-	Texture2D mask = t2d_maskTextures[NonUniformResourceIndex(textureIndex)];
-	//float const alpha = mask.SampleGrad(ss_mask, uv, grad0, grad1).a;
-	float const alpha = mask.SampleLevel(ss_mask, uv, 0).a;
+	float alpha;
+	uint width, height, elements, levels;
+	if (textureIndex & k_maskTextureFallback)
+	{
+		Texture2D mask = t2d_maskTextures[NonUniformResourceIndex(textureIndex & ~k_maskTextureFallback)];
+		mask.GetDimensions(0, width, height, levels);
+		float const lod = max(coneLod + 0.5f * log2(float(width) * float(height)), 0);
+		alpha = mask.SampleLevel(ss_mask, uv, lod).a;
+	}
+	else
+	{
+		t2da_alphaMasks.GetDimensions(0, width, height, elements, levels);
+		float const lod = max(coneLod + 0.5f * log2(float(width) * float(height)), 0);
+		alpha = t2da_alphaMasks.SampleLevel(ss_mask, float3(uv, textureIndex), lod);
+	}
 
 	return (alpha > 0.5);
 }
@@ -95,7 +182,7 @@ bool TraceOpaque(RaytracingAccelerationStructure ras, RayDesc ray)
 	return q.CommittedStatus() != COMMITTED_NOTHING;
 }
 
-bool TraceNonOpaque(RaytracingAccelerationStructure ras, RayDesc ray)
+bool TraceNonOpaque(RaytracingAccelerationStructure ras, RayDesc ray, float coneApexT)
 {
 	RayQuery<k_nonOpaqueFlags> q;
 
@@ -111,9 +198,9 @@ bool TraceNonOpaque(RaytracingAccelerationStructure ras, RayDesc ray)
 		uint const primOffset = q.CandidatePrimitiveIndex();
 		uint const textureIndex = q.CandidateInstanceContributionToHitGroupIndex();
 		float2 const barycentrics = q.CandidateTriangleBarycentrics();
-		float const t = q.CandidateTriangleRayT();
+		float const coneWidth = GetConeWidth(q.CandidateTriangleRayT(), coneApexT);
 
-		if (CheckAlphaMask(uvOffset + primOffset, textureIndex, barycentrics, t))
+		if (CheckAlphaMask(uvOffset + primOffset, textureIndex, barycentrics, coneWidth, q.CandidateObjectToWorld3x4()))
 		{
 			q.CommitNonOpaqueTriangleHit();
 		}
@@ -122,7 +209,7 @@ bool TraceNonOpaque(RaytracingAccelerationStructure ras, RayDesc ray)
 	return q.CommittedStatus() != COMMITTED_NOTHING;
 }
 
-bool TraceMixed(RaytracingAccelerationStructure ras, RayDesc ray)
+bool TraceMixed(RaytracingAccelerationStructure ras, RayDesc ray, float coneApexT)
 {
 	RayQuery<k_mixedFlags> q;
 
@@ -138,9 +225,9 @@ bool TraceMixed(RaytracingAccelerationStructure ras, RayDesc ray)
 		uint const primOffset = q.CandidatePrimitiveIndex();
 		uint const textureIndex = q.CandidateInstanceContributionToHitGroupIndex();
 		float2 const barycentrics = q.CandidateTriangleBarycentrics();
-		float const t = q.CandidateTriangleRayT();
+		float const coneWidth = GetConeWidth(q.CandidateTriangleRayT(), coneApexT);
 
-		if (CheckAlphaMask(uvOffset + primOffset, textureIndex, barycentrics, t))
+		if (CheckAlphaMask(uvOffset + primOffset, textureIndex, barycentrics, coneWidth, q.CandidateObjectToWorld3x4()))
 		{
 			q.CommitNonOpaqueTriangleHit();
 		}
@@ -172,7 +259,7 @@ bool TraceShadows(
 
 		RayDesc ray;
 		ray.Origin = worldPos + normal * pixelThickness;
-		ray.Direction = -lightDir;
+		ray.Direction = -lights[lightIndex].lightDir;
 		ray.TMin = currentTile.minT;
 		ray.TMax = currentTile.maxT;
 
@@ -183,8 +270,10 @@ bool TraceShadows(
 		}
 
 		// reverse ray direction for better traversal 
+		float coneApexT = 0;
 		if (bUseCascadesForRayT)
 		{
+			coneApexT = currentTile.maxT;
 			ray.Origin = ray.Origin + ray.Direction * (currentTile.maxT);
 			ray.Direction = -ray.Direction;
 			ray.TMin = 0;
@@ -198,12 +287,12 @@ bool TraceShadows(
 
 		if (bTraceNonOpaqueTlas && !bRayHitSomething)
 		{
-			bRayHitSomething = TraceNonOpaque(ras_nonOpaque, ray);
+			bRayHitSomething = TraceNonOpaque(ras_nonOpaque, ray, coneApexT);
 		}
 
 		if (bTlasIsMixed)
 		{
-			bRayHitSomething = TraceMixed(ras_opaque, ray);
+			bRayHitSomething = TraceMixed(ras_opaque, ray, coneApexT);
 		}
 	}
 
@@ -215,7 +304,7 @@ void TraceOpaqueOnly(uint localIndex : SV_GroupIndex, uint3 groupID : SV_GroupID
 {
 	uint2 const localID = FXX_Rmp8x8(localIndex);
 
-	Tile const currentTile = Tile::FromUint(sb_tiles[groupID.x]);
+	Tile const currentTile = Tile::FromUint(sb_tiles[GetLightTileOffset(lightIndex) + groupID.x]);
 
 	bool const bRayHitSomething = TraceShadows(
 		localID,
@@ -227,9 +316,10 @@ void TraceOpaqueOnly(uint localIndex : SV_GroupIndex, uint3 groupID : SV_GroupID
 	uint const waveOutput = BoolToWaveMask(bRayHitSomething, localID);
 	if (localIndex == 0)
 	{
-		uint const oldMask = rwt2d_rayHitResults[currentTile.location].x;
+		uint3 const location = uint3(currentTile.location, lightIndex);
+		uint const oldMask = rwt2da_rayHitResults[location].x;
 		// add results to mask
-		rwt2d_rayHitResults[currentTile.location] = waveOutput & oldMask;
+		rwt2da_rayHitResults[location] = waveOutput & oldMask;
 	}
 }
 
@@ -238,7 +328,7 @@ void TraceSplitTlas(uint localIndex : SV_GroupIndex, uint3 groupID : SV_GroupID)
 {
 	uint2 const localID = FXX_Rmp8x8(localIndex);
 
-	Tile const currentTile = Tile::FromUint(sb_tiles[groupID.x]);
+	Tile const currentTile = Tile::FromUint(sb_tiles[GetLightTileOffset(lightIndex) + groupID.x]);
 
 	bool const bRayHitSomething = TraceShadows(
 		localID,
@@ -250,9 +340,10 @@ void TraceSplitTlas(uint localIndex : SV_GroupIndex, uint3 groupID : SV_GroupID)
 	uint const waveOutput = BoolToWaveMask(bRayHitSomething, localID);
 	if (localIndex == 0)
 	{
-		uint const oldMask = rwt2d_rayHitResults[currentTile.location].x;
+		uint3 const location = uint3(currentTile.location, lightIndex);
+		uint const oldMask = rwt2da_rayHitResults[location].x;
 		// add results to mask
-		rwt2d_rayHitResults[currentTile.location] = waveOutput & oldMask;
+		rwt2da_rayHitResults[location] = waveOutput & oldMask;
 	}
 }
 
@@ -261,7 +352,7 @@ void TraceMixedTlas(uint localIndex : SV_GroupIndex, uint3 groupID : SV_GroupID)
 {
 	uint2 const localID = FXX_Rmp8x8(localIndex);
 
-	Tile const currentTile = Tile::FromUint(sb_tiles[groupID.x]);
+	Tile const currentTile = Tile::FromUint(sb_tiles[GetLightTileOffset(lightIndex) + groupID.x]);
 
 	bool const bRayHitSomething = TraceShadows(
 		localID,
@@ -273,8 +364,9 @@ void TraceMixedTlas(uint localIndex : SV_GroupIndex, uint3 groupID : SV_GroupID)
 	uint const waveOutput = BoolToWaveMask(bRayHitSomething, localID);
 	if (localIndex == 0)
 	{
-		uint const oldMask = rwt2d_rayHitResults[currentTile.location].x;
+		uint3 const location = uint3(currentTile.location, lightIndex);
+		uint const oldMask = rwt2da_rayHitResults[location].x;
 		// add results to mask
-		rwt2d_rayHitResults[currentTile.location] = waveOutput & oldMask;
+		rwt2da_rayHitResults[location] = waveOutput & oldMask;
 	}
 }
\ No newline at end of file
@@ -10,6 +10,7 @@ struct FFX_DNSR_Shadows_Data_Defn
     int2     BufferDimensions;
     float2   InvBufferDimensions;
     float    DepthSimilaritySigma;
+    uint     LightIndex;
 };
 
 cbuffer cbPassData : register(b0)
@@ -24,7 +25,7 @@ StructuredBuffer<uint>  sb_tileMetaData : register(t2);
 Texture2D<float16_t2>  rqt2d_input  : register(t0, space1);
 
 RWTexture2D<float2> rwt2d_history   : register(u0);
-RWTexture2D<unorm float4>  rwt2d_output    : register(u0);
+RWTexture2DArray<unorm float> rwt2da_output : register(u0);
 
 float2 FFX_DNSR_Shadows_GetInvBufferDimensions()
 {
@@ -131,6 +132,6 @@ void Pass2(uint2 gid : SV_GroupID, uint2 gtid : SV_GroupThreadID, uint2 did : SV
 
     if (bWriteOutput)
     {
-        rwt2d_output[did].x = mean;
+        rwt2da_output[uint3(did, FFX_DNSR_Shadows_Data.LightIndex)] = mean;
     }
 }
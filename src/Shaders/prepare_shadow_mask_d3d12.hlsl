@@ -25,9 +25,10 @@ bool WaveMaskToBool(uint mask, uint2 localID)
 cbuffer PassData : register(b0)
 {
     int2 BufferDimensions;
+    uint LightIndex;
 }
 
-Texture2D<uint> t2d_hitMaskResults : register(t0);
+Texture2DArray<uint> t2da_hitMaskResults : register(t0);
 RWStructuredBuffer<uint> rwsb_shadowMask : register(u0);
 
 int2 FFX_DNSR_Shadows_GetBufferDimensions()
@@ -37,7 +38,7 @@ int2 FFX_DNSR_Shadows_GetBufferDimensions()
 
 bool FFX_DNSR_Shadows_HitsLight(uint2 did, uint2 gtid, uint2 gid)
 {
-    return !WaveMaskToBool(t2d_hitMaskResults[gid], gtid);
+    return !WaveMaskToBool(t2da_hitMaskResults[uint3(gid, LightIndex)], gtid);
 }
 
 void FFX_DNSR_Shadows_WriteMask(uint offset, uint value)
@@ -0,0 +1,191 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+
+#include "UnitTest.h"
+
+#include <random>
+
+//--------------------------------------------------------------------------------------
+// The batched ComputeCascadeFrustumBounds against the per cascade, per corner loop that
+// SetupCascades used before.
+//--------------------------------------------------------------------------------------
+namespace
+{
+    void ComputeReferenceBounds(CSMManager& csm, math::Matrix4 const& matCameraProjection, math::Matrix4 const& matInverseViewCamera,
+        math::Matrix4 const& matLightCameraView, float camNear, int numCascades, float const* pIntervalBegin, float const* pIntervalEnd,
+        CSMManager::CascadeFrustumBounds* pBounds)
+    {
+        for (int cascade = 0; cascade < numCascades; ++cascade)
+        {
+            CSMManager::CascadeFrustumBounds& bounds = pBounds[cascade];
+
+            math::Vector4 vFrustumPoints[8];
+            csm.CreateFrustumPointsFromCascadeInterval(camNear, pIntervalBegin[cascade], pIntervalEnd[cascade], matCameraProjection, vFrustumPoints);
+
+            bounds.vFrustumMin = math::Vector4(FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX);
+            bounds.vFrustumMax = math::Vector4(-FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX);
+            bounds.fSphereRadius = 0.0f;
+            for (int i = 0; i < 8; ++i)
+            {
+                bounds.vFrustumMin = math::SSE::minPerElem(vFrustumPoints[i], bounds.vFrustumMin);
+                bounds.vFrustumMax = math::SSE::maxPerElem(vFrustumPoints[i], bounds.vFrustumMax);
+                bounds.fSphereRadius = max(bounds.fSphereRadius, math::SSE::length(vFrustumPoints[i].getXYZ()));
+            }
+
+            bounds.vLightMin = math::Vector4(FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX);
+            bounds.vLightMax = math::Vector4(-FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX);
+            for (int i = 0; i < 8; ++i)
+            {
+                vFrustumPoints[i] = matInverseViewCamera * vFrustumPoints[i];
+                math::Vector4 const vLightPoint = matLightCameraView * vFrustumPoints[i];
+                bounds.vLightMin = math::SSE::minPerElem(vLightPoint, bounds.vLightMin);
+                bounds.vLightMax = math::SSE::maxPerElem(vLightPoint, bounds.vLightMax);
+            }
+
+            bounds.fDiagonal = math::SSE::length((vFrustumPoints[0] - vFrustumPoints[6]).getXYZ());
+        }
+    }
+
+    void CheckVector(math::Vector4 const& a, math::Vector4 const& b)
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            CHECK_NEAR(a.getElem(c), b.getElem(c), 1e-4 * max(1.0f, fabsf(b.getElem(c))));
+        }
+    }
+
+    struct Setup
+    {
+        math::Matrix4 matProjection;
+        math::Matrix4 matInverseView;
+        math::Matrix4 matLightView;
+        float camNear;
+        int numCascades;
+        float intervalBegin[CSMManager::MaxCascades];
+        float intervalEnd[CSMManager::MaxCascades];
+    };
+
+    Setup MakeRandomSetup(std::mt19937& rng)
+    {
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        std::uniform_real_distribution<float> angle(-3.14159f, 3.14159f);
+        std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+
+        Setup setup;
+        setup.camNear = 0.05f + unit(rng);
+        setup.matProjection = UnitTest::Perspective(0.3f + 1.5f * unit(rng), 0.5f + 2.0f * unit(rng), setup.camNear, 1000.0f);
+        setup.matInverseView = math::affineInverse(math::Matrix4::lookAt(math::Point3(position(rng), position(rng), position(rng)),
+            math::Point3(position(rng), position(rng), position(rng)), math::Vector3(0.0f, 1.0f, 0.0f)));
+        setup.matLightView = math::Matrix4::rotationX(angle(rng)) * math::Matrix4::rotationY(angle(rng))
+            * math::Matrix4::translation(math::Vector3(position(rng), position(rng), position(rng)));
+
+        // Both the overlapping FIT_TO_SCENE and the back to back FIT_TO_CASCADES intervals
+        setup.numCascades = 1 + static_cast<int>(rng() % CSMManager::MaxCascades);
+        bool const bOverlapping = (rng() & 1) != 0;
+        float end = setup.camNear;
+        for (int i = 0; i < setup.numCascades; ++i)
+        {
+            setup.intervalBegin[i] = bOverlapping ? 0.0f : end;
+            end += 1.0f + 200.0f * unit(rng);
+            setup.intervalEnd[i] = end;
+        }
+        return setup;
+    }
+
+    void TestAgainstReference()
+    {
+        std::mt19937 rng(8);
+        CSMManager csm;
+        for (int i = 0; i < 1000; ++i)
+        {
+            Setup const setup = MakeRandomSetup(rng);
+
+            CSMManager::CascadeFrustumBounds bounds[CSMManager::MaxCascades];
+            CSMManager::CascadeFrustumBounds reference[CSMManager::MaxCascades];
+            csm.ComputeCascadeFrustumBounds(setup.matProjection, setup.matInverseView, setup.matLightView, setup.camNear,
+                setup.numCascades, setup.intervalBegin, setup.intervalEnd, bounds);
+            ComputeReferenceBounds(csm, setup.matProjection, setup.matInverseView, setup.matLightView, setup.camNear,
+                setup.numCascades, setup.intervalBegin, setup.intervalEnd, reference);
+
+            for (int cascade = 0; cascade < setup.numCascades; ++cascade)
+            {
+                CheckVector(bounds[cascade].vFrustumMin, reference[cascade].vFrustumMin);
+                CheckVector(bounds[cascade].vFrustumMax, reference[cascade].vFrustumMax);
+                CheckVector(bounds[cascade].vLightMin, reference[cascade].vLightMin);
+                CheckVector(bounds[cascade].vLightMax, reference[cascade].vLightMax);
+                CHECK_NEAR(bounds[cascade].fSphereRadius, reference[cascade].fSphereRadius, 1e-4 * reference[cascade].fSphereRadius);
+                CHECK_NEAR(bounds[cascade].fDiagonal, reference[cascade].fDiagonal, 1e-4 * reference[cascade].fDiagonal);
+            }
+        }
+    }
+
+    void Benchmark()
+    {
+        std::mt19937 rng(8);
+        std::vector<Setup> setups;
+        for (int i = 0; i < 256; ++i)
+        {
+            setups.push_back(MakeRandomSetup(rng));
+            setups.back().numCascades = CSMManager::MaxCascades;
+        }
+
+        CSMManager csm;
+        CSMManager::CascadeFrustumBounds bounds[CSMManager::MaxCascades];
+        volatile float sink = 0.0f;
+
+        int const repeats = 16;
+        double const batchedTime = UnitTest::Measure(5, [&]()
+        {
+            for (int r = 0; r < repeats; ++r)
+            {
+                for (Setup const& setup : setups)
+                {
+                    csm.ComputeCascadeFrustumBounds(setup.matProjection, setup.matInverseView, setup.matLightView, setup.camNear,
+                        setup.numCascades, setup.intervalBegin, setup.intervalEnd, bounds);
+                    sink = bounds[0].fDiagonal;
+                }
+            }
+        });
+        double const referenceTime = UnitTest::Measure(5, [&]()
+        {
+            for (int r = 0; r < repeats; ++r)
+            {
+                for (Setup const& setup : setups)
+                {
+                    ComputeReferenceBounds(csm, setup.matProjection, setup.matInverseView, setup.matLightView, setup.camNear,
+                        setup.numCascades, setup.intervalBegin, setup.intervalEnd, bounds);
+                    sink = bounds[0].fDiagonal;
+                }
+            }
+        });
+
+        double const calls = static_cast<double>(repeats * setups.size());
+        printf("4 cascades: per corner %7.3f us/call, batched %7.3f us/call\n", referenceTime / calls, batchedTime / calls);
+    }
+}
+
+int main()
+{
+    TestAgainstReference();
+    Benchmark();
+
+    return UnitTest::Result("CascadeFrustumBounds");
+}
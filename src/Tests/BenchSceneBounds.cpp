@@ -0,0 +1,162 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+
+#include "UnitTest.h"
+
+//--------------------------------------------------------------------------------------
+// SceneBounds against transforming every primitive of the scene each frame, which is what
+// SetupCascades used to do.
+//--------------------------------------------------------------------------------------
+namespace
+{
+    void ComputeFullBounds(GLTFCommon const* pC, math::Vector4* pMin, math::Vector4* pMax)
+    {
+        math::Vector4 vMin(FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX);
+        math::Vector4 vMax(-FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX);
+        for (uint32_t i = 0; i < pC->m_nodes.size(); i++)
+        {
+            tfNode const* pNode = &pC->m_nodes[i];
+            if (pNode->meshIndex < 0)
+                continue;
+
+            math::Matrix4 const matWorld = pC->m_worldSpaceMats[i].GetCurrent();
+            tfMesh const* pMesh = &pC->m_meshes[pNode->meshIndex];
+            for (uint32_t p = 0; p < pMesh->m_pPrimitives.size(); p++)
+            {
+                math::Vector4 vBoxMin, vBoxMax;
+                ShadowCasterCulling::TransformBox(matWorld, pMesh->m_pPrimitives[p].m_center, pMesh->m_pPrimitives[p].m_radius, &vBoxMin, &vBoxMax);
+                vMin = math::SSE::minPerElem(vBoxMin, vMin);
+                vMax = math::SSE::maxPerElem(vBoxMax, vMax);
+            }
+        }
+        *pMin = vMin;
+        *pMax = vMax;
+    }
+
+    bool IsSame(math::Vector4 const& a, math::Vector4 const& b)
+    {
+        return a.getX() == b.getX() && a.getY() == b.getY() && a.getZ() == b.getZ();
+    }
+
+    math::Matrix4 GetNodeMatrix(uint32_t index, float time)
+    {
+        float const x = static_cast<float>(index % 128) * 4.0f;
+        float const z = static_cast<float>(index / 128) * 4.0f;
+        return math::Matrix4::translation(math::Vector3(x, sinf(time + x) * 2.0f, z)) * math::Matrix4::rotationY(time);
+    }
+
+    // Moves every moveInterval-th node each frame, none when it's 0, checks the bounds against the
+    // full ones and prints the time per frame of both
+    void Run(char const* pName, uint32_t nodeCount, uint32_t moveInterval)
+    {
+        GLTFCommon gltf;
+        for (uint32_t i = 0; i < nodeCount; ++i)
+        {
+            UnitTest::AddBoxNode(gltf, math::Vector4(0.0f, 1.0f, 0.0f, 1.0f), math::Vector4(1.0f, 1.0f, 0.5f, 0.0f), GetNodeMatrix(i, 0.0f));
+        }
+
+        SceneBounds bounds;
+        bounds.Update(&gltf);
+
+        int const frameCount = 64;
+        uint32_t movedNode = 0;
+        auto moveNodes = [&](int frame)
+        {
+            if (moveInterval == 0)
+                return;
+
+            for (uint32_t i = frame % moveInterval; i < nodeCount; i += moveInterval)
+            {
+                gltf.m_worldSpaceMats[i].Set(GetNodeMatrix(i, 0.1f * frame));
+                movedNode = i;
+            }
+        };
+
+        // Correctness, frame by frame
+        for (int frame = 1; frame <= frameCount; ++frame)
+        {
+            moveNodes(frame);
+            bounds.Update(&gltf);
+
+            math::Vector4 vMin, vMax;
+            ComputeFullBounds(&gltf, &vMin, &vMax);
+            CHECK(IsSame(bounds.GetMin(), vMin));
+            CHECK(IsSame(bounds.GetMax(), vMax));
+
+            math::Vector4 vNodeMin, vNodeMax;
+            tfPrimitives const& primitive = gltf.m_meshes[gltf.m_nodes[movedNode].meshIndex].m_pPrimitives[0];
+            ShadowCasterCulling::TransformBox(gltf.m_worldSpaceMats[movedNode].GetCurrent(), primitive.m_center, primitive.m_radius, &vNodeMin, &vNodeMax);
+            CHECK(IsSame(bounds.GetNodeMin(movedNode), vNodeMin));
+            CHECK(IsSame(bounds.GetNodeMax(movedNode), vNodeMax));
+        }
+
+        // Timing, the nodes are moved outside of the timed part
+        double fullTime = 0.0;
+        double incrementalTime = 0.0;
+        for (int frame = 1; frame <= frameCount; ++frame)
+        {
+            moveNodes(frame);
+
+            math::Vector4 vMin, vMax;
+            fullTime += UnitTest::Measure(1, [&]() { ComputeFullBounds(&gltf, &vMin, &vMax); });
+            incrementalTime += UnitTest::Measure(1, [&]() { bounds.Update(&gltf); });
+        }
+
+        printf("%-40s full %9.2f us/frame, incremental %9.2f us/frame\n", pName, fullTime / frameCount, incrementalTime / frameCount);
+    }
+
+    void TestRebuild()
+    {
+        GLTFCommon gltf;
+        UnitTest::AddBoxNode(gltf, math::Vector4(0.0f, 0.0f, 0.0f, 1.0f), math::Vector4(1.0f, 1.0f, 1.0f, 0.0f), math::Matrix4::identity());
+        UnitTest::AddEmptyNode(gltf);
+
+        SceneBounds bounds;
+        bounds.Update(&gltf);
+        CHECK(bounds.GetNodeCount() == 2);
+        CHECK(IsSame(bounds.GetMax(), math::Vector4(1.0f, 1.0f, 1.0f, 1.0f)));
+
+        // A new node rebuilds the tree
+        UnitTest::AddBoxNode(gltf, math::Vector4(10.0f, 0.0f, 0.0f, 1.0f), math::Vector4(1.0f, 1.0f, 1.0f, 0.0f), math::Matrix4::identity());
+        bounds.Update(&gltf);
+        CHECK(bounds.GetNodeCount() == 3);
+        CHECK(IsSame(bounds.GetMax(), math::Vector4(11.0f, 1.0f, 1.0f, 1.0f)));
+
+        // So does a new scene with the same node count once invalidated
+        gltf.m_meshes[gltf.m_nodes[2].meshIndex].m_pPrimitives[0].m_center = math::Vector4(20.0f, 0.0f, 0.0f, 1.0f);
+        bounds.Update(&gltf);
+        CHECK(IsSame(bounds.GetMax(), math::Vector4(11.0f, 1.0f, 1.0f, 1.0f)));
+        bounds.Invalidate();
+        bounds.Update(&gltf);
+        CHECK(IsSame(bounds.GetMax(), math::Vector4(21.0f, 1.0f, 1.0f, 1.0f)));
+    }
+}
+
+int main()
+{
+    TestRebuild();
+
+    Run("16384 nodes, none moving", 16384, 0);
+    Run("16384 nodes, 1% moving", 16384, 100);
+    Run("16384 nodes, all moving", 16384, 1);
+
+    return UnitTest::Result("SceneBounds");
+}
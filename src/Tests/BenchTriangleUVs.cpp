@@ -0,0 +1,256 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+
+#include "UnitTest.h"
+#include "TriangleUVPacker.h"
+
+#include <limits>
+#include <random>
+
+//--------------------------------------------------------------------------------------
+// The templated index decoding and the F16C conversion of the UV deltas against the per
+// index switch and the per component ToF16 that the BLAS build used before.
+//--------------------------------------------------------------------------------------
+namespace
+{
+    typedef TriangleUVPacker::UV UV;
+
+    uint32_t GetReferenceIndex(tfAccessor const& indexBuffer, uint32_t indexIndex)
+    {
+        void const* pIndex = indexBuffer.Get(indexIndex);
+
+        uint32_t index = ~0;
+        switch (indexBuffer.m_stride)
+        {
+        case 1:
+            index = *reinterpret_cast<uint8_t const*>(pIndex);
+            break;
+        case 2:
+            index = *reinterpret_cast<uint16_t const*>(pIndex);
+            break;
+        case 4:
+            index = *reinterpret_cast<uint32_t const*>(pIndex);
+            break;
+        default:
+            break;
+        }
+
+        return index;
+    }
+
+    math::Point2 GetReferenceUV(tfAccessor const& uvBuffer, uint32_t index)
+    {
+        float const* pUV = reinterpret_cast<float const*>(uvBuffer.Get(index));
+        return math::Point2(pUV[0], pUV[1]);
+    }
+
+    void AppendReferenceTriangleUVs(tfAccessor const& uvBuffer, tfAccessor const& indexBuffer, std::vector<UV>& uvs)
+    {
+        for (uint32_t prim = 0; prim < (uint32_t)indexBuffer.m_count / 3; ++prim)
+        {
+            math::Point2 const uv0 = GetReferenceUV(uvBuffer, GetReferenceIndex(indexBuffer, prim * 3 + 0));
+            math::Point2 const uv1 = GetReferenceUV(uvBuffer, GetReferenceIndex(indexBuffer, prim * 3 + 1));
+            math::Point2 const uv2 = GetReferenceUV(uvBuffer, GetReferenceIndex(indexBuffer, prim * 3 + 2));
+
+            UV out = {};
+            out.uv0 = uv0;
+            out.uv01[0] = TriangleUVPacker::ToF16((uv1 - uv0).getX());
+            out.uv01[1] = TriangleUVPacker::ToF16((uv1 - uv0).getY());
+            out.uv02[0] = TriangleUVPacker::ToF16((uv2 - uv0).getX());
+            out.uv02[1] = TriangleUVPacker::ToF16((uv2 - uv0).getY());
+            uvs.push_back(out);
+        }
+    }
+
+    // Compares the bits, the NaNs have to come out the same too
+    bool IsSame(UV const& a, UV const& b)
+    {
+        float const a0[2] = { a.uv0.getX(), a.uv0.getY() };
+        float const b0[2] = { b.uv0.getX(), b.uv0.getY() };
+        return memcmp(a0, b0, sizeof(a0)) == 0
+            && memcmp(a.uv01, b.uv01, sizeof(a.uv01)) == 0
+            && memcmp(a.uv02, b.uv02, sizeof(a.uv02)) == 0
+            && a.uvDensity == 0.0f && a.normal == 0;
+    }
+
+    struct Mesh
+    {
+        std::vector<float> uvs;
+        std::vector<uint8_t> indexData;
+        tfAccessor uvBuffer;
+        tfAccessor indexBuffer;
+    };
+
+    // Random UVs with the values that the half conversion has to special case mixed in
+    void MakeMesh(Mesh& mesh, std::mt19937& rng, uint32_t vertexCount, uint32_t triangleCount, int indexStride)
+    {
+        float const special[] = {
+            0.0f, -0.0f, 1.0f, 65504.0f, 65520.0f, 1e6f, -1e6f, 6.1e-5f, 3e-6f, 1e-8f, 1.0f + 1.0f / 2048.0f,
+            std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(),
+            std::numeric_limits<float>::quiet_NaN(), -std::numeric_limits<float>::quiet_NaN(),
+            std::numeric_limits<float>::signaling_NaN()
+        };
+        std::uniform_real_distribution<float> uv(-2.0f, 2.0f);
+
+        mesh.uvs.resize(vertexCount * 2);
+        for (float& value : mesh.uvs)
+        {
+            uint32_t const pick = rng() % 64;
+            value = pick < _countof(special) ? special[pick] : uv(rng);
+        }
+
+        mesh.indexData.resize(triangleCount * 3 * indexStride);
+        for (uint32_t i = 0; i < triangleCount * 3; ++i)
+        {
+            uint32_t const index = rng() % vertexCount;
+            memcpy(&mesh.indexData[i * indexStride], &index, indexStride); // little endian
+        }
+
+        mesh.uvBuffer.m_data = mesh.uvs.data();
+        mesh.uvBuffer.m_count = (int)vertexCount;
+        mesh.uvBuffer.m_stride = 8;
+        mesh.indexBuffer.m_data = mesh.indexData.data();
+        mesh.indexBuffer.m_count = (int)triangleCount * 3;
+        mesh.indexBuffer.m_stride = indexStride;
+    }
+
+    void TestHalfConversion()
+    {
+        // every half that isn't a NaN goes through a float and back unchanged
+        for (uint32_t h = 0; h < 0x10000; ++h)
+        {
+            if ((h & 0x7c00) == 0x7c00 && (h & 0x3ff) != 0)
+                continue;
+            CHECK(TriangleUVPacker::ToF16(TriangleUVPacker::FromF16((uint16_t)h)) == h);
+        }
+
+        CHECK(TriangleUVPacker::ToF16(1.0f) == 0x3c00);
+        CHECK(TriangleUVPacker::ToF16(-2.0f) == 0xc000);
+        CHECK(TriangleUVPacker::ToF16(1e6f) == 0x7c00);
+        CHECK(TriangleUVPacker::ToF16(1e-8f) == 0);
+        CHECK(TriangleUVPacker::ToF16(1.0f + 1.0f / 2048.0f) == 0x3c00); // tie to even
+        CHECK(TriangleUVPacker::FromF16(0x0001) == ldexpf(1.0f, -24));
+    }
+
+    void TestReadIndices()
+    {
+        std::mt19937 rng(20);
+        for (int indexStride : { 1, 2, 4 })
+        {
+            Mesh mesh;
+            MakeMesh(mesh, rng, indexStride == 1 ? 200 : 70000, 1000, indexStride);
+
+            std::vector<uint32_t> indices;
+            TriangleUVPacker::ReadIndices(mesh.indexBuffer, indices);
+            CHECK(indices.size() == 3000);
+            for (uint32_t i = 0; i < indices.size(); ++i)
+            {
+                CHECK(indices[i] == GetReferenceIndex(mesh.indexBuffer, i));
+            }
+        }
+    }
+
+    void TestAgainstReference()
+    {
+        std::mt19937 rng(20);
+        for (int indexStride : { 1, 2, 4 })
+        {
+            for (bool bUseF16C : { false, true })
+            {
+                Mesh mesh;
+                MakeMesh(mesh, rng, indexStride == 1 ? 200 : 70000, 5000, indexStride);
+
+                // appends after what is already there, like the merged clusters do
+                std::vector<UV> uvs(3);
+                std::vector<UV> reference(3);
+                uvs[1].uv01[0] = reference[1].uv01[0] = 0x1234;
+                TriangleUVPacker::AppendTriangleUVs(mesh.uvBuffer, mesh.indexBuffer, uvs, bUseF16C);
+                AppendReferenceTriangleUVs(mesh.uvBuffer, mesh.indexBuffer, reference);
+
+                CHECK(uvs.size() == reference.size());
+                if (uvs.size() != reference.size())
+                    continue;
+
+                size_t mismatches = 0;
+                for (size_t i = 0; i < uvs.size(); ++i)
+                {
+                    mismatches += IsSame(uvs[i], reference[i]) ? 0 : 1;
+                }
+                CHECK(mismatches == 0);
+            }
+        }
+    }
+
+    void Benchmark()
+    {
+        std::mt19937 rng(20);
+        uint32_t const triangleCount = 1 << 20;
+        for (int indexStride : { 2, 4 })
+        {
+            Mesh mesh;
+            MakeMesh(mesh, rng, indexStride == 2 ? 65536 : triangleCount / 2, triangleCount, indexStride);
+
+            std::vector<UV> uvs;
+            std::vector<uint32_t> indices;
+            double const referenceTime = UnitTest::Measure(5, [&]()
+            {
+                uvs.clear();
+                AppendReferenceTriangleUVs(mesh.uvBuffer, mesh.indexBuffer, uvs);
+            });
+            double const scalarTime = UnitTest::Measure(5, [&]()
+            {
+                uvs.clear();
+                TriangleUVPacker::AppendTriangleUVs(mesh.uvBuffer, mesh.indexBuffer, uvs, false);
+            });
+            double const f16cTime = UnitTest::Measure(5, [&]()
+            {
+                uvs.clear();
+                TriangleUVPacker::AppendTriangleUVs(mesh.uvBuffer, mesh.indexBuffer, uvs, true);
+            });
+            double const readReferenceTime = UnitTest::Measure(5, [&]()
+            {
+                indices.resize(mesh.indexBuffer.m_count);
+                for (uint32_t i = 0; i < indices.size(); ++i)
+                {
+                    indices[i] = GetReferenceIndex(mesh.indexBuffer, i);
+                }
+            });
+            double const readTime = UnitTest::Measure(5, [&]()
+            {
+                TriangleUVPacker::ReadIndices(mesh.indexBuffer, indices);
+            });
+
+            printf("1M triangles, %d bit indices: UVs per index %7.2f ms, templated %7.2f ms, F16C %7.2f ms%s; indices per index %6.2f ms, templated %6.2f ms\n",
+                indexStride * 8, referenceTime / 1000.0, scalarTime / 1000.0, f16cTime / 1000.0,
+                TriangleUVPacker::IsF16CSupported() ? "" : " (no F16C on this CPU)", readReferenceTime / 1000.0, readTime / 1000.0);
+        }
+    }
+}
+
+int main()
+{
+    TestHalfConversion();
+    TestReadIndices();
+    TestAgainstReference();
+    Benchmark();
+
+    return UnitTest::Result("TriangleUVs");
+}
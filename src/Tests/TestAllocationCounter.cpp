@@ -0,0 +1,150 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+
+#include "UnitTest.h"
+
+#include <atomic>
+#include <thread>
+
+namespace
+{
+    // Keeps the allocations observable, new and delete pairs may be optimized away otherwise
+    void* volatile g_pSink = nullptr;
+
+    void Allocate(int count)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            int* p = new int(i);
+            g_pSink = p;
+            delete p;
+        }
+    }
+
+    void TestCount()
+    {
+        uint64_t const start = AllocationCounter::GetCount();
+        Allocate(10);
+        CHECK(AllocationCounter::GetCount() - start == 10);
+
+        char* pArray = new char[100];
+        g_pSink = pArray;
+        delete[] pArray;
+        CHECK(AllocationCounter::GetCount() - start == 11);
+
+        // Nothing is counted without allocations
+        uint64_t const before = AllocationCounter::GetCount();
+        int sum = 0;
+        for (int i = 0; i < 1000; ++i)
+            sum += i;
+        g_pSink = &sum;
+        CHECK(AllocationCounter::GetCount() == before);
+    }
+
+    void TestScope()
+    {
+        uint64_t const failedScopes = AllocationCounter::GetFailedScopeCount();
+
+        // A checked scope without allocations doesn't assert
+        {
+            AllocationCounter::Scope scope("TestScope", true);
+        }
+
+        // An unchecked one doesn't mind them
+        {
+            AllocationCounter::Scope scope("TestScope", false);
+            Allocate(3);
+        }
+        CHECK(AllocationCounter::GetFailedScopeCount() == failedScopes);
+
+        // Debug builds assert on a checked scope that allocated, release builds only count it
+#ifdef NDEBUG
+        {
+            AllocationCounter::Scope scope("TestScope", true);
+            Allocate(1);
+        }
+        CHECK(AllocationCounter::GetFailedScopeCount() == failedScopes + 1);
+#endif
+    }
+
+    // Paused allocations aren't counted, not even by a checked scope, and the pauses nest
+    void TestPause()
+    {
+        uint64_t const start = AllocationCounter::GetCount();
+        uint64_t const failedScopes = AllocationCounter::GetFailedScopeCount();
+        {
+            AllocationCounter::Scope scope("TestPause", true);
+            AllocationCounter::Pause pause;
+            Allocate(5);
+            {
+                AllocationCounter::Pause inner;
+                Allocate(5);
+            }
+            Allocate(5);
+        }
+        CHECK(AllocationCounter::GetCount() == start);
+        CHECK(AllocationCounter::GetFailedScopeCount() == failedScopes);
+
+        Allocate(2);
+        CHECK(AllocationCounter::GetCount() - start == 2);
+    }
+
+    // Another thread's allocations don't show up in this thread's count
+    void TestPerThread()
+    {
+        std::atomic<int> stage(0);
+        std::atomic<uint64_t> otherCount(0);
+
+        std::thread other([&]()
+        {
+            while (stage.load() != 1)
+                std::this_thread::yield();
+
+            uint64_t const start = AllocationCounter::GetCount();
+            Allocate(1000);
+            otherCount = AllocationCounter::GetCount() - start;
+            stage = 2;
+        });
+
+        // The thread is created outside of the measured part, creating it allocates
+        uint64_t const start = AllocationCounter::GetCount();
+        {
+            AllocationCounter::Scope scope("TestPerThread", true);
+            stage = 1;
+            while (stage.load() != 2)
+                std::this_thread::yield();
+        }
+        CHECK(AllocationCounter::GetCount() == start);
+        CHECK(otherCount.load() == 1000);
+
+        other.join();
+    }
+}
+
+int main()
+{
+    TestCount();
+    TestScope();
+    TestPause();
+    TestPerThread();
+
+    return UnitTest::Result("AllocationCounter");
+}
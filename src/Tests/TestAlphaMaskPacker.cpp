@@ -0,0 +1,407 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+
+#include "UnitTest.h"
+
+#include "AlphaMaskPacker.h"
+
+#include <random>
+
+namespace
+{
+    typedef AlphaMaskPacker::AlphaMask AlphaMask;
+
+    AlphaMask MakeRandomMask(std::mt19937& rng, uint32_t width, uint32_t height)
+    {
+        AlphaMask mask;
+        mask.width = width;
+        mask.height = height;
+        mask.alpha.resize((size_t)width * height);
+        for (uint8_t& alpha : mask.alpha)
+        {
+            alpha = (uint8_t)rng();
+        }
+        return mask;
+    }
+
+    // Grass like blades with soft edges, at sub texel offsets and of different widths and heights.
+    // A plain box filter thins them out in the mips.
+    AlphaMask MakeBladeMask(uint32_t size)
+    {
+        std::mt19937 rng(22);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        uint32_t const bladeCount = size / 8;
+        std::vector<float> centers(bladeCount);
+        std::vector<float> widths(bladeCount);
+        std::vector<uint32_t> heights(bladeCount);
+        for (uint32_t blade = 0; blade < bladeCount; ++blade)
+        {
+            centers[blade] = blade * 8.0f + 2.0f + 4.0f * unit(rng);
+            widths[blade] = 0.6f + 1.2f * unit(rng);
+            heights[blade] = size / 2 + rng() % (size / 2);
+        }
+
+        AlphaMask mask;
+        mask.width = size;
+        mask.height = size;
+        mask.alpha.resize((size_t)size * size);
+        for (uint32_t y = 0; y < size; ++y)
+        {
+            for (uint32_t x = 0; x < size; ++x)
+            {
+                uint32_t const blade = x / 8;
+                float const distance = ((float)x + 0.5f - centers[blade]) / widths[blade];
+                bool const bBlade = y < heights[blade];
+                mask.alpha[(size_t)y * size + x] = bBlade ? (uint8_t)(255.0f * expf(-distance * distance)) : 0;
+            }
+        }
+        return mask;
+    }
+
+    float Coverage(AlphaMask const& mask, float alphaCutoff)
+    {
+        size_t covered = 0;
+        for (uint8_t alpha : mask.alpha)
+        {
+            covered += alpha > alphaCutoff * 255.0f ? 1 : 0;
+        }
+        return (float)covered / (float)mask.alpha.size();
+    }
+
+    void TestExtractAlpha()
+    {
+        std::mt19937 rng(22);
+        std::vector<uint32_t> pixels(100);
+        for (uint32_t& pixel : pixels)
+        {
+            pixel = rng();
+        }
+
+        // the SSE loop and the tail for every count up to a few blocks
+        for (size_t count = 0; count <= pixels.size(); ++count)
+        {
+            std::vector<uint8_t> alpha(count + 1, 0xcd);
+            AlphaMaskPacker::ExtractAlpha(pixels.data(), count, alpha.data());
+
+            bool bSame = alpha[count] == 0xcd;
+            for (size_t i = 0; i < count; ++i)
+            {
+                bSame &= alpha[i] == (uint8_t)(pixels[i] >> 24);
+            }
+            CHECK(bSame);
+        }
+    }
+
+    void TestResample()
+    {
+        std::mt19937 rng(22);
+        AlphaMask const source = MakeRandomMask(rng, 12, 6);
+
+        AlphaMask same;
+        AlphaMaskPacker::Resample(source, 12, 6, same);
+        CHECK(same.width == 12 && same.height == 6);
+        CHECK(same.alpha == source.alpha);
+
+        // halving averages 2x2 texels, rounded to nearest
+        AlphaMask half;
+        AlphaMaskPacker::Resample(source, 6, 3, half);
+        CHECK(half.width == 6 && half.height == 3);
+        for (uint32_t y = 0; y < 3; ++y)
+        {
+            for (uint32_t x = 0; x < 6; ++x)
+            {
+                auto texel = [&](uint32_t sx, uint32_t sy) { return (uint32_t)source.alpha[sy * 12 + sx]; };
+                uint32_t const sum = texel(2 * x, 2 * y) + texel(2 * x + 1, 2 * y) + texel(2 * x, 2 * y + 1) + texel(2 * x + 1, 2 * y + 1);
+                CHECK(half.alpha[y * 6 + x] == (sum + 2) / 4);
+            }
+        }
+
+        // growing interpolates between the texels and wraps around at the edges
+        AlphaMask edge;
+        edge.width = 2;
+        edge.height = 1;
+        edge.alpha = { 0, 200 };
+        AlphaMask grown;
+        AlphaMaskPacker::Resample(edge, 8, 2, grown);
+        CHECK(grown.width == 8 && grown.height == 2);
+        uint8_t const expected[8] = { 75, 25, 25, 75, 125, 175, 175, 125 };
+        for (uint32_t y = 0; y < 2; ++y)
+        {
+            for (uint32_t x = 0; x < 8; ++x)
+            {
+                CHECK_NEAR(grown.alpha[y * 8 + x], expected[x], 1.0);
+            }
+        }
+
+        AlphaMask solid;
+        solid.width = 3;
+        solid.height = 5;
+        solid.alpha.assign(15, 77);
+        AlphaMaskPacker::Resample(solid, 16, 16, grown);
+        CHECK(std::all_of(grown.alpha.begin(), grown.alpha.end(), [](uint8_t alpha) { return alpha == 77; }));
+    }
+
+    void TestMipChain()
+    {
+        float const alphaCutoff = 0.5f;
+        AlphaMask const top = MakeBladeMask(256);
+        float const coverage = Coverage(top, alphaCutoff);
+
+        std::vector<AlphaMask> mips;
+        AlphaMaskPacker::BuildMipChain(top, 5, alphaCutoff, mips);
+        CHECK(mips.size() == 5);
+        if (mips.size() != 5)
+            return;
+        CHECK(mips[0].alpha == top.alpha);
+
+        AlphaMask filtered = top;
+        for (uint32_t mip = 1; mip < 5; ++mip)
+        {
+            CHECK(mips[mip].width == 256u >> mip && mips[mip].height == 256u >> mip);
+
+            // the plain box filtered mip loses most of the blades, the rescaled one keeps their coverage
+            AlphaMask next;
+            AlphaMaskPacker::Resample(filtered, filtered.width / 2, filtered.height / 2, next);
+            filtered = next;
+
+            // the coverage of a mip goes up a blade column at a time, around 1% at 64x64
+            float const error = fabsf(Coverage(mips[mip], alphaCutoff) - coverage);
+            CHECK(error <= 0.02f);
+            CHECK(error < fabsf(Coverage(filtered, alphaCutoff) - coverage));
+        }
+
+        AlphaMaskPacker::BuildMipChain(top, 0, alphaCutoff, mips);
+        CHECK(mips.empty());
+    }
+
+    void TestBC4()
+    {
+        CHECK(AlphaMaskPacker::GetBC4Size(4, 4) == 8);
+        CHECK(AlphaMaskPacker::GetBC4Size(256, 64) == 64 * 16 * 8);
+
+        // both palette modes against the values a GPU decodes, the first 8 texels take the palette
+        // entries in order and the rest take entry 0
+        uint8_t const block8[8] = { 255, 0, 0x88, 0xc6, 0xfa, 0, 0, 0 };
+        uint8_t const block6[8] = { 0, 255, 0x88, 0xc6, 0xfa, 0, 0, 0 };
+        uint8_t const palette8[8] = { 255, 0, 219, 182, 146, 109, 73, 36 };
+        uint8_t const palette6[8] = { 0, 255, 51, 102, 153, 204, 0, 255 };
+        AlphaMask decodedBlock;
+        AlphaMaskPacker::DecodeBC4(block8, 4, 4, decodedBlock);
+        for (uint32_t i = 0; i < 8; ++i)
+        {
+            CHECK(decodedBlock.alpha[i] == palette8[i]);
+        }
+        AlphaMaskPacker::DecodeBC4(block6, 4, 4, decodedBlock);
+        for (uint32_t i = 0; i < 8; ++i)
+        {
+            CHECK(decodedBlock.alpha[i] == palette6[i]);
+        }
+
+        std::mt19937 rng(22);
+        for (int test = 0; test < 200; ++test)
+        {
+            // random blocks and blocks with a narrow range, like most of a mask away from the edges
+            AlphaMask mask = MakeRandomMask(rng, 16, 8);
+            if (test % 2 == 1)
+            {
+                uint8_t const base = (uint8_t)(rng() % 200);
+                uint32_t const range = 1 + rng() % 40;
+                for (uint8_t& alpha : mask.alpha)
+                {
+                    alpha = (uint8_t)(base + alpha % range);
+                }
+            }
+            if (test % 10 == 0)
+            {
+                std::fill(mask.alpha.begin(), mask.alpha.begin() + 4, mask.alpha[0]);
+                std::fill(mask.alpha.begin() + 16, mask.alpha.begin() + 20, mask.alpha[0]);
+                std::fill(mask.alpha.begin() + 32, mask.alpha.begin() + 36, mask.alpha[0]);
+                std::fill(mask.alpha.begin() + 48, mask.alpha.begin() + 52, mask.alpha[0]);
+            }
+
+            std::vector<uint8_t> blocks(AlphaMaskPacker::GetBC4Size(16, 8));
+            AlphaMaskPacker::EncodeBC4(mask, blocks.data());
+            AlphaMask decoded;
+            AlphaMaskPacker::DecodeBC4(blocks.data(), 16, 8, decoded);
+            CHECK(decoded.width == 16 && decoded.height == 8);
+
+            for (uint32_t block = 0; block < 8; ++block)
+            {
+                uint32_t const bx = (block % 4) * 4;
+                uint32_t const by = (block / 4) * 4;
+                int lo = 255;
+                int hi = 0;
+                for (uint32_t i = 0; i < 16; ++i)
+                {
+                    int const alpha = mask.alpha[(by + i / 4) * 16 + bx + i % 4];
+                    lo = min(lo, alpha);
+                    hi = max(hi, alpha);
+                }
+
+                // the extremes are the endpoints and come back exact, the rest rounds to the nearest of
+                // the 8 steps, plus one for the rounding of the decoded palette
+                CHECK(blocks[block * 8] == hi && blocks[block * 8 + 1] == lo);
+                int maxError = 0;
+                for (uint32_t i = 0; i < 16; ++i)
+                {
+                    size_t const index = (by + i / 4) * 16 + bx + i % 4;
+                    int const error = abs((int)decoded.alpha[index] - (int)mask.alpha[index]);
+                    maxError = max(maxError, error);
+                    if (mask.alpha[index] == lo || mask.alpha[index] == hi)
+                    {
+                        CHECK(error == 0);
+                    }
+                }
+                CHECK(maxError * 14 <= hi - lo + 14);
+            }
+        }
+    }
+
+    void Cross(float const a[3], float const b[3], float result[3])
+    {
+        result[0] = a[1] * b[2] - a[2] * b[1];
+        result[1] = a[2] * b[0] - a[0] * b[2];
+        result[2] = a[0] * b[1] - a[1] * b[0];
+    }
+
+    void TestConeMipLevel()
+    {
+        // one unit of UV over a unit right triangle, a cone one texel wide picks the top mip
+        float const edge1[3] = { 1.0f, 0.0f, 0.0f };
+        float const edge2[3] = { 0.0f, 1.0f, 0.0f };
+        float const uv01[2] = { 1.0f, 0.0f };
+        float const uv02[2] = { 0.0f, 1.0f };
+        float const density = AlphaMaskPacker::GetUVDensity(edge1, edge2, uv01, uv02);
+        CHECK_NEAR(density, 0.0, 1e-6);
+        CHECK_NEAR(AlphaMaskPacker::GetConeMipLevel(density, 1.0f / 256.0f, 256, 256), 0.0, 1e-5);
+        CHECK_NEAR(AlphaMaskPacker::GetConeMipLevel(density, 4.0f / 256.0f, 256, 256), 2.0, 1e-5);
+        CHECK_NEAR(AlphaMaskPacker::GetConeMipLevel(density, 1.0f / 256.0f, 512, 128), 0.0, 1e-5);
+        CHECK_NEAR(AlphaMaskPacker::GetConeMipLevel(density, 1.0f / 256.0f, 512, 512), 1.0, 1e-5);
+
+        // twice the UVs over the same triangle is a mip up, twice the triangle with the same UVs a mip down
+        float const uv01x2[2] = { 2.0f, 0.0f };
+        float const uv02x2[2] = { 0.0f, 2.0f };
+        CHECK_NEAR(AlphaMaskPacker::GetUVDensity(edge1, edge2, uv01x2, uv02x2), 1.0, 1e-6);
+        float const edge1x2[3] = { 2.0f, 0.0f, 0.0f };
+        float const edge2x2[3] = { 0.0f, 2.0f, 0.0f };
+        CHECK_NEAR(AlphaMaskPacker::GetUVDensity(edge1x2, edge2x2, uv01, uv02), -1.0, 1e-6);
+
+        // the winding in either space doesn't matter
+        CHECK_NEAR(AlphaMaskPacker::GetUVDensity(edge2, edge1, uv01, uv02), 0.0, 1e-6);
+        CHECK_NEAR(AlphaMaskPacker::GetUVDensity(edge1, edge2, uv02, uv01), 0.0, 1e-6);
+
+        // degenerate triangles and cones stay finite
+        float const zero[3] = { 0.0f, 0.0f, 0.0f };
+        CHECK(std::isfinite(AlphaMaskPacker::GetUVDensity(edge1, zero, uv01, uv02)));
+        CHECK(std::isfinite(AlphaMaskPacker::GetUVDensity(edge1, edge2, uv01, zero)));
+        CHECK(std::isfinite(AlphaMaskPacker::GetConeMipLevel(density, 0.0f, 256, 256)));
+
+        // a random triangle against the texel footprint worked out by hand
+        std::mt19937 rng(23);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        for (int test = 0; test < 100; ++test)
+        {
+            float const e1[3] = { unit(rng), unit(rng), unit(rng) };
+            float const e2[3] = { unit(rng), unit(rng), unit(rng) };
+            float const t1[2] = { unit(rng), unit(rng) };
+            float const t2[2] = { unit(rng), unit(rng) };
+            float normal[3];
+            Cross(e1, e2, normal);
+            float const area = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            float const texelArea = fabsf(t1[0] * t2[1] - t1[1] * t2[0]) * 1024.0f * 256.0f;
+            if (area < 1e-3f || texelArea < 1e-3f)
+                continue;
+
+            float const coneWidth = 0.01f + 0.1f * fabsf(unit(rng));
+            float const texels = coneWidth * sqrtf(texelArea / area);
+            float const mip = AlphaMaskPacker::GetConeMipLevel(AlphaMaskPacker::GetUVDensity(e1, e2, t1, t2), coneWidth, 1024, 256);
+            CHECK_NEAR(mip, log2f(texels), 1e-4);
+        }
+    }
+
+    // The density is stored for the space of the structure, the shader moves it to world space with
+    // the area scale of the instance transform along the stored normal. Same math as GetAreaScale in
+    // ShadowRaytrace.hlsl, the columns are those of the 3x3 part of the transform.
+    void TestWorldSpaceDensity()
+    {
+        std::mt19937 rng(23);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        std::uniform_real_distribution<float> scale(0.1f, 10.0f);
+        for (int test = 0; test < 100; ++test)
+        {
+            // non uniform scale and shear
+            float columns[3][3];
+            for (uint32_t c = 0; c < 3; ++c)
+            {
+                for (uint32_t r = 0; r < 3; ++r)
+                {
+                    columns[c][r] = (r == c ? scale(rng) : 0.0f) + 0.5f * unit(rng);
+                }
+            }
+            auto transform = [&](float const v[3], float result[3])
+            {
+                for (uint32_t r = 0; r < 3; ++r)
+                {
+                    result[r] = columns[0][r] * v[0] + columns[1][r] * v[1] + columns[2][r] * v[2];
+                }
+            };
+
+            float const e1[3] = { unit(rng), unit(rng), unit(rng) };
+            float const e2[3] = { unit(rng), unit(rng), unit(rng) };
+            float const t1[2] = { unit(rng), unit(rng) };
+            float const t2[2] = { unit(rng), unit(rng) };
+            float normal[3];
+            Cross(e1, e2, normal);
+            float const length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            if (length < 1e-2f || fabsf(t1[0] * t2[1] - t1[1] * t2[0]) < 1e-3f)
+                continue;
+
+            float c12[3], c20[3], c01[3];
+            Cross(columns[1], columns[2], c12);
+            Cross(columns[2], columns[0], c20);
+            Cross(columns[0], columns[1], c01);
+            float areaScaleVector[3];
+            for (uint32_t i = 0; i < 3; ++i)
+            {
+                areaScaleVector[i] = (normal[0] * c12[i] + normal[1] * c20[i] + normal[2] * c01[i]) / length;
+            }
+            float const areaScale = sqrtf(areaScaleVector[0] * areaScaleVector[0] + areaScaleVector[1] * areaScaleVector[1] + areaScaleVector[2] * areaScaleVector[2]);
+
+            float worldEdge1[3], worldEdge2[3];
+            transform(e1, worldEdge1);
+            transform(e2, worldEdge2);
+            float const worldDensity = AlphaMaskPacker::GetUVDensity(worldEdge1, worldEdge2, t1, t2);
+            CHECK_NEAR(AlphaMaskPacker::GetUVDensity(e1, e2, t1, t2) - 0.5f * log2f(areaScale), worldDensity, 1e-3);
+        }
+    }
+}
+
+int main()
+{
+    TestExtractAlpha();
+    TestResample();
+    TestMipChain();
+    TestBC4();
+    TestConeMipLevel();
+    TestWorldSpaceDensity();
+
+    return UnitTest::Result("AlphaMaskPacker");
+}
@@ -0,0 +1,153 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+
+#include "UnitTest.h"
+
+namespace
+{
+    // CSMManager's FIT_PROJECTION_TO_CASCADES and FIT_TO_NEAR_FAR values, as the UI passes them
+    int const FitToCascades = 0;
+    int const FitToBoundingSphere = 2;
+    int const FitNearFarZeroOne = 0;
+    int const FitNearFarAABB = 1;
+    int const FitNearFarSceneAABB = 2;
+
+    int const NumCascades = 4;
+    float const ShadowMapWidth = 2048.0f;
+    float const CameraNear = 0.1f;
+
+    math::Matrix4 const g_matProjection = UnitTest::Perspective(1.0f, 16.0f / 9.0f, CameraNear, 1000.0f);
+    math::Matrix4 const g_matLightView = math::Matrix4::lookAt(math::Point3(30.0f, 100.0f, 20.0f), math::Point3(0.0f, 0.0f, 0.0f), math::Vector3(0.0f, 1.0f, 0.0f));
+    float const g_splitPoints[NumCascades] = { 5.0f, 15.0f, 40.0f, 100.0f };
+
+    math::Matrix4 GetView(math::Point3 const& eye, float yaw, float pitch)
+    {
+        math::Vector3 const direction(cosf(pitch) * sinf(yaw), sinf(pitch), cosf(pitch) * cosf(yaw));
+        return math::Matrix4::lookAt(eye, math::Point3(math::Vector3(eye.getX(), eye.getY(), eye.getZ()) + direction), math::Vector3(0.0f, 1.0f, 0.0f));
+    }
+
+    std::vector<math::Matrix4> SetupCascades(CSMManager& csm, GLTFCommon& gltf, math::Point3 const& eye, math::Matrix4 const& matView,
+        int cascadeType, int nearFarFitType = FitNearFarAABB)
+    {
+        csm.SetupCascades(g_matProjection, matView, eye, g_matLightView, CameraNear, &gltf, NumCascades, g_splitPoints,
+            cascadeType, nearFarFitType, ShadowMapWidth, true);
+        return csm.GetShadowProj();
+    }
+
+    float GetLargestDifference(math::Matrix4 const& a, math::Matrix4 const& b)
+    {
+        float difference = 0.0f;
+        for (int column = 0; column < 4; ++column)
+        {
+            for (int row = 0; row < 4; ++row)
+            {
+                difference = max(difference, fabsf(a.getElem(column, row) - b.getElem(column, row)));
+            }
+        }
+        return difference;
+    }
+
+    GLTFCommon MakeScene()
+    {
+        GLTFCommon gltf;
+        UnitTest::AddBoxNode(gltf, math::Vector4(0.0f, -1.0f, 0.0f, 1.0f), math::Vector4(200.0f, 1.0f, 200.0f, 0.0f), math::Matrix4::identity());
+        UnitTest::AddBoxNode(gltf, math::Vector4(10.0f, 5.0f, -10.0f, 1.0f), math::Vector4(2.0f, 5.0f, 2.0f, 0.0f), math::Matrix4::identity());
+        return gltf;
+    }
+
+    // Rotating the camera in place mustn't change the bounding sphere cascades, not even in the last
+    // bit: their contents would shimmer, and the cached static casters compare the projections with
+    // memcmp so they would be rendered again every frame
+    void TestRotation()
+    {
+        GLTFCommon gltf = MakeScene();
+        // away from the origin, so an inverse view would round the position differently for every rotation
+        math::Point3 const eye(53.3f, 2.0f, -37.7f);
+
+        CSMManager csm;
+        csm.OnCreate(NumCascades);
+
+        int const nearFarFitTypes[] = { FitNearFarZeroOne, FitNearFarAABB, FitNearFarSceneAABB };
+        for (int nearFarFitType : nearFarFitTypes)
+        {
+            std::vector<math::Matrix4> const reference = SetupCascades(csm, gltf, eye, GetView(eye, 0.0f, 0.0f), FitToBoundingSphere, nearFarFitType);
+
+            int changed = 0;
+            for (int yaw = 0; yaw < 360; yaw += 7)
+            {
+                for (int pitch = -80; pitch <= 80; pitch += 20)
+                {
+                    math::Matrix4 const matView = GetView(eye, yaw * 3.14159265f / 180.0f, pitch * 3.14159265f / 180.0f);
+                    std::vector<math::Matrix4> const projections = SetupCascades(csm, gltf, eye, matView, FitToBoundingSphere, nearFarFitType);
+                    for (int i = 0; i < NumCascades; ++i)
+                    {
+                        changed += memcmp(&projections[i], &reference[i], sizeof(math::Matrix4)) != 0 ? 1 : 0;
+                    }
+                }
+            }
+            CHECK(changed == 0);
+        }
+
+        // Fitting to the cascade frustums does change, so the check above does see a change
+        std::vector<math::Matrix4> const fitted = SetupCascades(csm, gltf, eye, GetView(eye, 0.0f, 0.0f), FitToCascades);
+        std::vector<math::Matrix4> const fittedRotated = SetupCascades(csm, gltf, eye, GetView(eye, 1.0f, 0.0f), FitToCascades);
+        CHECK(GetLargestDifference(fitted[0], fittedRotated[0]) > 1e-3f);
+    }
+
+    // Moving the camera moves the cascades by whole texels, and keeps their size
+    void TestTranslation()
+    {
+        GLTFCommon gltf = MakeScene();
+
+        CSMManager csm;
+        csm.OnCreate(NumCascades);
+        math::Point3 const start(0.0f, 2.0f, 0.0f);
+        std::vector<math::Matrix4> const reference = SetupCascades(csm, gltf, start, GetView(start, 0.5f, 0.0f), FitToBoundingSphere);
+
+        for (int step = 1; step < 50; ++step)
+        {
+            math::Point3 const eye(0.037f * step, 2.0f + 0.011f * step, -0.029f * step);
+            std::vector<math::Matrix4> const projections = SetupCascades(csm, gltf, eye, GetView(eye, 0.5f + 0.1f * step, 0.0f), FitToBoundingSphere);
+
+            for (int i = 0; i < NumCascades; ++i)
+            {
+                math::Matrix4 const& matProjection = projections[i];
+                CHECK_NEAR(matProjection.getElem(0, 0), reference[i].getElem(0, 0), 1e-7);
+                CHECK_NEAR(matProjection.getElem(1, 1), reference[i].getElem(1, 1), 1e-7);
+
+                // The center of the projection in light space, in texels
+                float const texelSize = 2.0f / (matProjection.getElem(0, 0) * ShadowMapWidth);
+                float const centerX = -matProjection.getElem(3, 0) / matProjection.getElem(0, 0) / texelSize;
+                float const centerY = -matProjection.getElem(3, 1) / matProjection.getElem(1, 1) / texelSize;
+                CHECK_NEAR(centerX, roundf(centerX), 1e-2);
+                CHECK_NEAR(centerY, roundf(centerY), 1e-2);
+            }
+        }
+    }
+}
+
+int main()
+{
+    TestRotation();
+    TestTranslation();
+
+    return UnitTest::Result("CascadeStability");
+}
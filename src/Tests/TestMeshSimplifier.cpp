@@ -0,0 +1,357 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+
+#include "UnitTest.h"
+
+#include "MeshSimplifier.h"
+
+#include <array>
+
+namespace
+{
+    struct Mesh
+    {
+        std::vector<float> positions;   // xyz per vertex
+        std::vector<uint32_t> indices;
+
+        uint32_t AddVertex(float x, float y, float z)
+        {
+            positions.push_back(x);
+            positions.push_back(y);
+            positions.push_back(z);
+            return static_cast<uint32_t>(positions.size() / 3 - 1);
+        }
+
+        uint32_t GetVertexCount() const { return static_cast<uint32_t>(positions.size() / 3); }
+    };
+
+    // Grid of quads on the square spanned by origin + [0, 1] * (u, v), the vertices of
+    // column seamColumn are duplicated like on a UV seam
+    void AddGrid(Mesh& mesh, float const origin[3], float const u[3], float const v[3], uint32_t size, uint32_t seamColumn)
+    {
+        std::vector<uint32_t> left((size + 1) * (size + 1));
+        std::vector<uint32_t> right((size + 1) * (size + 1));
+        for (uint32_t y = 0; y <= size; ++y)
+        {
+            for (uint32_t x = 0; x <= size; ++x)
+            {
+                float const s = static_cast<float>(x) / size;
+                float const t = static_cast<float>(y) / size;
+                float const p[3] = { origin[0] + s * u[0] + t * v[0], origin[1] + s * u[1] + t * v[1], origin[2] + s * u[2] + t * v[2] };
+                uint32_t const index = y * (size + 1) + x;
+                left[index] = right[index] = mesh.AddVertex(p[0], p[1], p[2]);
+                if (x == seamColumn)
+                {
+                    right[index] = mesh.AddVertex(p[0], p[1], p[2]);
+                }
+            }
+        }
+
+        for (uint32_t y = 0; y < size; ++y)
+        {
+            for (uint32_t x = 0; x < size; ++x)
+            {
+                // the quads right of the seam use the duplicates
+                std::vector<uint32_t> const& vertices = x >= seamColumn ? right : left;
+                uint32_t const i00 = vertices[y * (size + 1) + x];
+                uint32_t const i10 = vertices[y * (size + 1) + x + 1];
+                uint32_t const i01 = vertices[(y + 1) * (size + 1) + x];
+                uint32_t const i11 = vertices[(y + 1) * (size + 1) + x + 1];
+                mesh.indices.insert(mesh.indices.end(), { i00, i10, i11, i00, i11, i01 });
+            }
+        }
+    }
+
+    void GetPosition(Mesh const& mesh, uint32_t index, double p[3])
+    {
+        for (int c = 0; c < 3; ++c)
+            p[c] = mesh.positions[3 * index + c];
+    }
+
+    // Twice the area vector of a triangle
+    void GetNormal(Mesh const& mesh, uint32_t const* pTriangle, double n[3])
+    {
+        double p0[3], p1[3], p2[3];
+        GetPosition(mesh, pTriangle[0], p0);
+        GetPosition(mesh, pTriangle[1], p1);
+        GetPosition(mesh, pTriangle[2], p2);
+        double const e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+        double const e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+        n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+    }
+
+    double GetArea(Mesh const& mesh, std::vector<uint32_t> const& indices)
+    {
+        double area = 0.0;
+        for (size_t i = 0; i < indices.size(); i += 3)
+        {
+            double n[3];
+            GetNormal(mesh, &indices[i], n);
+            area += 0.5 * sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        }
+        return area;
+    }
+
+    // Signed volume of a closed mesh, from the tetrahedra of its triangles and the origin
+    double GetVolume(Mesh const& mesh, std::vector<uint32_t> const& indices)
+    {
+        double volume = 0.0;
+        for (size_t i = 0; i < indices.size(); i += 3)
+        {
+            double p0[3], p1[3], p2[3];
+            GetPosition(mesh, indices[i + 0], p0);
+            GetPosition(mesh, indices[i + 1], p1);
+            GetPosition(mesh, indices[i + 2], p2);
+            volume += (p0[0] * (p1[1] * p2[2] - p1[2] * p2[1]) - p0[1] * (p1[0] * p2[2] - p1[2] * p2[0]) + p0[2] * (p1[0] * p2[1] - p1[1] * p2[0])) / 6.0;
+        }
+        return volume;
+    }
+
+    void CheckIndices(Mesh const& mesh, std::vector<uint32_t> const& indices)
+    {
+        CHECK(indices.size() % 3 == 0);
+        bool bInRange = true;
+        bool bDegenerate = false;
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            bInRange &= indices[i] < mesh.GetVertexCount() && indices[i + 1] < mesh.GetVertexCount() && indices[i + 2] < mesh.GetVertexCount();
+            bDegenerate |= indices[i] == indices[i + 1] || indices[i + 1] == indices[i + 2] || indices[i + 2] == indices[i];
+        }
+        CHECK(bInRange);
+        CHECK(!bDegenerate);
+    }
+
+    // Every edge of a closed manifold mesh is used once in each direction, the vertices are
+    // compared by position since the simplified mesh indexes any of the welded ones
+    bool IsClosedManifold(Mesh const& mesh, std::vector<uint32_t> const& indices)
+    {
+        std::map<std::array<float, 3>, uint32_t> welded;
+        auto getWelded = [&](uint32_t index)
+        {
+            std::array<float, 3> const p = { mesh.positions[3 * index], mesh.positions[3 * index + 1], mesh.positions[3 * index + 2] };
+            return welded.emplace(p, static_cast<uint32_t>(welded.size())).first->second;
+        };
+
+        std::map<std::pair<uint32_t, uint32_t>, int> edges;
+        for (size_t i = 0; i < indices.size(); i += 3)
+        {
+            for (int e = 0; e < 3; ++e)
+            {
+                edges[{ getWelded(indices[i + e]), getWelded(indices[i + (e + 1) % 3]) }]++;
+            }
+        }
+
+        for (auto const& edge : edges)
+        {
+            auto const opposite = edges.find({ edge.first.second, edge.first.first });
+            if (edge.second != 1 || opposite == edges.end() || opposite->second != 1)
+                return false;
+        }
+        return true;
+    }
+
+    std::vector<uint32_t> Simplify(Mesh const& mesh, uint32_t targetIndexCount, float maxError)
+    {
+        std::vector<uint32_t> indices;
+        MeshSimplifier::Simplify(mesh.positions.data(), 3 * sizeof(float), mesh.GetVertexCount(), mesh.indices.data(),
+            static_cast<uint32_t>(mesh.indices.size()), targetIndexCount, maxError, indices);
+        return indices;
+    }
+
+    // A flat grid collapses to a handful of triangles that cover the same square, the seam doesn't
+    // stop it and no triangle flips
+    void TestPlane()
+    {
+        float const origin[3] = { 0.0f, 0.0f, 0.0f };
+        float const u[3] = { 1.0f, 0.0f, 0.0f };
+        float const v[3] = { 0.0f, 1.0f, 0.0f };
+
+        Mesh mesh;
+        AddGrid(mesh, origin, u, v, 32, 16);
+
+        std::vector<uint32_t> const indices = Simplify(mesh, 0, 1e-4f);
+        CheckIndices(mesh, indices);
+        CHECK(indices.size() <= 3 * 8);
+        CHECK_NEAR(GetArea(mesh, indices), 1.0, 1e-4);
+
+        bool bFlipped = false;
+        for (size_t i = 0; i < indices.size(); i += 3)
+        {
+            double n[3];
+            GetNormal(mesh, &indices[i], n);
+            bFlipped |= n[2] <= 0.0;
+        }
+        CHECK(!bFlipped);
+    }
+
+    // A cube made of six separate grids welds into a closed mesh and collapses down to its faces
+    // without moving them
+    void TestCube()
+    {
+        Mesh mesh;
+        float const faces[6][3][3] = {
+            { { 0, 0, 0 }, { 0, 1, 0 }, { 1, 0, 0 } },     // -Z
+            { { 0, 0, 1 }, { 1, 0, 0 }, { 0, 1, 0 } },     // +Z
+            { { 0, 0, 0 }, { 1, 0, 0 }, { 0, 0, 1 } },     // -Y
+            { { 0, 1, 0 }, { 0, 0, 1 }, { 1, 0, 0 } },     // +Y
+            { { 0, 0, 0 }, { 0, 0, 1 }, { 0, 1, 0 } },     // -X
+            { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } },     // +X
+        };
+        for (auto const& face : faces)
+        {
+            AddGrid(mesh, face[0], face[1], face[2], 8, 4);
+        }
+        CHECK_NEAR(GetVolume(mesh, mesh.indices), 1.0, 1e-5);
+        CHECK(IsClosedManifold(mesh, mesh.indices));
+
+        std::vector<uint32_t> const indices = Simplify(mesh, 0, 1e-4f);
+        CheckIndices(mesh, indices);
+        CHECK(indices.size() < mesh.indices.size() / 8);
+        CHECK_NEAR(GetArea(mesh, indices), 6.0, 1e-4);
+        CHECK_NEAR(GetVolume(mesh, indices), 1.0, 1e-4);
+        CHECK(IsClosedManifold(mesh, indices));
+    }
+
+    Mesh MakeSphere(uint32_t rings, uint32_t segments)
+    {
+        Mesh mesh;
+        for (uint32_t r = 0; r <= rings; ++r)
+        {
+            float const theta = 3.14159265f * r / rings;
+            for (uint32_t s = 0; s <= segments; ++s)
+            {
+                // the last column duplicates the first, like a UV seam
+                float const phi = 2.0f * 3.14159265f * (s % segments) / segments;
+                // and the poles are one position, up to the sign of the zeros
+                float const ringRadius = (r == 0 || r == rings) ? 0.0f : sinf(theta);
+                float const y = r == 0 ? 1.0f : (r == rings ? -1.0f : cosf(theta));
+                mesh.AddVertex(ringRadius * cosf(phi), y, ringRadius * sinf(phi));
+            }
+        }
+        for (uint32_t r = 0; r < rings; ++r)
+        {
+            for (uint32_t s = 0; s < segments; ++s)
+            {
+                uint32_t const i00 = r * (segments + 1) + s;
+                uint32_t const i01 = i00 + 1;
+                uint32_t const i10 = i00 + segments + 1;
+                uint32_t const i11 = i10 + 1;
+                if (r != 0)
+                    mesh.indices.insert(mesh.indices.end(), { i00, i01, i11 });
+                if (r != rings - 1)
+                    mesh.indices.insert(mesh.indices.end(), { i00, i11, i10 });
+            }
+        }
+        return mesh;
+    }
+
+    void TestSphere()
+    {
+        Mesh const mesh = MakeSphere(32, 64);
+        uint32_t const indexCount = static_cast<uint32_t>(mesh.indices.size());
+        double const volume = GetVolume(mesh, mesh.indices);
+        CHECK(IsClosedManifold(mesh, mesh.indices));
+
+        // Curved everywhere, nothing is cheap enough for a tiny error
+        std::vector<uint32_t> const exact = Simplify(mesh, 0, 1e-7f);
+        CheckIndices(mesh, exact);
+        CHECK(exact.size() == indexCount);
+
+        // Stops at the target, a collapse removes at most 2 triangles
+        std::vector<uint32_t> const half = Simplify(mesh, indexCount / 2, 1.0f);
+        CheckIndices(mesh, half);
+        CHECK(half.size() <= indexCount / 2);
+        CHECK(half.size() + 6 > indexCount / 2);
+        CHECK_NEAR(GetVolume(mesh, half), volume, 0.01 * volume);
+        CHECK(IsClosedManifold(mesh, half));
+
+        // The error bound stops it before the target, the shape stays close to the original
+        std::vector<uint32_t> const bounded = Simplify(mesh, 0, 0.03f);
+        CheckIndices(mesh, bounded);
+        CHECK(bounded.size() < indexCount / 2);
+        CHECK(bounded.size() > 3 * 32);
+        CHECK_NEAR(GetVolume(mesh, bounded), volume, 0.02 * volume);
+
+        // and a larger one goes further
+        std::vector<uint32_t> const coarse = Simplify(mesh, 0, 0.1f);
+        CheckIndices(mesh, coarse);
+        CHECK(coarse.size() < bounded.size());
+        CHECK(IsClosedManifold(mesh, bounded));
+        CHECK(IsClosedManifold(mesh, coarse));
+
+        // Down to a few triangles, the pole vertices have -0 and 0 coordinates and still weld
+        std::vector<uint32_t> const tiny = Simplify(mesh, 0, 10.0f);
+        CheckIndices(mesh, tiny);
+        CHECK(IsClosedManifold(mesh, tiny));
+
+    }
+
+    Mesh MakeTorus(uint32_t rings, uint32_t segments, float radius, float tubeRadius)
+    {
+        Mesh mesh;
+        for (uint32_t r = 0; r < rings; ++r)
+        {
+            float const theta = 2.0f * 3.14159265f * r / rings;
+            for (uint32_t s = 0; s < segments; ++s)
+            {
+                float const phi = 2.0f * 3.14159265f * s / segments;
+                float const distance = radius + tubeRadius * cosf(phi);
+                mesh.AddVertex(distance * cosf(theta), tubeRadius * sinf(phi), distance * sinf(theta));
+            }
+        }
+        for (uint32_t r = 0; r < rings; ++r)
+        {
+            for (uint32_t s = 0; s < segments; ++s)
+            {
+                uint32_t const i00 = r * segments + s;
+                uint32_t const i01 = r * segments + (s + 1) % segments;
+                uint32_t const i10 = ((r + 1) % rings) * segments + s;
+                uint32_t const i11 = ((r + 1) % rings) * segments + (s + 1) % segments;
+                mesh.indices.insert(mesh.indices.end(), { i00, i01, i11, i00, i11, i10 });
+            }
+        }
+        return mesh;
+    }
+
+    // Simplified as far as it goes, the link condition keeps the thin tube from being pinched
+    void TestTorus()
+    {
+        Mesh const mesh = MakeTorus(64, 16, 1.0f, 0.25f);
+        CHECK(IsClosedManifold(mesh, mesh.indices));
+
+        std::vector<uint32_t> const indices = Simplify(mesh, 0, 10.0f);
+        CheckIndices(mesh, indices);
+        CHECK(indices.size() < mesh.indices.size() / 10);
+        CHECK(IsClosedManifold(mesh, indices));
+    }
+}
+
+int main()
+{
+    TestPlane();
+    TestCube();
+    TestSphere();
+    TestTorus();
+
+    return UnitTest::Result("MeshSimplifier");
+}
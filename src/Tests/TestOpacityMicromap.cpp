@@ -0,0 +1,235 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+
+#include "UnitTest.h"
+
+#include "OpacityMicromap.h"
+
+#include <random>
+
+namespace
+{
+    OpacityMicromap::AlphaMask MakeSolidMask(uint8_t alpha)
+    {
+        OpacityMicromap::AlphaMask mask;
+        mask.width = 16;
+        mask.height = 8;
+        mask.alpha.assign(mask.width * mask.height, alpha);
+        return mask;
+    }
+
+    // A disc with a hole in a checkerboard, so that the cut outs run in every direction
+    OpacityMicromap::AlphaMask MakePatternMask()
+    {
+        OpacityMicromap::AlphaMask mask;
+        mask.width = 64;
+        mask.height = 32;
+        mask.alpha.resize(mask.width * mask.height);
+        for (uint32_t y = 0; y < mask.height; ++y)
+        {
+            for (uint32_t x = 0; x < mask.width; ++x)
+            {
+                float const dx = (x + 0.5f) / mask.width - 0.5f;
+                float const dy = (y + 0.5f) / mask.height - 0.5f;
+                float const r = sqrtf(dx * dx + dy * dy);
+                bool const bChecker = ((x / 8) + (y / 8)) % 2 == 0;
+                bool const bOpaque = (r < 0.4f && r > 0.15f) || (r >= 0.4f && bChecker);
+                mask.alpha[y * mask.width + x] = bOpaque ? 230 : 20;
+            }
+        }
+        return mask;
+    }
+
+    // What ss_mask returns, bilinear with wrap addressing
+    float SampleBilinear(OpacityMicromap::AlphaMask const& mask, float u, float v)
+    {
+        float const x = u * mask.width - 0.5f;
+        float const y = v * mask.height - 0.5f;
+        float const fx = floorf(x);
+        float const fy = floorf(y);
+        auto texel = [&](int64_t tx, int64_t ty)
+        {
+            tx = ((tx % mask.width) + mask.width) % mask.width;
+            ty = ((ty % mask.height) + mask.height) % mask.height;
+            return mask.alpha[ty * mask.width + tx] / 255.0f;
+        };
+        int64_t const x0 = (int64_t)fx;
+        int64_t const y0 = (int64_t)fy;
+        float const wx = x - fx;
+        float const wy = y - fy;
+        float const top = texel(x0, y0) * (1.0f - wx) + texel(x0 + 1, y0) * wx;
+        float const bottom = texel(x0, y0 + 1) * (1.0f - wx) + texel(x0 + 1, y0 + 1) * wx;
+        return top * (1.0f - wy) + bottom * wy;
+    }
+
+    void TestUniform()
+    {
+        for (OpacityMicromap::State state : { OpacityMicromap::Transparent, OpacityMicromap::Opaque, OpacityMicromap::Unknown })
+        {
+            uint32_t const descriptor = OpacityMicromap::MakeUniform(state);
+            CHECK(descriptor >> 28 == OpacityMicromap::UniformLevel);
+            CHECK(OpacityMicromap::GetState(descriptor, nullptr, 0.3f, 0.2f) == state);
+            CHECK(OpacityMicromap::Rebase(descriptor, 1000) == descriptor);
+        }
+
+        uint32_t const descriptor = (3u << 28) | 5;
+        CHECK(OpacityMicromap::Rebase(descriptor, 1000) == ((3u << 28) | 1005));
+    }
+
+    // The shader finds the micro triangle of a hit with GetMicroTriangleIndex, it has to count
+    // them in the order that Bake stores them
+    void TestMicroTriangleIndex()
+    {
+        for (uint32_t level = 0; level <= OpacityMicromap::MaxLevel; ++level)
+        {
+            uint32_t const segments = 1u << level;
+            uint32_t expected = 0;
+            bool bInOrder = true;
+            for (uint32_t iy = 0; iy < segments; ++iy)
+            {
+                for (uint32_t ix = 0; ix + iy < segments; ++ix)
+                {
+                    // centroids of the upright and the inverted micro triangle
+                    bInOrder &= OpacityMicromap::GetMicroTriangleIndex(level, (ix + 1.0f / 3.0f) / segments, (iy + 1.0f / 3.0f) / segments) == expected++;
+                    if (ix + iy + 1 < segments)
+                    {
+                        bInOrder &= OpacityMicromap::GetMicroTriangleIndex(level, (ix + 2.0f / 3.0f) / segments, (iy + 2.0f / 3.0f) / segments) == expected++;
+                    }
+                }
+            }
+            CHECK(bInOrder);
+            CHECK(expected == segments * segments);
+
+            // the corners and points just outside the triangle clamp to the micro triangles at the edge
+            CHECK(OpacityMicromap::GetMicroTriangleIndex(level, 0.0f, 0.0f) == 0);
+            CHECK(OpacityMicromap::GetMicroTriangleIndex(level, -0.1f, -0.1f) == 0);
+            CHECK(OpacityMicromap::GetMicroTriangleIndex(level, 1.0f, 0.0f) == 2 * segments - 2);
+            CHECK(OpacityMicromap::GetMicroTriangleIndex(level, 0.0f, 1.0f) == segments * segments - 1);
+            CHECK(OpacityMicromap::GetMicroTriangleIndex(level, 0.0f, 1.1f) == segments * segments - 1);
+            CHECK(OpacityMicromap::GetMicroTriangleIndex(level, 0.6f, 0.6f) < segments * segments);
+        }
+    }
+
+    void TestUniformMasks()
+    {
+        float const uv0[2] = { 0.0f, 0.0f };
+        float const uv01[2] = { 1.0f, 0.0f };
+        float const uv02[2] = { 0.0f, 1.0f };
+        float const cutoff = 0.5f;
+        std::vector<uint32_t> states;
+
+        CHECK(OpacityMicromap::Bake(MakeSolidMask(255), cutoff, uv0, uv01, uv02, 8, states) == OpacityMicromap::MakeUniform(OpacityMicromap::Opaque));
+        CHECK(OpacityMicromap::Bake(MakeSolidMask(0), cutoff, uv0, uv01, uv02, 8, states) == OpacityMicromap::MakeUniform(OpacityMicromap::Transparent));
+
+        // floor(0.5 * 255) = 127, a texel within a step of it may blend to either side on the GPU
+        CHECK(OpacityMicromap::Bake(MakeSolidMask(127), cutoff, uv0, uv01, uv02, 8, states) == OpacityMicromap::MakeUniform(OpacityMicromap::Unknown));
+        CHECK(OpacityMicromap::Bake(MakeSolidMask(128), cutoff, uv0, uv01, uv02, 8, states) == OpacityMicromap::MakeUniform(OpacityMicromap::Unknown));
+        CHECK(OpacityMicromap::Bake(MakeSolidMask(129), cutoff, uv0, uv01, uv02, 8, states) == OpacityMicromap::MakeUniform(OpacityMicromap::Opaque));
+        CHECK(OpacityMicromap::Bake(MakeSolidMask(126), cutoff, uv0, uv01, uv02, 8, states) == OpacityMicromap::MakeUniform(OpacityMicromap::Transparent));
+
+        // no mask to classify against, and UVs that can't be scanned
+        CHECK(OpacityMicromap::Bake(OpacityMicromap::AlphaMask(), cutoff, uv0, uv01, uv02, 8, states) == OpacityMicromap::MakeUniform(OpacityMicromap::Unknown));
+        float const nanUV[2] = { NAN, 0.0f };
+        CHECK(OpacityMicromap::Bake(MakeSolidMask(255), cutoff, nanUV, uv01, uv02, 8, states) == OpacityMicromap::MakeUniform(OpacityMicromap::Unknown));
+        float const hugeUV[2] = { 1e7f, 0.0f };
+        CHECK(OpacityMicromap::Bake(MakeSolidMask(255), cutoff, uv0, hugeUV, uv02, 8, states) == OpacityMicromap::MakeUniform(OpacityMicromap::Unknown));
+
+        CHECK(states.empty());
+    }
+
+    // Every point the bake calls opaque or transparent has to sample to that side of the cutoff,
+    // only the unknown micro triangles are left to the mask lookup in the shader
+    void TestConservative()
+    {
+        OpacityMicromap::AlphaMask const mask = MakePatternMask();
+        float const cutoff = 0.5f;
+        std::mt19937 rng(21);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        std::uniform_real_distribution<float> position(-1.0f, 2.0f);
+
+        std::vector<uint32_t> states(7, 0xdeadbeef);
+        uint32_t decided = 0;
+        uint32_t samples = 0;
+        uint32_t wrong = 0;
+        uint32_t maxLevelSeen = 0;
+        for (int triangle = 0; triangle < 300; ++triangle)
+        {
+            float const scale = triangle % 3 == 0 ? 0.05f : 1.0f;
+            float const uv0[2] = { position(rng), position(rng) };
+            float const uv01[2] = { scale * (unit(rng) - 0.5f), scale * (unit(rng) - 0.5f) };
+            float const uv02[2] = { scale * (unit(rng) - 0.5f), scale * (unit(rng) - 0.5f) };
+            uint32_t const maxLevel = triangle % 4 == 0 ? 2 : OpacityMicromap::MaxLevel;
+
+            size_t const stateCount = states.size();
+            uint32_t const descriptor = OpacityMicromap::Bake(mask, cutoff, uv0, uv01, uv02, maxLevel, states);
+            uint32_t const level = descriptor >> 28;
+            if (level == OpacityMicromap::UniformLevel)
+            {
+                CHECK(states.size() == stateCount);
+            }
+            else
+            {
+                // appended after what was there, the offset is relative to the start of states
+                CHECK(level <= maxLevel);
+                CHECK((descriptor & 0x0fffffff) == stateCount);
+                CHECK(states.size() == stateCount + ((1u << (2 * level)) + 15) / 16);
+                maxLevelSeen = max(maxLevelSeen, level);
+            }
+
+            for (int sample = 0; sample < 200; ++sample)
+            {
+                float u = unit(rng);
+                float v = unit(rng);
+                if (u + v > 1.0f)
+                {
+                    u = 1.0f - u;
+                    v = 1.0f - v;
+                }
+
+                OpacityMicromap::State const state = OpacityMicromap::GetState(descriptor, states.data(), u, v);
+                if (state == OpacityMicromap::Unknown)
+                    continue;
+
+                float const alpha = SampleBilinear(mask, uv0[0] + uv01[0] * u + uv02[0] * v, uv0[1] + uv01[1] * u + uv02[1] * v);
+                wrong += (alpha > cutoff) == (state == OpacityMicromap::Opaque) ? 0 : 1;
+                ++decided;
+            }
+            samples += 200;
+        }
+        CHECK(wrong == 0);
+        CHECK(states[0] == 0xdeadbeef && states[6] == 0xdeadbeef);
+
+        // the mask has large solid areas, a good part of the hits shouldn't need the texture
+        CHECK(decided > samples / 3);
+        CHECK(maxLevelSeen > 2);
+        printf("%u of %u samples decided by the micromaps\n", decided, samples);
+    }
+}
+
+int main()
+{
+    TestUniform();
+    TestMicroTriangleIndex();
+    TestUniformMasks();
+    TestConservative();
+
+    return UnitTest::Result("OpacityMicromap");
+}
@@ -0,0 +1,193 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+
+#include "UnitTest.h"
+
+#include "PositionQuantizer.h"
+
+#include <random>
+
+namespace
+{
+    // Interleaved like a glTF vertex buffer, the position followed by a normal and a UV
+    uint32_t const Stride = 8 * sizeof(float);
+
+    std::vector<float> MakeVertices(std::mt19937& rng, uint32_t vertexCount, float const center[3], float const halfExtent[3])
+    {
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        std::vector<float> vertices(vertexCount * 8);
+        for (uint32_t v = 0; v < vertexCount; ++v)
+        {
+            for (uint32_t i = 0; i < 8; ++i)
+            {
+                vertices[v * 8 + i] = i < 3 ? center[i] + halfExtent[i] * unit(rng) : 1e9f;
+            }
+        }
+        return vertices;
+    }
+
+    // Every position comes back within GetMaxError, plus the rounding of the float math at the
+    // magnitude of the bounds, which the original positions can't be more precise than either
+    void CheckRoundTrip(std::vector<float> const& vertices, PositionQuantizer::Bounds const& bounds)
+    {
+        uint32_t const vertexCount = (uint32_t)vertices.size() / 8;
+        std::vector<int16_t> quantized(vertexCount * 4, 0x5555);
+        std::vector<float> positions(vertexCount * 3);
+        PositionQuantizer::Quantize(vertices.data(), Stride, vertexCount, bounds, quantized.data());
+        PositionQuantizer::Dequantize(quantized.data(), vertexCount, bounds, positions.data());
+
+        float const maxError = PositionQuantizer::GetMaxError(bounds);
+        float slack = 0.0f;
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+            slack += 2.0f * FLT_EPSILON * (fabsf(bounds.center[i]) + bounds.halfExtent[i]);
+        }
+
+        float largestError = 0.0f;
+        bool bPadded = true;
+        for (uint32_t v = 0; v < vertexCount; ++v)
+        {
+            float distance = 0.0f;
+            for (uint32_t i = 0; i < 3; ++i)
+            {
+                float const d = positions[v * 3 + i] - vertices[v * 8 + i];
+                distance += d * d;
+            }
+            largestError = max(largestError, sqrtf(distance));
+            bPadded &= quantized[v * 4 + 3] == 0;
+        }
+        CHECK(largestError <= maxError + slack);
+        CHECK(bPadded);
+    }
+
+    void TestBounds()
+    {
+        std::mt19937 rng(24);
+        float const center[3] = { 1.0f, -2.0f, 3.0f };
+        float const halfExtent[3] = { 4.0f, 0.5f, 2.0f };
+        std::vector<float> vertices = MakeVertices(rng, 1000, center, halfExtent);
+
+        // the extremes of every axis are in the buffer
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+            vertices[i * 8 + i] = center[i] - halfExtent[i];
+            vertices[(i + 3) * 8 + i] = center[i] + halfExtent[i];
+        }
+
+        PositionQuantizer::Bounds const bounds = PositionQuantizer::GetBounds(vertices.data(), Stride, 1000);
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+            CHECK_NEAR(bounds.center[i], center[i], 1e-6);
+            CHECK_NEAR(bounds.halfExtent[i], halfExtent[i], 1e-6);
+        }
+
+        // the extremes quantize to the ends of the snorm range
+        std::vector<int16_t> quantized(1000 * 4);
+        PositionQuantizer::Quantize(vertices.data(), Stride, 1000, bounds, quantized.data());
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+            CHECK(quantized[i * 4 + i] == -32767);
+            CHECK(quantized[(i + 3) * 4 + i] == 32767);
+        }
+
+        CheckRoundTrip(vertices, bounds);
+
+        // half a step on every axis
+        float const step[3] = { 4.0f / 32767.0f, 0.5f / 32767.0f, 2.0f / 32767.0f };
+        CHECK_NEAR(PositionQuantizer::GetMaxError(bounds), 0.5f * sqrtf(step[0] * step[0] + step[1] * step[1] + step[2] * step[2]), 1e-9);
+    }
+
+    void TestRoundTrip()
+    {
+        std::mt19937 rng(24);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        for (int test = 0; test < 50; ++test)
+        {
+            // from millimeter details to kilometer terrain, some far from the origin
+            float const magnitude = powf(10.0f, -3.0f + 6.0f * unit(rng));
+            float const offset = test % 2 ? magnitude * 100.0f * unit(rng) : 0.0f;
+            float const center[3] = { offset, -offset, 0.5f * offset };
+            float const halfExtent[3] = { magnitude * unit(rng), magnitude * unit(rng), magnitude };
+            std::vector<float> const vertices = MakeVertices(rng, 500, center, halfExtent);
+
+            CheckRoundTrip(vertices, PositionQuantizer::GetBounds(vertices.data(), Stride, 500));
+        }
+    }
+
+    void TestFlatAxes()
+    {
+        std::mt19937 rng(24);
+
+        // a quad in the z = 5 plane, its z stays put and the dequantization can be inverted
+        float const center[3] = { 0.0f, 0.0f, 5.0f };
+        float const halfExtent[3] = { 10.0f, 3.0f, 0.0f };
+        std::vector<float> const plane = MakeVertices(rng, 100, center, halfExtent);
+        PositionQuantizer::Bounds const bounds = PositionQuantizer::GetBounds(plane.data(), Stride, 100);
+        CHECK(bounds.halfExtent[2] > 0.0f);
+        CHECK(bounds.halfExtent[2] <= 10.0f / 32767.0f);
+        CHECK(bounds.center[2] == 5.0f);
+        CheckRoundTrip(plane, bounds);
+
+        // a single point and no points at all
+        std::vector<float> const point = MakeVertices(rng, 1, center, halfExtent);
+        PositionQuantizer::Bounds const pointBounds = PositionQuantizer::GetBounds(point.data(), Stride, 1);
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+            CHECK(pointBounds.center[i] == point[i]);
+            CHECK(pointBounds.halfExtent[i] > 0.0f);
+        }
+        CheckRoundTrip(point, pointBounds);
+
+        PositionQuantizer::Bounds const empty = PositionQuantizer::GetBounds(nullptr, Stride, 0);
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+            CHECK(empty.center[i] == 0.0f);
+            CHECK(empty.halfExtent[i] > 0.0f);
+        }
+    }
+
+    void TestClamping()
+    {
+        PositionQuantizer::Bounds const bounds = { { 0.0f, 0.0f, 0.0f }, { 1.0f, 2.0f, 4.0f } };
+
+        // positions outside of the bounds clamp to them
+        float const outside[3] = { 3.0f, -5.0f, 4.0f };
+        int16_t quantized[4];
+        PositionQuantizer::Quantize(outside, 3 * sizeof(float), 1, bounds, quantized);
+        CHECK(quantized[0] == 32767 && quantized[1] == -32767 && quantized[2] == 32767);
+
+        // -32768 is -1 like -32767
+        int16_t const lowest[4] = { -32768, -32767, 0, 0 };
+        float positions[3];
+        PositionQuantizer::Dequantize(lowest, 1, bounds, positions);
+        CHECK(positions[0] == -1.0f && positions[1] == -2.0f && positions[2] == 0.0f);
+    }
+}
+
+int main()
+{
+    TestBounds();
+    TestRoundTrip();
+    TestFlatAxes();
+    TestClamping();
+
+    return UnitTest::Result("PositionQuantizer");
+}
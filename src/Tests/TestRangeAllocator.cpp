@@ -0,0 +1,216 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+
+#include "UnitTest.h"
+
+#include "RangeAllocator.h"
+
+#include <random>
+
+using Raytracing::RangeAllocator;
+
+namespace
+{
+    void TestAlignment()
+    {
+        RangeAllocator allocator;
+        allocator.Init(1000, 256);
+        CHECK(allocator.GetSize() == 768);
+        CHECK(allocator.GetLargestFreeRange() == 768);
+
+        // sizes are rounded up to the alignment, 0 still takes a range
+        CHECK(allocator.Allocate(1) == 0);
+        CHECK(allocator.Allocate(0) == 256);
+        CHECK(allocator.GetUsedSize() == 512);
+        CHECK(allocator.GetAllocationCount() == 2);
+
+        CHECK(allocator.Allocate(257) == RangeAllocator::InvalidOffset);
+        CHECK(allocator.Allocate(256) == 512);
+        CHECK(allocator.Allocate(1) == RangeAllocator::InvalidOffset);
+        CHECK(allocator.GetLargestFreeRange() == 0);
+    }
+
+    void TestMerge()
+    {
+        RangeAllocator allocator;
+        allocator.Init(4096, 16);
+
+        uint64_t const a = allocator.Allocate(1024);
+        uint64_t const b = allocator.Allocate(1024);
+        uint64_t const c = allocator.Allocate(1024);
+        uint64_t const d = allocator.Allocate(1024);
+        CHECK(a == 0 && b == 1024 && c == 2048 && d == 3072);
+
+        // a and c are free but apart
+        allocator.Free(a);
+        allocator.Free(c);
+        CHECK(allocator.GetLargestFreeRange() == 1024);
+        CHECK(allocator.Allocate(2048) == RangeAllocator::InvalidOffset);
+
+        // freeing b merges it with both
+        allocator.Free(b);
+        CHECK(allocator.GetLargestFreeRange() == 3072);
+        CHECK(allocator.Allocate(3072) == 0);
+
+        allocator.Free(0);
+        allocator.Free(d);
+        CHECK(allocator.GetLargestFreeRange() == 4096);
+        CHECK(allocator.GetUsedSize() == 0);
+        CHECK(allocator.GetAllocationCount() == 0);
+
+        // Reset frees everything at once
+        allocator.Allocate(100);
+        allocator.Allocate(200);
+        allocator.Reset();
+        CHECK(allocator.GetUsedSize() == 0);
+        CHECK(allocator.GetAllocationCount() == 0);
+        CHECK(allocator.Allocate(4096) == 0);
+    }
+
+    // Random allocations and frees against a map of the live ranges
+    void TestRandom()
+    {
+        uint64_t const size = 1 << 24;
+        uint64_t const alignment = 64;
+
+        RangeAllocator allocator;
+        allocator.Init(size, alignment);
+
+        std::mt19937 rng(18);
+        std::map<uint64_t, uint64_t> live;
+        uint64_t usedSize = 0;
+        bool bValid = true;
+        bool bFailedWithRoom = false;
+
+        for (int i = 0; i < 100000; ++i)
+        {
+            if (live.empty() || (rng() % 100) < 55)
+            {
+                // mostly small, now and then a large one
+                uint64_t const requested = (rng() % 8) == 0 ? rng() % (size / 16) : rng() % 4096;
+                uint64_t const alignedSize = (max(requested, 1ull) + alignment - 1) & ~(alignment - 1);
+                uint64_t const largestFree = allocator.GetLargestFreeRange();
+
+                uint64_t const offset = allocator.Allocate(requested);
+                if (offset == RangeAllocator::InvalidOffset)
+                {
+                    // only fails when no free range is large enough
+                    bFailedWithRoom |= largestFree >= alignedSize;
+                    continue;
+                }
+
+                bValid &= offset % alignment == 0 && offset + alignedSize <= size;
+
+                // no overlap with the neighbours
+                auto const next = live.lower_bound(offset);
+                bValid &= next == live.end() || offset + alignedSize <= next->first;
+                if (next != live.begin())
+                {
+                    auto const prev = std::prev(next);
+                    bValid &= prev->first + prev->second <= offset;
+                }
+
+                live.emplace(offset, alignedSize);
+                usedSize += alignedSize;
+            }
+            else
+            {
+                auto it = live.begin();
+                std::advance(it, rng() % live.size());
+                allocator.Free(it->first);
+                usedSize -= it->second;
+                live.erase(it);
+            }
+
+            bValid &= allocator.GetUsedSize() == usedSize && allocator.GetAllocationCount() == live.size();
+            bValid &= allocator.GetLargestFreeRange() <= size - usedSize;
+        }
+        CHECK(bValid);
+        CHECK(!bFailedWithRoom);
+
+        for (auto const& range : live)
+        {
+            allocator.Free(range.first);
+        }
+        CHECK(allocator.GetUsedSize() == 0);
+        CHECK(allocator.GetAllocationCount() == 0);
+        CHECK(allocator.GetLargestFreeRange() == size);
+    }
+
+    // One frame of scratch suballocations, the TLAS and skinned BLAS builds take their scratch like this
+    // and drop it all at once with Reset, the acceleration structures are freed one by one
+    void RunFrame(RangeAllocator& scratch, RangeAllocator& structures, std::vector<uint64_t>& offsets, uint32_t seed)
+    {
+        std::mt19937 rng(seed);
+
+        for (int build = 0; build < 64; ++build)
+        {
+            scratch.Allocate(256 + rng() % 65536);
+        }
+        scratch.Reset();
+
+        offsets.clear();
+        for (int build = 0; build < 256; ++build)
+        {
+            offsets.push_back(structures.Allocate(256 + rng() % 65536));
+        }
+        for (size_t i = 0; i < offsets.size(); ++i)
+        {
+            std::swap(offsets[i], offsets[i + rng() % (offsets.size() - i)]);
+        }
+        for (uint64_t offset : offsets)
+        {
+            structures.Free(offset);
+        }
+    }
+
+    // Once the peak number of ranges has been reached, allocating, freeing and resetting don't
+    // touch the heap, which the steady state frame relies on
+    void TestNoAllocations()
+    {
+        RangeAllocator scratch;
+        scratch.Init(1 << 24, 256);
+        RangeAllocator structures;
+        structures.Init(1 << 26, 256);
+        std::vector<uint64_t> offsets;
+        offsets.reserve(256);
+
+        RunFrame(scratch, structures, offsets, 18);
+
+        uint64_t const start = AllocationCounter::GetCount();
+        for (int frame = 0; frame < 10; ++frame)
+        {
+            RunFrame(scratch, structures, offsets, 18);
+        }
+        CHECK(AllocationCounter::GetCount() == start);
+        CHECK(structures.GetAllocationCount() == 0);
+    }
+}
+
+int main()
+{
+    TestAlignment();
+    TestMerge();
+    TestRandom();
+    TestNoAllocations();
+
+    return UnitTest::Result("RangeAllocator");
+}
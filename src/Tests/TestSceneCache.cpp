@@ -0,0 +1,242 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+
+#include "UnitTest.h"
+
+#include "SceneCache.h"
+
+#include <fstream>
+#include <random>
+
+using Raytracing::SceneCache;
+
+namespace
+{
+    // In the working directory of the test, removed again at the end
+    char const* const CachePath = "TestSceneCache.blascache";
+    char const* const MissingPath = "TestSceneCache.missing.blascache";
+
+    std::vector<uint8_t> MakeBlob(std::mt19937& rng, size_t size)
+    {
+        std::vector<uint8_t> blob(size);
+        for (uint8_t& value : blob)
+        {
+            value = (uint8_t)rng();
+        }
+        return blob;
+    }
+
+    std::vector<char> ReadFile(char const* pPath)
+    {
+        std::ifstream file(pPath, std::ios::binary);
+        return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    void WriteFile(char const* pPath, std::vector<char> const& contents)
+    {
+        std::ofstream file(pPath, std::ios::binary | std::ios::trunc);
+        file.write(contents.data(), (std::streamsize)contents.size());
+    }
+
+    void TestHash()
+    {
+        uint8_t const data[13] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13 };
+        uint8_t const zeros[2] = {};
+        CHECK(SceneCache::Hash(data, sizeof(data)) == SceneCache::Hash(data, sizeof(data)));
+        CHECK(SceneCache::Hash(data, sizeof(data)) != SceneCache::Hash(data, sizeof(data), 1));
+        CHECK(SceneCache::Hash(data, 12) != SceneCache::Hash(data, 13));
+        CHECK(SceneCache::Hash(zeros, 1) != SceneCache::Hash(zeros, 2));
+
+        // every byte of the words and of the tail counts
+        uint8_t changed[13];
+        memcpy(changed, data, sizeof(data));
+        bool bAllDiffer = true;
+        for (size_t i = 0; i < sizeof(changed); ++i)
+        {
+            changed[i] ^= 0x80;
+            bAllDiffer &= SceneCache::Hash(changed, sizeof(changed)) != SceneCache::Hash(data, sizeof(data));
+            changed[i] ^= 0x80;
+        }
+        CHECK(bAllDiffer);
+    }
+
+    void TestRoundTrip()
+    {
+        uint64_t const key = 0x0123456789abcdefull;
+        std::mt19937 rng(25);
+
+        // added from several threads in no particular order, with empty and odd sized sections
+        std::vector<std::pair<uint64_t, std::vector<uint8_t>>> sections;
+        for (uint64_t i = 0; i < 64; ++i)
+        {
+            uint64_t const id = (i * 0x9e3779b97f4a7c15ull) | (i % 3 == 0 ? 0x8000000000000000ull : 0);
+            sections.emplace_back(id, MakeBlob(rng, i == 5 ? 0 : rng() % 3000));
+        }
+
+        SceneCache cache;
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < 4; ++t)
+        {
+            threads.emplace_back([&, t]()
+            {
+                for (size_t i = t; i < sections.size(); i += 4)
+                {
+                    cache.Add(sections[i].first, sections[i].second);
+                }
+            });
+        }
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+        CHECK(cache.Save(CachePath, key));
+
+        CHECK(cache.Open(CachePath, key));
+        CHECK(cache.IsOpen());
+        for (auto const& section : sections)
+        {
+            size_t size = 1;
+            void const* pData = cache.Find(section.first, &size);
+            CHECK(size == section.second.size());
+            CHECK(pData != nullptr);
+            if (pData == nullptr || size != section.second.size())
+                continue;
+
+            // the sections are aligned for reading them in place
+            CHECK(reinterpret_cast<uintptr_t>(pData) % 16 == 0);
+            CHECK(memcmp(pData, section.second.data(), size) == 0);
+
+            std::vector<uint8_t> copy;
+            cache.Read(section.first, copy);
+            CHECK(copy == section.second);
+        }
+
+        // a missing section is nullptr and reads empty
+        size_t size = 1;
+        CHECK(cache.Find(42, &size) == nullptr);
+        CHECK(size == 0);
+        std::vector<uint32_t> missing(3);
+        cache.Read(42, missing);
+        CHECK(missing.empty());
+
+        // Save replaces the file that is open, the sections collected before are gone
+        std::vector<uint32_t> const replacement = { 1, 2, 3 };
+        cache.Add(7, replacement);
+        CHECK(cache.Save(CachePath, key + 1));
+        CHECK(!cache.IsOpen());
+        CHECK(cache.Open(CachePath, key + 1));
+        CHECK(cache.Find(sections[1].first, &size) == nullptr);
+        std::vector<uint32_t> read;
+        cache.Read(7, read);
+        CHECK(read == replacement);
+
+        CHECK(cache.Save(CachePath, key));
+        CHECK(cache.Open(CachePath, key));
+        CHECK(cache.Find(7, &size) == nullptr);
+        cache.Close();
+        CHECK(!cache.IsOpen());
+    }
+
+    // A file that wasn't made from the same inputs or by the same version, or that is damaged,
+    // doesn't open and finds nothing
+    void TestInvalidation()
+    {
+        uint64_t const key = 25;
+        std::mt19937 rng(25);
+
+        SceneCache cache;
+        cache.Add(1, MakeBlob(rng, 100));
+        cache.Add(2, MakeBlob(rng, 200));
+        CHECK(cache.Save(CachePath, key));
+        std::vector<char> const good = ReadFile(CachePath);
+        CHECK(good.size() > 300);
+
+        auto checkRejected = [&]()
+        {
+            CHECK(!cache.Open(CachePath, key));
+            CHECK(!cache.IsOpen());
+            size_t size = 1;
+            CHECK(cache.Find(1, &size) == nullptr);
+            CHECK(size == 0);
+        };
+
+        CHECK(!cache.Open(CachePath, key + 1));
+        CHECK(!cache.Open(MissingPath, key));
+        CHECK(cache.Open(CachePath, key));
+
+        // header is magic, version, key and section count
+        std::vector<char> file = good;
+        file[0] ^= 1;
+        WriteFile(CachePath, file);
+        checkRejected();
+
+        file = good;
+        uint32_t const oldVersion = SceneCache::Version - 1;
+        memcpy(&file[4], &oldVersion, sizeof(oldVersion));
+        WriteFile(CachePath, file);
+        checkRejected();
+
+        // more sections than the file has room for
+        file = good;
+        uint64_t const sectionCount = 1000;
+        memcpy(&file[16], &sectionCount, sizeof(sectionCount));
+        WriteFile(CachePath, file);
+        checkRejected();
+
+        // a section table that runs past the end of the file, what is there of it looks fine
+        file.assign(good.begin(), good.begin() + 24);
+        uint64_t const tableCount = 3;
+        memcpy(&file[16], &tableCount, sizeof(tableCount));
+        file.resize(24 + 24, 0);
+        WriteFile(CachePath, file);
+        checkRejected();
+
+        // the end of the last section cut off
+        file = good;
+        file.resize(good.size() - 1);
+        WriteFile(CachePath, file);
+        checkRejected();
+
+        // shorter than a header
+        file.resize(8);
+        WriteFile(CachePath, file);
+        checkRejected();
+
+        WriteFile(CachePath, good);
+        CHECK(cache.Open(CachePath, key));
+        cache.Close();
+
+        // nowhere to write to
+        cache.Add(1, MakeBlob(rng, 10));
+        CHECK(!cache.Save("TestSceneCache.missing/directory/cache.blascache", key));
+
+        DeleteFileA(CachePath);
+    }
+}
+
+int main()
+{
+    TestHash();
+    TestRoundTrip();
+    TestInvalidation();
+
+    return UnitTest::Result("SceneCache");
+}
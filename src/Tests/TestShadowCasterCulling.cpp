@@ -0,0 +1,233 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+
+#include "UnitTest.h"
+
+#include <random>
+
+namespace
+{
+    CasterCullVolume MakeVolume(float minX, float minY, float minZ, float maxX, float maxY, float maxZ)
+    {
+        return { math::Vector4(minX, minY, minZ, 1.0f), math::Vector4(maxX, maxY, maxZ, 1.0f) };
+    }
+
+    uint32_t CullBox(float minX, float minY, float minZ, float maxX, float maxY, float maxZ, CasterCullVolume const* pVolumes, int numVolumes)
+    {
+        return ShadowCasterCulling::CullBox(math::Vector4(minX, minY, minZ, 1.0f), math::Vector4(maxX, maxY, maxZ, 1.0f), pVolumes, numVolumes);
+    }
+
+    void TestCullBox()
+    {
+        // Two volumes side by side, the light looks down -Z
+        CasterCullVolume const volumes[2] = {
+            MakeVolume(-10.0f, -10.0f, -5.0f, 0.0f, 10.0f, 5.0f),
+            MakeVolume(0.0f, -10.0f, -5.0f, 10.0f, 10.0f, 5.0f),
+        };
+
+        CHECK(CullBox(-6.0f, -1.0f, -1.0f, -4.0f, 1.0f, 1.0f, volumes, 2) == 0x1);
+        CHECK(CullBox(4.0f, -1.0f, -1.0f, 6.0f, 1.0f, 1.0f, volumes, 2) == 0x2);
+        CHECK(CullBox(-1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f, volumes, 2) == 0x3);
+
+        // Between the light and the volume, it shadows the volume
+        CHECK(CullBox(-6.0f, -1.0f, 50.0f, -4.0f, 1.0f, 60.0f, volumes, 2) == 0x1);
+        // Below the far side, it can't cast into the volume
+        CHECK(CullBox(-6.0f, -1.0f, -20.0f, -4.0f, 1.0f, -10.0f, volumes, 2) == 0);
+        // Only partly below the far side
+        CHECK(CullBox(-6.0f, -1.0f, -20.0f, -4.0f, 1.0f, -4.0f, volumes, 2) == 0x1);
+
+        // Beside the volumes
+        CHECK(CullBox(11.0f, -1.0f, -1.0f, 12.0f, 1.0f, 1.0f, volumes, 2) == 0);
+        CHECK(CullBox(-12.0f, -1.0f, -1.0f, -11.0f, 1.0f, 1.0f, volumes, 2) == 0);
+        CHECK(CullBox(-6.0f, 11.0f, -1.0f, -4.0f, 12.0f, 1.0f, volumes, 2) == 0);
+        CHECK(CullBox(-6.0f, -12.0f, -1.0f, -4.0f, -11.0f, 1.0f, volumes, 2) == 0);
+
+        // Touching the side counts
+        CHECK(CullBox(10.0f, -1.0f, -1.0f, 12.0f, 1.0f, 1.0f, volumes, 2) == 0x2);
+
+        // Only the given volumes are tested
+        CHECK(CullBox(4.0f, -1.0f, -1.0f, 6.0f, 1.0f, 1.0f, volumes, 1) == 0);
+        CHECK(CullBox(-6.0f, -1.0f, -1.0f, -4.0f, 1.0f, 1.0f, volumes, 0) == 0);
+    }
+
+    void TestTransformBox()
+    {
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<float> angle(-3.14159f, 3.14159f);
+        std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+        std::uniform_real_distribution<float> extent(0.0f, 10.0f);
+
+        for (int i = 0; i < 100; ++i)
+        {
+            math::Matrix4 const matWorldToLight = math::Matrix4::translation(math::Vector3(position(rng), position(rng), position(rng)))
+                * math::Matrix4::rotationX(angle(rng)) * math::Matrix4::rotationY(angle(rng)) * math::Matrix4::rotationZ(angle(rng));
+            math::Vector4 const vCenter(position(rng), position(rng), position(rng), 1.0f);
+            math::Vector4 const vRadius(extent(rng), extent(rng), extent(rng), 0.0f);
+
+            math::Vector4 vBoxMin, vBoxMax;
+            ShadowCasterCulling::TransformBox(matWorldToLight, vCenter, vRadius, &vBoxMin, &vBoxMax);
+
+            // Same box as the bounds of the 8 transformed corners
+            math::Vector4 vCornersMin(FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX);
+            math::Vector4 vCornersMax(-FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX);
+            for (int corner = 0; corner < 8; ++corner)
+            {
+                math::Point3 const vCorner(
+                    vCenter.getX() + ((corner & 1) ? vRadius.getX() : -vRadius.getX()),
+                    vCenter.getY() + ((corner & 2) ? vRadius.getY() : -vRadius.getY()),
+                    vCenter.getZ() + ((corner & 4) ? vRadius.getZ() : -vRadius.getZ()));
+                math::Vector4 const vLightCorner = matWorldToLight * vCorner;
+                vCornersMin = math::SSE::minPerElem(vCornersMin, vLightCorner);
+                vCornersMax = math::SSE::maxPerElem(vCornersMax, vLightCorner);
+            }
+
+            for (int c = 0; c < 3; ++c)
+            {
+                CHECK_NEAR(vBoxMin.getElem(c), vCornersMin.getElem(c), 1e-3);
+                CHECK_NEAR(vBoxMax.getElem(c), vCornersMax.getElem(c), 1e-3);
+            }
+        }
+    }
+
+    void TestCull()
+    {
+        math::Vector4 const vUnitBox(1.0f, 1.0f, 1.0f, 0.0f);
+        math::Matrix4 const matIdentity = math::Matrix4::identity();
+
+        GLTFCommon gltf;
+        uint32_t const left = UnitTest::AddBoxNode(gltf, math::Vector4(-5.0f, 0.0f, 0.0f, 1.0f), vUnitBox, matIdentity);
+        uint32_t const right = UnitTest::AddBoxNode(gltf, math::Vector4(5.0f, 0.0f, 0.0f, 1.0f), vUnitBox, matIdentity);
+        uint32_t const empty = UnitTest::AddEmptyNode(gltf);
+        uint32_t const above = UnitTest::AddBoxNode(gltf, math::Vector4(-5.0f, 0.0f, 50.0f, 1.0f), vUnitBox, matIdentity);
+        uint32_t const below = UnitTest::AddBoxNode(gltf, math::Vector4(-5.0f, 0.0f, -50.0f, 1.0f), vUnitBox, matIdentity);
+        // Far away in object space, moved into the right volume by its world matrix
+        uint32_t const moved = UnitTest::AddBoxNode(gltf, math::Vector4(100.0f, 0.0f, 0.0f, 1.0f), vUnitBox,
+            math::Matrix4::translation(math::Vector3(-95.0f, 0.0f, 0.0f)));
+
+        // The volumes are in light space, the light view moves the scene down by 20
+        CasterCullVolume const volumes[2] = {
+            MakeVolume(-10.0f, -10.0f, -25.0f, 0.0f, 10.0f, -15.0f),
+            MakeVolume(0.0f, -10.0f, -25.0f, 10.0f, 10.0f, -15.0f),
+        };
+        math::Matrix4 const matLightView = math::Matrix4::translation(math::Vector3(0.0f, 0.0f, -20.0f));
+
+        ShadowCasterCulling culling;
+        culling.Cull(&gltf, matLightView, volumes, 2);
+
+        CHECK(culling.GetNodeMasks().size() == gltf.m_nodes.size());
+        CHECK(culling.GetNodeMasks()[left] == 0x1);
+        CHECK(culling.GetNodeMasks()[right] == 0x2);
+        CHECK(culling.GetNodeMasks()[empty] == 0);
+        CHECK(culling.GetNodeMasks()[above] == 0x1);
+        CHECK(culling.GetNodeMasks()[below] == 0);
+        CHECK(culling.GetNodeMasks()[moved] == 0x2);
+
+        CHECK(culling.IsVisible(left, 0));
+        CHECK(!culling.IsVisible(left, 1));
+        CHECK(culling.IsVisible(moved, 1));
+
+        // A mesh with several primitives is visible in every volume one of them is
+        gltf.m_meshes[gltf.m_nodes[left].meshIndex].m_pPrimitives.push_back(gltf.m_meshes[gltf.m_nodes[right].meshIndex].m_pPrimitives[0]);
+        culling.Cull(&gltf, matLightView, volumes, 2);
+        CHECK(culling.GetNodeMasks()[left] == 0x3);
+    }
+
+    void TestClassifyNodes()
+    {
+        math::Vector4 const vCenter(0.0f, 0.0f, 0.0f, 1.0f);
+        math::Vector4 const vUnitBox(1.0f, 1.0f, 1.0f, 0.0f);
+        math::Matrix4 const matIdentity = math::Matrix4::identity();
+
+        GLTFCommon gltf;
+        uint32_t const root = UnitTest::AddBoxNode(gltf, vCenter, vUnitBox, matIdentity);
+        uint32_t const child = UnitTest::AddBoxNode(gltf, vCenter, vUnitBox, matIdentity);
+        uint32_t const skinned = UnitTest::AddBoxNode(gltf, vCenter, vUnitBox, matIdentity);
+        uint32_t const skinnedChild = UnitTest::AddBoxNode(gltf, vCenter, vUnitBox, matIdentity);
+        uint32_t const animated = UnitTest::AddEmptyNode(gltf);
+        uint32_t const animatedChild = UnitTest::AddEmptyNode(gltf);
+        uint32_t const animatedGrandChild = UnitTest::AddBoxNode(gltf, vCenter, vUnitBox, matIdentity);
+
+        gltf.m_nodes[root].m_children.push_back(child);
+        gltf.m_nodes[skinned].m_children.push_back(skinnedChild);
+        gltf.m_nodes[animated].m_children.push_back(animatedChild);
+        gltf.m_nodes[animatedChild].m_children.push_back(animatedGrandChild);
+
+        ShadowCasterCulling culling;
+        culling.ClassifyNodes(&gltf);
+        CHECK(!culling.HasDynamicNodes());
+        CHECK(!culling.IsDynamic(root));
+        CHECK(!culling.IsDynamic(animatedGrandChild));
+
+        gltf.m_nodes[skinned].skinIndex = 0;
+        gltf.m_animations.resize(1);
+        gltf.m_animations[0].m_channels[animated];
+        culling.ClassifyNodes(&gltf);
+
+        CHECK(culling.HasDynamicNodes());
+        CHECK(!culling.IsDynamic(root));
+        CHECK(!culling.IsDynamic(child));
+        CHECK(culling.IsDynamic(skinned));
+        CHECK(culling.IsDynamic(skinnedChild));
+        CHECK(culling.IsDynamic(animated));
+        CHECK(culling.IsDynamic(animatedChild));
+        CHECK(culling.IsDynamic(animatedGrandChild));
+        // Loaded after the classification
+        CHECK(culling.IsDynamic(static_cast<uint32_t>(gltf.m_nodes.size())));
+
+        CasterCullVolume const volume = MakeVolume(-10.0f, -10.0f, -10.0f, 10.0f, 10.0f, 10.0f);
+        culling.Cull(&gltf, matIdentity, &volume, 1);
+
+        typedef ShadowCasterCulling::CasterFilter CasterFilter;
+        CHECK(culling.IsVisible(child, 0, CasterFilter::All));
+        CHECK(culling.IsVisible(child, 0, CasterFilter::Static));
+        CHECK(!culling.IsVisible(child, 0, CasterFilter::Dynamic));
+        CHECK(culling.IsVisible(skinnedChild, 0, CasterFilter::All));
+        CHECK(!culling.IsVisible(skinnedChild, 0, CasterFilter::Static));
+        CHECK(culling.IsVisible(skinnedChild, 0, CasterFilter::Dynamic));
+        // Not visible at all, whatever the filter
+        CHECK(!culling.IsVisible(animated, 0, CasterFilter::Dynamic));
+
+        // The mask the depth pass draws with agrees with IsVisible for every node
+        CasterFilter const filters[] = { CasterFilter::All, CasterFilter::Static, CasterFilter::Dynamic };
+        std::vector<uint8_t> visibleNodes(100, 1);
+        for (CasterFilter filter : filters)
+        {
+            culling.GetVisibleNodes(0, filter, &visibleNodes);
+            CHECK(visibleNodes.size() == gltf.m_nodes.size());
+            for (uint32_t i = 0; i < visibleNodes.size(); ++i)
+            {
+                CHECK((visibleNodes[i] != 0) == culling.IsVisible(i, 0, filter));
+            }
+        }
+        CHECK(visibleNodes[skinnedChild] != 0);
+        CHECK(visibleNodes[child] == 0);
+    }
+}
+
+int main()
+{
+    TestCullBox();
+    TestTransformBox();
+    TestCull();
+    TestClassifyNodes();
+
+    return UnitTest::Result("ShadowCasterCulling");
+}
@@ -0,0 +1,146 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "stdafx.h"
+
+#include "UnitTest.h"
+
+using Raytracing::RangeAllocator;
+
+namespace
+{
+    // CSMManager's FIT_PROJECTION_TO_CASCADES and FIT_TO_NEAR_FAR values, as the UI passes them
+    int const FitToBoundingSphere = 2;
+    int const FitNearFarAABB = 1;
+
+    int const NumCascades = 4;
+    float const ShadowMapWidth = 2048.0f;
+    float const CameraNear = 0.1f;
+    float const SunSize = 0.01f;
+
+    math::Matrix4 const g_matProjection = UnitTest::Perspective(1.0f, 16.0f / 9.0f, CameraNear, 1000.0f);
+    math::Matrix4 const g_matLightView = math::Matrix4::lookAt(math::Point3(30.0f, 100.0f, 20.0f), math::Point3(0.0f, 0.0f, 0.0f), math::Vector3(0.0f, 1.0f, 0.0f));
+    float const g_splitPoints[NumCascades] = { 5.0f, 15.0f, 40.0f, 100.0f };
+    int const g_updateIntervals[NumCascades] = { 1, 1, 2, 4 };
+
+    // What the renderer keeps between frames for one light
+    struct LightShadows
+    {
+        CSMManager csmManager;
+        ShadowCasterCulling casterCulling;
+        ShadowCasterCulling receiverCulling;
+        std::vector<uint8_t> casterNodeMask;
+        std::vector<uint8_t> tlasNodeMask;
+        RangeAllocator scratch;
+    };
+
+    // The CPU side of one frame of shadows as Renderer::OnRender runs it: the cascades, the caster
+    // culling and the depth pass masks, the TLAS instance culling and the scratch suballocations of the builds
+    void RunFrame(LightShadows& light, GLTFCommon& gltf, uint32_t frame)
+    {
+        math::Vector3 const eye(0.3f * frame, 2.0f, -0.2f * frame);
+        math::Vector3 const direction(sinf(0.1f * frame), 0.0f, cosf(0.1f * frame));
+        math::Matrix4 const matView = math::Matrix4::lookAt(math::Point3(eye), math::Point3(eye + direction), math::Vector3(0.0f, 1.0f, 0.0f));
+
+        float partitions[NumCascades];
+        CSMManager::ComputeDepthPartitions(1.0f, 200.0f + frame, NumCascades, 0.7f, partitions);
+
+        uint32_t const updateMask = light.csmManager.ScheduleCascadeUpdates(frame, NumCascades, g_updateIntervals, false);
+        light.csmManager.SetupCascades(g_matProjection, matView, math::Point3(eye), g_matLightView, CameraNear, &gltf, NumCascades, g_splitPoints,
+            FitToBoundingSphere, FitNearFarAABB, ShadowMapWidth, true, partitions, updateMask);
+        light.casterCulling.Cull(&gltf, g_matLightView, light.csmManager.GetCasterCullVolumes().data(), 2 * NumCascades);
+        // the casters the depth pass draws, the cached static ones and the dynamic ones on top
+        for (int i = 0; i < NumCascades; ++i)
+        {
+            light.casterCulling.GetVisibleNodes(NumCascades + i, ShadowCasterCulling::CasterFilter::Static, &light.casterNodeMask);
+            light.casterCulling.GetVisibleNodes(i, ShadowCasterCulling::CasterFilter::Dynamic, &light.casterNodeMask);
+        }
+
+        CasterCullVolume receivers;
+        light.csmManager.ComputeReceiverVolume(g_matProjection, matView, g_matLightView, CameraNear, SunSize, &gltf, &receivers);
+        light.receiverCulling.Cull(&gltf, g_matLightView, &receivers, 1);
+
+        std::vector<uint8_t> const& masks = light.receiverCulling.GetNodeMasks();
+        light.tlasNodeMask.assign(gltf.m_nodes.size(), 0);
+        for (size_t i = 0; i < masks.size(); ++i)
+        {
+            light.tlasNodeMask[i] |= masks[i];
+        }
+
+        // one scratch range per visible instance, the TLAS and skinned BLAS builds drop them all at the end of the frame
+        for (size_t i = 0; i < masks.size(); ++i)
+        {
+            if (masks[i] != 0)
+                light.scratch.Allocate(4096 + 256 * i);
+        }
+        light.scratch.Reset();
+    }
+
+    GLTFCommon MakeScene()
+    {
+        GLTFCommon gltf;
+        math::Matrix4 const matIdentity = math::Matrix4::identity();
+        UnitTest::AddBoxNode(gltf, math::Vector4(0.0f, -1.0f, 0.0f, 1.0f), math::Vector4(200.0f, 1.0f, 200.0f, 0.0f), matIdentity);
+        for (int i = 0; i < 64; ++i)
+        {
+            UnitTest::AddBoxNode(gltf, math::Vector4(-80.0f + 20.0f * (i % 8), 3.0f, -80.0f + 20.0f * (i / 8), 1.0f), math::Vector4(2.0f, 3.0f, 2.0f, 0.0f), matIdentity);
+        }
+        UnitTest::AddEmptyNode(gltf);
+        return gltf;
+    }
+
+    // The first frame sizes the persistent vectors, the ones after it mustn't touch the heap
+    void TestSecondFrameDoesntAllocate()
+    {
+        GLTFCommon gltf = MakeScene();
+
+        LightShadows light;
+        light.csmManager.OnCreate(NumCascades);
+        light.casterCulling.ClassifyNodes(&gltf);
+        light.scratch.Init(1 << 24, 256);
+
+        RunFrame(light, gltf, 0);
+
+        uint64_t const start = AllocationCounter::GetCount();
+        uint64_t const failedScopes = AllocationCounter::GetFailedScopeCount();
+        {
+            AllocationCounter::Scope allocations("TestSteadyStateFrame", true);
+            RunFrame(light, gltf, 1);
+        }
+        CHECK(AllocationCounter::GetCount() == start);
+        CHECK(AllocationCounter::GetFailedScopeCount() == failedScopes);
+
+        // The frames do cover the scene, there's something for the allocations to happen in
+        CHECK(light.csmManager.GetShadowProj().size() == NumCascades);
+        uint32_t visible = 0;
+        for (uint8_t mask : light.tlasNodeMask)
+        {
+            visible += mask != 0 ? 1 : 0;
+        }
+        CHECK(visible > 0);
+        CHECK(visible < gltf.m_nodes.size());
+    }
+}
+
+int main()
+{
+    TestSecondFrameDoesntAllocate();
+
+    return UnitTest::Result("SteadyStateFrame");
+}
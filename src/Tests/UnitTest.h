@@ -0,0 +1,117 @@
+// AMD SampleDX12 sample code
+// 
+// Copyright(c) 2020 Advanced Micro Devices, Inc.All rights reserved.
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+
+//--------------------------------------------------------------------------------------
+// Checks and timing shared by the unit tests. A failed check prints where it failed and
+// the test carries on, main returns UnitTest::Result so ctest sees the failure.
+//--------------------------------------------------------------------------------------
+namespace UnitTest
+{
+    inline int& FailureCount()
+    {
+        static int s_failureCount = 0;
+        return s_failureCount;
+    }
+
+    inline void Check(bool bPassed, char const* pExpression, char const* pFile, int line)
+    {
+        if (!bPassed)
+        {
+            printf("%s(%d): check failed: %s\n", pFile, line, pExpression);
+            ++FailureCount();
+        }
+    }
+
+    inline void CheckNear(double a, double b, double tolerance, char const* pA, char const* pB, char const* pFile, int line)
+    {
+        if (!(fabs(a - b) <= tolerance))
+        {
+            printf("%s(%d): check failed: %s = %g and %s = %g differ by more than %g\n", pFile, line, pA, a, pB, b, tolerance);
+            ++FailureCount();
+        }
+    }
+
+    inline int Result(char const* pName)
+    {
+        printf("%s: %s\n", pName, FailureCount() == 0 ? "passed" : "FAILED");
+        return FailureCount() == 0 ? 0 : 1;
+    }
+
+    // Best time of several runs of f in microseconds, the best run is the one the least disturbed
+    template <typename F>
+    double Measure(int runs, F&& f)
+    {
+        double best = 0.0;
+        for (int i = 0; i < runs; ++i)
+        {
+            auto const start = std::chrono::high_resolution_clock::now();
+            f();
+            double const time = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+            if (i == 0 || time < best)
+                best = time;
+        }
+        return best;
+    }
+
+    // D3D style projection of a camera looking down -Z, depth 0 on the near plane like Cauldron's cameras
+    inline math::Matrix4 Perspective(float fovY, float aspect, float zNear, float zFar)
+    {
+        float const yScale = 1.0f / tanf(0.5f * fovY);
+        float const zRange = zFar / (zNear - zFar);
+        return math::Matrix4(
+            math::Vector4(yScale / aspect, 0.0f, 0.0f, 0.0f),
+            math::Vector4(0.0f, yScale, 0.0f, 0.0f),
+            math::Vector4(0.0f, 0.0f, zRange, -1.0f),
+            math::Vector4(0.0f, 0.0f, zNear * zRange, 0.0f));
+    }
+
+    // Appends a node with a mesh of one primitive, a box given by its center and half extents
+    inline uint32_t AddBoxNode(GLTFCommon& gltf, math::Vector4 const& vCenter, math::Vector4 const& vRadius, math::Matrix4 const& matWorld)
+    {
+        tfMesh mesh;
+        mesh.m_pPrimitives.resize(1);
+        mesh.m_pPrimitives[0].m_center = vCenter;
+        mesh.m_pPrimitives[0].m_radius = vRadius;
+        gltf.m_meshes.push_back(mesh);
+
+        tfNode node;
+        node.meshIndex = static_cast<int>(gltf.m_meshes.size() - 1);
+        gltf.m_nodes.push_back(node);
+
+        gltf.m_worldSpaceMats.emplace_back();
+        gltf.m_worldSpaceMats.back().Set(matWorld);
+        return static_cast<uint32_t>(gltf.m_nodes.size() - 1);
+    }
+
+    inline uint32_t AddEmptyNode(GLTFCommon& gltf)
+    {
+        gltf.m_nodes.push_back(tfNode());
+        gltf.m_worldSpaceMats.emplace_back();
+        gltf.m_worldSpaceMats.back().Set(math::Matrix4::identity());
+        return static_cast<uint32_t>(gltf.m_nodes.size() - 1);
+    }
+}
+
+#define CHECK(expression) UnitTest::Check((expression), #expression, __FILE__, __LINE__)
+#define CHECK_NEAR(a, b, tolerance) UnitTest::CheckNear((a), (b), (tolerance), #a, #b, __FILE__, __LINE__)